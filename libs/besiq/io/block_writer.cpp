@@ -0,0 +1,169 @@
+#include <algorithm>
+
+#include <string.h>
+#include <stdlib.h>
+
+#include <besiq/io/block_writer.hpp>
+
+block_writer::block_writer(FILE *fp, size_t block_size, size_t num_blocks)
+    : m_fp( fp ),
+      m_block_size( block_size ),
+      m_busy( false ),
+      m_stop( false ),
+      m_error( false )
+{
+    if( num_blocks < 2 )
+    {
+        num_blocks = 2;
+    }
+
+    for(size_t i = 0; i < num_blocks; i++)
+    {
+        m_blocks.push_back( (char *) malloc( block_size ) );
+    }
+
+    m_current.data = m_blocks[ 0 ];
+    m_current.length = 0;
+    for(size_t i = 1; i < num_blocks; i++)
+    {
+        m_free.push_back( m_blocks[ i ] );
+    }
+
+    pthread_mutex_init( &m_mutex, NULL );
+    pthread_cond_init( &m_has_full, NULL );
+    pthread_cond_init( &m_has_free, NULL );
+    pthread_create( &m_thread, NULL, &block_writer::writer_main, this );
+}
+
+block_writer::~block_writer()
+{
+    flush( );
+
+    pthread_mutex_lock( &m_mutex );
+    m_stop = true;
+    pthread_cond_signal( &m_has_full );
+    pthread_mutex_unlock( &m_mutex );
+
+    pthread_join( m_thread, NULL );
+
+    pthread_cond_destroy( &m_has_free );
+    pthread_cond_destroy( &m_has_full );
+    pthread_mutex_destroy( &m_mutex );
+
+    for(size_t i = 0; i < m_blocks.size( ); i++)
+    {
+        free( m_blocks[ i ] );
+    }
+}
+
+bool
+block_writer::write(const void *data, size_t length)
+{
+    const char *bytes = (const char *) data;
+    while( length > 0 )
+    {
+        size_t room = m_block_size - m_current.length;
+        size_t chunk = std::min( room, length );
+        memcpy( m_current.data + m_current.length, bytes, chunk );
+        m_current.length += chunk;
+        bytes += chunk;
+        length -= chunk;
+
+        if( m_current.length == m_block_size )
+        {
+            submit_current( );
+        }
+    }
+
+    return good( );
+}
+
+bool
+block_writer::flush()
+{
+    if( m_current.length > 0 )
+    {
+        submit_current( );
+    }
+
+    pthread_mutex_lock( &m_mutex );
+    while( !m_full.empty( ) || m_busy )
+    {
+        pthread_cond_wait( &m_has_free, &m_mutex );
+    }
+    bool error = m_error;
+    pthread_mutex_unlock( &m_mutex );
+
+    if( fflush( m_fp ) != 0 )
+    {
+        error = true;
+    }
+
+    return !error;
+}
+
+bool
+block_writer::good()
+{
+    pthread_mutex_lock( &m_mutex );
+    bool error = m_error;
+    pthread_mutex_unlock( &m_mutex );
+
+    return !error;
+}
+
+void
+block_writer::submit_current()
+{
+    pthread_mutex_lock( &m_mutex );
+    m_full.push_back( m_current );
+    pthread_cond_signal( &m_has_full );
+
+    while( m_free.empty( ) )
+    {
+        pthread_cond_wait( &m_has_free, &m_mutex );
+    }
+    m_current.data = m_free.front( );
+    m_current.length = 0;
+    m_free.pop_front( );
+    pthread_mutex_unlock( &m_mutex );
+}
+
+void *
+block_writer::writer_main(void *arg)
+{
+    block_writer *writer = (block_writer *) arg;
+
+    pthread_mutex_lock( &writer->m_mutex );
+    while( true )
+    {
+        while( writer->m_full.empty( ) && !writer->m_stop )
+        {
+            pthread_cond_wait( &writer->m_has_full, &writer->m_mutex );
+        }
+
+        if( writer->m_full.empty( ) )
+        {
+            break;
+        }
+
+        block current = writer->m_full.front( );
+        writer->m_full.pop_front( );
+        writer->m_busy = true;
+        pthread_mutex_unlock( &writer->m_mutex );
+
+        size_t written = fwrite( current.data, 1, current.length, writer->m_fp );
+
+        pthread_mutex_lock( &writer->m_mutex );
+        if( written != current.length )
+        {
+            writer->m_error = true;
+        }
+        writer->m_busy = false;
+        writer->m_free.push_back( current.data );
+        pthread_cond_broadcast( &writer->m_has_free );
+    }
+    pthread_mutex_unlock( &writer->m_mutex );
+
+    return NULL;
+}
@@ -0,0 +1,167 @@
+#ifndef __BLOCK_WRITER_H__
+#define __BLOCK_WRITER_H__
+
+#include <deque>
+#include <vector>
+
+#include <pthread.h>
+#include <stdio.h>
+
+/**
+ * Default size of each block in bytes.
+ */
+#define BLOCK_WRITER_BLOCK_SIZE ( 4 * 1024 * 1024 )
+
+/**
+ * Default number of blocks, i.e. the block that is currently
+ * being filled plus the blocks that are queued for writing.
+ */
+#define BLOCK_WRITER_NUM_BLOCKS 4
+
+/**
+ * Writes data to a file from a separate thread.
+ *
+ * Data is appended to an in-memory block, when it is full it is
+ * handed over to the writer thread and the next free block is
+ * filled. The number of blocks is fixed, so memory use is bounded
+ * and the caller only waits when the disk cannot keep up with
+ * all queued blocks.
+ *
+ * Only a single thread may call write and flush.
+ */
+class block_writer
+{
+    public:
+        /**
+         * Constructor.
+         *
+         * @param fp File to write to, it is not closed by the writer.
+         * @param block_size Size of each block in bytes.
+         * @param num_blocks Number of blocks, must be at least 2.
+         */
+        block_writer(FILE *fp, size_t block_size = BLOCK_WRITER_BLOCK_SIZE, size_t num_blocks = BLOCK_WRITER_NUM_BLOCKS);
+
+        /**
+         * Destructor, writes all remaining data and stops
+         * the writer thread.
+         */
+        ~block_writer();
+
+        /**
+         * Appends data to the current block.
+         *
+         * @param data Data to write.
+         * @param length Number of bytes to write.
+         *
+         * @return False if a previous write to the file has failed,
+         *         true otherwise.
+         */
+        bool write(const void *data, size_t length);
+
+        /**
+         * Writes all buffered data to the file and waits until it
+         * has been written. After this call the file can be safely
+         * used directly, e.g. to seek and rewrite a header.
+         *
+         * @return True if all data was successfully written, false otherwise.
+         */
+        bool flush();
+
+        /**
+         * Returns false if any write to the file has failed.
+         *
+         * @return False if any write to the file has failed.
+         */
+        bool good();
+
+    private:
+        /**
+         * A block of data.
+         */
+        struct block
+        {
+            char *data;
+            size_t length;
+        };
+
+        /**
+         * Hands over the current block to the writer thread and
+         * waits for a free block to fill.
+         */
+        void submit_current();
+
+        /**
+         * Main loop of the writer thread.
+         *
+         * @param arg Pointer to the block_writer.
+         */
+        static void *writer_main(void *arg);
+
+        /**
+         * File to write to.
+         */
+        FILE *m_fp;
+
+        /**
+         * Size of each block.
+         */
+        size_t m_block_size;
+
+        /**
+         * All allocated blocks.
+         */
+        std::vector<char *> m_blocks;
+
+        /**
+         * The block that is currently being filled.
+         */
+        block m_current;
+
+        /**
+         * Blocks that are waiting to be written.
+         */
+        std::deque<block> m_full;
+
+        /**
+         * Blocks that can be filled.
+         */
+        std::deque<char *> m_free;
+
+        /**
+         * True while the writer thread is writing a block.
+         */
+        bool m_busy;
+
+        /**
+         * Set when the writer thread should exit.
+         */
+        bool m_stop;
+
+        /**
+         * Set when a write to the file has failed, only accessed
+         * while holding m_mutex.
+         */
+        bool m_error;
+
+        /**
+         * Protects the queues and flags.
+         */
+        pthread_mutex_t m_mutex;
+
+        /**
+         * Signaled when a block has been queued for writing.
+         */
+        pthread_cond_t m_has_full;
+
+        /**
+         * Signaled when a block has been written.
+         */
+        pthread_cond_t m_has_free;
+
+        /**
+         * The writer thread.
+         */
+        pthread_t m_thread;
+};
+
+#endif /* End of __BLOCK_WRITER_H__ */
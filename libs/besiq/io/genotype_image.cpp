@@ -0,0 +1,449 @@
+#include <algorithm>
+#include <sstream>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <besiq/io/genotype_image.hpp>
+#include <besiq/io/string_table.hpp>
+
+/**
+ * Keeps a memory mapping alive for as long as the rows that
+ * refer to it are in use, and provides the names, name index
+ * and summaries of the image.
+ */
+class mapped_storage
+: public genotype_storage
+{
+public:
+    mapped_storage(void *addr, size_t length)
+        : m_summaries( NULL ),
+          m_sparse( NULL ),
+          m_addr( addr ),
+          m_length( length )
+    {
+    }
+
+    ~mapped_storage()
+    {
+        munmap( m_addr, m_length );
+    }
+
+    bool has_snp_index() const
+    {
+        return m_names.size( ) > 0;
+    }
+
+    bool find_snp(const std::string &name, size_t *index)
+    {
+        uint32_t found;
+        if( !m_names.find( name, &found ) )
+        {
+            return false;
+        }
+
+        *index = found;
+        return true;
+    }
+
+    bool get_snp_names(std::vector<std::string> *names) const
+    {
+        *names = m_names.to_vector( );
+        return true;
+    }
+
+    const snp_summary *get_summaries() const
+    {
+        return m_summaries;
+    }
+
+    const unsigned char *get_sparse_flags() const
+    {
+        return m_sparse;
+    }
+
+    /**
+     * Names of the rows, they point into the mapping.
+     */
+    string_table m_names;
+
+    /**
+     * Summary of each row, they point into the mapping.
+     */
+    const snp_summary *m_summaries;
+
+    /**
+     * Whether each row is sparse, they point into the mapping.
+     */
+    const unsigned char *m_sparse;
+
+private:
+    void *m_addr;
+    size_t m_length;
+};
+
+/**
+ * Rounds a position up to the alignment of the rows.
+ *
+ * @param x The position.
+ *
+ * @return The aligned position.
+ */
+static uint64_t
+align_image(uint64_t x)
+{
+    return ( x + GENOTYPE_IMAGE_ALIGNMENT - 1 ) / GENOTYPE_IMAGE_ALIGNMENT * GENOTYPE_IMAGE_ALIGNMENT;
+}
+
+/**
+ * Returns the name of a shared memory segment, POSIX requires
+ * it to start with a slash.
+ *
+ * @param name The name given by the user.
+ *
+ * @return The name of the segment.
+ */
+static std::string
+shm_name(const std::string &name)
+{
+    if( !name.empty( ) && name[ 0 ] == '/' )
+    {
+        return name;
+    }
+
+    return "/" + name;
+}
+
+/**
+ * Reads the size and modification time, in nanoseconds, of the
+ * files of a plink file.
+ *
+ * @param plink_prefix Path to the plink file.
+ * @param source The sizes and times will be stored here.
+ *
+ * @return True if all files could be found, false otherwise.
+ */
+static bool
+read_image_source(const std::string &plink_prefix, genotype_image_source *source)
+{
+    const char *extensions[ 3 ] = { ".bed", ".bim", ".fam" };
+
+    memset( source, 0, sizeof( genotype_image_source ) );
+    for(int i = 0; i < 3; i++)
+    {
+        struct stat st;
+        if( stat( ( plink_prefix + extensions[ i ] ).c_str( ), &st ) != 0 )
+        {
+            return false;
+        }
+        source->size[ i ] = st.st_size;
+        source->mtime[ i ] = (int64_t) st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    }
+
+    return true;
+}
+
+/**
+ * Computes the layout of an image.
+ *
+ * @param genotype_file The plink file.
+ * @param packed_names The packed snp names.
+ * @param packed_index The packed index of the snp names.
+ * @param flags The GENOTYPE_IMAGE_* flags.
+ * @param header The layout will be stored here, the magic and source are not set.
+ */
+static void
+layout_genotype_image(plink_file_ptr genotype_file, const std::string &packed_names, const std::string &packed_index, uint32_t flags, genotype_image_header *header)
+{
+    memset( header, 0, sizeof( genotype_image_header ) );
+    header->version = GENOTYPE_IMAGE_VERSION;
+    header->flags = flags;
+    header->num_samples = genotype_file->get_samples( ).size( );
+    header->num_snps = genotype_file->get_loci( ).size( );
+    header->row_length = std::max( align_image( snp_row::num_elements( header->num_samples ) * sizeof( unsigned int ) ), (uint64_t) GENOTYPE_IMAGE_ALIGNMENT );
+    header->names_offset = sizeof( genotype_image_header );
+    header->names_length = packed_names.size( );
+    header->index_offset = align_image( header->names_offset + header->names_length );
+    header->index_length = packed_index.size( );
+    header->summaries_offset = align_image( header->index_offset + header->index_length );
+    header->sparse_offset = header->summaries_offset + header->num_snps * sizeof( snp_summary );
+    header->rows_offset = align_image( header->sparse_offset + header->num_snps );
+    header->size = header->rows_offset + header->num_snps * header->row_length;
+}
+
+/**
+ * Decodes the genotypes into an image that has been laid out
+ * with layout_genotype_image and zero filled, and finally marks
+ * the image as complete.
+ *
+ * @param genotype_file The plink file.
+ * @param packed_names The packed snp names.
+ * @param packed_index The packed index of the snp names.
+ * @param header The layout of the image.
+ * @param image The image.
+ *
+ * @return True if all rows could be read, false otherwise.
+ */
+static bool
+fill_genotype_image(plink_file_ptr genotype_file, const std::string &packed_names, const std::string &packed_index, const genotype_image_header &header, char *image)
+{
+    memcpy( image + header.names_offset, packed_names.data( ), packed_names.size( ) );
+    memcpy( image + header.index_offset, packed_index.data( ), packed_index.size( ) );
+
+    snp_row row;
+    size_t row_bytes = snp_row::num_elements( header.num_samples ) * sizeof( unsigned int );
+    for(uint64_t i = 0; i < header.num_snps; i++)
+    {
+        if( !genotype_file->next_row( row ) || row.size( ) != header.num_samples )
+        {
+            return false;
+        }
+        if( row_bytes > 0 )
+        {
+            memcpy( image + header.rows_offset + i * header.row_length, row.data( ), row_bytes );
+        }
+
+        snp_summary summary = summarize_snp( row );
+        memcpy( image + header.summaries_offset + i * sizeof( snp_summary ), &summary, sizeof( snp_summary ) );
+        image[ header.sparse_offset + i ] = sparse_row::is_sparse( summary, row.size( ) ) ? 1 : 0;
+    }
+
+    memcpy( image, &header, sizeof( genotype_image_header ) );
+    __sync_synchronize( );
+    memcpy( image, GENOTYPE_IMAGE_MAGIC, sizeof( header.magic ) );
+
+    return true;
+}
+
+/**
+ * Sizes an opened file or shared memory segment, maps it and
+ * decodes the genotypes into it.
+ *
+ * @param fd The file or segment, it is not closed.
+ * @param plink_prefix Path to the plink file.
+ * @param genotype_file The plink file.
+ * @param mafflip Whether the plink file was opened with mafflip.
+ *
+ * @return True if the image was created, false otherwise.
+ */
+static bool
+create_genotype_image(int fd, const std::string &plink_prefix, plink_file_ptr genotype_file, bool mafflip)
+{
+    std::string packed_names = string_table::pack( genotype_file->get_locus_names( ) );
+    string_table names;
+    names.open( packed_names.data( ), packed_names.size( ) );
+    std::string packed_index = names.pack_index( );
+
+    genotype_image_header header;
+    layout_genotype_image( genotype_file, packed_names, packed_index, mafflip ? GENOTYPE_IMAGE_MAFFLIP : 0, &header );
+    read_image_source( plink_prefix, &header.source );
+
+    if( ftruncate( fd, header.size ) != 0 )
+    {
+        return false;
+    }
+
+    void *image = mmap( NULL, header.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    if( image == MAP_FAILED )
+    {
+        return false;
+    }
+
+    bool success = fill_genotype_image( genotype_file, packed_names, packed_index, header, (char *) image );
+    if( munmap( image, header.size ) != 0 )
+    {
+        success = false;
+    }
+
+    return success;
+}
+
+/**
+ * Maps an image read-only and creates a genotype matrix whose rows
+ * are views of it, after checking that the image matches the plink
+ * file.
+ *
+ * @param fd The file or segment, it is not closed.
+ * @param genotype_file The plink file.
+ * @param flags The GENOTYPE_IMAGE_* flags that the image must have.
+ * @param source If not NULL, the files that the image must have been created from.
+ *
+ * @return The genotypes, or an empty pointer if the image is invalid.
+ */
+static genotype_matrix_ptr
+open_genotype_image(int fd, plink_file_ptr genotype_file, uint32_t flags, const genotype_image_source *source)
+{
+    struct stat st;
+    if( fstat( fd, &st ) != 0 || st.st_size < (off_t) sizeof( genotype_image_header ) )
+    {
+        return genotype_matrix_ptr( );
+    }
+
+    uint64_t size = st.st_size;
+    void *addr = mmap( NULL, size, PROT_READ, MAP_SHARED, fd, 0 );
+    if( addr == MAP_FAILED )
+    {
+        return genotype_matrix_ptr( );
+    }
+    shared_ptr<mapped_storage> storage( new mapped_storage( addr, size ) );
+    const char *image = (const char *) addr;
+
+    genotype_image_header header;
+    memcpy( &header, image, sizeof( genotype_image_header ) );
+
+    uint64_t row_bytes = snp_row::num_elements( header.num_samples ) * sizeof( unsigned int );
+    if( memcmp( header.magic, GENOTYPE_IMAGE_MAGIC, sizeof( header.magic ) ) != 0 ||
+        header.version != GENOTYPE_IMAGE_VERSION ||
+        header.flags != flags ||
+        header.size > size ||
+        header.num_samples != genotype_file->get_samples( ).size( ) ||
+        header.num_snps != genotype_file->get_loci( ).size( ) ||
+        header.row_length == 0 ||
+        header.row_length < row_bytes ||
+        header.row_length % sizeof( unsigned int ) != 0 ||
+        header.rows_offset % sizeof( unsigned int ) != 0 ||
+        header.names_offset > header.size ||
+        header.names_length > header.size - header.names_offset ||
+        header.index_offset > header.size ||
+        header.index_length > header.size - header.index_offset ||
+        header.summaries_offset > header.size ||
+        header.summaries_offset % sizeof( unsigned int ) != 0 ||
+        ( header.size - header.summaries_offset ) / sizeof( snp_summary ) < header.num_snps ||
+        header.sparse_offset > header.size ||
+        header.size - header.sparse_offset < header.num_snps ||
+        header.rows_offset > header.size ||
+        ( header.size - header.rows_offset ) / header.row_length < header.num_snps )
+    {
+        return genotype_matrix_ptr( );
+    }
+
+    if( source != NULL && memcmp( &header.source, source, sizeof( genotype_image_source ) ) != 0 )
+    {
+        return genotype_matrix_ptr( );
+    }
+
+    if( !storage->m_names.open( image + header.names_offset, header.names_length ) ||
+        storage->m_names.size( ) != header.num_snps ||
+        !storage->m_names.open_index( image + header.index_offset, header.index_length ) )
+    {
+        return genotype_matrix_ptr( );
+    }
+
+    const std::vector<pio_locus_t> &loci = genotype_file->get_loci( );
+    for(size_t i = 0; i < loci.size( ); i++)
+    {
+        if( strcmp( storage->m_names.get( i ), loci[ i ].name ) != 0 )
+        {
+            return genotype_matrix_ptr( );
+        }
+    }
+
+    storage->m_summaries = (const snp_summary *) ( image + header.summaries_offset );
+    storage->m_sparse = (const unsigned char *) ( image + header.sparse_offset );
+
+    shared_ptr< std::vector<snp_row> > genotypes( new std::vector<snp_row>( ) );
+    genotypes->reserve( header.num_snps );
+    for(uint64_t i = 0; i < header.num_snps; i++)
+    {
+        const unsigned int *row = (const unsigned int *) ( image + header.rows_offset + i * header.row_length );
+        genotypes->push_back( snp_row( row, header.num_samples ) );
+    }
+
+    /* The names are only copied from the image if they are asked for. */
+    return genotype_matrix_ptr( new genotype_matrix( genotypes, std::vector<std::string>( ), storage ) );
+}
+
+bool
+create_genotype_shm(const std::string &name, const std::string &plink_prefix, plink_file_ptr genotype_file, bool mafflip)
+{
+    /* Replace any old segment, attached processes keep their mapping. */
+    std::string segment = shm_name( name );
+    shm_unlink( segment.c_str( ) );
+    int fd = shm_open( segment.c_str( ), O_RDWR | O_CREAT | O_EXCL, 0644 );
+    if( fd == -1 )
+    {
+        return false;
+    }
+
+    bool success = create_genotype_image( fd, plink_prefix, genotype_file, mafflip );
+    close( fd );
+    if( !success )
+    {
+        shm_unlink( segment.c_str( ) );
+    }
+
+    return success;
+}
+
+bool
+remove_genotype_shm(const std::string &name)
+{
+    return shm_unlink( shm_name( name ).c_str( ) ) == 0;
+}
+
+genotype_matrix_ptr
+attach_genotype_shm(const std::string &name, plink_file_ptr genotype_file, bool mafflip)
+{
+    int fd = shm_open( shm_name( name ).c_str( ), O_RDONLY, 0 );
+    if( fd == -1 )
+    {
+        return genotype_matrix_ptr( );
+    }
+
+    genotype_matrix_ptr genotypes = open_genotype_image( fd, genotype_file, mafflip ? GENOTYPE_IMAGE_MAFFLIP : 0, NULL );
+    close( fd );
+
+    return genotypes;
+}
+
+bool
+create_genotype_cache(const std::string &plink_prefix, plink_file_ptr genotype_file, bool mafflip)
+{
+    std::ostringstream tmp_path;
+    tmp_path << plink_prefix << GENOTYPE_CACHE_EXTENSION << ".tmp" << getpid( );
+
+    int fd = open( tmp_path.str( ).c_str( ), O_RDWR | O_CREAT | O_TRUNC, 0644 );
+    if( fd == -1 )
+    {
+        return false;
+    }
+
+    bool success = create_genotype_image( fd, plink_prefix, genotype_file, mafflip );
+    if( close( fd ) != 0 )
+    {
+        success = false;
+    }
+
+    if( !success || rename( tmp_path.str( ).c_str( ), ( plink_prefix + GENOTYPE_CACHE_EXTENSION ).c_str( ) ) != 0 )
+    {
+        unlink( tmp_path.str( ).c_str( ) );
+        return false;
+    }
+
+    return true;
+}
+
+genotype_matrix_ptr
+open_genotype_cache(const std::string &plink_prefix, plink_file_ptr genotype_file, bool mafflip)
+{
+    genotype_image_source source;
+    if( !read_image_source( plink_prefix, &source ) )
+    {
+        return genotype_matrix_ptr( );
+    }
+
+    int fd = open( ( plink_prefix + GENOTYPE_CACHE_EXTENSION ).c_str( ), O_RDONLY );
+    if( fd == -1 )
+    {
+        return genotype_matrix_ptr( );
+    }
+
+    genotype_matrix_ptr genotypes = open_genotype_image( fd, genotype_file, mafflip ? GENOTYPE_IMAGE_MAFFLIP : 0, &source );
+    close( fd );
+
+    return genotypes;
+}
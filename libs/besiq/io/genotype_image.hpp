@@ -0,0 +1,177 @@
+#ifndef __GENOTYPE_IMAGE_H__
+#define __GENOTYPE_IMAGE_H__
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#include <plink/plink_file.hpp>
+
+/**
+ * Identifies a genotype image.
+ */
+#define GENOTYPE_IMAGE_MAGIC "BSQGENO"
+
+/**
+ * Version of the image layout, images with a different
+ * version are rejected.
+ */
+#define GENOTYPE_IMAGE_VERSION 4
+
+/**
+ * Flag that is set when the genotypes are coded according to
+ * the minor allele.
+ */
+#define GENOTYPE_IMAGE_MAFFLIP 1
+
+/**
+ * Alignment of the rows in bytes.
+ */
+#define GENOTYPE_IMAGE_ALIGNMENT 64
+
+/**
+ * Extension of the genotype cache that is stored next to
+ * the plink file.
+ */
+#define GENOTYPE_CACHE_EXTENSION ".bsqgeno"
+
+/**
+ * Size and modification time in nanoseconds of the .bed, .bim
+ * and .fam file that an image was created from.
+ */
+struct genotype_image_source
+{
+    uint64_t size[ 3 ];
+    int64_t mtime[ 3 ];
+};
+
+/**
+ * A genotype image is the decoded genotype matrix of a plink
+ * file in the same bit-packed layout as snp_row, so that it can
+ * be used in place by many processes:
+ *
+ *   genotype_image_header header
+ *   char names[ names_length ]             (string_table, at names_offset)
+ *   uint32_t index[ index_length / 4 ]     (string_table index, at index_offset)
+ *   snp_summary summaries[ num_snps ]      (at summaries_offset)
+ *   uint8_t sparse[ num_snps ]             (at sparse_offset, see sparse_row::is_sparse)
+ *   char rows[ num_snps * row_length ]     (at rows_offset)
+ *
+ * The magic is written last, so a reader never sees an image
+ * that is still being filled.
+ */
+struct genotype_image_header
+{
+    /* Equal to GENOTYPE_IMAGE_MAGIC when the image is complete. */
+    char magic[ 8 ];
+
+    /* Version of the layout. */
+    uint32_t version;
+
+    /* Bit mask of GENOTYPE_IMAGE_* flags. */
+    uint32_t flags;
+
+    /* Number of samples in each row. */
+    uint64_t num_samples;
+
+    /* Number of rows. */
+    uint64_t num_snps;
+
+    /* Number of bytes used by each row, including padding. */
+    uint64_t row_length;
+
+    /* Position and length of the snp names. */
+    uint64_t names_offset;
+    uint64_t names_length;
+
+    /* Position and length of the hash index of the snp names. */
+    uint64_t index_offset;
+    uint64_t index_length;
+
+    /* Position of the per snp summaries. */
+    uint64_t summaries_offset;
+
+    /* Position of the per snp flags that are 1 for sparse snps. */
+    uint64_t sparse_offset;
+
+    /* Position of the first row. */
+    uint64_t rows_offset;
+
+    /* Total size of the image in bytes. */
+    uint64_t size;
+
+    /* The files the image was created from. */
+    genotype_image_source source;
+};
+
+/**
+ * Decodes all genotypes of a plink file into a new POSIX shared
+ * memory segment. An existing segment with the same name is
+ * replaced, processes that have already attached the old segment
+ * keep using it.
+ *
+ * @param name Name of the segment, e.g. "/besiq".
+ * @param plink_prefix Path to the plink file.
+ * @param genotype_file The opened plink file, no rows must have been read.
+ * @param mafflip Whether the plink file was opened with mafflip.
+ *
+ * @return True if the segment was created, false otherwise.
+ */
+bool create_genotype_shm(const std::string &name, const std::string &plink_prefix, plink_file_ptr genotype_file, bool mafflip);
+
+/**
+ * Removes a shared memory segment, it is freed when the last
+ * process detaches.
+ *
+ * @param name Name of the segment.
+ *
+ * @return True if the segment was removed, false otherwise.
+ */
+bool remove_genotype_shm(const std::string &name);
+
+/**
+ * Attaches a shared memory segment read-only and returns its
+ * genotypes, the rows and their summaries are views of the
+ * segment. The segment is checked against the samples and snps
+ * of the plink file.
+ *
+ * @param name Name of the segment.
+ * @param genotype_file The plink file the segment was created from.
+ * @param mafflip Whether the genotypes should be coded according to the minor allele.
+ *
+ * @return The genotypes, or an empty pointer if the segment
+ *         could not be attached or does not match the plink file.
+ */
+genotype_matrix_ptr attach_genotype_shm(const std::string &name, plink_file_ptr genotype_file, bool mafflip);
+
+/**
+ * Decodes all genotypes of a plink file into the cache file
+ * plink_prefix.bsqgeno. The cache is written to a temporary file
+ * that is renamed when complete, so concurrent jobs never see a
+ * partial cache.
+ *
+ * @param plink_prefix Path to the plink file.
+ * @param genotype_file The opened plink file, no rows must have been read.
+ * @param mafflip Whether the plink file was opened with mafflip.
+ *
+ * @return True if the cache was created, false otherwise.
+ */
+bool create_genotype_cache(const std::string &plink_prefix, plink_file_ptr genotype_file, bool mafflip);
+
+/**
+ * Memory maps the cache file plink_prefix.bsqgeno and returns its
+ * genotypes, the rows and their summaries are views of the file.
+ * The cache is only used if the size and modification time of the
+ * .bed, .bim and .fam files are the same as when it was created.
+ *
+ * @param plink_prefix Path to the plink file.
+ * @param genotype_file The opened plink file.
+ * @param mafflip Whether the genotypes should be coded according to the minor allele.
+ *
+ * @return The genotypes, or an empty pointer if there is no
+ *         valid cache.
+ */
+genotype_matrix_ptr open_genotype_cache(const std::string &plink_prefix, plink_file_ptr genotype_file, bool mafflip);
+
+#endif /* End of __GENOTYPE_IMAGE_H__ */
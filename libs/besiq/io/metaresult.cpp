@@ -1,7 +1,139 @@
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include <besiq/io/resultfile.hpp>
 
 #include <besiq/io/metaresult.hpp>
 
+/**
+ * A range of records in a memory mapped result file.
+ */
+struct record_range
+{
+    mresultfile *file;
+    uint64_t start;
+    uint64_t end;
+};
+
+/**
+ * Filters a list of memory mapped files. The files are split into
+ * ranges that are filtered in parallel, a batch of ranges at a time
+ * so that the matches are written in file order without keeping the
+ * matches of all files in memory.
+ *
+ * @param files The memory mapped files.
+ * @param column The column to filter on.
+ * @param filter The filter.
+ * @param output The pairs that pass will be written here.
+ * @param num_threads The number of threads to use.
+ * @param values Buffer with room for all columns.
+ *
+ * @return The number of pairs written.
+ */
+static uint64_t
+filter_mapped(const std::vector<mresultfile *> &files, size_t column, const value_filter &filter, resultfile *output, int num_threads, float *values)
+{
+    std::vector<record_range> ranges;
+    for(size_t i = 0; i < files.size( ); i++)
+    {
+        uint64_t num_records = files[ i ]->num_records( );
+        for(uint64_t start = 0; start < num_records; start += META_RANGE_NUM_RECORDS)
+        {
+            record_range range;
+            range.file = files[ i ];
+            range.start = start;
+            range.end = std::min( num_records, start + META_RANGE_NUM_RECORDS );
+            ranges.push_back( range );
+        }
+    }
+
+    uint64_t num_written = 0;
+    int batch_size = std::max( num_threads, 1 ) * 4;
+    std::vector< std::vector<uint64_t> > matches( batch_size );
+    std::pair<std::string, std::string> pair;
+    for(int batch_start = 0; batch_start < (int) ranges.size( ); batch_start += batch_size)
+    {
+        int batch_end = std::min( (int) ranges.size( ), batch_start + batch_size );
+
+        #pragma omp parallel for schedule( dynamic ) num_threads( num_threads )
+        for(int r = batch_start; r < batch_end; r++)
+        {
+            const record_range &range = ranges[ r ];
+            std::vector<uint64_t> &range_matches = matches[ r - batch_start ];
+            range_matches.clear( );
+            for(uint64_t i = range.start; i < range.end; i++)
+            {
+                if( filter( range.file->get_value( i, column ) ) )
+                {
+                    range_matches.push_back( i );
+                }
+            }
+        }
+
+        for(int r = batch_start; r < batch_end; r++)
+        {
+            const std::vector<uint64_t> &range_matches = matches[ r - batch_start ];
+            for(size_t i = 0; i < range_matches.size( ); i++)
+            {
+                if( ranges[ r ].file->read_record( range_matches[ i ], &pair, values ) )
+                {
+                    output->write( pair, values );
+                    num_written++;
+                }
+            }
+        }
+    }
+
+    return num_written;
+}
+
+/**
+ * Filters a columnar file, blocks whose zone map cannot pass the filter
+ * are skipped without reading them, and the remaining columns are only
+ * read for blocks with a passing pair.
+ *
+ * @param file The columnar file.
+ * @param column The column to filter on.
+ * @param filter The filter.
+ * @param output The pairs that pass will be written here.
+ * @param values Buffer with room for all columns.
+ *
+ * @return The number of pairs written.
+ */
+static uint64_t
+filter_columnar(cresultfile *file, size_t column, const value_filter &filter, resultfile *output, float *values)
+{
+    uint64_t num_written = 0;
+    std::pair<std::string, std::string> pair;
+    while( file->next_block( ) )
+    {
+        if( !filter.may_match( file->block_min( column ), file->block_max( column ) ) )
+        {
+            continue;
+        }
+
+        const float *column_values = file->block_column( column );
+        if( column_values == NULL )
+        {
+            break;
+        }
+
+        for(size_t i = 0; i < file->block_num_pairs( ); i++)
+        {
+            if( filter( column_values[ i ] ) && file->block_pair( i, &pair, values ) )
+            {
+                output->write( pair, values );
+                num_written++;
+            }
+        }
+    }
+
+    return num_written;
+}
+
 metaresultfile::metaresultfile(const std::vector<resultfile *> &result_files)
     : m_results( result_files ),
       m_cur_file( 0 )
@@ -49,6 +181,61 @@ metaresultfile::get_header()
     }
 }
 
+uint64_t
+metaresultfile::filter(size_t column, const value_filter &filter, resultfile *output, int num_threads)
+{
+    if( num_threads <= 0 )
+    {
+#ifdef _OPENMP
+        num_threads = omp_get_max_threads( );
+#else
+        num_threads = 1;
+#endif
+    }
+
+    std::vector<float> values( get_header( ).size( ) + 1 );
+    std::pair<std::string, std::string> pair;
+    uint64_t num_written = 0;
+
+    size_t i = 0;
+    while( i < m_results.size( ) )
+    {
+        std::vector<mresultfile *> mapped;
+        while( i < m_results.size( ) && dynamic_cast<mresultfile *>( m_results[ i ] ) != NULL )
+        {
+            mapped.push_back( dynamic_cast<mresultfile *>( m_results[ i ] ) );
+            i++;
+        }
+        if( mapped.size( ) > 0 )
+        {
+            num_written += filter_mapped( mapped, column, filter, output, num_threads, &values[ 0 ] );
+            continue;
+        }
+
+        cresultfile *columnar = dynamic_cast<cresultfile *>( m_results[ i ] );
+        if( columnar != NULL )
+        {
+            num_written += filter_columnar( columnar, column, filter, output, &values[ 0 ] );
+        }
+        else
+        {
+            while( m_results[ i ]->read( &pair, &values[ 0 ] ) )
+            {
+                if( filter( values[ column ] ) )
+                {
+                    output->write( pair, &values[ 0 ] );
+                    num_written++;
+                }
+            }
+        }
+        i++;
+    }
+
+    m_cur_file = m_results.size( );
+
+    return num_written;
+}
+
 std::vector<resultfile *> open_result_files(const std::vector<std::string> &paths)
 {
     std::vector<resultfile *> result_files;
@@ -6,8 +6,48 @@
 
 #include <stdexcept>
 
+#include <stdint.h>
+
 class resultfile;
 
+/**
+ * Number of records in each range that is scanned by a thread.
+ */
+#define META_RANGE_NUM_RECORDS ( 1 << 20 )
+
+/**
+ * A filter on the values of a column.
+ */
+struct value_filter
+{
+    virtual ~value_filter()
+    {
+    }
+
+    /**
+     * Returns true if the value passes the filter.
+     *
+     * @param x The value.
+     *
+     * @return True if the value passes the filter.
+     */
+    virtual bool operator()(float x) const = 0;
+
+    /**
+     * Returns true if some value between min and max may pass the
+     * filter, used to skip blocks of columnar result files.
+     *
+     * @param min Smallest value.
+     * @param max Largest value.
+     *
+     * @return False if no value in the range can pass the filter.
+     */
+    virtual bool may_match(float min, float max) const
+    {
+        return true;
+    }
+};
+
 class result_open_error: public std::exception
 {
 public:
@@ -53,6 +93,22 @@ public:
     uint64_t num_pairs();
     std::vector<std::string> get_header();
 
+    /**
+     * Writes all pairs where the value in the given column passes the
+     * filter to the output, in file order. Memory mapped files are split
+     * into ranges of records that are filtered by several threads, and
+     * blocks in columnar files are skipped using their zone maps.
+     *
+     * @param column The column to filter on.
+     * @param filter The filter.
+     * @param output The pairs that pass will be written here.
+     * @param num_threads The number of threads to use, 0 uses the
+     *                    OpenMP default, e.g. from OMP_NUM_THREADS.
+     *
+     * @return The number of pairs written.
+     */
+    uint64_t filter(size_t column, const value_filter &filter, resultfile *output, int num_threads);
+
 private:
     std::vector<resultfile *> m_results;
     size_t m_cur_file;
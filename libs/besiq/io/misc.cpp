@@ -1,16 +1,34 @@
-#include <iterator>
 #include <sstream>
 
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+
 #include <besiq/io/misc.hpp>
 
 std::vector<std::string>
 unpack_string(const char *snp_name_str)
 {
-    std::string snp_names( snp_name_str );
-    std::stringstream strstr( snp_names );
-    std::istream_iterator<std::string> it( strstr );
-    std::istream_iterator<std::string> end;
-    std::vector<std::string> results( it, end );
+    std::vector<std::string> results;
+    const char *cur = snp_name_str;
+    while( *cur != '\0' )
+    {
+        while( isspace( (unsigned char) *cur ) )
+        {
+            cur++;
+        }
+
+        const char *start = cur;
+        while( *cur != '\0' && !isspace( (unsigned char) *cur ) )
+        {
+            cur++;
+        }
+
+        if( cur != start )
+        {
+            results.push_back( std::string( start, cur ) );
+        }
+    }
 
     return results;
 }
@@ -32,3 +50,157 @@ pack_string(const std::vector<std::string> &snp_names)
 
     return output.str( );
 }
+
+/**
+ * Exactly representable powers of ten.
+ */
+static const double POW10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+/**
+ * Scales x so that it has 6 digits before the decimal point
+ * when x has the given decimal exponent.
+ *
+ * @param x The value to scale.
+ * @param exponent The decimal exponent of x.
+ * @param scaled The scaled value will be stored here.
+ *
+ * @return False if the scaling cannot be done in a single
+ *         correctly rounded operation, true otherwise.
+ */
+static bool
+scale_to_digits(double x, int exponent, double *scaled)
+{
+    int shift = 5 - exponent;
+    if( shift >= 0 && shift <= 22 )
+    {
+        *scaled = x * POW10[ shift ];
+    }
+    else if( shift < 0 && shift >= -22 )
+    {
+        *scaled = x / POW10[ -shift ];
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+size_t
+format_float(float value, char *buffer)
+{
+    double x = value;
+    if( x == 0.0 )
+    {
+        buffer[ 0 ] = '0';
+        buffer[ 1 ] = '\0';
+        return 1;
+    }
+
+    double abs_x = fabs( x );
+    if( !( abs_x <= 3.5e38 ) )
+    {
+        return snprintf( buffer, FORMAT_FLOAT_MAX_LENGTH, "%g", x );
+    }
+
+    /* Find the 6 significant digits, the exponent from log10 can
+     * be off by one so it is adjusted until the digits fit. */
+    int exponent = (int) floor( log10( abs_x ) );
+    double scaled;
+    if( !scale_to_digits( abs_x, exponent, &scaled ) )
+    {
+        return snprintf( buffer, FORMAT_FLOAT_MAX_LENGTH, "%g", x );
+    }
+    while( scaled >= 999999.5 && scale_to_digits( abs_x, exponent + 1, &scaled ) )
+    {
+        exponent++;
+    }
+    while( scaled < 99999.5 && scale_to_digits( abs_x, exponent - 1, &scaled ) )
+    {
+        exponent--;
+    }
+
+    /* Values close to a rounding tie are left to printf, since the
+     * scaling above is not exact. */
+    double fraction = scaled - floor( scaled );
+    if( fabs( fraction - 0.5 ) < 1e-6 || scaled < 99999.5 || scaled >= 999999.5 )
+    {
+        return snprintf( buffer, FORMAT_FLOAT_MAX_LENGTH, "%g", x );
+    }
+
+    unsigned int digits = (unsigned int) ( scaled + 0.5 );
+    char digit_str[ 6 ];
+    for(int i = 5; i >= 0; i--)
+    {
+        digit_str[ i ] = '0' + ( digits % 10 );
+        digits /= 10;
+    }
+
+    int num_digits = 6;
+    while( num_digits > 1 && digit_str[ num_digits - 1 ] == '0' )
+    {
+        num_digits--;
+    }
+
+    char *p = buffer;
+    if( x < 0 )
+    {
+        *p++ = '-';
+    }
+
+    if( exponent < -4 || exponent >= 6 )
+    {
+        *p++ = digit_str[ 0 ];
+        if( num_digits > 1 )
+        {
+            *p++ = '.';
+            for(int i = 1; i < num_digits; i++)
+            {
+                *p++ = digit_str[ i ];
+            }
+        }
+
+        *p++ = 'e';
+        *p++ = exponent < 0 ? '-' : '+';
+        int abs_exponent = exponent < 0 ? -exponent : exponent;
+        if( abs_exponent >= 100 )
+        {
+            *p++ = '0' + abs_exponent / 100;
+        }
+        *p++ = '0' + ( abs_exponent / 10 ) % 10;
+        *p++ = '0' + abs_exponent % 10;
+    }
+    else if( exponent >= 0 )
+    {
+        for(int i = 0; i <= exponent; i++)
+        {
+            *p++ = digit_str[ i ];
+        }
+        if( num_digits > exponent + 1 )
+        {
+            *p++ = '.';
+            for(int i = exponent + 1; i < num_digits; i++)
+            {
+                *p++ = digit_str[ i ];
+            }
+        }
+    }
+    else
+    {
+        *p++ = '0';
+        *p++ = '.';
+        for(int i = 0; i < -exponent - 1; i++)
+        {
+            *p++ = '0';
+        }
+        for(int i = 0; i < num_digits; i++)
+        {
+            *p++ = digit_str[ i ];
+        }
+    }
+
+    *p = '\0';
+    return p - buffer;
+}
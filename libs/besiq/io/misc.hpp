@@ -8,4 +8,22 @@ std::vector<std::string> unpack_string(const char *snp_name_str);
 
 std::string pack_string(const std::vector<std::string> &snp_names);
 
+/**
+ * Maximum number of characters written by format_float,
+ * including the terminating null character.
+ */
+#define FORMAT_FLOAT_MAX_LENGTH 32
+
+/**
+ * Formats a float in the same way as printf with "%g", i.e. the
+ * same as the default formatting of std::ostream, but without
+ * going through the locale and stream machinery.
+ *
+ * @param value The value to format.
+ * @param buffer Output buffer of at least FORMAT_FLOAT_MAX_LENGTH characters.
+ *
+ * @return The number of characters written, excluding the null character.
+ */
+size_t format_float(float value, char *buffer);
+
 #endif /* End of __MISC_H__ */
@@ -3,15 +3,43 @@
 #include <sstream>
 #include <algorithm>
 
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #include <besiq/io/misc.hpp>
 #include <besiq/io/pairfile.hpp>
 
 #define BLOCK_SIZE 4194304ULL
 
+/**
+ * Checks that the version of a pair file is known and that the
+ * format matches it.
+ *
+ * @param header The header of the pair file.
+ *
+ * @return True if the file can be read, false otherwise.
+ */
+static bool
+valid_pair_header(const bpair_header &header)
+{
+    if( header.version == PAIR_CUR_VERSION )
+    {
+        return header.format == PAIR_FORMAT_STRING_TABLE;
+    }
+    else if( header.version == PAIR_NAMES_VERSION )
+    {
+        return header.format == PAIR_FORMAT_NAMES;
+    }
+
+    return false;
+}
+
 bpairfile::bpairfile(const std::string &path)
     : m_path( path ),
       m_mode( "r" ),
-      m_fp( NULL )
+      m_fp( NULL ),
+      m_header_map( NULL ),
+      m_header_map_size( 0 )
 {
 }
 
@@ -19,7 +47,9 @@ bpairfile::bpairfile(const std::string &path, const std::vector<std::string> &sn
     : m_path( path ),
       m_mode( "w" ),
       m_fp( NULL ),
-      m_snp_names( snp_names )
+      m_snp_names( snp_names ),
+      m_header_map( NULL ),
+      m_header_map_size( 0 )
 {
 }
 
@@ -34,7 +64,7 @@ bpairfile::open(size_t split, size_t num_splits)
     if( m_fp == NULL )
     {
         m_header.version = PAIR_CUR_VERSION;
-        m_header.format = 0;
+        m_header.format = PAIR_FORMAT_STRING_TABLE;
         m_header.num_pairs = 0;
         m_header.header_length = 0;
 
@@ -52,29 +82,20 @@ bpairfile::open(size_t split, size_t num_splits)
         fseek( m_fp, 0L, SEEK_SET );
     }
 
+    if( m_fp == NULL )
+    {
+        return false;
+    }
+
     if( m_mode == "r" )
     {
         size_t bytes_read = fread( &m_header, sizeof( bpair_header ), 1, m_fp );
-        if( bytes_read != 1 || m_header.version != PAIR_CUR_VERSION )
+        if( bytes_read != 1 || !valid_pair_header( m_header ) || !read_snp_names( ) )
         {
-            fclose( m_fp );
-            m_fp = NULL;
+            close( );
             return false;
         }
 
-        char *buffer = (char *) malloc( m_header.header_length );
-        bytes_read = fread( buffer, 1, m_header.header_length, m_fp );
-        if( bytes_read != m_header.header_length )
-        {
-            free( buffer );
-            fclose( m_fp );
-            m_fp = NULL;
-            return false;
-        }
-
-        m_snp_names = unpack_string( buffer );
-        free( buffer );
-
         /* Only read a part of the pair file */
         uint64_t pairs_per_split = ( m_header.num_pairs + num_splits - 1 ) / num_splits;
         uint64_t seek_length = sizeof( uint32_t ) * 2 * pairs_per_split * (split - 1);
@@ -87,15 +108,15 @@ bpairfile::open(size_t split, size_t num_splits)
     }
     else
     {
-        std::string snp_names = pack_string( m_snp_names );
-        m_header.header_length = snp_names.size( ) + 1;
+        std::string snp_names = string_table::pack( m_snp_names );
+        m_header.header_length = snp_names.size( );
         size_t bytes_written = fwrite( &m_header, sizeof( bpair_header ), 1, m_fp );
         if( bytes_written != 1 )
         {
             return false;
         }
 
-        bytes_written = fwrite( snp_names.c_str( ), 1, m_header.header_length, m_fp );
+        bytes_written = fwrite( snp_names.data( ), 1, m_header.header_length, m_fp );
         if( bytes_written != m_header.header_length )
         {
             return false;
@@ -105,9 +126,63 @@ bpairfile::open(size_t split, size_t num_splits)
     return m_fp != NULL;
 }
 
+bool
+bpairfile::read_snp_names()
+{
+    if( m_header_map != NULL )
+    {
+        munmap( m_header_map, m_header_map_size );
+        m_header_map = NULL;
+    }
+    m_snp_names.clear( );
+
+    /* A corrupt header length must not map or allocate past the end of the file. */
+    struct stat st;
+    if( fstat( fileno( m_fp ), &st ) != 0 || st.st_size < (off_t) sizeof( bpair_header ) ||
+        m_header.header_length > (uint64_t) st.st_size - sizeof( bpair_header ) )
+    {
+        return false;
+    }
+
+    if( m_header.version == PAIR_CUR_VERSION )
+    {
+        /* Use the names directly from the mapped header instead of copying them. */
+        m_header_map_size = sizeof( bpair_header ) + (size_t) m_header.header_length;
+        void *data = mmap( NULL, m_header_map_size, PROT_READ, MAP_SHARED, fileno( m_fp ), 0 );
+        if( data == MAP_FAILED )
+        {
+            return false;
+        }
+        m_header_map = data;
+
+        return m_snp_table.open( (const char *) data + sizeof( bpair_header ), m_header.header_length ) &&
+               fseek( m_fp, m_header.header_length, SEEK_CUR ) == 0;
+    }
+
+    char *buffer = (char *) malloc( m_header.header_length );
+    size_t bytes_read = fread( buffer, 1, m_header.header_length, m_fp );
+    if( bytes_read != m_header.header_length || m_header.header_length == 0 || buffer[ m_header.header_length - 1 ] != '\0' )
+    {
+        free( buffer );
+        return false;
+    }
+
+    m_packed_snp_names = string_table::pack( unpack_string( buffer ) );
+    free( buffer );
+
+    return m_snp_table.open( m_packed_snp_names.data( ), m_packed_snp_names.size( ) );
+}
+
 void
 bpairfile::close()
 {
+    if( m_header_map != NULL )
+    {
+        m_snp_table.open( NULL, 0 );
+        munmap( m_header_map, m_header_map_size );
+        m_header_map = NULL;
+    }
+
     if( m_fp != NULL )
     {
         if( m_mode == "w" )
@@ -124,11 +199,32 @@ bpairfile::close()
 const std::vector<std::string> &
 bpairfile::get_snp_names()
 {
+    if( m_mode == "r" && m_snp_names.size( ) != m_snp_table.size( ) )
+    {
+        m_snp_names = m_snp_table.to_vector( );
+    }
+
     return m_snp_names;
 }
 
 bool
 bpairfile::read(std::pair<std::string, std::string> &pair)
+{
+    uint32_t snp1;
+    uint32_t snp2;
+    if( !read_ids( &snp1, &snp2 ) )
+    {
+        return false;
+    }
+
+    pair.first = m_snp_table.get( snp1 );
+    pair.second = m_snp_table.get( snp2 );
+
+    return true;
+}
+
+bool
+bpairfile::read_ids(uint32_t *snp1, uint32_t *snp2)
 {
     if( m_mode != "r" || m_fp == NULL || m_pairs_left <= 0 )
     {
@@ -142,13 +238,30 @@ bpairfile::read(std::pair<std::string, std::string> &pair)
         return false;
     }
 
-    pair.first = m_snp_names[ read_pair[ 0 ] ];
-    pair.second = m_snp_names[ read_pair[ 1 ] ];
+    if( read_pair[ 0 ] >= m_snp_table.size( ) || read_pair[ 1 ] >= m_snp_table.size( ) )
+    {
+        return false;
+    }
+
+    *snp1 = read_pair[ 0 ];
+    *snp2 = read_pair[ 1 ];
     m_pairs_left--;
 
     return true;
 }
 
+const char *
+bpairfile::get_snp_name(uint32_t index) const
+{
+    return m_snp_table.get( index );
+}
+
+size_t
+bpairfile::num_snps() const
+{
+    return m_snp_table.size( );
+}
+
 bool
 bpairfile::write(size_t snp_id1, size_t snp_id2)
 {
@@ -333,7 +446,7 @@ open_pair_file(const std::string &path, const std::vector<std::string> &snp_name
     bpair_header header;
     size_t bytes_read = fread( &header, sizeof( bpair_header ), 1, fp );
     fclose( fp );
-    if( bytes_read == 1 && header.version == PAIR_CUR_VERSION )
+    if( bytes_read == 1 && valid_pair_header( header ) )
     {
         return new bpairfile( path );
     }
@@ -370,7 +483,7 @@ char * parse_header(FILE *fp, bpair_header *header)
 {
     /* Parse header info */
     size_t bytes_read = fread( header, sizeof( bpair_header ), 1, fp );
-    if( bytes_read != 1 || header->version != PAIR_CUR_VERSION )
+    if( bytes_read != 1 || !valid_pair_header( *header ) )
     {
         fclose( fp );
         return NULL;
@@ -470,4 +583,69 @@ split_error:
     return !error;
 }
 
+bool
+find_pair_snps(const std::string &path, const std::vector<std::string> &snp_names, size_t split, size_t num_splits, std::vector<bool> *used)
+{
+    if( path == "-" )
+    {
+        return false;
+    }
+
+    pairfile *pairs = open_pair_file( path, snp_names );
+    if( pairs == NULL || !pairs->open( split, num_splits ) )
+    {
+        delete pairs;
+        return false;
+    }
+
+    string_table names( snp_names );
+    used->assign( snp_names.size( ), false );
+
+    bpairfile *binary_pairs = dynamic_cast<bpairfile *>( pairs );
+    if( binary_pairs != NULL )
+    {
+        /* Mark the ids of the file first, so each name is only looked up once. */
+        std::vector<bool> used_ids( binary_pairs->num_snps( ), false );
+        uint32_t snp1;
+        uint32_t snp2;
+        while( binary_pairs->read_ids( &snp1, &snp2 ) )
+        {
+            if( snp1 >= used_ids.size( ) || snp2 >= used_ids.size( ) )
+            {
+                delete pairs;
+                return false;
+            }
+            used_ids[ snp1 ] = true;
+            used_ids[ snp2 ] = true;
+        }
 
+        for(size_t i = 0; i < used_ids.size( ); i++)
+        {
+            uint32_t index;
+            if( used_ids[ i ] && names.find( binary_pairs->get_snp_name( i ), &index ) )
+            {
+                (*used)[ index ] = true;
+            }
+        }
+    }
+    else
+    {
+        std::pair<std::string, std::string> pair;
+        while( pairs->read( pair ) )
+        {
+            uint32_t index;
+            if( names.find( pair.first, &index ) )
+            {
+                (*used)[ index ] = true;
+            }
+            if( names.find( pair.second, &index ) )
+            {
+                (*used)[ index ] = true;
+            }
+        }
+    }
+
+    delete pairs;
+
+    return true;
+}
@@ -9,7 +9,28 @@
 #include <stdlib.h>
 #include <stdio.h>
 
-#define PAIR_CUR_VERSION 0x5cf2d3f2
+#include <besiq/io/string_table.hpp>
+
+#define PAIR_CUR_VERSION 0x5cf2d3f3
+
+/**
+ * Version of older pair files, where the snp names in the header
+ * are separated by tabs.
+ */
+#define PAIR_NAMES_VERSION 0x5cf2d3f2
+
+/**
+ * The snp names in the header are separated by tabs, the format of
+ * PAIR_NAMES_VERSION files.
+ */
+#define PAIR_FORMAT_NAMES 0
+
+/**
+ * The snp names in the header are stored as a string_table, the
+ * format of PAIR_CUR_VERSION files.
+ */
+#define PAIR_FORMAT_STRING_TABLE 1
+
 /**
  * Defines the header.
  */
@@ -22,7 +43,8 @@ struct bpair_header
     uint32_t version;
 
     /**
-     * Indicates the file format.
+     * Indicates the file format, PAIR_FORMAT_NAMES or
+     * PAIR_FORMAT_STRING_TABLE.
      */
     uint32_t format;
 
@@ -103,7 +125,41 @@ public:
     bool write(size_t snp_id1, size_t snp_id2);
     size_t num_pairs();
 
+    /**
+     * Reads the next pair as indices into the snp names of
+     * the file, see get_snp_names.
+     *
+     * @param snp1 Index of the first snp.
+     * @param snp2 Index of the second snp.
+     *
+     * @return True if a pair could be read, false otherwise.
+     */
+    bool read_ids(uint32_t *snp1, uint32_t *snp2);
+
+    /**
+     * Returns the name of a snp.
+     *
+     * @param index Index of the snp.
+     *
+     * @return The name of the snp.
+     */
+    const char *get_snp_name(uint32_t index) const;
+
+    /**
+     * Returns the number of snp names in the file.
+     *
+     * @return The number of snp names.
+     */
+    size_t num_snps() const;
+
 private:
+    /**
+     * Reads the snp names that follow the header.
+     *
+     * @return True if successful, false otherwise.
+     */
+    bool read_snp_names();
+
     /* Path to the file */
     std::string m_path;
 
@@ -116,9 +172,21 @@ private:
     /* Header */
     bpair_header m_header;
 
-    /* Names of the SNPs */
+    /* Names of the SNPs, only created on demand when reading */
     std::vector<std::string> m_snp_names;
 
+    /* Names of the SNPs when reading */
+    string_table m_snp_table;
+
+    /* Packed names when reading a file with tab separated names */
+    std::string m_packed_snp_names;
+
+    /* The memory mapped header when reading a string table */
+    void *m_header_map;
+
+    /* Size of the memory mapped header */
+    size_t m_header_map_size;
+
     /* 
      * Number of pairs left to read.
      */
@@ -128,4 +196,18 @@ private:
 pairfile * open_pair_file(const std::string &path, const std::vector<std::string> &snp_names);
 bool split_pair_file(const std::string &all_pairs, size_t num_splits, const std::string &output_path);
 
+/**
+ * Finds the snps that occur in a part of a pair file. The file is
+ * opened separately, so it can be scanned before it is analyzed.
+ *
+ * @param path Path to the pair file.
+ * @param snp_names Names of the snps in the genotype file.
+ * @param split The part of the file to scan, 1 to num_splits.
+ * @param num_splits Number of parts of the file.
+ * @param used used[ i ] is set to true if snp_names[ i ] occurs in a pair.
+ *
+ * @return True if the file could be scanned, false otherwise.
+ */
+bool find_pair_snps(const std::string &path, const std::vector<std::string> &snp_names, size_t split, size_t num_splits, std::vector<bool> *used);
+
 #endif /* End of __BINARY_PAIR_H__ */
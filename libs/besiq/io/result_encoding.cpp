@@ -0,0 +1,143 @@
+#include <math.h>
+#include <string.h>
+
+#include <besiq/io/result_encoding.hpp>
+#include <besiq/io/resultfile.hpp>
+
+/**
+ * Code of missing values in the integer encodings.
+ */
+#define RESULT_MISSING_UINT8 255
+#define RESULT_MISSING_UINT16 65535
+
+/**
+ * Rounds and clamps a value to an integer code, missing values
+ * and NaN are mapped to the missing code.
+ *
+ * @param value The value.
+ * @param missing The missing code, the largest valid code is one less.
+ *
+ * @return The code.
+ */
+static unsigned int
+integer_code(float value, unsigned int missing)
+{
+    if( value == result_get_missing( ) || value != value )
+    {
+        return missing;
+    }
+
+    float rounded = floorf( value + 0.5f );
+    if( rounded <= 0.0f )
+    {
+        return 0;
+    }
+    if( rounded >= missing - 1 )
+    {
+        return missing - 1;
+    }
+
+    return (unsigned int) rounded;
+}
+
+/**
+ * Decoded p-values of all log p codes.
+ */
+static std::vector<float>
+build_logp_table()
+{
+    std::vector<float> table( RESULT_MISSING_UINT16 + 1 );
+    for(size_t i = 0; i < RESULT_MISSING_UINT16; i++)
+    {
+        table[ i ] = (float) pow( 10.0, -( (double) i ) / RESULT_LOGP16_SCALE );
+    }
+    table[ RESULT_MISSING_UINT16 ] = result_get_missing( );
+
+    return table;
+}
+
+bool
+result_encoding_valid(uint8_t encoding)
+{
+    return encoding <= RESULT_ENCODING_LOGP16;
+}
+
+void
+result_encode(uint8_t encoding, float value, char *output)
+{
+    uint8_t code8;
+    uint16_t code16;
+    switch( encoding )
+    {
+        case RESULT_ENCODING_UINT8:
+            code8 = integer_code( value, RESULT_MISSING_UINT8 );
+            memcpy( output, &code8, sizeof( code8 ) );
+            break;
+        case RESULT_ENCODING_UINT16:
+            code16 = integer_code( value, RESULT_MISSING_UINT16 );
+            memcpy( output, &code16, sizeof( code16 ) );
+            break;
+        case RESULT_ENCODING_LOGP16:
+            if( value == result_get_missing( ) || value != value )
+            {
+                code16 = RESULT_MISSING_UINT16;
+            }
+            else if( value <= 0.0f )
+            {
+                code16 = RESULT_MISSING_UINT16 - 1;
+            }
+            else
+            {
+                code16 = integer_code( -log10( value ) * RESULT_LOGP16_SCALE, RESULT_MISSING_UINT16 );
+            }
+            memcpy( output, &code16, sizeof( code16 ) );
+            break;
+        default:
+            memcpy( output, &value, sizeof( float ) );
+            break;
+    }
+}
+
+float
+result_decode(uint8_t encoding, const char *input)
+{
+    static const std::vector<float> logp_table = build_logp_table( );
+
+    uint8_t code8;
+    uint16_t code16;
+    float value;
+    switch( encoding )
+    {
+        case RESULT_ENCODING_UINT8:
+            memcpy( &code8, input, sizeof( code8 ) );
+            return code8 != RESULT_MISSING_UINT8 ? code8 : result_get_missing( );
+        case RESULT_ENCODING_UINT16:
+            memcpy( &code16, input, sizeof( code16 ) );
+            return code16 != RESULT_MISSING_UINT16 ? code16 : result_get_missing( );
+        case RESULT_ENCODING_LOGP16:
+            memcpy( &code16, input, sizeof( code16 ) );
+            return logp_table[ code16 ];
+        default:
+            memcpy( &value, input, sizeof( float ) );
+            return value;
+    }
+}
+
+std::vector<uint8_t>
+result_default_encodings(const std::vector<std::string> &col_names)
+{
+    std::vector<uint8_t> encodings( col_names.size( ), RESULT_ENCODING_FLOAT );
+    for(size_t i = 0; i < col_names.size( ); i++)
+    {
+        if( col_names[ i ] == "P" || col_names[ i ].compare( 0, 2, "P_" ) == 0 )
+        {
+            encodings[ i ] = RESULT_ENCODING_LOGP16;
+        }
+        else if( col_names[ i ] == "df" || col_names[ i ].compare( 0, 3, "df_" ) == 0 )
+        {
+            encodings[ i ] = RESULT_ENCODING_UINT8;
+        }
+    }
+
+    return encodings;
+}
@@ -0,0 +1,98 @@
+#ifndef __RESULT_ENCODING_H__
+#define __RESULT_ENCODING_H__
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+/**
+ * Column is stored as a 32-bit float.
+ */
+#define RESULT_ENCODING_FLOAT 0
+
+/**
+ * Column is stored as an 8-bit unsigned integer, values are
+ * rounded and clamped to [0, 254], missing values are 255.
+ */
+#define RESULT_ENCODING_UINT8 1
+
+/**
+ * Column is stored as a 16-bit unsigned integer, values are
+ * rounded and clamped to [0, 65534], missing values are 65535.
+ */
+#define RESULT_ENCODING_UINT16 2
+
+/**
+ * Column is a p-value stored as round( -log10( p ) * RESULT_LOGP16_SCALE )
+ * in a 16-bit unsigned integer, missing values are 65535. The relative
+ * error of a decoded p-value is at most 10^(1 / (2 * RESULT_LOGP16_SCALE)) - 1,
+ * i.e. about 0.11%, for all normal positive floats up to 1. Values larger
+ * than 1 are stored as 1 and 0 is stored exactly.
+ */
+#define RESULT_ENCODING_LOGP16 3
+
+/**
+ * Number of codes per order of magnitude in the log p-value encoding.
+ */
+#define RESULT_LOGP16_SCALE 1024
+
+/**
+ * Returns true if the encoding is known.
+ *
+ * @param encoding The encoding.
+ *
+ * @return True if the encoding is known, false otherwise.
+ */
+bool result_encoding_valid(uint8_t encoding);
+
+/**
+ * Returns the number of bytes that a value takes in an encoding.
+ *
+ * @param encoding The encoding.
+ *
+ * @return The number of bytes of an encoded value.
+ */
+inline size_t
+result_encoding_size(uint8_t encoding)
+{
+    switch( encoding )
+    {
+        case RESULT_ENCODING_UINT8: return 1;
+        case RESULT_ENCODING_UINT16: return 2;
+        case RESULT_ENCODING_LOGP16: return 2;
+        default: return 4;
+    }
+}
+
+/**
+ * Encodes a value.
+ *
+ * @param encoding The encoding to use.
+ * @param value The value.
+ * @param output The result_encoding_size( encoding ) encoded bytes will be stored here.
+ */
+void result_encode(uint8_t encoding, float value, char *output);
+
+/**
+ * Decodes a value.
+ *
+ * @param encoding The encoding of the value.
+ * @param input The encoded bytes.
+ *
+ * @return The decoded value, result_get_missing( ) for missing values.
+ */
+float result_decode(uint8_t encoding, const char *input);
+
+/**
+ * Chooses encodings from the names of the columns, p-value columns ("P"
+ * and "P_*") are stored with RESULT_ENCODING_LOGP16, degrees of freedom
+ * ("df" and "df_*") with RESULT_ENCODING_UINT8 and everything else as floats.
+ *
+ * @param col_names The names of the columns.
+ *
+ * @return The encoding of each column.
+ */
+std::vector<uint8_t> result_default_encodings(const std::vector<std::string> &col_names);
+
+#endif /* End of __RESULT_ENCODING_H__ */
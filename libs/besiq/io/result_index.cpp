@@ -0,0 +1,304 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <besiq/io/misc.hpp>
+#include <besiq/io/resultfile.hpp>
+#include <besiq/io/result_index.hpp>
+
+/**
+ * Orders positions by chromosome and then by position.
+ */
+static bool
+position_less(const index_position &a, const index_position &b)
+{
+    if( a.chromosome != b.chromosome )
+    {
+        return a.chromosome < b.chromosome;
+    }
+
+    return a.position < b.position;
+}
+
+/**
+ * Returns the size and modification time of a file.
+ *
+ * @param path Path to the file.
+ * @param size The size will be stored here.
+ * @param mtime The modification time in nanoseconds will be stored here.
+ *
+ * @return True if successful, false otherwise.
+ */
+static bool
+get_file_stamp(const std::string &path, uint64_t *size, int64_t *mtime)
+{
+    struct stat st;
+    if( stat( path.c_str( ), &st ) != 0 )
+    {
+        return false;
+    }
+
+    *size = st.st_size;
+    *mtime = (int64_t) st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    return true;
+}
+
+/**
+ * Reads the positions of the snps in the result file from a .bim file.
+ *
+ * @param bim_path Path to the .bim file.
+ * @param result The result file.
+ * @param positions The positions will be stored here, sorted.
+ * @param chromosomes The chromosome names will be stored here.
+ *
+ * @return True if the file could be read, false otherwise.
+ */
+static bool
+read_positions(const std::string &bim_path, mresultfile &result, std::vector<index_position> *positions, std::vector<std::string> *chromosomes)
+{
+    std::ifstream bim_file( bim_path.c_str( ) );
+    if( !bim_file.good( ) )
+    {
+        return false;
+    }
+
+    std::map<std::string, uint32_t> chromosome_index;
+    std::string line;
+    while( std::getline( bim_file, line ) )
+    {
+        std::istringstream fields( line );
+        std::string chromosome, name, cm;
+        long long bp;
+        if( !( fields >> chromosome >> name >> cm >> bp ) )
+        {
+            continue;
+        }
+
+        uint32_t snp;
+        if( !result.find_snp( name, &snp ) )
+        {
+            continue;
+        }
+
+        if( chromosome_index.count( chromosome ) == 0 )
+        {
+            chromosome_index[ chromosome ] = chromosomes->size( );
+            chromosomes->push_back( chromosome );
+        }
+
+        index_position position;
+        position.snp = snp;
+        position.chromosome = chromosome_index[ chromosome ];
+        position.position = bp;
+        positions->push_back( position );
+    }
+
+    std::sort( positions->begin( ), positions->end( ), position_less );
+
+    return true;
+}
+
+std::string
+result_index_path(const std::string &result_path)
+{
+    return result_path + ".idx";
+}
+
+bool
+build_result_index(mresultfile &result, const std::string &result_path, const std::string &bim_path)
+{
+    result_index_header header;
+    header.version = RESULT_INDEX_VERSION;
+    header.num_snps = result.num_snps( );
+    header.num_records = result.num_records( );
+    if( !get_file_stamp( result_path, &header.result_size, &header.result_mtime ) )
+    {
+        return false;
+    }
+
+    /* Count the records of each snp, and then fill the posting lists. */
+    std::vector<uint64_t> offsets( header.num_snps + 1, 0 );
+    uint32_t snps[ 2 ];
+    for(uint64_t i = 0; i < header.num_records; i++)
+    {
+        result.get_snps( i, snps );
+        if( snps[ 0 ] >= header.num_snps || snps[ 1 ] >= header.num_snps )
+        {
+            return false;
+        }
+
+        offsets[ snps[ 0 ] + 1 ]++;
+        if( snps[ 1 ] != snps[ 0 ] )
+        {
+            offsets[ snps[ 1 ] + 1 ]++;
+        }
+    }
+    for(uint32_t i = 0; i < header.num_snps; i++)
+    {
+        offsets[ i + 1 ] += offsets[ i ];
+    }
+    header.num_postings = offsets[ header.num_snps ];
+
+    std::vector<uint64_t> postings( header.num_postings + 1 );
+    std::vector<uint64_t> next( offsets.begin( ), offsets.end( ) - 1 );
+    for(uint64_t i = 0; i < header.num_records; i++)
+    {
+        result.get_snps( i, snps );
+        postings[ next[ snps[ 0 ] ]++ ] = i;
+        if( snps[ 1 ] != snps[ 0 ] )
+        {
+            postings[ next[ snps[ 1 ] ]++ ] = i;
+        }
+    }
+
+    std::vector<index_position> positions;
+    std::vector<std::string> chromosomes;
+    if( bim_path != "" && !read_positions( bim_path, result, &positions, &chromosomes ) )
+    {
+        return false;
+    }
+    std::string packed_chromosomes = pack_string( chromosomes );
+    header.num_positions = positions.size( );
+    header.chromosome_names_length = packed_chromosomes.size( ) + 1;
+
+    FILE *fp = fopen( result_index_path( result_path ).c_str( ), "w" );
+    if( fp == NULL )
+    {
+        return false;
+    }
+
+    bool success = fwrite( &header, sizeof( result_index_header ), 1, fp ) == 1;
+    success = success && fwrite( &offsets[ 0 ], sizeof( uint64_t ), offsets.size( ), fp ) == offsets.size( );
+    success = success && fwrite( &postings[ 0 ], sizeof( uint64_t ), header.num_postings, fp ) == header.num_postings;
+    if( header.num_positions > 0 )
+    {
+        success = success && fwrite( &positions[ 0 ], sizeof( index_position ), header.num_positions, fp ) == header.num_positions;
+    }
+    success = success && fwrite( packed_chromosomes.c_str( ), 1, header.chromosome_names_length, fp ) == header.chromosome_names_length;
+    success = ( fclose( fp ) == 0 ) && success;
+
+    return success;
+}
+
+result_index::result_index(const std::string &result_path)
+    : m_result_path( result_path ),
+      m_path( result_index_path( result_path ) ),
+      m_data( NULL ),
+      m_size( 0 ),
+      m_offsets( NULL ),
+      m_postings( NULL ),
+      m_positions( NULL )
+{
+}
+
+result_index::~result_index()
+{
+    if( m_data != NULL )
+    {
+        munmap( m_data, m_size );
+    }
+}
+
+bool
+result_index::open(mresultfile &result)
+{
+    int fd = ::open( m_path.c_str( ), O_RDONLY );
+    if( fd == -1 )
+    {
+        return false;
+    }
+
+    struct stat st;
+    if( fstat( fd, &st ) != 0 || st.st_size < (off_t) sizeof( result_index_header ) )
+    {
+        ::close( fd );
+        return false;
+    }
+
+    void *data = mmap( NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+    ::close( fd );
+    if( data == MAP_FAILED )
+    {
+        return false;
+    }
+
+    m_data = (char *) data;
+    m_size = st.st_size;
+    memcpy( &m_header, m_data, sizeof( result_index_header ) );
+
+    uint64_t positions_offset = sizeof( result_index_header ) + sizeof( uint64_t ) * ( m_header.num_snps + 1 + m_header.num_postings );
+    uint64_t names_offset = positions_offset + sizeof( index_position ) * m_header.num_positions;
+    if( m_header.version != RESULT_INDEX_VERSION || names_offset + m_header.chromosome_names_length > m_size ||
+        m_header.chromosome_names_length == 0 || m_data[ names_offset + m_header.chromosome_names_length - 1 ] != '\0' )
+    {
+        return false;
+    }
+
+    /* The index is out of date if the result file has changed. */
+    uint64_t result_size;
+    int64_t result_mtime;
+    if( !get_file_stamp( m_result_path, &result_size, &result_mtime ) ||
+        result_size != m_header.result_size || result_mtime != m_header.result_mtime ||
+        m_header.num_snps != result.num_snps( ) || m_header.num_records != result.num_records( ) )
+    {
+        return false;
+    }
+
+    m_offsets = (const uint64_t *) ( m_data + sizeof( result_index_header ) );
+    m_postings = m_offsets + m_header.num_snps + 1;
+    m_positions = (const index_position *) ( m_data + positions_offset );
+
+    std::vector<std::string> chromosomes = unpack_string( m_data + names_offset );
+    for(size_t i = 0; i < chromosomes.size( ); i++)
+    {
+        m_chromosomes[ chromosomes[ i ] ] = i;
+    }
+
+    return true;
+}
+
+const uint64_t *
+result_index::snp_records(uint32_t snp, uint64_t *length) const
+{
+    if( snp >= m_header.num_snps )
+    {
+        *length = 0;
+        return m_postings;
+    }
+
+    *length = m_offsets[ snp + 1 ] - m_offsets[ snp ];
+    return m_postings + m_offsets[ snp ];
+}
+
+std::vector<uint32_t>
+result_index::region_snps(const std::string &chromosome, int64_t start, int64_t end) const
+{
+    std::vector<uint32_t> snps;
+    std::map<std::string, uint32_t>::const_iterator it = m_chromosomes.find( chromosome );
+    if( it == m_chromosomes.end( ) )
+    {
+        return snps;
+    }
+
+    index_position first;
+    first.chromosome = it->second;
+    first.position = start;
+    first.snp = 0;
+
+    const index_position *end_positions = m_positions + m_header.num_positions;
+    const index_position *cur = std::lower_bound( m_positions, end_positions, first, position_less );
+    for( ; cur != end_positions && cur->chromosome == it->second && cur->position <= end; ++cur )
+    {
+        snps.push_back( cur->snp );
+    }
+
+    return snps;
+}
@@ -0,0 +1,197 @@
+#ifndef __RESULT_INDEX_H__
+#define __RESULT_INDEX_H__
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+class mresultfile;
+
+#define RESULT_INDEX_VERSION 0x61248fd2
+
+#pragma pack(push, 1)
+/**
+ * Header of a result index file. It is followed by the posting list
+ * offsets (num_snps + 1 uint64), the posting lists (num_postings uint64
+ * record indices), the position table (num_positions index_position)
+ * and the packed chromosome names.
+ */
+struct result_index_header
+{
+    /**
+     * Version number / magic number.
+     */
+    uint32_t version;
+
+    /**
+     * Number of snps in the result file.
+     */
+    uint32_t num_snps;
+
+    /**
+     * Number of snps with a known position.
+     */
+    uint32_t num_positions;
+
+    /**
+     * Length of the chromosome names part.
+     */
+    uint32_t chromosome_names_length;
+
+    /**
+     * Number of records in the result file when the index was built.
+     */
+    uint64_t num_records;
+
+    /**
+     * Total length of all posting lists.
+     */
+    uint64_t num_postings;
+
+    /**
+     * Size of the result file when the index was built.
+     */
+    uint64_t result_size;
+
+    /**
+     * Modification time of the result file in nanoseconds when the
+     * index was built, so that a file that is rewritten with the same
+     * number of records is detected.
+     */
+    int64_t result_mtime;
+};
+
+/**
+ * The position of a snp, the table is sorted on chromosome and position.
+ */
+struct index_position
+{
+    /**
+     * Index of the snp in the result file.
+     */
+    uint32_t snp;
+
+    /**
+     * Index of the chromosome name.
+     */
+    uint32_t chromosome;
+
+    /**
+     * Base pair position.
+     */
+    int64_t position;
+};
+#pragma pack(pop)
+
+/**
+ * Returns the path of the index that belongs to a result file.
+ *
+ * @param result_path Path to the result file.
+ *
+ * @return Path to the index file.
+ */
+std::string result_index_path(const std::string &result_path);
+
+/**
+ * Builds an index for a result file, containing the records of each snp
+ * and a table of snp positions from a plink .bim file.
+ *
+ * @param result An opened memory mapped result file.
+ * @param result_path Path to the result file.
+ * @param bim_path Path to a .bim file, or an empty string to
+ *                 only index the snps.
+ *
+ * @return True if the index was written, false otherwise.
+ */
+bool build_result_index(mresultfile &result, const std::string &result_path, const std::string &bim_path);
+
+/**
+ * A memory mapped index of a result file.
+ */
+class result_index
+{
+public:
+    /**
+     * Constructor.
+     *
+     * @param result_path Path to the result file that has been indexed.
+     */
+    result_index(const std::string &result_path);
+
+    /**
+     * Destructor.
+     */
+    ~result_index();
+
+    /**
+     * Opens the index.
+     *
+     * @param result The result file, used to check that the index is up to date.
+     *
+     * @return True if the index could be opened and is up to date, false otherwise.
+     */
+    bool open(mresultfile &result);
+
+    /**
+     * Returns the records that contain the given snp, in file order.
+     *
+     * @param snp Index of the snp in the result file.
+     * @param length The number of records will be stored here.
+     *
+     * @return Pointer to the record indices.
+     */
+    const uint64_t *snp_records(uint32_t snp, uint64_t *length) const;
+
+    /**
+     * Returns the snps located in a region.
+     *
+     * @param chromosome Name of the chromosome as in the .bim file.
+     * @param start First position of the region.
+     * @param end Last position of the region.
+     *
+     * @return Indices of the snps in the result file.
+     */
+    std::vector<uint32_t> region_snps(const std::string &chromosome, int64_t start, int64_t end) const;
+
+private:
+    /**
+     * Path to the result file.
+     */
+    std::string m_result_path;
+
+    /**
+     * Path to the index.
+     */
+    std::string m_path;
+
+    /**
+     * The mapped file.
+     */
+    char *m_data;
+
+    /**
+     * Size of the mapped file.
+     */
+    uint64_t m_size;
+
+    /**
+     * The index header.
+     */
+    result_index_header m_header;
+
+    /**
+     * The parts of the mapped file.
+     */
+    const uint64_t *m_offsets;
+    const uint64_t *m_postings;
+    const index_position *m_positions;
+
+    /**
+     * Maps a chromosome name to its index.
+     */
+    std::map<std::string, uint32_t> m_chromosomes;
+};
+
+#endif /* End of __RESULT_INDEX_H__ */
@@ -0,0 +1,199 @@
+#include <algorithm>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <besiq/io/resultfile.hpp>
+#include <besiq/io/result_sorter.hpp>
+
+/**
+ * Orders sort keys by key, missing and NaN values are placed last
+ * so that the order is a strict weak ordering. Ties keep the input
+ * order.
+ */
+static bool
+sort_key_less(const result_sort_key &a, const result_sort_key &b)
+{
+    bool a_missing = result_is_missing_key( a.key );
+    bool b_missing = result_is_missing_key( b.key );
+    if( a_missing != b_missing )
+    {
+        return b_missing;
+    }
+    if( !a_missing && a.key != b.key )
+    {
+        return a.key < b.key;
+    }
+
+    return a.index < b.index;
+}
+
+bool
+result_run_head_greater::operator()(const result_run_head &a, const result_run_head &b) const
+{
+    result_sort_key ka = { a.key, (uint64_t) a.run };
+    result_sort_key kb = { b.key, (uint64_t) b.run };
+    return sort_key_less( kb, ka );
+}
+
+bool
+result_is_missing_key(float key)
+{
+    return key == result_get_missing( ) || key != key;
+}
+
+bool
+write_indexed_record(const char *record, const std::vector<std::string> &snp_names, resultfile *output)
+{
+    uint32_t snps[ 2 ];
+    memcpy( snps, record, sizeof( snps ) );
+    std::pair<std::string, std::string> pair( snp_names[ snps[ 0 ] ], snp_names[ snps[ 1 ] ] );
+
+    return output->write( pair, (float *) ( record + sizeof( snps ) ) );
+}
+
+result_sorter::result_sorter(size_t record_size, size_t field, size_t memory)
+    : m_record_size( record_size ),
+      m_field( field ),
+      m_memory( memory )
+{
+    m_run_buffer_size = std::max( std::min( (size_t) RESULT_SORTER_RUN_BUFFER_SIZE, memory / 64 ), (size_t) RESULT_SORTER_MIN_RUN_BUFFER_SIZE );
+
+    /* Reserve the buffers once, so that they never grow past the budget. */
+    size_t max_records = std::max( memory / ( record_size + sizeof( result_sort_key ) ), (size_t) 1 );
+    m_buffer.reserve( max_records * record_size );
+    m_keys.reserve( max_records );
+}
+
+result_sorter::~result_sorter()
+{
+    for(size_t i = 0; i < m_runs.size( ); i++)
+    {
+        fclose( m_runs[ i ] );
+        free( m_run_buffers[ i ] );
+    }
+}
+
+bool
+result_sorter::add(const char *record)
+{
+    result_sort_key key;
+    memcpy( &key.key, record + sizeof( uint32_t ) * 2 + m_field * sizeof( float ), sizeof( float ) );
+    key.index = m_keys.size( );
+    m_keys.push_back( key );
+    m_buffer.insert( m_buffer.end( ), record, record + m_record_size );
+
+    if( used_bytes( ) + m_record_size + sizeof( result_sort_key ) > m_memory )
+    {
+        return write_run( );
+    }
+
+    return true;
+}
+
+bool
+result_sorter::merge(const std::vector<std::string> &snp_names, resultfile *output)
+{
+    std::sort( m_keys.begin( ), m_keys.end( ), sort_key_less );
+    if( m_runs.size( ) == 0 )
+    {
+        for(size_t i = 0; i < m_keys.size( ); i++)
+        {
+            if( !write_indexed_record( &m_buffer[ m_keys[ i ].index * m_record_size ], snp_names, output ) )
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    if( m_keys.size( ) > 0 && !write_run( ) )
+    {
+        return false;
+    }
+    std::vector<char>( ).swap( m_buffer );
+
+    std::vector< std::vector<char> > heads( m_runs.size( ), std::vector<char>( m_record_size ) );
+    run_queue queue;
+    for(size_t i = 0; i < m_runs.size( ); i++)
+    {
+        rewind( m_runs[ i ] );
+        push_head( i, &heads[ i ][ 0 ], &queue );
+    }
+
+    while( !queue.empty( ) )
+    {
+        result_run_head head = queue.top( );
+        queue.pop( );
+        if( !write_indexed_record( &heads[ head.run ][ 0 ], snp_names, output ) )
+        {
+            return false;
+        }
+
+        push_head( head.run, &heads[ head.run ][ 0 ], &queue );
+    }
+
+    for(size_t i = 0; i < m_runs.size( ); i++)
+    {
+        if( ferror( m_runs[ i ] ) )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+size_t
+result_sorter::num_runs() const
+{
+    return m_runs.size( );
+}
+
+size_t
+result_sorter::used_bytes() const
+{
+    return m_buffer.size( ) + m_keys.size( ) * sizeof( result_sort_key ) + m_runs.size( ) * m_run_buffer_size;
+}
+
+bool
+result_sorter::write_run()
+{
+    FILE *fp = tmpfile( );
+    if( fp == NULL )
+    {
+        return false;
+    }
+    m_runs.push_back( fp );
+    m_run_buffers.push_back( (char *) malloc( m_run_buffer_size ) );
+    setvbuf( fp, m_run_buffers.back( ), _IOFBF, m_run_buffer_size );
+
+    std::sort( m_keys.begin( ), m_keys.end( ), sort_key_less );
+    for(size_t i = 0; i < m_keys.size( ); i++)
+    {
+        if( fwrite( &m_buffer[ m_keys[ i ].index * m_record_size ], m_record_size, 1, fp ) != 1 )
+        {
+            return false;
+        }
+    }
+
+    m_keys.clear( );
+    m_buffer.clear( );
+
+    return fflush( fp ) == 0;
+}
+
+void
+result_sorter::push_head(size_t run, char *record, run_queue *queue)
+{
+    if( fread( record, m_record_size, 1, m_runs[ run ] ) != 1 )
+    {
+        return;
+    }
+
+    result_run_head head;
+    memcpy( &head.key, record + sizeof( uint32_t ) * 2 + m_field * sizeof( float ), sizeof( float ) );
+    head.run = run;
+    queue->push( head );
+}
@@ -0,0 +1,199 @@
+#ifndef __RESULT_SORTER_H__
+#define __RESULT_SORTER_H__
+
+#include <queue>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+#include <stdio.h>
+
+class resultfile;
+
+/**
+ * Largest size of the stdio buffer of each sorted run, smaller
+ * buffers are used for small memory budgets.
+ */
+#define RESULT_SORTER_RUN_BUFFER_SIZE ( 1024 * 1024 )
+
+/**
+ * Smallest size of the stdio buffer of each sorted run.
+ */
+#define RESULT_SORTER_MIN_RUN_BUFFER_SIZE 4096
+
+/**
+ * A record that is waiting to be sorted, the key is the value
+ * that is sorted on and index is the position of the record in
+ * the buffer.
+ */
+struct result_sort_key
+{
+    float key;
+    uint64_t index;
+};
+
+/**
+ * The head of a sorted run during the merge.
+ */
+struct result_run_head
+{
+    float key;
+    size_t run;
+};
+
+/**
+ * Orders the run heads so that the smallest key is at the top
+ * of a priority queue, ties are broken by the run number so that
+ * the input order is kept.
+ */
+struct result_run_head_greater
+{
+    bool operator()(const result_run_head &a, const result_run_head &b) const;
+};
+
+/**
+ * Returns true if a key has no value to sort on, i.e. it is
+ * missing or NaN.
+ *
+ * @param key The key.
+ *
+ * @return True if the key is missing or NaN.
+ */
+bool result_is_missing_key(float key);
+
+/**
+ * Writes a record that is stored with snp indices to the output file.
+ *
+ * @param record The record, two uint32_t snp indices followed by
+ *               the values as floats.
+ * @param snp_names The names of the snp indices.
+ * @param output The output file.
+ *
+ * @return True if successful, false otherwise.
+ */
+bool write_indexed_record(const char *record, const std::vector<std::string> &snp_names, resultfile *output);
+
+/**
+ * Accumulates records in a bounded buffer, and writes them as
+ * sorted runs to temporary files when it is full. The runs are
+ * then merged into the output file in increasing order of the
+ * sorted value, missing and NaN values are placed last and ties
+ * keep the input order.
+ *
+ * The records, their sort keys and the stdio buffers of the runs
+ * together use at most the given number of bytes, unless every
+ * run only holds one record.
+ */
+class result_sorter
+{
+public:
+    /**
+     * Constructor.
+     *
+     * @param record_size Size of a record in bytes.
+     * @param field Index of the value to sort on.
+     * @param memory Number of bytes that can be used for buffering.
+     */
+    result_sorter(size_t record_size, size_t field, size_t memory);
+
+    /**
+     * Destructor, removes any remaining runs.
+     */
+    ~result_sorter();
+
+    /**
+     * Adds a record.
+     *
+     * @param record The record, see write_indexed_record.
+     *
+     * @return True if successful, false if a run could not be written.
+     */
+    bool add(const char *record);
+
+    /**
+     * Writes all records in sorted order to the output file.
+     *
+     * @param snp_names The names of the snp indices.
+     * @param output The output file.
+     *
+     * @return True if successful, false otherwise.
+     */
+    bool merge(const std::vector<std::string> &snp_names, resultfile *output);
+
+    /**
+     * Returns the number of runs that have been written to
+     * temporary files.
+     *
+     * @return The number of runs.
+     */
+    size_t num_runs() const;
+
+private:
+    typedef std::priority_queue<result_run_head, std::vector<result_run_head>, result_run_head_greater> run_queue;
+
+    /**
+     * Returns the number of bytes used by the buffered records, their
+     * sort keys and the stdio buffers of the runs.
+     *
+     * @return The number of bytes in use.
+     */
+    size_t used_bytes() const;
+
+    /**
+     * Sorts the buffered records and writes them to a temporary file.
+     *
+     * @return True if successful, false otherwise.
+     */
+    bool write_run();
+
+    /**
+     * Reads the next record of a run and pushes it on the queue.
+     *
+     * @param run Index of the run.
+     * @param record The record will be stored here.
+     * @param queue The priority queue of run heads.
+     */
+    void push_head(size_t run, char *record, run_queue *queue);
+
+    /**
+     * Size of a record in bytes.
+     */
+    size_t m_record_size;
+
+    /**
+     * Index of the value to sort on.
+     */
+    size_t m_field;
+
+    /**
+     * Number of bytes that can be used for buffering.
+     */
+    size_t m_memory;
+
+    /**
+     * Size of the stdio buffer of each run.
+     */
+    size_t m_run_buffer_size;
+
+    /**
+     * Buffered records.
+     */
+    std::vector<char> m_buffer;
+
+    /**
+     * Sort keys of the buffered records.
+     */
+    std::vector<result_sort_key> m_keys;
+
+    /**
+     * Temporary files with sorted runs.
+     */
+    std::vector<FILE *> m_runs;
+
+    /**
+     * Stdio buffers of the temporary files.
+     */
+    std::vector<char *> m_run_buffers;
+};
+
+#endif /* End of __RESULT_SORTER_H__ */
@@ -1,42 +1,848 @@
+#include <sys/mman.h>
 #include <sys/stat.h>
 
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <float.h>
+#include <string.h>
+
+#include <zlib.h>
+
 #include <besiq/io/misc.hpp>
 #include <besiq/io/resultfile.hpp>
+#include <besiq/io/string_table.hpp>
+
+/**
+ * Checks that the version of a binary result file is known and
+ * that the format flags match it.
+ *
+ * @param header The header of the file.
+ * @param version The current version of the file type.
+ * @param names_version The older version of the file type, where
+ *                      the snp names are separated by tabs.
+ *
+ * @return True if the file can be read, false otherwise.
+ */
+static bool
+valid_result_header(const result_header &header, uint32_t version, uint32_t names_version)
+{
+    if( ( header.format & ~( RESULT_FORMAT_ENCODED | RESULT_FORMAT_STRING_TABLE ) ) != 0 )
+    {
+        return false;
+    }
+
+    bool has_string_table = ( header.format & RESULT_FORMAT_STRING_TABLE ) != 0;
+    if( header.version == version )
+    {
+        return has_string_table;
+    }
+    else if( header.version == names_version )
+    {
+        return !has_string_table;
+    }
+
+    return false;
+}
+
+/**
+ * Reads the header and the snp and column names of a binary
+ * result file.
+ *
+ * @param fp File positioned at the start of the header.
+ * @param version Current version of the file type.
+ * @param names_version Older version of the file type, where the
+ *                      snp names are separated by tabs.
+ * @param header The header will be stored here.
+ * @param snp_names The snp names will be stored here as a packed
+ *                  string_table, older files are converted.
+ * @param col_names The column names will be stored here.
+ * @param encodings The column encodings will be stored here, they are
+ *                  empty if all columns are floats. If NULL only files
+ *                  with float columns can be read.
+ *
+ * @return True if successful, false otherwise.
+ */
+static bool
+read_result_header(FILE *fp, uint32_t version, uint32_t names_version, result_header *header, std::string *snp_names, std::vector<std::string> *col_names, std::vector<uint8_t> *encodings)
+{
+    size_t bytes_read = fread( header, sizeof( result_header ), 1, fp );
+    if( bytes_read != 1 || !valid_result_header( *header, version, names_version ) || header->snp_names_length == 0 )
+    {
+        return false;
+    }
+
+    if( header->version == version )
+    {
+        /* The table is kept packed, so no string is created for each name. */
+        snp_names->resize( header->snp_names_length );
+        bytes_read = fread( &(*snp_names)[ 0 ], 1, header->snp_names_length, fp );
+        if( bytes_read != header->snp_names_length )
+        {
+            return false;
+        }
+    }
+    else
+    {
+        char *buffer = (char *) malloc( header->snp_names_length );
+        bytes_read = fread( buffer, 1, header->snp_names_length, fp );
+        if( bytes_read != header->snp_names_length || buffer[ header->snp_names_length - 1 ] != '\0' )
+        {
+            free( buffer );
+            return false;
+        }
+
+        *snp_names = string_table::pack( unpack_string( buffer ) );
+        free( buffer );
+    }
+
+    char *buffer = (char *) malloc( header->col_names_length );
+    bytes_read = fread( buffer, 1, header->col_names_length, fp );
+    if( bytes_read != header->col_names_length )
+    {
+        free( buffer );
+        return false;
+    }
+
+    *col_names = unpack_string( buffer );
+    free( buffer );
+
+    if( !( header->format & RESULT_FORMAT_ENCODED ) )
+    {
+        if( encodings != NULL )
+        {
+            encodings->clear( );
+        }
+        return true;
+    }
+    if( encodings == NULL )
+    {
+        return false;
+    }
+
+    encodings->resize( header->num_float_cols );
+    if( header->num_float_cols > 0 && fread( &(*encodings)[ 0 ], 1, header->num_float_cols, fp ) != header->num_float_cols )
+    {
+        return false;
+    }
+    for(size_t i = 0; i < encodings->size( ); i++)
+    {
+        if( !result_encoding_valid( (*encodings)[ i ] ) )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Returns true if any column is stored with another encoding
+ * than float.
+ *
+ * @param encodings The encoding of each column.
+ *
+ * @return True if any column is not a float.
+ */
+static bool
+has_encoded_columns(const std::vector<uint8_t> &encodings)
+{
+    for(size_t i = 0; i < encodings.size( ); i++)
+    {
+        if( encodings[ i ] != RESULT_ENCODING_FLOAT )
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Returns the size of a record in a row-major result file.
+ *
+ * @param num_cols Number of columns.
+ * @param encodings The encoding of each column, or empty if
+ *                  all columns are floats.
+ *
+ * @return The size of a record in bytes.
+ */
+static size_t
+result_record_size(size_t num_cols, const std::vector<uint8_t> &encodings)
+{
+    size_t record_size = sizeof( uint32_t ) * 2;
+    for(size_t i = 0; i < num_cols; i++)
+    {
+        record_size += i < encodings.size( ) ? result_encoding_size( encodings[ i ] ) : sizeof( float );
+    }
+
+    return record_size;
+}
+
+/**
+ * Writes the header and the snp and column names of a binary
+ * result file at the start of the file, the name lengths and
+ * number of columns in the header are updated.
+ *
+ * @param fp File to write to.
+ * @param header The header to write.
+ * @param snp_names The snp names.
+ * @param col_names The column names.
+ * @param encodings The column encodings, if any column is not a
+ *                  float they are written after the column names.
+ *
+ * @return True if successful, false otherwise.
+ */
+static bool
+write_result_header(FILE *fp, result_header *header, const std::vector<std::string> &snp_names, const std::vector<std::string> &col_names, const std::vector<uint8_t> &encodings)
+{
+    fseek( fp, 0L, SEEK_SET );
+
+    std::string packed_snp_names = string_table::pack( snp_names );
+    std::string packed_col_names = pack_string( col_names );
+
+    header->snp_names_length = packed_snp_names.size( );
+    header->col_names_length = packed_col_names.size( ) + 1;
+    header->num_float_cols = col_names.size( );
+    header->format = RESULT_FORMAT_STRING_TABLE;
+    if( has_encoded_columns( encodings ) )
+    {
+        header->format |= RESULT_FORMAT_ENCODED;
+    }
+
+    size_t bytes_written = fwrite( header, sizeof( result_header ), 1, fp );
+    if( bytes_written != 1 )
+    {
+        return false;
+    }
+
+    bytes_written = fwrite( packed_snp_names.data( ), 1, header->snp_names_length, fp );
+    if( bytes_written != header->snp_names_length )
+    {
+        return false;
+    }
+
+    bytes_written = fwrite( packed_col_names.c_str( ), 1, header->col_names_length, fp );
+    if( bytes_written != header->col_names_length )
+    {
+        return false;
+    }
+
+    if( header->format & RESULT_FORMAT_ENCODED )
+    {
+        bytes_written = fwrite( &encodings[ 0 ], 1, encodings.size( ), fp );
+        if( bytes_written != encodings.size( ) )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
 
 bresultfile::bresultfile(const std::string &path)
     : m_mode( "r" ),
       m_path( path ),
-      m_fp( NULL )
+      m_fp( NULL ),
+      m_last_snp1( 0 ),
+      m_writer( NULL ),
+      m_compact( false )
+{
+}
+
+bresultfile::bresultfile(const std::string &path, const std::vector<std::string> &snp_names)
+    : m_mode( "w" ),
+      m_path( path ),
+      m_fp( NULL ),
+      m_snp_names( snp_names ),
+      m_snp_table( snp_names ),
+      m_last_snp1( 0 ),
+      m_writer( NULL ),
+      m_compact( false )
+{
+}
+
+bresultfile::~bresultfile()
+{
+    close( );
+}
+
+bool
+bresultfile::open()
+{
+    if( m_fp != NULL )
+    {
+        fseek( m_fp, 0L, SEEK_SET );
+    }
+
+    m_header.version = RESULT_CUR_VERSION;
+    m_header.format = 0;
+    m_header.snp_names_length = 0;
+    m_header.col_names_length = 0;
+    m_header.num_pairs = 0;
+    m_header.num_float_cols = 0;
+
+    m_fp = fopen( m_path.c_str( ), m_mode.c_str( ) );
+    if( m_fp == NULL )
+    {
+        return false;
+    }
+
+    if( m_mode == "r" )
+    {
+        m_snp_names.clear( );
+        if( !read_result_header( m_fp, RESULT_CUR_VERSION, RESULT_NAMES_VERSION, &m_header, &m_packed_snp_names, &m_col_names, &m_encodings ) ||
+            !m_snp_table.open( m_packed_snp_names.data( ), m_packed_snp_names.size( ) ) )
+        {
+            fclose( m_fp );
+            m_fp = NULL;
+            return false;
+        }
+        m_record.resize( result_record_size( m_header.num_float_cols, m_encodings ) );
+    }
+    else
+    {
+        if( m_writer == NULL )
+        {
+            m_writer = new block_writer( m_fp );
+        }
+
+        return set_header( m_col_names );
+    }
+
+    return m_fp != NULL;
+}
+
+bool
+bresultfile::read(std::pair<std::string, std::string> *pair, float *values)
+{
+    if( m_fp == NULL || m_mode != "r" )
+    {
+        return false;
+    }
+
+    size_t bytes_read = fread( &m_record[ 0 ], m_record.size( ), 1, m_fp );
+    if( bytes_read != 1 )
+    {
+        return false;
+    }
+
+    uint32_t snps[ 2 ];
+    memcpy( snps, &m_record[ 0 ], sizeof( snps ) );
+    if( snps[ 0 ] >= m_snp_table.size( ) || snps[ 1 ] >= m_snp_table.size( ) )
+    {
+        return false;
+    }
+
+    pair->first = m_snp_table.get( snps[ 0 ] );
+    pair->second = m_snp_table.get( snps[ 1 ] );
+
+    if( m_encodings.empty( ) )
+    {
+        memcpy( values, &m_record[ sizeof( snps ) ], sizeof( float ) * m_header.num_float_cols );
+        return true;
+    }
+
+    const char *encoded = &m_record[ sizeof( snps ) ];
+    for(size_t i = 0; i < m_encodings.size( ); i++)
+    {
+        values[ i ] = result_decode( m_encodings[ i ], encoded );
+        encoded += result_encoding_size( m_encodings[ i ] );
+    }
+
+    return true;
+}
+
+bool
+bresultfile::write(const std::pair<std::string, std::string> &pair, float *values)
+{
+    if( m_mode != "w" || m_fp == NULL )
+    {
+        return false;
+    }
+
+    if( m_last_snp1_name.empty( ) || m_last_snp1_name != pair.first )
+    {
+        m_last_snp1_name.clear( );
+        if( !m_snp_table.find( pair.first, &m_last_snp1 ) )
+        {
+            return false;
+        }
+        m_last_snp1_name = pair.first;
+    }
+
+    uint32_t snp2;
+    if( !m_snp_table.find( pair.second, &snp2 ) )
+    {
+        return false;
+    }
+
+    uint32_t write_pair[] = { m_last_snp1, snp2 };
+    memcpy( &m_record[ 0 ], write_pair, sizeof( write_pair ) );
+    if( m_encodings.empty( ) )
+    {
+        memcpy( &m_record[ sizeof( write_pair ) ], values, sizeof( float ) * m_header.num_float_cols );
+    }
+    else
+    {
+        char *encoded = &m_record[ sizeof( write_pair ) ];
+        for(size_t i = 0; i < m_encodings.size( ); i++)
+        {
+            result_encode( m_encodings[ i ], values[ i ], encoded );
+            encoded += result_encoding_size( m_encodings[ i ] );
+        }
+    }
+    if( !m_writer->write( &m_record[ 0 ], m_record.size( ) ) )
+    {
+        return false;
+    }
+
+    m_header.num_pairs++;
+
+    return true;
+}
+
+void
+bresultfile::close()
+{
+    if( m_writer != NULL )
+    {
+        delete m_writer;
+        m_writer = NULL;
+    }
+
+    if( m_fp != NULL )
+    {
+        if( m_mode == "w" )
+        {
+            fseek( m_fp, 0L, SEEK_SET );
+            fwrite( &m_header, sizeof( result_header ), 1, m_fp );
+        }
+
+        fclose( m_fp );
+        m_fp = NULL;
+    }
+}
+
+uint64_t
+bresultfile::num_pairs()
+{
+    if( m_fp != NULL )
+    {
+        return m_header.num_pairs;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+const std::vector<std::string> &
+bresultfile::get_header()
+{
+    return m_col_names;
+}
+const std::vector<std::string> &
+bresultfile::get_snp_names()
+{
+    if( m_mode == "r" && m_snp_names.size( ) != m_snp_table.size( ) )
+    {
+        m_snp_names = m_snp_table.to_vector( );
+    }
+
+    return m_snp_names;
+}
+
+bool
+bresultfile::set_header(const std::vector<std::string> &col_names)
+{
+    if( m_fp == NULL )
+    {
+        return false;
+    }
+
+    if( m_writer != NULL )
+    {
+        m_writer->flush( );
+    }
+
+    if( m_compact )
+    {
+        m_encodings = result_default_encodings( col_names );
+    }
+    if( !m_encodings.empty( ) && m_encodings.size( ) != col_names.size( ) )
+    {
+        return false;
+    }
+    if( !has_encoded_columns( m_encodings ) )
+    {
+        m_encodings.clear( );
+    }
+
+    m_col_names = col_names;
+    bool success = write_result_header( m_fp, &m_header, m_snp_names, m_col_names, m_encodings );
+    m_record.resize( result_record_size( m_header.num_float_cols, m_encodings ) );
+
+    return success;
+}
+
+void
+bresultfile::set_encodings(const std::vector<uint8_t> &encodings)
+{
+    m_encodings = encodings;
+    m_compact = false;
+}
+
+void
+bresultfile::use_compact_encodings()
+{
+    m_compact = true;
+}
+
+const std::vector<uint8_t> &
+bresultfile::get_encodings()
+{
+    return m_encodings;
+}
+
+bool
+bresultfile::is_corrupted()
+{
+    struct stat st;
+    if( fstat( fileno( m_fp ), &st ) != 0 )
+    {
+        return false;
+    }
+
+    uint64_t pair_size = (st.st_size - sizeof( result_header ) - m_header.snp_names_length - m_header.col_names_length);
+    if( m_header.format & RESULT_FORMAT_ENCODED )
+    {
+        pair_size -= m_header.num_float_cols;
+    }
+    uint64_t row_size = m_record.size( );
+
+    uint64_t num_pairs = pair_size / row_size;
+    return num_pairs != m_header.num_pairs;
+}
+
+mresultfile::mresultfile(const std::string &path)
+    : m_path( path ),
+      m_data( NULL ),
+      m_size( 0 ),
+      m_records( NULL ),
+      m_record_size( 0 ),
+      m_num_records( 0 ),
+      m_cur_record( 0 )
+{
+}
+
+mresultfile::~mresultfile()
+{
+    close( );
+}
+
+bool
+mresultfile::open()
+{
+    if( m_data != NULL )
+    {
+        return false;
+    }
+
+    int fd = ::open( m_path.c_str( ), O_RDONLY );
+    if( fd == -1 )
+    {
+        return false;
+    }
+
+    struct stat st;
+    if( fstat( fd, &st ) != 0 || st.st_size < (off_t) sizeof( result_header ) )
+    {
+        ::close( fd );
+        return false;
+    }
+
+    void *data = mmap( NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+    ::close( fd );
+    if( data == MAP_FAILED )
+    {
+        return false;
+    }
+
+    m_data = (char *) data;
+    m_size = st.st_size;
+
+    memcpy( &m_header, m_data, sizeof( result_header ) );
+    uint64_t names_end = sizeof( result_header ) + (uint64_t) m_header.snp_names_length + m_header.col_names_length;
+    if( !valid_result_header( m_header, RESULT_CUR_VERSION, RESULT_NAMES_VERSION ) || names_end > m_size ||
+        m_header.snp_names_length == 0 || m_header.col_names_length == 0 ||
+        m_data[ sizeof( result_header ) + m_header.snp_names_length - 1 ] != '\0' ||
+        m_data[ names_end - 1 ] != '\0' )
+    {
+        close( );
+        return false;
+    }
+
+    /* The string table is used in place, so the names are only created if they are asked for. */
+    const char *snp_names = m_data + sizeof( result_header );
+    uint64_t snp_names_length = m_header.snp_names_length;
+    m_snp_names.clear( );
+    if( m_header.version == RESULT_NAMES_VERSION )
+    {
+        m_packed_snp_names = string_table::pack( unpack_string( snp_names ) );
+        snp_names = m_packed_snp_names.data( );
+        snp_names_length = m_packed_snp_names.size( );
+    }
+    if( !m_snp_table.open( snp_names, snp_names_length ) )
+    {
+        close( );
+        return false;
+    }
+    m_col_names = unpack_string( m_data + sizeof( result_header ) + m_header.snp_names_length );
+
+    m_encodings.assign( m_header.num_float_cols, RESULT_ENCODING_FLOAT );
+    if( m_header.format & RESULT_FORMAT_ENCODED )
+    {
+        if( names_end + m_header.num_float_cols > m_size )
+        {
+            close( );
+            return false;
+        }
+        if( m_header.num_float_cols > 0 )
+        {
+            memcpy( &m_encodings[ 0 ], m_data + names_end, m_header.num_float_cols );
+        }
+        names_end += m_header.num_float_cols;
+    }
+
+    m_col_offsets.resize( m_header.num_float_cols );
+    m_record_size = sizeof( uint32_t ) * 2;
+    for(size_t i = 0; i < m_encodings.size( ); i++)
+    {
+        if( !result_encoding_valid( m_encodings[ i ] ) )
+        {
+            close( );
+            return false;
+        }
+        m_col_offsets[ i ] = m_record_size;
+        m_record_size += result_encoding_size( m_encodings[ i ] );
+    }
+
+    m_records = m_data + names_end;
+    m_num_records = ( m_size - names_end ) / m_record_size;
+    m_cur_record = 0;
+
+    return true;
+}
+
+void
+mresultfile::close()
+{
+    if( m_data != NULL )
+    {
+        munmap( m_data, m_size );
+        m_data = NULL;
+        m_records = NULL;
+        m_size = 0;
+        m_num_records = 0;
+        m_snp_table.open( NULL, 0 );
+    }
+}
+
+bool
+mresultfile::read_record(uint64_t index, std::pair<std::string, std::string> *pair, float *values)
+{
+    if( index >= m_num_records )
+    {
+        return false;
+    }
+
+    const char *record = m_records + index * m_record_size;
+    uint32_t snps[ 2 ];
+    memcpy( snps, record, sizeof( snps ) );
+    if( snps[ 0 ] >= m_snp_table.size( ) || snps[ 1 ] >= m_snp_table.size( ) )
+    {
+        return false;
+    }
+
+    pair->first = m_snp_table.get( snps[ 0 ] );
+    pair->second = m_snp_table.get( snps[ 1 ] );
+    for(size_t i = 0; i < m_encodings.size( ); i++)
+    {
+        values[ i ] = get_value( index, i );
+    }
+
+    return true;
+}
+
+bool
+mresultfile::read(std::pair<std::string, std::string> *pair, float *values)
+{
+    if( !read_record( m_cur_record, pair, values ) )
+    {
+        return false;
+    }
+
+    m_cur_record++;
+
+    return true;
+}
+
+bool
+mresultfile::write(const std::pair<std::string, std::string> &pair, float *values)
+{
+    return false;
+}
+
+uint64_t
+mresultfile::num_pairs()
+{
+    if( m_data != NULL )
+    {
+        return m_header.num_pairs;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+uint64_t
+mresultfile::num_records()
+{
+    return m_num_records;
+}
+
+const std::vector<std::string> &
+mresultfile::get_header()
+{
+    return m_col_names;
+}
+
+const std::vector<std::string> &
+mresultfile::get_snp_names()
+{
+    if( m_snp_names.size( ) != m_snp_table.size( ) )
+    {
+        m_snp_names = m_snp_table.to_vector( );
+    }
+
+    return m_snp_names;
+}
+
+size_t
+mresultfile::num_snps()
+{
+    return m_snp_table.size( );
+}
+
+bool
+mresultfile::find_snp(const std::string &name, uint32_t *index)
+{
+    return m_snp_table.find( name, index );
+}
+
+bool
+mresultfile::set_header(const std::vector<std::string> &header)
+{
+    return false;
+}
+
+const std::vector<uint8_t> &
+mresultfile::get_encodings()
+{
+    return m_encodings;
+}
+
+bool
+mresultfile::is_corrupted()
+{
+    return m_num_records != m_header.num_pairs;
+}
+
+/**
+ * Splits an array of 4-byte values into 4 planes of bytes, which
+ * makes floats and indices compress considerably better.
+ *
+ * @param input The values.
+ * @param n Number of values.
+ * @param output The shuffled bytes will be stored here.
+ */
+static void
+shuffle_bytes(const unsigned char *input, size_t n, unsigned char *output)
+{
+    for(size_t i = 0; i < n; i++)
+    {
+        for(size_t b = 0; b < 4; b++)
+        {
+            output[ b * n + i ] = input[ i * 4 + b ];
+        }
+    }
+}
+
+/**
+ * Reverses shuffle_bytes.
+ *
+ * @param input The shuffled bytes.
+ * @param n Number of values.
+ * @param output The values will be stored here.
+ */
+static void
+unshuffle_bytes(const unsigned char *input, size_t n, unsigned char *output)
+{
+    for(size_t i = 0; i < n; i++)
+    {
+        for(size_t b = 0; b < 4; b++)
+        {
+            output[ i * 4 + b ] = input[ b * n + i ];
+        }
+    }
+}
+
+cresultfile::cresultfile(const std::string &path)
+    : m_mode( "r" ),
+      m_path( path ),
+      m_fp( NULL ),
+      m_last_snp1( 0 ),
+      m_writer( NULL ),
+      m_block_data_offset( 0 ),
+      m_block_end_offset( 0 ),
+      m_file_size( 0 ),
+      m_pair_index( 0 )
 {
-    
+    m_block_header.num_pairs = 0;
 }
 
-bresultfile::bresultfile(const std::string &path, const std::vector<std::string> &snp_names)
+cresultfile::cresultfile(const std::string &path, const std::vector<std::string> &snp_names)
     : m_mode( "w" ),
       m_path( path ),
       m_fp( NULL ),
-      m_snp_names( snp_names )
+      m_snp_names( snp_names ),
+      m_snp_table( snp_names ),
+      m_last_snp1( 0 ),
+      m_writer( NULL ),
+      m_block_data_offset( 0 ),
+      m_block_end_offset( 0 ),
+      m_file_size( 0 ),
+      m_pair_index( 0 )
 {
-    for(int i = 0; i < snp_names.size( ); i++)
-    {
-        m_snp_to_index[ snp_names[ i ] ] = i;
-    }
+    m_block_header.num_pairs = 0;
 }
 
-bresultfile::~bresultfile()
+cresultfile::~cresultfile()
 {
     close( );
 }
 
 bool
-bresultfile::open()
+cresultfile::open()
 {
     if( m_fp != NULL )
     {
-        fseek( m_fp, 0L, SEEK_SET );
+        return false;
     }
 
-    m_header.version = RESULT_CUR_VERSION;
+    m_header.version = RESULT_COLUMNAR_VERSION;
     m_header.format = 0;
     m_header.snp_names_length = 0;
     m_header.col_names_length = 0;
@@ -51,123 +857,363 @@ bresultfile::open()
 
     if( m_mode == "r" )
     {
-        size_t bytes_read = fread( &m_header, sizeof( result_header ), 1, m_fp );
-        if( bytes_read != 1 || m_header.version != RESULT_CUR_VERSION )
+        m_snp_names.clear( );
+        if( !read_result_header( m_fp, RESULT_COLUMNAR_VERSION, RESULT_COLUMNAR_NAMES_VERSION, &m_header, &m_packed_snp_names, &m_col_names, NULL ) ||
+            !m_snp_table.open( m_packed_snp_names.data( ), m_packed_snp_names.size( ) ) )
         {
             fclose( m_fp );
             m_fp = NULL;
             return false;
         }
 
-        char *buffer = (char *) malloc( m_header.snp_names_length );
-        bytes_read = fread( buffer, 1, m_header.snp_names_length, m_fp );
-        if( bytes_read != m_header.snp_names_length )
+        struct stat st;
+        if( fstat( fileno( m_fp ), &st ) != 0 )
         {
-            free( buffer );
             fclose( m_fp );
             m_fp = NULL;
             return false;
         }
+        m_file_size = st.st_size;
 
-        m_snp_names = unpack_string( buffer );
-        free( buffer );
+        m_block_end_offset = ftello( m_fp );
+        m_columns.resize( m_header.num_float_cols );
+
+        return true;
+    }
+    else
+    {
+        m_writer = new block_writer( m_fp );
+
+        return set_header( m_col_names );
+    }
+}
+
+bool
+cresultfile::next_block()
+{
+    if( m_fp == NULL || m_mode != "r" )
+    {
+        return false;
+    }
+
+    if( fseeko( m_fp, m_block_end_offset, SEEK_SET ) != 0 )
+    {
+        return false;
+    }
+
+    /* The writer never writes empty or larger blocks, so any other size is corrupt. */
+    if( fread( &m_block_header, sizeof( result_block_header ), 1, m_fp ) != 1 ||
+        m_block_header.num_pairs == 0 || m_block_header.num_pairs > RESULT_BLOCK_NUM_PAIRS )
+    {
+        m_block_header.num_pairs = 0;
+        return false;
+    }
+
+    size_t num_columns = m_header.num_float_cols + 2;
+    m_column_info.resize( num_columns );
+    if( fread( &m_column_info[ 0 ], sizeof( result_column_info ), num_columns, m_fp ) != num_columns )
+    {
+        m_block_header.num_pairs = 0;
+        return false;
+    }
 
-        buffer = (char *) malloc( m_header.col_names_length );
-        bytes_read = fread( buffer, 1, m_header.col_names_length, m_fp );
-        if( bytes_read != m_header.col_names_length )
+    /* Check the lengths before they are used to size the buffers. */
+    uLong bound = compressBound( m_block_header.num_pairs * 4 );
+    m_block_data_offset = ftello( m_fp );
+    m_block_end_offset = m_block_data_offset;
+    for(size_t i = 0; i < num_columns; i++)
+    {
+        m_block_end_offset += m_column_info[ i ].compressed_length;
+        if( m_column_info[ i ].compressed_length > bound || m_block_end_offset > m_file_size )
         {
-            free( buffer );
-            fclose( m_fp );
-            m_fp = NULL;
+            m_block_header.num_pairs = 0;
             return false;
         }
+    }
+
+    m_column_loaded.assign( num_columns, false );
+    m_pair_index = 0;
+
+    return true;
+}
 
-        m_col_names = unpack_string( buffer );
+uint32_t
+cresultfile::block_num_pairs()
+{
+    return m_block_header.num_pairs;
+}
+
+float
+cresultfile::block_min(size_t column)
+{
+    return m_column_info[ column + 2 ].min;
+}
+
+float
+cresultfile::block_max(size_t column)
+{
+    return m_column_info[ column + 2 ].max;
+}
+
+bool
+cresultfile::load_column(size_t file_column, void *data)
+{
+    if( m_column_loaded[ file_column ] )
+    {
+        return true;
     }
-    else
+
+    int64_t offset = m_block_data_offset;
+    for(size_t i = 0; i < file_column; i++)
     {
-        return set_header( m_col_names );
+        offset += m_column_info[ i ].compressed_length;
     }
 
-    return m_fp != NULL;
+    uint32_t compressed_length = m_column_info[ file_column ].compressed_length;
+    m_compressed.resize( compressed_length + 1 );
+    if( fseeko( m_fp, offset, SEEK_SET ) != 0 || fread( &m_compressed[ 0 ], 1, compressed_length, m_fp ) != compressed_length )
+    {
+        return false;
+    }
+
+    uLongf length = m_block_header.num_pairs * 4;
+    m_shuffled.resize( length + 1 );
+    if( uncompress( &m_shuffled[ 0 ], &length, &m_compressed[ 0 ], compressed_length ) != Z_OK || length != m_block_header.num_pairs * 4 )
+    {
+        return false;
+    }
+
+    unshuffle_bytes( &m_shuffled[ 0 ], m_block_header.num_pairs, (unsigned char *) data );
+    m_column_loaded[ file_column ] = true;
+
+    return true;
+}
+
+const float *
+cresultfile::block_column(size_t column)
+{
+    std::vector<float> &values = m_columns[ column ];
+    values.resize( m_block_header.num_pairs + 1 );
+    if( !load_column( column + 2, &values[ 0 ] ) )
+    {
+        return NULL;
+    }
+
+    return &values[ 0 ];
 }
 
 bool
-bresultfile::read(std::pair<std::string, std::string> *pair, float *values)
+cresultfile::load_all_columns()
 {
-    if( m_fp == NULL || m_mode != "r" )
+    m_snp1.resize( m_block_header.num_pairs + 1 );
+    m_snp2.resize( m_block_header.num_pairs + 1 );
+    if( !load_column( 0, &m_snp1[ 0 ] ) || !load_column( 1, &m_snp2[ 0 ] ) )
     {
         return false;
     }
 
-    uint32_t snps[ 2 ];
-    size_t bytes_read = fread( snps, sizeof( uint32_t ), 2, m_fp );
-    if( bytes_read != 2 )
+    for(size_t i = 0; i < m_header.num_float_cols; i++)
+    {
+        if( block_column( i ) == NULL )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool
+cresultfile::block_pair(size_t index, std::pair<std::string, std::string> *pair, float *values)
+{
+    if( index >= m_block_header.num_pairs || !load_all_columns( ) )
     {
         return false;
     }
-    
-    pair->first = m_snp_names[ snps[ 0 ] ];
-    pair->second = m_snp_names[ snps[ 1 ] ];
 
-    bytes_read = fread( values, sizeof( float ), m_header.num_float_cols, m_fp );
-    if( bytes_read != m_header.num_float_cols )
+    if( m_snp1[ index ] >= m_snp_table.size( ) || m_snp2[ index ] >= m_snp_table.size( ) )
     {
         return false;
     }
 
+    pair->first = m_snp_table.get( m_snp1[ index ] );
+    pair->second = m_snp_table.get( m_snp2[ index ] );
+    for(size_t i = 0; i < m_header.num_float_cols; i++)
+    {
+        values[ i ] = m_columns[ i ][ index ];
+    }
+
     return true;
 }
 
 bool
-bresultfile::write(const std::pair<std::string, std::string> &pair, float *values)
+cresultfile::read(std::pair<std::string, std::string> *pair, float *values)
 {
-    if( m_mode != "w" || m_fp == NULL )
+    if( m_fp == NULL || m_mode != "r" )
+    {
+        return false;
+    }
+
+    while( m_pair_index >= m_block_header.num_pairs )
+    {
+        if( !next_block( ) )
+        {
+            return false;
+        }
+    }
+
+    if( !block_pair( m_pair_index, pair, values ) )
     {
         return false;
     }
+    m_pair_index++;
 
-    std::map<std::string, size_t>::const_iterator snp1 = m_snp_to_index.find( pair.first );
-    std::map<std::string, size_t>::const_iterator snp2 = m_snp_to_index.find( pair.second );
+    return true;
+}
 
-    if( ( snp1 == m_snp_to_index.end( ) ) || ( snp2 == m_snp_to_index.end( ) ) )
+bool
+cresultfile::write(const std::pair<std::string, std::string> &pair, float *values)
+{
+    if( m_mode != "w" || m_fp == NULL )
     {
         return false;
     }
 
-    uint32_t write_pair[] = { (uint32_t) snp1->second, (uint32_t) snp2->second };
-    size_t n_snp = fwrite( write_pair, sizeof( uint32_t ), 2, m_fp );
-    size_t n_cols = fwrite( values, sizeof( float ), m_header.num_float_cols, m_fp );
-    if( n_snp == 2 && n_cols == m_header.num_float_cols )
+    if( m_last_snp1_name.empty( ) || m_last_snp1_name != pair.first )
     {
-        m_header.num_pairs++;
+        m_last_snp1_name.clear( );
+        if( !m_snp_table.find( pair.first, &m_last_snp1 ) )
+        {
+            return false;
+        }
+        m_last_snp1_name = pair.first;
     }
-    else
+
+    uint32_t snp2;
+    if( !m_snp_table.find( pair.second, &snp2 ) )
     {
         return false;
     }
 
+    m_snp1.push_back( m_last_snp1 );
+    m_snp2.push_back( snp2 );
+    for(size_t i = 0; i < m_header.num_float_cols; i++)
+    {
+        m_columns[ i ].push_back( values[ i ] );
+    }
+    m_header.num_pairs++;
+
+    if( m_snp1.size( ) >= RESULT_BLOCK_NUM_PAIRS )
+    {
+        return write_block( );
+    }
+
     return true;
 }
 
-void
-bresultfile::close()
+bool
+cresultfile::write_block()
 {
-    if( m_fp != NULL )
+    uint32_t num_pairs = m_snp1.size( );
+    if( num_pairs == 0 )
     {
-        if( m_mode == "w" )
+        return true;
+    }
+
+    size_t num_columns = m_header.num_float_cols + 2;
+    std::vector<result_column_info> column_info( num_columns );
+    for(size_t i = 0; i < num_columns; i++)
+    {
+        column_info[ i ].min = FLT_MAX;
+        column_info[ i ].max = -FLT_MAX;
+    }
+    for(size_t i = 0; i < m_header.num_float_cols; i++)
+    {
+        const std::vector<float> &values = m_columns[ i ];
+        result_column_info &info = column_info[ i + 2 ];
+        for(size_t j = 0; j < num_pairs; j++)
         {
-            fseek( m_fp, 0L, SEEK_SET );
-            fwrite( &m_header, sizeof( result_header ), 1, m_fp );
+            if( values[ j ] != result_get_missing( ) )
+            {
+                info.min = std::min( info.min, values[ j ] );
+                info.max = std::max( info.max, values[ j ] );
+            }
+        }
+    }
+
+    /* Compress the columns after each other in the block buffer,
+     * leaving room for the block header and column infos. */
+    size_t info_length = sizeof( result_block_header ) + sizeof( result_column_info ) * num_columns;
+    size_t bound = compressBound( num_pairs * 4 );
+    m_block_buffer.resize( info_length + bound * num_columns );
+    m_shuffled.resize( num_pairs * 4 );
+
+    size_t offset = info_length;
+    for(size_t i = 0; i < num_columns; i++)
+    {
+        const unsigned char *data;
+        if( i == 0 )
+        {
+            data = (const unsigned char *) &m_snp1[ 0 ];
+        }
+        else if( i == 1 )
+        {
+            data = (const unsigned char *) &m_snp2[ 0 ];
+        }
+        else
+        {
+            data = (const unsigned char *) &m_columns[ i - 2 ][ 0 ];
+        }
+
+        shuffle_bytes( data, num_pairs, &m_shuffled[ 0 ] );
+
+        uLongf length = bound;
+        if( compress2( &m_block_buffer[ offset ], &length, &m_shuffled[ 0 ], num_pairs * 4, Z_BEST_SPEED ) != Z_OK )
+        {
+            return false;
         }
 
+        column_info[ i ].compressed_length = length;
+        offset += length;
+    }
+
+    result_block_header block_header;
+    block_header.num_pairs = num_pairs;
+    memcpy( &m_block_buffer[ 0 ], &block_header, sizeof( result_block_header ) );
+    memcpy( &m_block_buffer[ sizeof( result_block_header ) ], &column_info[ 0 ], sizeof( result_column_info ) * num_columns );
+
+    m_snp1.clear( );
+    m_snp2.clear( );
+    for(size_t i = 0; i < m_header.num_float_cols; i++)
+    {
+        m_columns[ i ].clear( );
+    }
+
+    return m_writer->write( &m_block_buffer[ 0 ], offset );
+}
+
+void
+cresultfile::close()
+{
+    if( m_fp != NULL && m_mode == "w" )
+    {
+        write_block( );
+        delete m_writer;
+        m_writer = NULL;
+
+        fseek( m_fp, 0L, SEEK_SET );
+        fwrite( &m_header, sizeof( result_header ), 1, m_fp );
+    }
+
+    if( m_fp != NULL )
+    {
         fclose( m_fp );
         m_fp = NULL;
     }
 }
 
 uint64_t
-bresultfile::num_pairs()
+cresultfile::num_pairs()
 {
     if( m_fp != NULL )
     {
@@ -180,69 +1226,39 @@ bresultfile::num_pairs()
 }
 
 const std::vector<std::string> &
-bresultfile::get_header()
+cresultfile::get_header()
 {
     return m_col_names;
 }
-const std::vector<std::string> &
-bresultfile::get_snp_names()
-{
-    return m_snp_names;
-}
 
-bool
-bresultfile::set_header(const std::vector<std::string> &col_names)
+const std::vector<std::string> &
+cresultfile::get_snp_names()
 {
-    if( m_fp == NULL )
-    {
-        return false;
-    }
-
-    fseek( m_fp, 0L, SEEK_SET );
-    m_col_names = col_names;
-    
-    std::string packed_snp_names = pack_string( m_snp_names );
-    std::string packed_col_names = pack_string( m_col_names );
-
-    m_header.snp_names_length = packed_snp_names.size( ) + 1;
-    m_header.col_names_length = packed_col_names.size( ) + 1;
-    m_header.num_float_cols = m_col_names.size( );
-
-    size_t bytes_written = fwrite( &m_header, sizeof( result_header ), 1, m_fp );
-    if( bytes_written != 1 )
-    {
-        return false;
-    }
-
-    bytes_written = fwrite( packed_snp_names.c_str( ), 1, m_header.snp_names_length, m_fp );
-    if( bytes_written != m_header.snp_names_length )
-    {
-        return false;
-    }
-
-    bytes_written = fwrite( packed_col_names.c_str( ), 1, m_header.col_names_length, m_fp );
-    if( bytes_written != m_header.col_names_length )
+    if( m_mode == "r" && m_snp_names.size( ) != m_snp_table.size( ) )
     {
-        return false;
+        m_snp_names = m_snp_table.to_vector( );
     }
 
-    return true;
+    return m_snp_names;
 }
 
 bool
-bresultfile::is_corrupted()
+cresultfile::set_header(const std::vector<std::string> &col_names)
 {
-    struct stat st;
-    if( fstat( fileno( m_fp ), &st ) != 0 )
+    if( m_fp == NULL || m_mode != "w" )
     {
         return false;
     }
 
-    uint64_t pair_size = (st.st_size - sizeof( result_header ) - m_header.snp_names_length - m_header.col_names_length);
-    uint64_t row_size = sizeof( uint32_t ) * 2 + m_header.num_float_cols * sizeof( float );
+    m_writer->flush( );
 
-    uint64_t num_pairs = pair_size / row_size;
-    return num_pairs != m_header.num_pairs;
+    m_col_names = col_names;
+    m_header.num_pairs = 0;
+    m_snp1.clear( );
+    m_snp2.clear( );
+    m_columns.assign( col_names.size( ), std::vector<float>( ) );
+
+    return write_result_header( m_fp, &m_header, m_snp_names, m_col_names, std::vector<uint8_t>( ) );
 }
 
 tresultfile::tresultfile(const std::string &path, const std::string &mode)
@@ -250,6 +1266,7 @@ tresultfile::tresultfile(const std::string &path, const std::string &mode)
       m_path( path ),
       m_input( NULL ),
       m_output( NULL ),
+      m_writer( NULL ),
       m_num_pairs( 0 ),
       m_written( false )
 {
@@ -296,14 +1313,21 @@ tresultfile::open()
     {
         if( m_path != "-" )
         {
-            m_output = new std::ofstream( m_path );
+            m_output = fopen( m_path.c_str( ), "w" );
         }
         else
         {
-            m_output = &std::cout;
+            m_output = stdout;
+        }
+
+        if( m_output == NULL )
+        {
+            return false;
         }
 
-        return m_output->good( );
+        m_writer = new block_writer( m_output );
+
+        return true;
     }
     else
     {
@@ -353,21 +1377,35 @@ tresultfile::write(const std::pair<std::string, std::string> &pair, float *value
         return false;
     }
 
-    *m_output << pair.first << " " << pair.second;
+    size_t max_length = pair.first.size( ) + pair.second.size( ) + 2 + m_col_names.size( ) * FORMAT_FLOAT_MAX_LENGTH;
+    if( m_line.size( ) < max_length )
+    {
+        m_line.resize( max_length );
+    }
+
+    char *line = &m_line[ 0 ];
+    memcpy( line, pair.first.c_str( ), pair.first.size( ) );
+    line += pair.first.size( );
+    *line++ = ' ';
+    memcpy( line, pair.second.c_str( ), pair.second.size( ) );
+    line += pair.second.size( );
+
     for(int i = 0; i < m_col_names.size( ); i++)
     {
+        *line++ = '\t';
         if( values[ i ] != result_get_missing( ) )
         {
-            *m_output << "\t" << values[ i ];
+            line += format_float( values[ i ], line );
         }
         else
         {
-            *m_output << "\tNA";
+            *line++ = 'N';
+            *line++ = 'A';
         }
     }
-    *m_output << "\n";
+    *line++ = '\n';
 
-    return true;
+    return m_writer->write( &m_line[ 0 ], line - &m_line[ 0 ] );
 }
 
 uint64_t
@@ -409,12 +1447,13 @@ tresultfile::set_header(const std::vector<std::string> &header)
     }
     
     m_col_names = std::vector<std::string>( header );
-    *m_output << "snp1 snp2";
+    std::string header_line = "snp1 snp2";
     for(int i = 0; i < m_col_names.size( ); i++)
     {
-        *m_output << "\t" << m_col_names[ i ];
+        header_line += "\t" + m_col_names[ i ];
     }
-    *m_output << "\n";
+    header_line += "\n";
+    m_writer->write( header_line.c_str( ), header_line.size( ) );
 
     m_written = true;
 
@@ -424,9 +1463,17 @@ tresultfile::set_header(const std::vector<std::string> &header)
 void
 tresultfile::close()
 {
-    if( m_output != NULL && m_output != &std::cout )
+    if( m_writer != NULL )
     {
-        delete m_output;
+        delete m_writer;
+        m_writer = NULL;
+    }
+    if( m_output != NULL )
+    {
+        if( m_output != stdout )
+        {
+            fclose( m_output );
+        }
         m_output = NULL;
     }
     if( m_input != NULL )
@@ -447,15 +1494,19 @@ open_result_file(const std::string &path)
 
     result_header header;
     size_t bytes_read = fread( &header, sizeof( result_header ), 1, fp );
+    fclose( fp );
     if( bytes_read != 1 )
     {
         return NULL;
     }
 
-    if( header.version == RESULT_CUR_VERSION )
+    if( header.version == RESULT_CUR_VERSION || header.version == RESULT_NAMES_VERSION )
     {
-        fclose( fp );
-        return new bresultfile( path );
+        return new mresultfile( path );
+    }
+    else if( header.version == RESULT_COLUMNAR_VERSION || header.version == RESULT_COLUMNAR_NAMES_VERSION )
+    {
+        return new cresultfile( path );
     }
     else
     {
@@ -463,6 +1514,49 @@ open_result_file(const std::string &path)
     }
 }
 
+bool
+peek_result_header(const std::string &path, result_header *header, bool *corrupted)
+{
+    FILE *fp = fopen( path.c_str( ), "r" );
+    if( fp == NULL )
+    {
+        return false;
+    }
+
+    struct stat st;
+    size_t bytes_read = fread( header, sizeof( result_header ), 1, fp );
+    bool has_stat = fstat( fileno( fp ), &st ) == 0;
+    if( bytes_read != 1 || !has_stat )
+    {
+        fclose( fp );
+        return false;
+    }
+
+    *corrupted = false;
+    if( valid_result_header( *header, RESULT_CUR_VERSION, RESULT_NAMES_VERSION ) )
+    {
+        uint64_t pair_size = st.st_size - sizeof( result_header ) - header->snp_names_length - header->col_names_length;
+        std::vector<uint8_t> encodings;
+        if( header->format & RESULT_FORMAT_ENCODED )
+        {
+            encodings.resize( header->num_float_cols );
+            fseeko( fp, sizeof( result_header ) + (off_t) header->snp_names_length + header->col_names_length, SEEK_SET );
+            if( header->num_float_cols > 0 && fread( &encodings[ 0 ], 1, header->num_float_cols, fp ) != header->num_float_cols )
+            {
+                fclose( fp );
+                return false;
+            }
+            pair_size -= header->num_float_cols;
+        }
+        uint64_t row_size = result_record_size( header->num_float_cols, encodings );
+        *corrupted = pair_size / row_size != header->num_pairs;
+    }
+    fclose( fp );
+
+    return valid_result_header( *header, RESULT_CUR_VERSION, RESULT_NAMES_VERSION ) ||
+           valid_result_header( *header, RESULT_COLUMNAR_VERSION, RESULT_COLUMNAR_NAMES_VERSION );
+}
+
 float
 result_get_missing()
 {
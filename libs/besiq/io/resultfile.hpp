@@ -10,8 +10,50 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
-#define RESULT_CUR_VERSION 0x61248fc2
+#include <besiq/io/block_writer.hpp>
+#include <besiq/io/result_encoding.hpp>
+#include <besiq/io/string_table.hpp>
+
+#define RESULT_CUR_VERSION 0x61248fc4
+
+/**
+ * Version number of the columnar result file.
+ */
+#define RESULT_COLUMNAR_VERSION 0x61248fc5
+
+/**
+ * Version numbers of older row-major and columnar result files,
+ * where the snp names are separated by tabs.
+ */
+#define RESULT_NAMES_VERSION 0x61248fc2
+#define RESULT_COLUMNAR_NAMES_VERSION 0x61248fc3
+
+/**
+ * The format field of the header is a set of flags, without any
+ * flags all columns are floats and the snp names are separated by
+ * tabs.
+ */
+#define RESULT_FORMAT_FLOAT 0
+
+/**
+ * Row-major result file where the column names are followed by
+ * one byte per column with its encoding, see result_encoding.hpp.
+ */
+#define RESULT_FORMAT_ENCODED 1
+
+/**
+ * The snp names are stored as a string_table, which can be used
+ * directly from a memory mapped file. Set in all RESULT_CUR_VERSION
+ * and RESULT_COLUMNAR_VERSION files and never in older files.
+ */
+#define RESULT_FORMAT_STRING_TABLE 2
+
+/**
+ * Number of pairs in each block of a columnar result file.
+ */
+#define RESULT_BLOCK_NUM_PAIRS 65536
 
 #pragma pack(push, 1)
 struct result_header
@@ -22,7 +64,7 @@ struct result_header
     uint32_t version;
 
     /**
-     * Format number (not used atm).
+     * Format flags, see RESULT_FORMAT_FLOAT.
      */
     uint32_t format;
 
@@ -46,6 +88,41 @@ struct result_header
      */
     uint32_t num_float_cols;
 };
+
+/**
+ * Header of a block in a columnar result file, it is followed by
+ * one result_column_info for each column (snp1, snp2 and then the
+ * float columns) and then the compressed columns in the same order.
+ */
+struct result_block_header
+{
+    /**
+     * Number of pairs in the block.
+     */
+    uint32_t num_pairs;
+};
+
+/**
+ * Describes a column within a block of a columnar result file.
+ */
+struct result_column_info
+{
+    /**
+     * Length of the compressed column in bytes.
+     */
+    uint32_t compressed_length;
+
+    /**
+     * Smallest non-missing value in the column, larger than
+     * max if all values are missing.
+     */
+    float min;
+
+    /**
+     * Largest non-missing value in the column.
+     */
+    float max;
+};
 #pragma pack(pop)
 
 /**
@@ -190,6 +267,28 @@ class bresultfile : public resultfile
          */
         bool set_header(const std::vector<std::string> &header);
 
+        /**
+         * Sets the encoding of each column, must be called after open
+         * and before set_header. An empty list stores all columns as
+         * floats.
+         *
+         * @param encodings The encoding of each column.
+         */
+        void set_encodings(const std::vector<uint8_t> &encodings);
+
+        /**
+         * Chooses the encodings with result_default_encodings when
+         * the header is set.
+         */
+        void use_compact_encodings();
+
+        /**
+         * Returns the encoding of each column.
+         *
+         * @return The encoding of each column.
+         */
+        const std::vector<uint8_t> &get_encodings();
+
         /**
          * Returns true if the file seems corrupted.
          *
@@ -224,14 +323,525 @@ class bresultfile : public resultfile
         std::vector<std::string> m_col_names;
 
         /**
-         * List of names of the variants in the result file.
+         * List of names of the variants in the result file, when
+         * reading it is only created if get_snp_names is called.
+         */
+        std::vector<std::string> m_snp_names;
+
+        /**
+         * The snp names with an index for finding a name.
+         */
+        string_table m_snp_table;
+
+        /**
+         * Packed snp names that m_snp_table uses when reading.
+         */
+        std::string m_packed_snp_names;
+
+        /**
+         * The most recently written first snp, pairs are usually
+         * written with the same first snp so this saves a lookup.
+         */
+        std::string m_last_snp1_name;
+
+        /**
+         * Index of m_last_snp1_name.
+         */
+        uint32_t m_last_snp1;
+
+        /**
+         * Writes the pairs from a separate thread when writing.
+         */
+        block_writer *m_writer;
+
+        /**
+         * Buffer for a single record.
+         */
+        std::vector<char> m_record;
+
+        /**
+         * Encoding of each column.
+         */
+        std::vector<uint8_t> m_encodings;
+
+        /**
+         * If true the encodings are chosen from the column names.
+         */
+        bool m_compact;
+};
+
+/**
+ * A read-only, memory mapped, view of a binary result file. In
+ * addition to sequential reading the records can be accessed
+ * randomly, which allows several threads to scan a file.
+ */
+class mresultfile : public resultfile
+{
+    public:
+        /**
+         * Constructor.
+         *
+         * @param path Path to the input file.
+         */
+        mresultfile(const std::string &path);
+
+        /**
+         * Destructor.
+         */
+        ~mresultfile();
+
+        /**
+         * @see resultfile::open.
+         */
+        bool open();
+        
+        /**
+         * @see resultfile::close.
+         */
+        void close();
+
+        /**
+         * @see resultfile::read.
+         */
+        bool read(std::pair<std::string, std::string> *pair, float *values);
+
+        /**
+         * Not supported, always returns false.
+         */
+        virtual bool write(const std::pair<std::string, std::string> &pair, float *values);
+
+        /**
+         * @see resultfile::num_pairs.
+         */
+        uint64_t num_pairs();
+
+        /**
+         * @see resultfile::get_header.
+         */
+        const std::vector<std::string> &get_header();
+        
+        /**
+         * @see resultfile::get_snp_names.
+         */
+        const std::vector<std::string> &get_snp_names();
+
+        /**
+         * Not supported, always returns false.
+         */
+        bool set_header(const std::vector<std::string> &header);
+
+        /**
+         * Returns true if the file seems corrupted.
+         *
+         * @return True if the file seems corrupted.
+         */
+        bool is_corrupted();
+
+        /**
+         * Returns the number of complete records in the file, this
+         * differs from num_pairs only if the file is corrupted.
+         *
+         * @return The number of complete records in the file.
+         */
+        uint64_t num_records();
+
+        /**
+         * Returns the number of snps, unlike get_snp_names this does
+         * not create a string for each snp.
+         *
+         * @return The number of snps.
+         */
+        size_t num_snps();
+
+        /**
+         * Finds the index of a snp, the index is built on the first
+         * call so it must not be called concurrently.
+         *
+         * @param name Name of the snp.
+         * @param index The index will be stored here.
+         *
+         * @return True if the snp was found, false otherwise.
+         */
+        bool find_snp(const std::string &name, uint32_t *index);
+
+        /**
+         * Returns the encoding of each column.
+         *
+         * @return The encoding of each column.
+         */
+        const std::vector<uint8_t> &get_encodings();
+
+        /**
+         * Returns a single value of a record.
+         *
+         * @param index Index of the record.
+         * @param column Index of the float column.
+         *
+         * @return The value.
+         */
+        float get_value(uint64_t index, size_t column) const
+        {
+            const char *encoded = m_records + index * m_record_size + m_col_offsets[ column ];
+            if( m_encodings[ column ] != RESULT_ENCODING_FLOAT )
+            {
+                return result_decode( m_encodings[ column ], encoded );
+            }
+
+            float value;
+            memcpy( &value, encoded, sizeof( float ) );
+            return value;
+        }
+
+        /**
+         * Returns the snp indices of a record.
+         *
+         * @param index Index of the record.
+         * @param snps The two snp indices will be stored here.
+         */
+        void get_snps(uint64_t index, uint32_t *snps) const
+        {
+            memcpy( snps, m_records + index * m_record_size, sizeof( uint32_t ) * 2 );
+        }
+
+        /**
+         * Reads a record.
+         *
+         * @param index Index of the record.
+         * @param pair The names of the variants will be written here.
+         * @param values The values in the columns will be stored here.
+         *
+         * @return True if successful, false otherwise.
+         */
+        bool read_record(uint64_t index, std::pair<std::string, std::string> *pair, float *values);
+
+    private:
+        /**
+         * Path to the file.
+         */
+        std::string m_path;
+
+        /**
+         * The mapped file.
+         */
+        char *m_data;
+
+        /**
+         * Size of the mapped file.
+         */
+        uint64_t m_size;
+
+        /**
+         * Start of the records in the mapped file.
+         */
+        const char *m_records;
+
+        /**
+         * Size of a record in bytes.
+         */
+        uint64_t m_record_size;
+
+        /**
+         * Number of complete records in the file.
+         */
+        uint64_t m_num_records;
+
+        /**
+         * Index of the next record for read.
+         */
+        uint64_t m_cur_record;
+
+        /**
+         * File header.
+         */
+        result_header m_header;
+
+        /**
+         * List of names of the columns in the result file.
+         */
+        std::vector<std::string> m_col_names;
+
+        /**
+         * List of names of the variants in the result file, only
+         * created if get_snp_names is called.
+         */
+        std::vector<std::string> m_snp_names;
+
+        /**
+         * The snp names, in the mapped file if it stores a string
+         * table and otherwise in m_packed_snp_names.
+         */
+        string_table m_snp_table;
+
+        /**
+         * Packed snp names of files with tab separated names.
+         */
+        std::string m_packed_snp_names;
+
+        /**
+         * Encoding of each column.
+         */
+        std::vector<uint8_t> m_encodings;
+
+        /**
+         * Offset of each column within a record.
+         */
+        std::vector<size_t> m_col_offsets;
+};
+
+/**
+ * A binary file format for results that stores blocks of pairs
+ * column by column. Each column in a block is compressed separately
+ * and carries the min and max of its values, so that a reader can skip
+ * blocks that cannot contain interesting values and only decompress
+ * the columns it needs.
+ */
+class cresultfile : public resultfile
+{
+    public:
+        /**
+         * Constructor for reading.
+         *
+         * @param path Path to the input file.
+         */
+        cresultfile(const std::string &path);
+
+        /**
+         * Constructor for writing.
+         *
+         * @param path Path to the output file.
+         * @param snp_names A list of names for each snp.
+         */
+        cresultfile(const std::string &path, const std::vector<std::string> &snp_names);
+
+        /**
+         * Destructor.
+         */
+        ~cresultfile();
+
+        /**
+         * @see resultfile::open.
+         */
+        bool open();
+        
+        /**
+         * @see resultfile::close.
+         */
+        void close();
+
+        /**
+         * @see resultfile::read.
+         */
+        bool read(std::pair<std::string, std::string> *pair, float *values);
+
+        /**
+         * @see resultfile::write.
+         */
+        virtual bool write(const std::pair<std::string, std::string> &pair, float *values);
+
+        /**
+         * @see resultfile::num_pairs.
+         */
+        uint64_t num_pairs();
+
+        /**
+         * @see resultfile::get_header.
+         */
+        const std::vector<std::string> &get_header();
+        
+        /**
+         * @see resultfile::get_snp_names.
+         */
+        const std::vector<std::string> &get_snp_names();
+
+        /**
+         * @see resultfile::set_header.
+         */
+        bool set_header(const std::vector<std::string> &header);
+
+        /**
+         * Moves to the next block and reads its zone maps, no
+         * column data is read until it is requested. Pairs that
+         * have not been read in the current block are skipped.
+         *
+         * @return True if there was another block, false otherwise.
+         */
+        bool next_block();
+
+        /**
+         * Returns the number of pairs in the current block.
+         *
+         * @return the number of pairs in the current block.
+         */
+        uint32_t block_num_pairs();
+
+        /**
+         * Returns the smallest non-missing value of a column
+         * in the current block.
+         *
+         * @param column Index of the float column.
+         *
+         * @return The smallest value, larger than block_max if
+         *         all values are missing.
+         */
+        float block_min(size_t column);
+
+        /**
+         * Returns the largest non-missing value of a column
+         * in the current block.
+         *
+         * @param column Index of the float column.
+         *
+         * @return The largest value.
+         */
+        float block_max(size_t column);
+
+        /**
+         * Reads and decompresses a single column of the current block.
+         *
+         * @param column Index of the float column.
+         *
+         * @return The values of the column, or NULL on error.
+         */
+        const float *block_column(size_t column);
+
+        /**
+         * Reads a pair in the current block, the remaining columns
+         * of the block are decompressed when needed.
+         *
+         * @param index Index of the pair within the block.
+         * @param pair The names of the variants will be written here.
+         * @param values The values in the columns will be stored here.
+         *
+         * @return True if successful, false otherwise.
+         */
+        bool block_pair(size_t index, std::pair<std::string, std::string> *pair, float *values);
+
+    private:
+        /**
+         * Compresses the buffered pairs and hands them to the writer.
+         *
+         * @return True if successful, false otherwise.
+         */
+        bool write_block();
+
+        /**
+         * Reads and decompresses a column of the current block.
+         *
+         * @param file_column Index of the column in the block,
+         *        0 and 1 are the snps.
+         * @param data The decompressed column will be stored here.
+         *
+         * @return True if successful, false otherwise.
+         */
+        bool load_column(size_t file_column, void *data);
+
+        /**
+         * Reads and decompresses all columns of the current block.
+         *
+         * @return True if successful, false otherwise.
+         */
+        bool load_all_columns();
+
+        /**
+         * Read or writing mode.
+         */
+        std::string m_mode;
+
+        /**
+         * Path to the output file.
+         */
+        std::string m_path;
+
+        /**
+         * Underlying file pointer.
+         */
+        FILE *m_fp;
+        
+        /**
+         * File header (that has been parsed or will be written).
+         */
+        result_header m_header;
+
+        /**
+         * List of names of the columns in the result file.
+         */
+        std::vector<std::string> m_col_names;
+
+        /**
+         * List of names of the variants in the result file, when
+         * reading it is only created if get_snp_names is called.
          */
         std::vector<std::string> m_snp_names;
 
         /**
-         * Maps snp names to indices in m_snp_names.
+         * The snp names with an index for finding a name.
          */
-        std::map<std::string, size_t> m_snp_to_index;
+        string_table m_snp_table;
+
+        /**
+         * Packed snp names that m_snp_table uses when reading.
+         */
+        std::string m_packed_snp_names;
+
+        /**
+         * The most recently written first snp.
+         */
+        std::string m_last_snp1_name;
+
+        /**
+         * Index of m_last_snp1_name.
+         */
+        uint32_t m_last_snp1;
+
+        /**
+         * Writes the blocks from a separate thread when writing.
+         */
+        block_writer *m_writer;
+
+        /**
+         * The snp columns of the current block.
+         */
+        std::vector<uint32_t> m_snp1;
+        std::vector<uint32_t> m_snp2;
+
+        /**
+         * The float columns of the current block.
+         */
+        std::vector< std::vector<float> > m_columns;
+
+        /**
+         * Header and column infos of the current block.
+         */
+        result_block_header m_block_header;
+        std::vector<result_column_info> m_column_info;
+
+        /**
+         * File offsets of the column data and the end of the current block.
+         */
+        int64_t m_block_data_offset;
+        int64_t m_block_end_offset;
+
+        /**
+         * Size of the file when it was opened for reading.
+         */
+        int64_t m_file_size;
+
+        /**
+         * Whether each column of the current block has been decompressed.
+         */
+        std::vector<bool> m_column_loaded;
+
+        /**
+         * Index of the next pair in the current block for read.
+         */
+        size_t m_pair_index;
+
+        /**
+         * Buffers for compressed data.
+         */
+        std::vector<unsigned char> m_compressed;
+        std::vector<unsigned char> m_shuffled;
+        std::vector<unsigned char> m_block_buffer;
 };
 
 /**
@@ -308,7 +918,17 @@ class tresultfile : public resultfile
          * Underlying file pointer.
          */
         std::istream *m_input;
-        std::ostream *m_output;
+        FILE *m_output;
+
+        /**
+         * Writes the lines from a separate thread.
+         */
+        block_writer *m_writer;
+
+        /**
+         * Buffer for a single line.
+         */
+        std::vector<char> m_line;
 
         /**
          * Number of pairs written
@@ -327,6 +947,27 @@ class tresultfile : public resultfile
         std::vector<std::string> m_snp_names;
 };
 
+/**
+ * A result file that discards all pairs, used when only a summary
+ * of the results is wanted.
+ */
+class nresultfile : public resultfile
+{
+    public:
+        bool open() { return true; }
+        void close() { }
+        bool read(std::pair<std::string, std::string> *pair, float *values) { return false; }
+        bool write(const std::pair<std::string, std::string> &pair, float *values) { return true; }
+        uint64_t num_pairs() { return 0; }
+        const std::vector<std::string> &get_header() { return m_col_names; }
+        const std::vector<std::string> &get_snp_names() { return m_snp_names; }
+        bool set_header(const std::vector<std::string> &header) { m_col_names = header; return true; }
+
+    private:
+        std::vector<std::string> m_col_names;
+        std::vector<std::string> m_snp_names;
+};
+
 /**
  * Opens a result file (binary or text) and returns a pointer to it.
  *
@@ -336,6 +977,19 @@ class tresultfile : public resultfile
  */
 resultfile * open_result_file(const std::string &path);
 
+/**
+ * Reads only the fixed size header of a binary result file, which
+ * is enough to get the number of pairs without parsing the names.
+ *
+ * @param path Path to the file.
+ * @param header The header will be stored here.
+ * @param corrupted Set to true if the size of a row-major file does
+ *                  not match the number of pairs in the header.
+ *
+ * @return True if the file is a binary result file, false otherwise.
+ */
+bool peek_result_header(const std::string &path, result_header *header, bool *corrupted);
+
 /**
  * Returns a missing value.
  *
@@ -0,0 +1,239 @@
+#include <string.h>
+
+#include <besiq/io/string_table.hpp>
+
+/**
+ * Computes the FNV-1a hash of a string.
+ *
+ * @param str The string.
+ * @param length Length of the string.
+ *
+ * @return The hash value.
+ */
+static uint64_t
+hash_string(const char *str, size_t length)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for(size_t i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char) str[ i ];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+string_table::string_table()
+    : m_count( 0 ),
+      m_offsets( NULL ),
+      m_blob( NULL ),
+      m_index( NULL ),
+      m_num_slots( 0 )
+{
+}
+
+string_table::string_table(const std::vector<std::string> &strings)
+    : m_packed( pack( strings ) ),
+      m_count( 0 ),
+      m_offsets( NULL ),
+      m_blob( NULL ),
+      m_index( NULL ),
+      m_num_slots( 0 )
+{
+    open( m_packed.data( ), m_packed.size( ) );
+}
+
+bool
+string_table::open(const char *data, uint64_t length)
+{
+    m_count = 0;
+    m_offsets = NULL;
+    m_blob = NULL;
+    m_slots.clear( );
+    m_index = NULL;
+    m_num_slots = 0;
+
+    uint64_t count;
+    if( length < sizeof( uint64_t ) * 2 )
+    {
+        return false;
+    }
+    memcpy( &count, data, sizeof( uint64_t ) );
+    if( count > ( length - sizeof( uint64_t ) * 2 ) / sizeof( uint64_t ) || count >= UINT32_MAX )
+    {
+        return false;
+    }
+
+    const char *offsets = data + sizeof( uint64_t );
+    const char *blob = offsets + ( count + 1 ) * sizeof( uint64_t );
+    uint64_t blob_length = length - ( blob - data );
+
+    /* All strings lie within the blob if the offsets are increasing and the blob ends with a null. */
+    uint64_t prev = 0;
+    for(uint64_t i = 0; i <= count; i++)
+    {
+        uint64_t offset;
+        memcpy( &offset, offsets + i * sizeof( uint64_t ), sizeof( uint64_t ) );
+        if( offset < prev || offset > blob_length )
+        {
+            return false;
+        }
+        prev = offset;
+    }
+    if( count > 0 && ( prev == 0 || blob[ prev - 1 ] != '\0' ) )
+    {
+        return false;
+    }
+
+    m_count = count;
+    m_offsets = offsets;
+    m_blob = blob;
+
+    return true;
+}
+
+bool
+string_table::find(const std::string &name, uint32_t *index)
+{
+    if( m_count == 0 )
+    {
+        return false;
+    }
+    if( m_index == NULL )
+    {
+        build_index( );
+    }
+
+    size_t mask = m_num_slots - 1;
+    for(size_t slot = hash_string( name.c_str( ), name.size( ) ) & mask; m_index[ slot ] != 0; slot = ( slot + 1 ) & mask)
+    {
+        uint32_t cur = m_index[ slot ] - 1;
+        if( strcmp( get( cur ), name.c_str( ) ) == 0 )
+        {
+            *index = cur;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Returns the number of slots in the hash index of a table.
+ *
+ * @param count Number of strings.
+ *
+ * @return The number of slots, a power of two.
+ */
+static uint64_t
+index_num_slots(uint64_t count)
+{
+    uint64_t num_slots = 16;
+    while( num_slots < 2 * count )
+    {
+        num_slots *= 2;
+    }
+
+    return num_slots;
+}
+
+bool
+string_table::open_index(const char *data, uint64_t length)
+{
+    /* The size must match build_index, otherwise the hashes map to other slots. */
+    uint64_t num_slots = length / sizeof( uint32_t );
+    if( length % sizeof( uint32_t ) != 0 || ( (uintptr_t) data ) % sizeof( uint32_t ) != 0 ||
+        num_slots != index_num_slots( m_count ) )
+    {
+        return false;
+    }
+
+    /* The probing loop in find needs an empty slot to terminate. */
+    const uint32_t *slots = (const uint32_t *) data;
+    bool has_empty = false;
+    for(uint64_t i = 0; i < num_slots; i++)
+    {
+        if( slots[ i ] > m_count )
+        {
+            return false;
+        }
+        has_empty = has_empty || slots[ i ] == 0;
+    }
+    if( !has_empty )
+    {
+        return false;
+    }
+
+    m_slots.clear( );
+    m_index = slots;
+    m_num_slots = num_slots;
+
+    return true;
+}
+
+std::string
+string_table::pack_index()
+{
+    if( m_index == NULL )
+    {
+        build_index( );
+    }
+
+    return std::string( (const char *) m_index, m_num_slots * sizeof( uint32_t ) );
+}
+
+std::vector<std::string>
+string_table::to_vector() const
+{
+    std::vector<std::string> strings( m_count );
+    for(size_t i = 0; i < m_count; i++)
+    {
+        strings[ i ] = get( i );
+    }
+
+    return strings;
+}
+
+std::string
+string_table::pack(const std::vector<std::string> &strings)
+{
+    uint64_t count = strings.size( );
+    std::vector<uint64_t> offsets( count + 1, 0 );
+    for(size_t i = 0; i < strings.size( ); i++)
+    {
+        offsets[ i + 1 ] = offsets[ i ] + strings[ i ].size( ) + 1;
+    }
+
+    std::string packed;
+    packed.reserve( sizeof( uint64_t ) * ( count + 2 ) + offsets[ count ] );
+    packed.append( (const char *) &count, sizeof( uint64_t ) );
+    packed.append( (const char *) &offsets[ 0 ], sizeof( uint64_t ) * offsets.size( ) );
+    for(size_t i = 0; i < strings.size( ); i++)
+    {
+        packed.append( strings[ i ].c_str( ), strings[ i ].size( ) + 1 );
+    }
+
+    return packed;
+}
+
+void
+string_table::build_index()
+{
+    size_t num_slots = index_num_slots( m_count );
+    m_slots.assign( num_slots, 0 );
+
+    size_t mask = num_slots - 1;
+    for(uint32_t i = 0; i < m_count; i++)
+    {
+        const char *name = get( i );
+        size_t slot = hash_string( name, strlen( name ) ) & mask;
+        while( m_slots[ slot ] != 0 && strcmp( get( m_slots[ slot ] - 1 ), name ) != 0 )
+        {
+            slot = ( slot + 1 ) & mask;
+        }
+        m_slots[ slot ] = i + 1;
+    }
+
+    m_index = &m_slots[ 0 ];
+    m_num_slots = num_slots;
+}
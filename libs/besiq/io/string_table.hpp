@@ -0,0 +1,171 @@
+#ifndef __STRING_TABLE_H__
+#define __STRING_TABLE_H__
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * A list of strings stored as a count, an array of count + 1
+ * offsets and a blob with the null terminated strings:
+ *
+ *   uint64_t count
+ *   uint64_t offsets[ count + 1 ]   (relative to the blob)
+ *   char blob[ offsets[ count ] ]
+ *
+ * The table can be used in place, e.g. directly in a memory mapped
+ * file, so opening a file with millions of names does not allocate
+ * a string for each name. The index that maps names to positions is
+ * only built the first time a name is looked up.
+ */
+class string_table
+{
+    public:
+        /**
+         * Constructs an empty table.
+         */
+        string_table();
+
+        /**
+         * Constructs a table that owns a packed copy of the strings.
+         *
+         * @param strings The strings.
+         */
+        string_table(const std::vector<std::string> &strings);
+
+        /**
+         * Uses a packed table in place, the memory must outlive
+         * the table.
+         *
+         * @param data The packed table.
+         * @param length Length of the packed table in bytes.
+         *
+         * @return True if the table is valid, false otherwise.
+         */
+        bool open(const char *data, uint64_t length);
+
+        /**
+         * Returns the number of strings.
+         *
+         * @return The number of strings.
+         */
+        size_t size() const
+        {
+            return m_count;
+        }
+
+        /**
+         * Returns a string.
+         *
+         * @param index Index of the string, must be less than size( ).
+         *
+         * @return The null terminated string.
+         */
+        const char *get(size_t index) const
+        {
+            uint64_t offset;
+            memcpy( &offset, m_offsets + index * sizeof( uint64_t ), sizeof( uint64_t ) );
+            return m_blob + offset;
+        }
+
+        /**
+         * Finds the index of a string, if a string occurs more than
+         * once the last index is returned. The first call builds the
+         * index, so it must not be called concurrently.
+         *
+         * @param name The string to find.
+         * @param index The index will be stored here.
+         *
+         * @return True if the string was found, false otherwise.
+         */
+        bool find(const std::string &name, uint32_t *index);
+
+        /**
+         * Uses a hash index created by pack_index in place, so that
+         * the index does not have to be built when the table is
+         * opened from a file. The memory must outlive the table.
+         *
+         * @param data The packed index, aligned to 4 bytes.
+         * @param length Length of the packed index in bytes.
+         *
+         * @return True if the index is valid, false otherwise.
+         */
+        bool open_index(const char *data, uint64_t length);
+
+        /**
+         * Returns the hash index of the strings, so that it can be
+         * stored together with the table.
+         *
+         * @return The packed index.
+         */
+        std::string pack_index();
+
+        /**
+         * Copies the strings into a vector.
+         *
+         * @return The strings.
+         */
+        std::vector<std::string> to_vector() const;
+
+        /**
+         * Packs strings into the table format.
+         *
+         * @param strings The strings.
+         *
+         * @return The packed table.
+         */
+        static std::string pack(const std::vector<std::string> &strings);
+
+    private:
+        /**
+         * Not copyable, since the table may point into its own data.
+         */
+        string_table(const string_table &other);
+        string_table &operator=(const string_table &other);
+
+        /**
+         * Builds the hash index of the strings.
+         */
+        void build_index();
+
+        /**
+         * Packed table when the table owns its data.
+         */
+        std::string m_packed;
+
+        /**
+         * Number of strings.
+         */
+        uint64_t m_count;
+
+        /**
+         * Start of the offsets array, it is not necessarily aligned.
+         */
+        const char *m_offsets;
+
+        /**
+         * Start of the blob of strings.
+         */
+        const char *m_blob;
+
+        /**
+         * Open addressing hash table with the index + 1 of each
+         * string, 0 denotes an empty slot.
+         */
+        std::vector<uint32_t> m_slots;
+
+        /**
+         * The hash table that is used, either m_slots or an index
+         * opened in place.
+         */
+        const uint32_t *m_index;
+
+        /**
+         * Number of slots in the hash table, a power of two.
+         */
+        uint64_t m_num_slots;
+};
+
+#endif /* End of __STRING_TABLE_H__ */
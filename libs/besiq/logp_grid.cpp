@@ -81,6 +81,24 @@ logp_grid::add_pvalue(const std::string &snp1, const std::string &snp2, double p
     return true;
 }
 
+void
+logp_grid::merge(const logp_grid &other)
+{
+    for(int i = 0; i < m_grid.size( ) && i < other.m_grid.size( ); i++)
+    {
+        for(int j = 0; j < m_grid[ i ].size( ) && j < other.m_grid[ i ].size( ); j++)
+        {
+            grid_data &data = m_grid[ i ][ j ];
+            const grid_data &other_data = other.m_grid[ i ][ j ];
+
+            data.max_value = std::max( data.max_value, other_data.max_value );
+            data.sum += other_data.sum;
+            data.sum_sq += other_data.sum_sq;
+            data.n += other_data.n;
+        }
+    }
+}
+
 void
 logp_grid::write_grid(std::ostream &stream)
 {
@@ -73,6 +73,14 @@ public:
      */
     bool add_pvalue(const std::string &snp1, const std::string &snp2, double p);
 
+    /**
+     * Adds the summary stats of another grid, created from the
+     * same loci, to this grid.
+     *
+     * @param other The other grid.
+     */
+    void merge(const logp_grid &other);
+
     /**
      * Writes the grid to a file on the csv format
      *
@@ -45,6 +45,10 @@ std::vector<std::string>
 bayes_fast_method::init()
 {
     m_weight = arma::ones<arma::vec>( get_data( )->missing.n_elem );
+    for(int i = 0; i < m_models.size( ); i++)
+    {
+        m_models[ i ]->set_max_count( m_weight.n_elem );
+    }
    
     const arma::uvec &missing = get_data( )->missing;
     for(int i = 0; i < missing.size( ); i++)
@@ -62,11 +66,14 @@ bayes_fast_method::init()
 
 double bayes_fast_method::run(const snp_row &row1, const snp_row &row2, float *output)
 {
+    /* All models are computed from the same counts. */
+    arma::mat count = joint_count( row1, row2, get_data( )->phenotype, m_weight );
+
     log_double denominator = 0.0;
     std::vector<log_double> prior_likelihood( m_models.size( ), 0.0 );
     for(int i = 0; i < m_models.size( ); i++)
     {
-        prior_likelihood[ i ] = m_models[ i ]->prior( ) * m_models[ i ]->prob( row1, row2, get_data( )->phenotype, m_weight );
+        prior_likelihood[ i ] = m_models[ i ]->prior( ) * m_models[ i ]->prob( count );
         denominator += prior_likelihood[ i ];
     }
     log_double posterior = prior_likelihood[ 0 ] / denominator;
@@ -75,3 +82,15 @@ double bayes_fast_method::run(const snp_row &row1, const snp_row &row2, float *o
     
     return posterior.value( );
 }
+
+std::string
+bayes_fast_method::statistic_name() const
+{
+    return "Posterior";
+}
+
+bool
+bayes_fast_method::higher_is_better() const
+{
+    return true;
+}
@@ -46,6 +46,18 @@ public:
      */
     virtual double run(const snp_row &row1, const snp_row &row2, float *output);
 
+    /**
+     * The posterior probability of an interaction.
+     *
+     * @see method_type::statistic_name.
+     */
+    virtual std::string statistic_name() const;
+
+    /**
+     * @see method_type::higher_is_better.
+     */
+    virtual bool higher_is_better() const;
+
 private:
     /**
      * The different models that is part of the besiq method,
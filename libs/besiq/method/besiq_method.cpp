@@ -49,6 +49,12 @@ besiq_method::init()
     if( get_data( )->covariate_matrix.n_elem == 0 )
     {
         m_weight = arma::ones<arma::vec>( get_data( )->missing.n_elem );
+
+        /* Counts are integers, so the likelihoods can be looked up. */
+        for(int i = 0; i < m_models.size( ); i++)
+        {
+            m_models[ i ]->set_max_count( m_weight.n_elem );
+        }
     }
     else
     {
@@ -80,18 +86,55 @@ besiq_method::init()
     return header;
 }
 
-double besiq_method::run(const snp_row &row1, const snp_row &row2, float *output)
+log_double
+besiq_method::compute_posterior(const arma::mat &count)
 {
     log_double denominator = 0.0;
-    std::vector<log_double> prior_likelihood( m_models.size( ), 0.0 );
+    log_double first = 0.0;
     for(int i = 0; i < m_models.size( ); i++)
     {
-        prior_likelihood[ i ] = m_models[ i ]->prior( ) * m_models[ i ]->prob( row1, row2, get_data( )->phenotype, m_weight );
-        denominator += prior_likelihood[ i ];
+        log_double prior_likelihood = m_models[ i ]->prior( ) * m_models[ i ]->prob( count );
+        denominator += prior_likelihood;
+        if( i == 0 )
+        {
+            first = prior_likelihood;
+        }
     }
-    log_double posterior = prior_likelihood[ 0 ] / denominator;
+
+    return first / denominator;
+}
+
+double besiq_method::run(const snp_row &row1, const snp_row &row2, float *output)
+{
+    arma::mat count = joint_count( row1, row2, get_data( )->phenotype, m_weight );
+    log_double posterior = compute_posterior( count );
 
     output[ 0 ] = posterior.value( );
 
     return posterior.value( );
 }
+
+void
+besiq_method::run_batch(const std::vector<snp_row_pair> &pairs, float *output, size_t num_columns, double *statistics, size_t *ok_samples)
+{
+    std::vector<arma::mat> counts = joint_count( pairs, get_data( )->phenotype, m_weight );
+    for(size_t i = 0; i < pairs.size( ); i++)
+    {
+        log_double posterior = compute_posterior( counts[ i ] );
+        output[ i * num_columns ] = posterior.value( );
+        statistics[ i ] = posterior.value( );
+        ok_samples[ i ] = num_ok_samples( *pairs[ i ].first, *pairs[ i ].second );
+    }
+}
+
+std::string
+besiq_method::statistic_name() const
+{
+    return "Posterior";
+}
+
+bool
+besiq_method::higher_is_better() const
+{
+    return true;
+}
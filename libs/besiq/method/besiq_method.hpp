@@ -46,6 +46,35 @@ public:
      */
     virtual double run(const snp_row &row1, const snp_row &row2, float *output);
 
+    /**
+     * Counts all pairs of the batch before the posteriors are computed.
+     *
+     * @see method_type::run_batch.
+     */
+    virtual void run_batch(const std::vector<snp_row_pair> &pairs, float *output, size_t num_columns, double *statistics, size_t *ok_samples);
+
+    /**
+     * The posterior probability of an interaction.
+     *
+     * @see method_type::statistic_name.
+     */
+    virtual std::string statistic_name() const;
+
+    /**
+     * @see method_type::higher_is_better.
+     */
+    virtual bool higher_is_better() const;
+
+    /**
+     * Computes the posterior probability of the first model from
+     * the joint counts of a pair, all models use the same counts.
+     *
+     * @param count The weighted counts from joint_count.
+     *
+     * @return The posterior probability of the first model.
+     */
+    log_double compute_posterior(const arma::mat &count);
+
 private:
     /**
      * The different models that is part of the besiq method,
@@ -1,13 +1,27 @@
+#include <algorithm>
+#include <stdexcept>
+
 #include <dcdflib/libdcdf.hpp>
 #include <besiq/method/caseonly_method.hpp>
 #include <besiq/stats/snp_count.hpp>
 
-caseonly_method::caseonly_method(method_data_ptr data, const std::string &method)
+caseonly_method::caseonly_method(method_data_ptr data, const std::string &method, bool cases_only)
 : method_type::method_type( data ),
   m_method( method ),
+  m_cases_only( cases_only ),
   m_wald( data )
 {
-    m_weight = arma::ones<arma::vec>( data->phenotype.size( ) );
+    if( cases_only && method != "r2" && method != "css" )
+    {
+        throw std::invalid_argument( "caseonly_method: Only 'r2' and 'css' can be computed from the cases only." );
+    }
+
+    m_mask = make_phenotype_mask( data->phenotype, data->missing );
+    if( cases_only )
+    {
+        /* The controls are never visited. */
+        std::fill( m_mask.controls.begin( ), m_mask.controls.end( ), 0 );
+    }
 }
 
 std::vector<std::string>
@@ -26,8 +40,11 @@ caseonly_method::init()
         }
         
         header.push_back( "P_ld" );
-        std::vector<std::string> wald_header = m_wald.init( );
-        header.insert( header.end( ), wald_header.begin( ), wald_header.end( ) );
+        if( !m_cases_only )
+        {
+            std::vector<std::string> wald_header = m_wald.init( );
+            header.insert( header.end( ), wald_header.begin( ), wald_header.end( ) );
+        }
     }
     else if( m_method == "contrast" )
     {
@@ -41,29 +58,85 @@ caseonly_method::init()
 double
 caseonly_method::run(const snp_row &row1, const snp_row &row2, float *output)
 {
-    double p = -1.0;
-    if( m_method == "r2" )
+    return compute( joint_count( row1, row2, m_mask ), output );
+}
+
+double
+caseonly_method::run_sparse(const std::pair<std::string, std::string> &pair, const snp_row &row1, const snp_row &row2, const sparse_row *sparse1, const sparse_row *sparse2, float *output)
+{
+    if( sparse1 != NULL && sparse2 != NULL )
+    {
+        return compute( joint_count( *sparse1, *sparse2, m_mask ), output );
+    }
+    else if( sparse1 != NULL )
+    {
+        return compute( joint_count( *sparse1, row2, m_mask, get_marginal( pair.second, row2 ) ), output );
+    }
+    else if( sparse2 != NULL )
+    {
+        return compute( joint_count( row1, *sparse2, m_mask, get_marginal( pair.first, row1 ) ), output );
+    }
+    else
+    {
+        return run( row1, row2, output );
+    }
+}
+
+bool
+caseonly_method::uses_sparse_rows() const
+{
+    return true;
+}
+
+const arma::mat &
+caseonly_method::get_marginal(const std::string &name, const snp_row &row)
+{
+    std::map<std::string, arma::mat>::iterator it = m_marginals.find( name );
+    if( it == m_marginals.end( ) )
     {
-        p = compute_r2( row1, row2, output );
-        m_wald.run( row1, row2, &output[ 2 ] );
+        if( m_marginals.size( ) >= CASEONLY_MAX_MARGINALS )
+        {
+            m_marginals.clear( );
+        }
+        it = m_marginals.insert( std::make_pair( name, marginal_count( row, m_mask ) ) ).first;
     }
-    else if( m_method == "css" )
+
+    return it->second;
+}
+
+double
+caseonly_method::compute(const arma::mat &counts, float *output)
+{
+    /* All statistics are computed from the same table. */
+    double p = -1.0;
+    if( m_method == "r2" || m_method == "css" )
     {
-        p = compute_css( row1, row2, output );
-        m_wald.run( row1, row2, &output[ 2 ] );
+        arma::mat ld_counts = m_cases_only ? arma::mat( counts.col( 1 ) ) : counts;
+        if( m_method == "r2" )
+        {
+            p = compute_r2( ld_counts, output );
+        }
+        else
+        {
+            p = compute_css( ld_counts, output );
+        }
+
+        if( !m_cases_only )
+        {
+            m_wald.compute( counts, &output[ 2 ] );
+        }
     }
     else if( m_method == "contrast" )
     {
-        p = compute_contrast( row1, row2, output );
+        p = compute_contrast( counts, output );
     }
 
     return p;
 }
 
 double
-caseonly_method::compute_r2(const snp_row &row1, const snp_row &row2, float *output)
+caseonly_method::compute_r2(const arma::mat &counts, float *output)
 {
-    arma::mat counts = joint_count( row1, row2, get_data( )->phenotype, m_weight );
     arma::vec snp_snp = sum( counts, 1 );
     arma::vec snp1 = arma::zeros<arma::vec>( 3 );
     arma::vec snp2 = arma::zeros<arma::vec>( 3 );
@@ -109,9 +182,8 @@ caseonly_method::compute_r2(const snp_row &row1, const snp_row &row2, float *out
 }
 
 double
-caseonly_method::compute_css(const snp_row &row1, const snp_row &row2, float *output)
+caseonly_method::compute_css(const arma::mat &counts, float *output)
 {
-    arma::mat counts = joint_count( row1, row2, get_data( )->phenotype, m_weight );
     arma::vec snp_snp = sum( counts, 1 );
     arma::vec snp1 = arma::zeros<arma::vec>( 3 );
     arma::vec snp2 = arma::zeros<arma::vec>( 3 );
@@ -157,9 +229,8 @@ caseonly_method::compute_css(const snp_row &row1, const snp_row &row2, float *ou
 }
 
 double
-caseonly_method::compute_contrast(const snp_row &row1, const snp_row &row2, float *output)
+caseonly_method::compute_contrast(const arma::mat &counts, float *output)
 {
-    arma::mat counts = joint_count( row1, row2, get_data( )->phenotype, m_weight );
 
     if( arma::min( arma::min( counts ) ) < METHOD_SMALLEST_CELL_SIZE_BINOMIAL )
     {
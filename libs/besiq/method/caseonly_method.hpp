@@ -1,6 +1,7 @@
 #ifndef __CASEONLY_METHOD_H__
 #define __CASEONLY_METHOD_H__
 
+#include <map>
 #include <string>
 #include <vector>
 
@@ -9,6 +10,13 @@
 #include <besiq/method/method.hpp>
 #include <besiq/method/wald_method.hpp>
 #include <besiq/stats/log_scale.hpp>
+#include <besiq/stats/snp_count.hpp>
+
+/**
+ * Number of snps whose marginal counts are kept, the counts are
+ * cleared when this is reached.
+ */
+#define CASEONLY_MAX_MARGINALS 65536
 
 /**
  * This class is responsible for intializing and repeatedly
@@ -23,9 +31,13 @@ public:
      *
      * @param data Additional data required by all methods, such as
      *             covariates.
-     * @param method The method to use, 'r2' or 'css'.
+     * @param method The method to use, 'r2', 'css' or 'contrast'.
+     * @param cases_only If true, 'r2' and 'css' are computed from the
+     *                   cases only and the wald test is not run. The
+     *                   contrast needs the controls, so it can not be
+     *                   combined with this.
      */
-    caseonly_method(method_data_ptr data, const std::string &method);
+    caseonly_method(method_data_ptr data, const std::string &method, bool cases_only = false);
     
     /**
      * @see method_type::init.
@@ -37,21 +49,72 @@ public:
      */
     virtual double run(const snp_row &row1, const snp_row &row2, float *output);
 
+    /**
+     * Counts the pair from the sparse rows when available.
+     *
+     * @see method_type::run_sparse.
+     */
+    virtual double run_sparse(const std::pair<std::string, std::string> &pair, const snp_row &row1, const snp_row &row2, const sparse_row *sparse1, const sparse_row *sparse2, float *output);
+
+    /**
+     * @see method_type::uses_sparse_rows.
+     */
+    virtual bool uses_sparse_rows() const;
+
 private: 
-    virtual double compute_r2(const snp_row &row1, const snp_row &row2, float *output);
-    virtual double compute_css(const snp_row &row1, const snp_row &row2, float *output);
-    virtual double compute_contrast(const snp_row &row1, const snp_row &row2, float *output);
     /**
-     * A weight > 0 associated with each sample, that allows for
-     * covariate adjustment.
+     * Computes the statistic of the chosen method from the counts
+     * of a pair.
+     *
+     * @param counts The counts as a 9x2 matrix, see joint_count.
+     * @param output The results, see method_type::run.
+     *
+     * @return The p-value, or -9 if it could not be computed.
      */
-    arma::vec m_weight;
+    double compute(const arma::mat &counts, float *output);
+
+    /**
+     * Returns the counts of the controls and cases with each genotype
+     * of a snp, they are counted the first time the snp is used. The
+     * counts are kept for at most CASEONLY_MAX_MARGINALS snps.
+     *
+     * @param name The name of the snp.
+     * @param row The genotypes of the snp.
+     *
+     * @return The counts, see marginal_count, valid until the next call.
+     */
+    const arma::mat &get_marginal(const std::string &name, const snp_row &row);
+
+    /**
+     * The statistics are computed from the counts of a pair, as a
+     * 9x2 matrix of controls and cases, or a 9x1 matrix of cases
+     * for 'r2' and 'css' when only the cases are used.
+     */
+    virtual double compute_r2(const arma::mat &counts, float *output);
+    virtual double compute_css(const arma::mat &counts, float *output);
+    virtual double compute_contrast(const arma::mat &counts, float *output);
+
+    /**
+     * The controls and the cases that are counted.
+     */
+    phenotype_mask m_mask;
+
+    /**
+     * The counts of snps that have been paired with a sparse row,
+     * by the name of the snp.
+     */
+    std::map<std::string, arma::mat> m_marginals;
 
     /**
      * What type of method to use 'r2' or 'css'.
      */
     std::string m_method;
 
+    /**
+     * If true, only the cases are used.
+     */
+    bool m_cases_only;
+
     /**
      * To run the LR test.
      */
@@ -3,13 +3,9 @@
 #include <besiq/stats/snp_count.hpp>
 
 loglinear_method::loglinear_method(method_data_ptr data)
-: method_type::method_type( data )
+: method_type::method_type( data ),
+  m_models( false, data->phenotype.n_elem )
 {
-    m_models.push_back( new binomial_full( ) );
-    m_models.push_back( new binomial_single( true ) );
-    m_models.push_back( new binomial_single( false ) );
-    m_models.push_back( new binomial_null( ) );
-
     m_weight = arma::ones<arma::vec>( data->phenotype.size( ) );
 }
 
@@ -34,20 +30,27 @@ loglinear_method::run(const snp_row &row1, const snp_row &row2, float *output)
         return -9;
     }
 
-    std::vector<log_double> likelihood( m_models.size( ), 0.0 );
-    std::vector<double> bic( m_models.size( ), 0.0 );
-    for(int i = 0; i < m_models.size( ); i++)
+    double likelihood[ CLOSED_FORM_NUM_MODELS ];
+    m_models.log_likelihoods( count, likelihood );
+
+    /* Compare the full model with the best of the simpler models, ties go to snp1, snp2 and then null. */
+    int order[ 3 ] = { CLOSED_FORM_SNP1, CLOSED_FORM_SNP2, CLOSED_FORM_NULL };
+    int best_model = order[ 0 ];
+    double best_bic = 0.0;
+    for(int i = 0; i < 3; i++)
     {
-        likelihood[ i ] = m_models[ i ]->prob( count );
-        bic[ i ] = -2.0 * likelihood[ i ].log_value( ) + m_models[ i ]->df( ) * log( num_samples );
+        double bic = -2.0 * likelihood[ order[ i ] ] + closed_form_table::df( order[ i ] ) * log( num_samples );
+        if( i == 0 || bic < best_bic )
+        {
+            best_model = order[ i ];
+            best_bic = bic;
+        }
     }
-
-    unsigned int best_model = std::distance( bic.begin( ), std::min_element( bic.begin( ) + 1, bic.end( ) ) );
-    double LR = -2.0*(likelihood[ best_model ].log_value( ) - likelihood[ 0 ].log_value( ));
+    double LR = -2.0*(likelihood[ best_model ] - likelihood[ CLOSED_FORM_FULL ]);
 
     try
     {
-        double p_value = 1.0 - chi_square_cdf( LR, m_models[ 0 ]->df( ) - m_models[ best_model ]->df( ) );
+        double p_value = 1.0 - chi_square_cdf( LR, closed_form_table::df( CLOSED_FORM_FULL ) - closed_form_table::df( best_model ) );
         output[ 0 ] = p_value;
         return p_value;
     }
@@ -8,7 +8,7 @@
 
 #include <besiq/method/method.hpp>
 #include <besiq/stats/log_scale.hpp>
-#include <besiq/stats/binomial_models.hpp>
+#include <besiq/stats/closed_form_table.hpp>
 
 /**
  * This class is responsible for intializing and repeatedly
@@ -44,9 +44,9 @@ private:
     arma::vec m_weight;
 
     /**
-     * The models used.
+     * Computes the likelihoods of the models.
      */
-    std::vector<closed_form_model *> m_models;
+    closed_form_table m_models;
 };
 
 #endif /* End of __LOGLINEAR_METHOD_H__ */
@@ -1,42 +1,234 @@
 #include <algorithm>
+#include <deque>
+#include <iostream>
+
+#include <stdlib.h>
 
 #include <plink/plink_file.hpp>
 #include <besiq/method/method.hpp>
 #include <besiq/io/pairfile.hpp>
 #include <besiq/io/resultfile.hpp>
 
+/**
+ * Number of pairs that are read ahead of the current pair, so that
+ * genotypes that are decoded on demand can be prefetched.
+ */
+#define RUN_METHOD_LOOKAHEAD 4096
+
+/**
+ * Reads pairs ahead of the pair that is analyzed, and hints the
+ * genotype matrix about the snps that will be needed.
+ */
+class pair_lookahead
+{
+public:
+    pair_lookahead(pairfile &pairs, genotype_matrix &genotypes)
+        : m_pairs( pairs ),
+          m_genotypes( genotypes ),
+          m_enabled( genotypes.is_on_demand( ) ),
+          m_done( false )
+    {
+    }
+
+    bool read(std::pair<std::string, std::string> &pair)
+    {
+        if( !m_enabled )
+        {
+            return m_pairs.read( pair );
+        }
+
+        std::pair<std::string, std::string> next;
+        while( !m_done && m_upcoming.size( ) < RUN_METHOD_LOOKAHEAD )
+        {
+            if( !m_pairs.read( next ) )
+            {
+                m_done = true;
+                break;
+            }
+
+            m_genotypes.prefetch( next.first );
+            m_genotypes.prefetch( next.second );
+            m_upcoming.push_back( next );
+        }
+
+        if( m_upcoming.empty( ) )
+        {
+            return false;
+        }
+
+        pair = m_upcoming.front( );
+        m_upcoming.pop_front( );
+
+        return true;
+    }
+
+private:
+    pairfile &m_pairs;
+    genotype_matrix &m_genotypes;
+    bool m_enabled;
+    bool m_done;
+    std::deque< std::pair<std::string, std::string> > m_upcoming;
+};
+
+/**
+ * Number of pairs that are counted together when the method is run
+ * on a batch of pairs.
+ */
+#define RUN_METHOD_BATCH_SIZE 256
+
+/**
+ * Summarizes and writes the results of a pair.
+ *
+ * @param method The method.
+ * @param pair The names of the snps.
+ * @param output The results of the pair, the last column is set to ok_samples.
+ * @param num_columns The length of the header.
+ * @param statistic The value returned by the method.
+ * @param ok_samples The number of samples that were used.
+ * @param result The result file.
+ */
+static void
+write_pair(method_type &method, const std::pair<std::string, std::string> &pair, float *output, size_t num_columns, double statistic, size_t ok_samples, resultfile &result)
+{
+    double threshold = method.get_data( )->threshold;
+    pair_summary *summary = method.get_data( )->summary.get( );
+    if( summary != NULL && statistic != result_get_missing( ) )
+    {
+        summary->add( pair, statistic );
+    }
+
+    if( threshold != -9 && (statistic == -9 || statistic > threshold) )
+    {
+        return;
+    }
+
+    output[ num_columns - 1 ] = ok_samples;
+
+    result.write( pair, output );
+}
+
 void run_method(method_type &method, genotype_matrix_ptr genotypes, pairfile &pairs, resultfile &result)
 {
     std::vector<std::string> method_header = method.init( );
     method_header.push_back( "N" );
     result.set_header( method_header );
 
-    float *output = new float[ method_header.size( ) ];
+    size_t num_columns = method_header.size( );
     double threshold = method.get_data( )->threshold;
+    pair_summary *summary = method.get_data( )->summary.get( );
+    if( summary != NULL )
+    {
+        if( method.higher_is_better( ) && summary->has_grid( ) )
+        {
+            std::cerr << "besiq: error: --grid can only summarize p-values, not '" << method.statistic_name( ) << "'." << std::endl;
+            exit( 1 );
+        }
+        summary->set_statistic( method.statistic_name( ), method.higher_is_better( ) );
+    }
     
+    /* Sparse copies of the rare snps are only created for methods that count from them. Rows
+     * that are decoded on demand may be dropped when other rows are read, so they are not batched. */
+    bool use_sparse = method.uses_sparse_rows( );
+    size_t batch_size = ( use_sparse || genotypes->is_on_demand( ) ) ? 1 : RUN_METHOD_BATCH_SIZE;
+
+    std::vector< std::pair<std::string, std::string> > batch_names;
+    std::vector<snp_row_pair> batch_rows;
+    std::vector<snp_row_pair> testable_rows;
+    std::vector<size_t> testable_index;
+    std::vector<float> output( batch_size * num_columns );
+    std::vector<double> statistics( batch_size );
+    std::vector<size_t> ok_samples( batch_size );
+
+    pair_lookahead upcoming( pairs, *genotypes );
     std::pair<std::string, std::string> pair;
-    while( pairs.read( pair ) )
+    bool has_pair = true;
+    while( has_pair )
     {
-        snp_row const *row1 = genotypes->get_row( pair.first );
-        snp_row const *row2 = genotypes->get_row( pair.second );
+        has_pair = upcoming.read( pair );
+        if( has_pair )
+        {
+            snp_row const *row1 = genotypes->get_row( pair.first );
+            snp_row const *row2 = genotypes->get_row( pair.second );
+            if( row1 == NULL || row2 == NULL )
+            {
+                continue;
+            }
 
-        if( row1 == NULL || row2 == NULL )
+            /* Pairs that can not produce a statistic only need the number of samples. */
+            bool testable = method.is_testable( *genotypes->get_summary( pair.first ), *genotypes->get_summary( pair.second ) );
+            if( !testable && threshold != -9 )
+            {
+                continue;
+            }
+
+            if( testable )
+            {
+                testable_index.push_back( batch_names.size( ) );
+                testable_rows.push_back( snp_row_pair( row1, row2 ) );
+            }
+            batch_names.push_back( pair );
+            batch_rows.push_back( snp_row_pair( row1, row2 ) );
+            if( batch_names.size( ) < batch_size )
+            {
+                continue;
+            }
+        }
+        if( batch_names.empty( ) )
         {
-            continue;
+            break;
         }
 
-        std::fill( output, output + method_header.size( ), result_get_missing( ) );
-
-        double statistic = method.run( *row1, *row2, output );
-        if( threshold != -9 && (statistic == -9 || statistic > threshold) )
+        std::fill( output.begin( ), output.end( ), result_get_missing( ) );
+        std::fill( statistics.begin( ), statistics.end( ), result_get_missing( ) );
+        if( use_sparse && !testable_rows.empty( ) )
         {
-            continue;
+            sparse_row const *sparse1 = genotypes->get_sparse_row( batch_names[ 0 ].first );
+            sparse_row const *sparse2 = genotypes->get_sparse_row( batch_names[ 0 ].second );
+            if( sparse1 != NULL || sparse2 != NULL )
+            {
+                statistics[ 0 ] = method.run_sparse( batch_names[ 0 ], *testable_rows[ 0 ].first, *testable_rows[ 0 ].second, sparse1, sparse2, &output[ 0 ] );
+                ok_samples[ 0 ] = method.num_ok_samples( *testable_rows[ 0 ].first, *testable_rows[ 0 ].second );
+            }
+            else
+            {
+                method.run_batch( testable_rows, &output[ 0 ], num_columns, &statistics[ 0 ], &ok_samples[ 0 ] );
+            }
+        }
+        else if( !testable_rows.empty( ) )
+        {
+            /* The testable pairs are run first, and moved to their place in the batch. */
+            method.run_batch( testable_rows, &output[ 0 ], num_columns, &statistics[ 0 ], &ok_samples[ 0 ] );
+            for(size_t k = testable_rows.size( ); k-- > 0; )
+            {
+                size_t i = testable_index[ k ];
+                if( i != k )
+                {
+                    std::copy( &output[ k * num_columns ], &output[ ( k + 1 ) * num_columns ], &output[ i * num_columns ] );
+                    std::fill( &output[ k * num_columns ], &output[ ( k + 1 ) * num_columns ], result_get_missing( ) );
+                    statistics[ i ] = statistics[ k ];
+                    statistics[ k ] = result_get_missing( );
+                    ok_samples[ i ] = ok_samples[ k ];
+                }
+            }
         }
 
-        output[ method_header.size( ) - 1 ] = method.num_ok_samples( *row1, *row2 );
+        size_t k = 0;
+        for(size_t i = 0; i < batch_names.size( ); i++)
+        {
+            bool testable = k < testable_index.size( ) && testable_index[ k ] == i;
+            size_t num_samples = testable ? ok_samples[ i ] : count_called( *batch_rows[ i ].first, *batch_rows[ i ].second );
+            write_pair( method, batch_names[ i ], &output[ i * num_columns ], num_columns, statistics[ i ], num_samples, result );
+            k += testable;
+        }
 
-        result.write( pair, output );
+        batch_names.clear( );
+        batch_rows.clear( );
+        testable_rows.clear( );
+        testable_index.clear( );
     }
 
-    delete[] output;
+    if( summary != NULL )
+    {
+        summary->write( std::cout );
+    }
 }
@@ -7,6 +7,10 @@
 #include <armadillo>
 
 #include <plink/snp_row.hpp>
+#include <plink/snp_summary.hpp>
+#include <plink/sparse_row.hpp>
+#include <besiq/pair_summary.hpp>
+#include <besiq/stats/snp_count.hpp>
 #include <shared_ptr/shared_ptr.hpp>
 
 class pairfile;
@@ -36,6 +40,18 @@ struct method_data
      */
     arma::vec phenotype;
 
+    /**
+     * All phenotypes of the phenotype file as a sample by phenotype
+     * matrix when they are tested together, missing values are NaN.
+     * Empty if only phenotype is tested.
+     */
+    arma::mat phenotypes;
+
+    /**
+     * The name of each column in phenotypes.
+     */
+    std::vector<std::string> phenotype_names;
+
     /**
      * The covariates.
      */
@@ -46,6 +62,13 @@ struct method_data
      */
     arma::uvec missing;
 
+    /**
+     * Index in the plink file of each sample, in the original
+     * order. Samples that can not be used are removed before
+     * the analysis, so this may be shorter than the .fam file.
+     */
+    arma::uvec samples;
+
     /**
     * The number of interactions to correct for.
     */
@@ -75,6 +98,12 @@ struct method_data
      * Use fast less robust matrix inversion.
      */
     bool fast_inversion;
+
+    /**
+     * If set, the p-values of all pairs are summarized here and
+     * written when all pairs have been run.
+     */
+    shared_ptr<pair_summary> summary;
 };
 
 /**
@@ -142,6 +171,98 @@ public:
      */
     virtual double run(const snp_row &row1, const snp_row &row2, float *output) = 0;
 
+    /**
+     * Runs the method on many pairs, so that methods can count all
+     * pairs before the statistics are computed. By default each pair
+     * is run separately.
+     *
+     * @param pairs The pairs of snps.
+     * @param output The results of pair i are stored from
+     *               output + i * num_columns, see run.
+     * @param num_columns The length of the header.
+     * @param statistics The value returned by run for each pair will
+     *                   be stored here.
+     * @param ok_samples The number of samples that could be used for
+     *                   each pair will be stored here, see num_ok_samples.
+     */
+    virtual void run_batch(const std::vector<snp_row_pair> &pairs, float *output, size_t num_columns, double *statistics, size_t *ok_samples)
+    {
+        for(size_t i = 0; i < pairs.size( ); i++)
+        {
+            statistics[ i ] = run( *pairs[ i ].first, *pairs[ i ].second, output + i * num_columns );
+            ok_samples[ i ] = num_ok_samples( *pairs[ i ].first, *pairs[ i ].second );
+        }
+    }
+
+    /**
+     * Runs the method on a pair where one or both snps are rare
+     * and also stored sparsely, so that methods which can count
+     * a pair from the sparse rows only visit the rare genotypes.
+     * Only called when uses_sparse_rows returns true, by default
+     * the dense rows are used.
+     *
+     * @param pair The names of the snps.
+     * @param row1 The first genotype.
+     * @param row2 The second genotype.
+     * @param sparse1 The first genotype as a sparse row, or NULL.
+     * @param sparse2 The second genotype as a sparse row, or NULL.
+     * @param output The results, see run.
+     *
+     * @return The value of the test statistic, see run.
+     */
+    virtual double run_sparse(const std::pair<std::string, std::string> &pair, const snp_row &row1, const snp_row &row2, const sparse_row *sparse1, const sparse_row *sparse2, float *output)
+    {
+        return run( row1, row2, output );
+    }
+
+    /**
+     * Returns true if run_sparse makes use of the sparse rows, the
+     * sparse copies of rare snps are otherwise never created.
+     *
+     * @return True if the method should be given sparse rows.
+     */
+    virtual bool uses_sparse_rows() const
+    {
+        return false;
+    }
+
+    /**
+     * Returns the name of the statistic that run returns, which is
+     * used when the statistics are summarized.
+     *
+     * @return The name of the statistic.
+     */
+    virtual std::string statistic_name() const
+    {
+        return "P";
+    }
+
+    /**
+     * Returns true if larger values returned by run are stronger
+     * evidence, e.g. posterior probabilities, and false for p-values.
+     *
+     * @return True if higher values are better.
+     */
+    virtual bool higher_is_better() const
+    {
+        return false;
+    }
+
+    /**
+     * Determines from the genotype counts of each snp whether
+     * run can compute anything for the pair, so that the pair can
+     * be skipped without counting the samples.
+     *
+     * @param snp1 Summary of the first genotype.
+     * @param snp2 Summary of the second genotype.
+     *
+     * @return False if run would only produce missing values.
+     */
+    virtual bool is_testable(const snp_summary &snp1, const snp_summary &snp2)
+    {
+        return true;
+    }
+
 private:
     /**
      * Additional data required by the method.
@@ -1,4 +1,7 @@
+#include <cmath>
+
 #include <dcdflib/libdcdf.hpp>
+#include <glm/irls.hpp>
 #include <glm/models/binomial.hpp>
 #include <glm/models/normal.hpp>
 
@@ -6,6 +9,148 @@
 
 #include <besiq/method/separate_method.hpp>
 
+/**
+ * Solves a symmetric 3x3 system with Cramer's rule.
+ *
+ * @param A The matrix.
+ * @param b The right hand side.
+ * @param x The solution will be stored here.
+ *
+ * @return False if the matrix is singular, true otherwise.
+ */
+static bool
+solve3(const double A[ 3 ][ 3 ], const double b[ 3 ], double x[ 3 ])
+{
+    double det = A[ 0 ][ 0 ] * ( A[ 1 ][ 1 ] * A[ 2 ][ 2 ] - A[ 1 ][ 2 ] * A[ 2 ][ 1 ] ) -
+                 A[ 0 ][ 1 ] * ( A[ 1 ][ 0 ] * A[ 2 ][ 2 ] - A[ 1 ][ 2 ] * A[ 2 ][ 0 ] ) +
+                 A[ 0 ][ 2 ] * ( A[ 1 ][ 0 ] * A[ 2 ][ 1 ] - A[ 1 ][ 1 ] * A[ 2 ][ 0 ] );
+    if( !( fabs( det ) > 1e-12 ) )
+    {
+        return false;
+    }
+
+    for(int k = 0; k < 3; k++)
+    {
+        double M[ 3 ][ 3 ];
+        for(int i = 0; i < 3; i++)
+        {
+            for(int j = 0; j < 3; j++)
+            {
+                M[ i ][ j ] = ( j == k ) ? b[ i ] : A[ i ][ j ];
+            }
+        }
+
+        x[ k ] = ( M[ 0 ][ 0 ] * ( M[ 1 ][ 1 ] * M[ 2 ][ 2 ] - M[ 1 ][ 2 ] * M[ 2 ][ 1 ] ) -
+                   M[ 0 ][ 1 ] * ( M[ 1 ][ 0 ] * M[ 2 ][ 2 ] - M[ 1 ][ 2 ] * M[ 2 ][ 0 ] ) +
+                   M[ 0 ][ 2 ] * ( M[ 1 ][ 0 ] * M[ 2 ][ 1 ] - M[ 1 ][ 1 ] * M[ 2 ][ 0 ] ) ) / det;
+    }
+
+    return true;
+}
+
+/**
+ * Fits the main effect model on the 2x2 table of a coding, where
+ * group g = 2 * snp1 + snp2 has the covariates ( 1, snp1, snp2 ).
+ * For the binomial model the fit is a logistic regression with
+ * Newton's method, for the normal model it is least squares.
+ *
+ * @param n Number of samples in each group.
+ * @param s Number of cases or sum of the phenotype in each group.
+ * @param q Sum of the squared phenotype in each group.
+ * @param is_normal If true, fit a linear model.
+ * @param logl The log likelihood will be stored here.
+ *
+ * @return True if the fit converged, false otherwise.
+ */
+static bool
+fit_grouped_null(const double *n, const double *s, const double *q, bool is_normal, double *logl)
+{
+    double x[ 4 ][ 3 ] = { { 1, 0, 0 }, { 1, 0, 1 }, { 1, 1, 0 }, { 1, 1, 1 } };
+    double total_n = n[ 0 ] + n[ 1 ] + n[ 2 ] + n[ 3 ];
+    double total_s = s[ 0 ] + s[ 1 ] + s[ 2 ] + s[ 3 ];
+
+    if( is_normal )
+    {
+        double I[ 3 ][ 3 ] = { { 0 } };
+        double U[ 3 ] = { 0 };
+        for(int g = 0; g < 4; g++)
+        {
+            for(int k = 0; k < 3; k++)
+            {
+                U[ k ] += x[ g ][ k ] * s[ g ];
+                for(int l = 0; l < 3; l++)
+                {
+                    I[ k ][ l ] += n[ g ] * x[ g ][ k ] * x[ g ][ l ];
+                }
+            }
+        }
+
+        double beta[ 3 ];
+        if( total_n <= 3 || !solve3( I, U, beta ) )
+        {
+            return false;
+        }
+
+        double rss = 0.0;
+        for(int g = 0; g < 4; g++)
+        {
+            double m = x[ g ][ 0 ] * beta[ 0 ] + x[ g ][ 1 ] * beta[ 1 ] + x[ g ][ 2 ] * beta[ 2 ];
+            rss += q[ g ] - 2 * m * s[ g ] + n[ g ] * m * m;
+        }
+
+        double sigma2 = rss / ( total_n - 3 );
+        *logl = -total_n / 2 * log( 2 * arma::datum::pi ) - total_n / 2 * log( sigma2 ) - rss / ( 2 * sigma2 );
+
+        return true;
+    }
+
+    double beta[ 3 ] = { log( total_s / ( total_n - total_s ) ), 0.0, 0.0 };
+    double old_logl = -HUGE_VAL;
+    for(int iter = 0; iter < IRLS_MAX_ITERS; iter++)
+    {
+        double I[ 3 ][ 3 ] = { { 0 } };
+        double U[ 3 ] = { 0 };
+        double cur_logl = 0.0;
+        for(int g = 0; g < 4; g++)
+        {
+            double eta = x[ g ][ 0 ] * beta[ 0 ] + x[ g ][ 1 ] * beta[ 1 ] + x[ g ][ 2 ] * beta[ 2 ];
+            double mu = 1.0 / ( 1.0 + exp( -eta ) );
+            if( n[ g ] > 0 )
+            {
+                cur_logl += s[ g ] * log( mu ) + ( n[ g ] - s[ g ] ) * log( 1 - mu );
+            }
+
+            for(int k = 0; k < 3; k++)
+            {
+                U[ k ] += x[ g ][ k ] * ( s[ g ] - n[ g ] * mu );
+                for(int l = 0; l < 3; l++)
+                {
+                    I[ k ][ l ] += n[ g ] * mu * ( 1 - mu ) * x[ g ][ k ] * x[ g ][ l ];
+                }
+            }
+        }
+
+        if( fabs( cur_logl - old_logl ) / ( 0.1 + fabs( cur_logl ) ) < IRLS_TOLERANCE )
+        {
+            *logl = cur_logl;
+            return true;
+        }
+        old_logl = cur_logl;
+
+        double delta[ 3 ];
+        if( !solve3( I, U, delta ) )
+        {
+            return false;
+        }
+        for(int k = 0; k < 3; k++)
+        {
+            beta[ k ] += delta[ k ];
+        }
+    }
+
+    return false;
+}
+
 separate_method::separate_method(method_data_ptr data, glm_model *model)
 : method_type::method_type( data ),
   m_model( model )
@@ -14,6 +159,14 @@ separate_method::separate_method(method_data_ptr data, glm_model *model)
     m_model_matrix.push_back( new separate_matrix( data->covariate_matrix, data->phenotype.n_elem, REC_DOM ) );
     m_model_matrix.push_back( new separate_matrix( data->covariate_matrix, data->phenotype.n_elem, DOM_REC ) );
     m_model_matrix.push_back( new separate_matrix( data->covariate_matrix, data->phenotype.n_elem, REC_REC ) );
+
+    /* Without covariates the design only depends on the joint genotype, so the
+     * default models can be fitted on the joint table instead of the samples. */
+    std::string link = model->get_link( ).get_name( );
+    m_is_normal = model->get_name( ) == "normal";
+    m_use_table = data->covariate_matrix.n_cols == 0 &&
+                  ( ( !m_is_normal && link == "logit" ) || ( m_is_normal && link == "identity" ) );
+    m_weight = 1.0 - arma::conv_to<arma::vec>::from( data->missing );
 }
 
 separate_method::~separate_method()
@@ -40,39 +193,192 @@ separate_method::init()
     return header;
 }
 
-double separate_method::run(const snp_row &row1, const snp_row &row2, float *output)
+bool
+separate_method::fit_table(const arma::mat &count, separate_mode_t mode, float *output)
 {
-    size_t num_samples = get_data( )->missing.n_elem - sum( get_data( )->missing );
-    
-    for(int i = 0; i < m_model_matrix.size( ); i++)
+    int snp1_threshold;
+    int snp2_threshold;
+    separate_thresholds( mode, &snp1_threshold, &snp2_threshold );
+
+    /* Collapse the joint table into the 2x2 table of the coding. */
+    double n[ 4 ] = { 0.0, 0.0, 0.0, 0.0 };
+    double s[ 4 ] = { 0.0, 0.0, 0.0, 0.0 };
+    double q[ 4 ] = { 0.0, 0.0, 0.0, 0.0 };
+    for(int i = 0; i < 3; i++)
     {
-        arma::uvec missing = get_data( )->missing;
-        m_model_matrix[ i ]->update_matrix( row1, row2, missing );
-        glm_info alt_info;
-        arma::vec b = glm_fit( m_model_matrix[ i ]->get_alt( ), get_data( )->phenotype, missing, *m_model, alt_info );
+        for(int j = 0; j < 3; j++)
+        {
+            int g = 2 * ( i >= snp1_threshold ) + ( j >= snp2_threshold );
+            if( m_is_normal )
+            {
+                s[ g ] += count( 3 * i + j, 0 );
+                n[ g ] += count( 3 * i + j, 1 );
+                q[ g ] += count( 3 * i + j, 2 );
+            }
+            else
+            {
+                s[ g ] += count( 3 * i + j, 1 );
+                n[ g ] += count( 3 * i + j, 0 ) + count( 3 * i + j, 1 );
+            }
+        }
+    }
 
-        glm_info null_info;
-        glm_fit( m_model_matrix[ i ]->get_null( ), get_data( )->phenotype, missing, *m_model, null_info );
-        num_samples = std::min( (size_t) (missing.n_elem - sum( missing )), num_samples );
+    /* The interaction model is saturated, so the fitted values are the group means. Empty or
+     * separated groups are left to the sample based fit, so that they are treated as before. */
+    double total_n = 0.0;
+    double mu[ 4 ];
+    for(int g = 0; g < 4; g++)
+    {
+        if( n[ g ] <= 0 || ( !m_is_normal && ( s[ g ] <= 0 || s[ g ] >= n[ g ] ) ) )
+        {
+            return false;
+        }
+        mu[ g ] = s[ g ] / n[ g ];
+        total_n += n[ g ];
+    }
 
-        if( !null_info.success || !alt_info.success )
+    double b;
+    double alt_logl = 0.0;
+    if( m_is_normal )
+    {
+        if( total_n <= 4 )
         {
-            continue;
+            return false;
         }
 
-        try
+        double rss = 0.0;
+        for(int g = 0; g < 4; g++)
+        {
+            rss += q[ g ] - s[ g ] * mu[ g ];
+        }
+        double sigma2 = rss / ( total_n - 4 );
+        alt_logl = -total_n / 2 * log( 2 * arma::datum::pi ) - total_n / 2 * log( sigma2 ) - rss / ( 2 * sigma2 );
+        b = mu[ 3 ] - mu[ 2 ] - mu[ 1 ] + mu[ 0 ];
+    }
+    else
+    {
+        for(int g = 0; g < 4; g++)
         {
-            double LR = -2 * ( null_info.logl - alt_info.logl );
-            double p = 1.0 - chi_square_cdf( LR, m_model_matrix[ i ]->num_df( ) );
-            output[ 2*i ] = b[ 2 ];
-            output[ 2*i + 1 ] = p;
+            alt_logl += s[ g ] * log( mu[ g ] ) + ( n[ g ] - s[ g ] ) * log( 1 - mu[ g ] );
         }
-        catch(bad_domain_value &e)
+        b = log( mu[ 3 ] / ( 1 - mu[ 3 ] ) ) - log( mu[ 2 ] / ( 1 - mu[ 2 ] ) ) -
+            log( mu[ 1 ] / ( 1 - mu[ 1 ] ) ) + log( mu[ 0 ] / ( 1 - mu[ 0 ] ) );
+    }
+
+    double null_logl;
+    if( !fit_grouped_null( n, s, q, m_is_normal, &null_logl ) )
+    {
+        return false;
+    }
+
+    try
+    {
+        double LR = -2 * ( null_logl - alt_logl );
+        double p = 1.0 - chi_square_cdf( LR, m_model_matrix[ mode ]->num_df( ) );
+        output[ 2*mode ] = b;
+        output[ 2*mode + 1 ] = p;
+    }
+    catch(bad_domain_value &e)
+    {
+    }
+
+    return true;
+}
+
+void
+separate_method::fit_samples(const snp_row &row1, const snp_row &row2, int mode, float *output)
+{
+    if( m_cells.size( ) != row1.size( ) )
+    {
+        /* The joint genotype is decoded once and shared by the remaining codings. */
+        m_cells.resize( row1.size( ) );
+        for(int i = 0; i < row1.size( ); i++)
         {
+            m_cells[ i ] = ( row1[ i ] != 3 && row2[ i ] != 3 ) ? 3 * row1[ i ] + row2[ i ] : SEPARATE_MISSING_CELL;
         }
     }
 
-    set_num_ok_samples( num_samples );
+    arma::uvec missing = get_data( )->missing;
+    separate_matrix *matrix = m_model_matrix[ mode ];
+    matrix->update_matrix( m_cells, missing );
+
+    glm_info alt_info;
+    arma::vec b = glm_fit( matrix->get_alt( ), get_data( )->phenotype, missing, *m_model, alt_info );
+
+    glm_info null_info;
+    glm_fit( matrix->get_null( ), get_data( )->phenotype, missing, *m_model, null_info );
+
+    if( !null_info.success || !alt_info.success )
+    {
+        return;
+    }
+
+    try
+    {
+        double LR = -2 * ( null_info.logl - alt_info.logl );
+        double p = 1.0 - chi_square_cdf( LR, matrix->num_df( ) );
+        output[ 2*mode ] = b[ 2 ];
+        output[ 2*mode + 1 ] = p;
+    }
+    catch(bad_domain_value &e)
+    {
+    }
+}
+
+double
+separate_method::compute(const snp_row &row1, const snp_row &row2, const arma::mat &count, float *output)
+{
+    if( m_is_normal )
+    {
+        set_num_ok_samples( (size_t) arma::accu( count.col( 1 ) ) );
+    }
+    else
+    {
+        set_num_ok_samples( (size_t) arma::accu( count ) );
+    }
+
+    m_cells.clear( );
+    for(int i = 0; i < m_model_matrix.size( ); i++)
+    {
+        if( !m_use_table || !fit_table( count, (separate_mode_t) i, output ) )
+        {
+            fit_samples( row1, row2, i, output );
+        }
+    }
 
     return min_na( min_na( output[ 1 ], output[ 3 ] ), min_na( output[ 5 ], output[ 7 ] ) );
 }
+
+double
+separate_method::run(const snp_row &row1, const snp_row &row2, float *output)
+{
+    /* All codings are derived from the same joint table. */
+    if( m_is_normal )
+    {
+        return compute( row1, row2, joint_count_cont( row1, row2, get_data( )->phenotype, m_weight ), output );
+    }
+    else
+    {
+        return compute( row1, row2, joint_count( row1, row2, get_data( )->phenotype, m_weight ), output );
+    }
+}
+
+void
+separate_method::run_batch(const std::vector<snp_row_pair> &pairs, float *output, size_t num_columns, double *statistics, size_t *ok_samples)
+{
+    std::vector<arma::mat> counts;
+    if( m_is_normal )
+    {
+        counts = joint_count_cont( pairs, get_data( )->phenotype, m_weight );
+    }
+    else
+    {
+        counts = joint_count( pairs, get_data( )->phenotype, m_weight );
+    }
+
+    for(size_t i = 0; i < pairs.size( ); i++)
+    {
+        statistics[ i ] = compute( *pairs[ i ].first, *pairs[ i ].second, counts[ i ], output + i * num_columns );
+        ok_samples[ i ] = num_ok_samples( *pairs[ i ].first, *pairs[ i ].second );
+    }
+}
@@ -40,17 +40,81 @@ public:
      */
     virtual double run(const snp_row &row1, const snp_row &row2, float *output);
 
+    /**
+     * Counts all pairs of the batch before the codings are fitted.
+     *
+     * @see method_type::run_batch.
+     */
+    virtual void run_batch(const std::vector<snp_row_pair> &pairs, float *output, size_t num_columns, double *statistics, size_t *ok_samples);
+
 private:
+    /**
+     * Fits all codings of a pair from its joint table, and falls back
+     * to the samples for codings that can not use the table.
+     *
+     * @param row1 The first snp.
+     * @param row2 The second snp.
+     * @param count The table from joint_count or joint_count_cont.
+     * @param output The results, see method_type::run.
+     *
+     * @return The smallest p-value.
+     */
+    double compute(const snp_row &row1, const snp_row &row2, const arma::mat &count, float *output);
+
+    /**
+     * Fits the models of a coding on the 2x2 table that is
+     * collapsed from the joint table of the pair.
+     *
+     * @param count The table from joint_count or joint_count_cont.
+     * @param mode The coding.
+     * @param output The results, see method_type::run.
+     *
+     * @return False if the table can not be used and the models
+     *         should be fitted on the samples, true otherwise.
+     */
+    bool fit_table(const arma::mat &count, separate_mode_t mode, float *output);
+
+    /**
+     * Fits the models of a coding on the samples.
+     *
+     * @param row1 The first snp.
+     * @param row2 The second snp.
+     * @param mode The coding.
+     * @param output The results, see method_type::run.
+     */
+    void fit_samples(const snp_row &row1, const snp_row &row2, int mode, float *output);
+
     /**
      * The included models.
      */
-    std::vector<model_matrix *> m_model_matrix;
+    std::vector<separate_matrix *> m_model_matrix;
 
     /**
      * The glm model.
      */
     glm_model *m_model;
 
+    /**
+     * True if the glm model is the normal model.
+     */
+    bool m_is_normal;
+
+    /**
+     * True if the models can be fitted on the joint table.
+     */
+    bool m_use_table;
+
+    /**
+     * Weight of each sample in the joint table, 0 for missing.
+     */
+    arma::vec m_weight;
+
+    /**
+     * Joint genotype of each sample in the current pair, empty
+     * until a coding is fitted on the samples.
+     */
+    std::vector<unsigned char> m_cells;
+
 };
 
 #endif /* End of __SEPARATE_METHOD_H__ */
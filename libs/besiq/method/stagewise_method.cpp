@@ -1,28 +1,12 @@
 #include <dcdflib/libdcdf.hpp>
 #include <besiq/method/stagewise_method.hpp>
 #include <besiq/stats/snp_count.hpp>
-#include <besiq/stats/binomial_models.hpp>
-#include <besiq/stats/normal_models.hpp>
 
 stagewise_method::stagewise_method(method_data_ptr data, const std::string &model)
 : method_type::method_type( data ),
-  m_model( model )
+  m_model( model ),
+  m_models( model == "normal", data->phenotype.n_elem )
 {
-    if( model == "normal" )
-    {
-        m_models.push_back( new normal_full( ) );
-        m_models.push_back( new normal_null( ) );
-        m_models.push_back( new normal_single( true ) );
-        m_models.push_back( new normal_single( false ) );
-    }
-    else if( model == "binomial" )
-    {
-        m_models.push_back( new binomial_full( ) );
-        m_models.push_back( new binomial_null( ) );
-        m_models.push_back( new binomial_single( true ) );
-        m_models.push_back( new binomial_single( false ) );
-    }
-
     m_weight = 1.0 - arma::conv_to<arma::vec>::from( data->missing );
 }
 
@@ -41,8 +25,6 @@ stagewise_method::init()
 double
 stagewise_method::run(const snp_row &row1, const snp_row &row2, float *output)
 {
-    std::vector<log_double> likelihood( m_models.size( ), 0.0 );
-
     arma::mat count;
     float min_samples = 0.0;
     unsigned int sample_threshold = METHOD_SMALLEST_CELL_SIZE_BINOMIAL;
@@ -65,18 +47,15 @@ stagewise_method::run(const snp_row &row1, const snp_row &row2, float *output)
         return -9;
     }
     
-    for(int i = 0; i < m_models.size( ); i++)
-    {
-        likelihood[ i ] = m_models[ i ]->prob( count );
-    }
+    double LR[ CLOSED_FORM_NUM_MODELS ];
+    m_models.likelihood_ratios( count, LR );
 
-    for(int i = 1; i < m_models.size( ); i++)
+    /* The p-values are written in the order null, snp1 and snp2. */
+    for(int i = 1; i < CLOSED_FORM_NUM_MODELS; i++)
     {
-        double LR = -2.0*(likelihood[ i ].log_value( ) - likelihood[ 0 ].log_value( ));
-
         try
         {
-            output[ i - 1 ] = 1.0 - chi_square_cdf( LR, m_models[ 0 ]->df( ) - m_models[ i ]->df( ) );
+            output[ i - 1 ] = 1.0 - chi_square_cdf( LR[ i ], closed_form_table::df( CLOSED_FORM_FULL ) - closed_form_table::df( i ) );
         }
         catch(bad_domain_value &e)
         {
@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include <dcdflib/libdcdf.hpp>
 #include <besiq/method/wald_lm_method.hpp>
 #include <besiq/stats/snp_count.hpp>
@@ -6,15 +8,46 @@ wald_lm_method::wald_lm_method(method_data_ptr data, bool unequal_var)
 : method_type::method_type( data ),
   m_unequal_var( unequal_var )
 {
-    m_weight = arma::ones<arma::vec>( data->phenotype.n_elem );
-    m_missing = get_data( )->missing;
+    m_weight = 1.0 - arma::conv_to<arma::vec>::from( data->missing );
     m_pheno = get_data()->phenotype;
+
+    if( data->phenotypes.n_cols > 0 )
+    {
+        m_phenotypes = arma::trans( data->phenotypes );
+        m_phenotype_weights = arma::zeros<arma::mat>( m_phenotypes.n_rows, m_phenotypes.n_cols );
+        for(size_t i = 0; i < m_phenotypes.n_cols; i++)
+        {
+            for(size_t p = 0; p < m_phenotypes.n_rows; p++)
+            {
+                if( arma::is_finite( m_phenotypes( p, i ) ) )
+                {
+                    m_phenotype_weights( p, i ) = m_weight[ i ];
+                }
+                else
+                {
+                    m_phenotypes( p, i ) = 0.0;
+                }
+            }
+        }
+    }
 }
 
 std::vector<std::string>
 wald_lm_method::init()
 {
     std::vector<std::string> header;
+    if( m_phenotypes.n_rows > 0 )
+    {
+        const std::vector<std::string> &names = get_data( )->phenotype_names;
+        for(size_t p = 0; p < m_phenotypes.n_rows; p++)
+        {
+            header.push_back( "LR_" + names[ p ] );
+            header.push_back( "P_" + names[ p ] );
+            header.push_back( "df_" + names[ p ] );
+        }
+
+        return header;
+    }
 
     header.push_back( "LR" );
     header.push_back( "P" );
@@ -39,24 +72,39 @@ wald_lm_method::get_last_beta()
 double
 wald_lm_method::run(const snp_row &row1, const snp_row &row2, float *output)
 {
-    arma::mat suf = arma::zeros<arma::mat>( 3, 3 );
-    arma::mat suf2 = arma::zeros<arma::mat>( 3, 3 );
-    arma::mat n = arma::zeros<arma::mat>( 3, 3 );
+    if( m_phenotypes.n_rows == 0 )
+    {
+        return compute( joint_count_cont( row1, row2, m_pheno, m_weight ), output );
+    }
+
+    /* Each phenotype has its own samples, report the largest number that was used. */
+    arma::mat counts = joint_count_phenotypes( row1, row2, m_phenotypes, m_phenotype_weights );
+    double min_p = -9;
+    size_t max_ok_samples = 0;
+    for(size_t p = 0; p < m_phenotypes.n_rows; p++)
+    {
+        min_p = min_na( min_p, compute( counts.cols( 3 * p, 3 * p + 2 ), output + 3 * p ) );
+        max_ok_samples = std::max( max_ok_samples, num_ok_samples( row1, row2 ) );
+    }
+    set_num_ok_samples( max_ok_samples );
 
-    for(int i = 0; i < row1.size( ); i++)
+    return min_p;
+}
+
+double
+wald_lm_method::compute(const arma::mat &count, float *output)
+{
+    arma::mat suf( 3, 3 );
+    arma::mat suf2( 3, 3 );
+    arma::mat n( 3, 3 );
+    for(int i = 0; i < 3; i++)
     {
-        unsigned char snp1 = row1[ i ];
-        unsigned char snp2 = row2[ i ];
-        
-        if( snp1 == 3 || snp2 == 3 || m_missing[ i ] == 1 )
+        for(int j = 0; j < 3; j++)
         {
-            continue;
+            suf( i, j ) = count( 3 * i + j, 0 );
+            n( i, j ) = count( 3 * i + j, 1 );
+            suf2( i, j ) = count( 3 * i + j, 2 );
         }
-
-        double pheno = m_pheno[ i ];
-        n( snp1, snp2 ) += 1;
-        suf( snp1, snp2 ) += pheno;
-        suf2( snp1, snp2 ) += pheno * pheno;
     }
 
     /* Calculate residual and estimate sigma^2 */
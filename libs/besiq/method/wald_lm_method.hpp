@@ -21,7 +21,8 @@ public:
      * Constructor.
      *
      * @param data Additional data required by all methods, such as
-     *             covariates.
+     *             covariates. If data->phenotypes is set, all of its
+     *             phenotypes are tested instead of data->phenotype.
      * @param unequal_var If true, estimates a separate variance for each cell.
      */
     wald_lm_method(method_data_ptr data, bool unequal_var = false);
@@ -46,12 +47,27 @@ public:
     arma::vec get_last_beta();
     
     /**
+     * Runs the test for each phenotype when several are tested, the
+     * pair is then only decoded once.
+     *
      * @see method_type::run.
+     *
+     * @return The smallest p-value of all phenotypes.
      */
     virtual double run(const snp_row &row1, const snp_row &row2, float *output);
+
+    /**
+     * Computes the test from the sufficient statistics of a pair.
+     *
+     * @param count The 9x3 matrix from joint_count_cont.
+     * @param output The results, see method_type::run.
+     *
+     * @return The p-value, or -9 if it could not be computed.
+     */
+    double compute(const arma::mat &count, float *output);
 private:
     /**
-     * Weight for each sample.
+     * Weight for each sample, 0 for missing samples.
      */
     arma::vec m_weight;
     
@@ -61,9 +77,16 @@ private:
     arma::vec m_pheno;
 
     /**
-     * Missing samples.
+     * All tested phenotypes as a P x N matrix with missing values set
+     * to 0, or empty if only m_pheno is tested.
+     */
+    arma::mat m_phenotypes;
+
+    /**
+     * Weight of each phenotype and sample as a P x N matrix, 0 when
+     * the sample or its value of the phenotype is missing.
      */
-    arma::uvec m_missing;
+    arma::mat m_phenotype_weights;
     
     /**
      * Determines whether variances should be estimated separately.
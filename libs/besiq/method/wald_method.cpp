@@ -5,9 +5,9 @@
 wald_method::wald_method(method_data_ptr data)
 : method_type::method_type( data )
 {
-    m_weight = arma::ones<arma::vec>( data->phenotype.n_elem );
+    m_weight = 1.0 - arma::conv_to<arma::vec>::from( data->missing );
     m_pheno = get_data( )->phenotype;
-    m_missing = get_data( )->missing;
+    m_mask = make_phenotype_mask( data->phenotype, data->missing );
 }
 
 std::vector<std::string>
@@ -37,25 +37,47 @@ wald_method::get_last_beta()
 double
 wald_method::run(const snp_row &row1, const snp_row &row2, float *output)
 {
-    arma::mat n0 = arma::zeros<arma::mat>( 3, 3 );
-    arma::mat n1 = arma::zeros<arma::mat>( 3, 3 );
-    for(int i = 0; i < row1.size( ); i++)
+    return compute( joint_count( row1, row2, m_pheno, m_weight ), output );
+}
+
+double
+wald_method::run_sparse(const std::pair<std::string, std::string> &pair, const snp_row &row1, const snp_row &row2, const sparse_row *sparse1, const sparse_row *sparse2, float *output)
+{
+    if( sparse1 != NULL && sparse2 != NULL )
     {
-        unsigned char snp1 = row1[ i ];
-        unsigned char snp2 = row2[ i ];
-        if( snp1 == 3 || snp2 == 3 || m_missing[ i ] == 1 )
-        {
-            continue;
-        }
+        return compute( joint_count( *sparse1, *sparse2, m_mask ), output );
+    }
+    else if( sparse1 != NULL )
+    {
+        return compute( joint_count( *sparse1, row2, m_mask ), output );
+    }
+    else if( sparse2 != NULL )
+    {
+        return compute( joint_count( row1, *sparse2, m_mask ), output );
+    }
+    else
+    {
+        return run( row1, row2, output );
+    }
+}
 
-        unsigned int pheno = m_pheno[ i ];
-        if( pheno == 0 )
-        {
-            n0( snp1, snp2 ) += 1;
-        }
-        else if( pheno == 1 )
+bool
+wald_method::uses_sparse_rows() const
+{
+    return true;
+}
+
+double
+wald_method::compute(const arma::mat &count, float *output)
+{
+    arma::mat n0( 3, 3 );
+    arma::mat n1( 3, 3 );
+    for(int i = 0; i < 3; i++)
+    {
+        for(int j = 0; j < 3; j++)
         {
-            n1( snp1, snp2 ) += 1;
+            n0( i, j ) = count( 3 * i + j, 0 );
+            n1( i, j ) = count( 3 * i + j, 1 );
         }
     }
 
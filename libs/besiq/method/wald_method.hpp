@@ -7,6 +7,7 @@
 #include <armadillo>
 
 #include <besiq/method/method.hpp>
+#include <besiq/stats/snp_count.hpp>
 #include <besiq/stats/log_scale.hpp>
 
 /**
@@ -48,9 +49,33 @@ public:
      * @see method_type::run.
      */
     virtual double run(const snp_row &row1, const snp_row &row2, float *output);
+
+    /**
+     * Counts the pair from the sparse rows when available.
+     *
+     * @see method_type::run_sparse.
+     */
+    virtual double run_sparse(const std::pair<std::string, std::string> &pair, const snp_row &row1, const snp_row &row2, const sparse_row *sparse1, const sparse_row *sparse2, float *output);
+
+    /**
+     * @see method_type::uses_sparse_rows.
+     */
+    virtual bool uses_sparse_rows() const;
+
+    /**
+     * Computes the test from the number of controls and cases with
+     * each genotype, so that methods that have already counted the
+     * pair do not need to count it again.
+     *
+     * @param count The counts as a 9x2 matrix, see joint_count.
+     * @param output The results, see method_type::run.
+     *
+     * @return The p-value, or -9 if it could not be computed.
+     */
+    double compute(const arma::mat &count, float *output);
 private:
     /**
-     * Weight for each sample.
+     * Weight for each sample, 0 for missing samples.
      */
     arma::vec m_weight;
     
@@ -58,11 +83,11 @@ private:
      * Phenotypes.
      */
     arma::vec m_pheno;
-    
+
     /**
-     * Missing.
+     * The controls and cases that are counted for rare snps.
      */
-    arma::uvec m_missing;
+    phenotype_mask m_mask;
 
     /**
      * Current covariance matrix for the betas.
@@ -26,17 +26,26 @@ wald_separate_method::init()
     return header;
 }
 
+/**
+ * Cells of the joint table that are contrasted by each of the four
+ * codings, in the order dd, rd, dr and rr. The dominant and recessive
+ * codings only differ in which of the non-zero genotypes is used.
+ */
+static const int SEPARATE_CELLS[ 4 ][ 4 ] = {
+    { 0, 1, 3, 4 },
+    { 0, 2, 3, 5 },
+    { 0, 1, 6, 7 },
+    { 0, 2, 6, 8 }
+};
+
 void
-wald_separate_method::compute_lm(const snp_row &row1, const snp_row &row2, float *output)
+wald_separate_method::compute_lm(const arma::mat &n, float *output)
 {
-    arma::mat n = joint_count_cont( row1, row2, get_data( )->phenotype, m_weight );
-
     size_t num_samples = arma::accu( n.col( 1 ) );
     set_num_ok_samples( num_samples );
     
     /* Calculate residual and estimate sigma^2 */
     double residual_sum = 0.0;
-    arma::mat mu = arma::zeros<arma::mat>( 3, 3 );
     for(int i = 0; i < 9; i++)
     {
         double deviance = ( n( i, 2 ) - n( i, 0 ) * n( i, 0 ) / n( i, 1 ) );
@@ -44,132 +53,110 @@ wald_separate_method::compute_lm(const snp_row &row1, const snp_row &row2, float
     }
     double sigma2 = residual_sum / ( num_samples - 9 );
 
-    if( n( 0, 1 ) > METHOD_SMALLEST_CELL_SIZE_NORMAL &&
-        n( 1, 1 ) > METHOD_SMALLEST_CELL_SIZE_NORMAL &&
-        n( 3, 1 ) > METHOD_SMALLEST_CELL_SIZE_NORMAL &&
-        n( 4, 1 ) > METHOD_SMALLEST_CELL_SIZE_NORMAL )
+    for(int i = 0; i < 4; i++)
     {
-        double b_dd = n( 0, 0 ) / n( 0, 1 ) - n( 1, 0 ) / n( 1, 1 ) - n( 3, 0 ) / n( 3, 1 ) + n( 4, 0 ) / n( 4, 1 );
-        double var_dd = sigma2 * ( 1.0 / n( 0, 1 ) + 1.0 / n( 1, 1 ) + 1.0 / n( 3, 1 ) + 1.0 / n( 4, 1 ) );
-        double w_dd = b_dd * b_dd / var_dd;
-        output[ 0 ] = b_dd;
-        output[ 1 ] = 1.0 - chi_square_cdf( w_dd, 1 );
-    }
-    if( n( 0, 1 ) > METHOD_SMALLEST_CELL_SIZE_NORMAL &&
-        n( 2, 1 ) > METHOD_SMALLEST_CELL_SIZE_NORMAL &&
-        n( 3, 1 ) > METHOD_SMALLEST_CELL_SIZE_NORMAL &&
-        n( 5, 1 ) > METHOD_SMALLEST_CELL_SIZE_NORMAL )
-    {
-        double b_rd = n( 0, 0 ) / n( 0, 1 ) - n( 2, 0 ) / n( 2, 1 ) - n( 3, 0 ) / n( 3, 1 ) + n( 5, 0 ) / n( 5, 1 );
-        double var_rd = sigma2 * ( 1.0 / n( 0, 1 ) + 1.0 / n( 2, 1 ) + 1.0 / n( 3, 1 ) + 1.0 / n( 5, 1 ) );
-        double w_rd = b_rd * b_rd / var_rd;
-        output[ 2 ] = b_rd;
-        output[ 3 ] = 1.0 - chi_square_cdf( w_rd, 1 );
-    }
-    if( n( 0, 1 ) > METHOD_SMALLEST_CELL_SIZE_NORMAL &&
-        n( 1, 1 ) > METHOD_SMALLEST_CELL_SIZE_NORMAL &&
-        n( 6, 1 ) > METHOD_SMALLEST_CELL_SIZE_NORMAL &&
-        n( 7, 1 ) > METHOD_SMALLEST_CELL_SIZE_NORMAL )
-    {
-        double b_dr = n( 0, 0 ) / n( 0, 1 ) - n( 1, 0 ) / n( 1, 1 ) - n( 6, 0 ) / n( 6, 1 ) + n( 7, 0 ) / n( 7, 1 );
-        double var_dr = sigma2 * ( 1.0 / n( 0, 1 ) + 1.0 / n( 1, 1 ) + 1.0 / n( 6, 1 ) + 1.0 / n( 7, 1 ) );
-        double w_dr = b_dr * b_dr / var_dr;
-        output[ 4 ] = b_dr;
-        output[ 5 ] = 1.0 - chi_square_cdf( w_dr, 1 );
-    }
-    if( n( 0, 1 ) > METHOD_SMALLEST_CELL_SIZE_NORMAL &&
-        n( 2, 1 ) > METHOD_SMALLEST_CELL_SIZE_NORMAL &&
-        n( 6, 1 ) > METHOD_SMALLEST_CELL_SIZE_NORMAL &&
-        n( 8, 1 ) > METHOD_SMALLEST_CELL_SIZE_NORMAL )
-    {
-        double b_rr = n( 0, 0 ) / n( 0, 1 ) - n( 2, 0 ) / n( 2, 1 ) - n( 6, 0 ) / n( 6, 1 ) + n( 8, 0 ) / n( 8, 1 );
-        double var_rr = sigma2 * ( 1.0 / n( 0, 1 ) + 1.0 / n( 2, 1 ) + 1.0 / n( 6, 1 ) + 1.0 / n( 8, 1 ) );
-        double w_rr = b_rr * b_rr / var_rr;
-        output[ 6 ] = b_rr;
-        output[ 7 ] = 1.0 - chi_square_cdf( w_rr, 1 );
+        const int *c = SEPARATE_CELLS[ i ];
+        if( n( c[ 0 ], 1 ) > METHOD_SMALLEST_CELL_SIZE_NORMAL &&
+            n( c[ 1 ], 1 ) > METHOD_SMALLEST_CELL_SIZE_NORMAL &&
+            n( c[ 2 ], 1 ) > METHOD_SMALLEST_CELL_SIZE_NORMAL &&
+            n( c[ 3 ], 1 ) > METHOD_SMALLEST_CELL_SIZE_NORMAL )
+        {
+            double b = n( c[ 0 ], 0 ) / n( c[ 0 ], 1 ) - n( c[ 1 ], 0 ) / n( c[ 1 ], 1 ) - n( c[ 2 ], 0 ) / n( c[ 2 ], 1 ) + n( c[ 3 ], 0 ) / n( c[ 3 ], 1 );
+            double var = sigma2 * ( 1.0 / n( c[ 0 ], 1 ) + 1.0 / n( c[ 1 ], 1 ) + 1.0 / n( c[ 2 ], 1 ) + 1.0 / n( c[ 3 ], 1 ) );
+            double w = b * b / var;
+            output[ 2*i ] = b;
+            output[ 2*i + 1 ] = 1.0 - chi_square_cdf( w, 1 );
+        }
     }
 }
 
 void
-wald_separate_method::compute_binomial(const snp_row &row1, const snp_row &row2, float *output)
+wald_separate_method::compute_binomial(const arma::mat &n, float *output)
 {
-    arma::mat n = joint_count( row1, row2, get_data( )->phenotype, m_weight );
     set_num_ok_samples( (size_t) arma::accu( n ) );
 
-    if( n( 0, 1 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
-        n( 1, 1 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
-        n( 3, 1 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
-        n( 4, 1 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
-        n( 0, 0 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
-        n( 1, 0 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
-        n( 3, 0 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
-        n( 4, 0 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL )
-    {
-        double b_dd = log( n( 0, 1 ) / n( 0, 0 ) ) - log( n( 1, 1 ) / n( 1, 0 ) ) - log( n( 3, 1 ) / n( 3, 0 ) ) + log( n( 4, 1 ) / n( 4, 0 ) );
-        double var_dd = 1.0 / n( 0, 0 ) + 1.0 / n( 0, 1 ) + 1.0 / n( 1, 0 ) + 1.0 / n( 1, 1 ) + 1.0 / n( 3, 0 ) + 1.0 / n( 3, 1 ) + 1.0 / n( 4, 0 ) + 1.0 / n( 4, 1 );
-        double w_dd = b_dd * b_dd / var_dd;
-        output[ 0 ] = b_dd;
-        output[ 1 ] = 1.0 - chi_square_cdf( w_dd, 1 );
-    }
-    if( n( 0, 1 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
-        n( 2, 1 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
-        n( 3, 1 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
-        n( 5, 1 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
-        n( 0, 0 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
-        n( 2, 0 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
-        n( 3, 0 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
-        n( 5, 0 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL )
+    for(int i = 0; i < 4; i++)
     {
-        double b_rd = log( n( 0, 1 ) / n( 0, 0 ) ) - log( n( 2, 1 ) / n( 2, 0 ) ) - log( n( 3, 1 ) / n( 3, 0 ) ) + log( n( 5, 1 ) / n( 5, 0 ) );
-        double var_rd = 1.0 / n( 0, 0 ) + 1.0 / n( 0, 1 ) + 1.0 / n( 2, 0 ) + 1.0 / n( 2, 1 ) + 1.0 / n( 3, 0 ) + 1.0 / n( 3, 1 ) + 1.0 / n( 5, 0 ) + 1.0 / n( 5, 1 );
-        double w_rd = b_rd * b_rd / var_rd;
-        output[ 2 ] = b_rd;
-        output[ 3 ] = 1.0 - chi_square_cdf( w_rd, 1 );
+        const int *c = SEPARATE_CELLS[ i ];
+        if( n( c[ 0 ], 1 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
+            n( c[ 1 ], 1 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
+            n( c[ 2 ], 1 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
+            n( c[ 3 ], 1 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
+            n( c[ 0 ], 0 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
+            n( c[ 1 ], 0 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
+            n( c[ 2 ], 0 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
+            n( c[ 3 ], 0 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL )
+        {
+            double b = log( n( c[ 0 ], 1 ) / n( c[ 0 ], 0 ) ) - log( n( c[ 1 ], 1 ) / n( c[ 1 ], 0 ) ) - log( n( c[ 2 ], 1 ) / n( c[ 2 ], 0 ) ) + log( n( c[ 3 ], 1 ) / n( c[ 3 ], 0 ) );
+            double var = 0.0;
+            for(int j = 0; j < 4; j++)
+            {
+                var += 1.0 / n( c[ j ], 0 ) + 1.0 / n( c[ j ], 1 );
+            }
+            double w = b * b / var;
+            output[ 2*i ] = b;
+            output[ 2*i + 1 ] = 1.0 - chi_square_cdf( w, 1 );
+        }
     }
-    if( n( 0, 1 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
-        n( 1, 1 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
-        n( 6, 1 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
-        n( 7, 1 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
-        n( 0, 0 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
-        n( 1, 0 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
-        n( 6, 0 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
-        n( 7, 0 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL )
+}
+
+double
+wald_separate_method::compute(const arma::mat &count, float *output)
+{
+    if( m_is_lm )
     {
-        double b_dr = log( n( 0, 1 ) / n( 0, 0 ) ) - log( n( 1, 1 ) / n( 1, 0 ) ) - log( n( 6, 1 ) / n( 6, 0 ) ) + log( n( 7, 1 ) / n( 7, 0 ) );
-        double var_dr = 1.0 / n( 0, 0 ) + 1.0 / n( 0, 1 ) + 1.0 / n( 1, 0 ) + 1.0 / n( 1, 1 ) + 1.0 / n( 6, 0 ) + 1.0 / n( 6, 1 ) + 1.0 / n( 7, 0 ) + 1.0 / n( 7, 1 );
-        double w_dr = b_dr * b_dr / var_dr;
-        output[ 4 ] = b_dr;
-        output[ 5 ] = 1.0 - chi_square_cdf( w_dr, 1 );
+        compute_lm( count, output );
     }
-    if( n( 0, 1 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
-        n( 2, 1 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
-        n( 6, 1 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
-        n( 8, 1 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
-        n( 0, 0 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
-        n( 2, 0 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
-        n( 6, 0 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL &&
-        n( 8, 0 ) > METHOD_SMALLEST_CELL_SIZE_BINOMIAL )
+    else
     {
-        double b_rr = log( n( 0, 1 ) / n( 0, 0 ) ) - log( n( 2, 1 ) / n( 2, 0 ) ) - log( n( 6, 1 ) / n( 6, 0 ) ) + log( n( 8, 1 ) / n( 8, 0 ) );
-        double var_rr = 1.0 / n( 0, 0 ) + 1.0 / n( 0, 1 ) + 1.0 / n( 2, 0 ) + 1.0 / n( 2, 1 ) + 1.0 / n( 6, 0 ) + 1.0 / n( 6, 1 ) + 1.0 / n( 8, 0 ) + 1.0 / n( 8, 1 );
-        double w_rr = b_rr * b_rr / var_rr;
-        output[ 6 ] = b_rr;
-        output[ 7 ] = 1.0 - chi_square_cdf( w_rr, 1 );
+        compute_binomial( count, output );
     }
+
+    return min_na( min_na( output[ 1 ], output[ 3 ] ),
+                   min_na( output[ 5 ], output[ 7 ] ) );
+}
+
+bool
+wald_separate_method::is_testable(const snp_summary &snp1, const snp_summary &snp2)
+{
+    /* A cell of the joint table can not be larger than the genotype counts of either snp,
+     * and every test needs cell (0,0) and a cell where both snps are non-zero. */
+    unsigned int min_size = m_is_lm ? METHOD_SMALLEST_CELL_SIZE_NORMAL : METHOD_SMALLEST_CELL_SIZE_BINOMIAL;
+    return snp1.counts[ 0 ] > min_size && snp2.counts[ 0 ] > min_size &&
+           ( snp1.counts[ 1 ] > min_size || snp1.counts[ 2 ] > min_size ) &&
+           ( snp2.counts[ 1 ] > min_size || snp2.counts[ 2 ] > min_size );
 }
 
 double
 wald_separate_method::run(const snp_row &row1, const snp_row &row2, float *output)
 {
+    /* All four codings are contrasts of the same joint table. */
     if( m_is_lm )
     {
-        compute_lm( row1, row2, output );
+        return compute( joint_count_cont( row1, row2, get_data( )->phenotype, m_weight ), output );
     }
     else
     {
-        compute_binomial( row1, row2, output );
+        return compute( joint_count( row1, row2, get_data( )->phenotype, m_weight ), output );
     }
+}
 
-    return min_na( min_na( output[ 1 ], output[ 3 ] ),
-                   min_na( output[ 5 ], output[ 7 ] ) );
+void
+wald_separate_method::run_batch(const std::vector<snp_row_pair> &pairs, float *output, size_t num_columns, double *statistics, size_t *ok_samples)
+{
+    std::vector<arma::mat> counts;
+    if( m_is_lm )
+    {
+        counts = joint_count_cont( pairs, get_data( )->phenotype, m_weight );
+    }
+    else
+    {
+        counts = joint_count( pairs, get_data( )->phenotype, m_weight );
+    }
+
+    for(size_t i = 0; i < pairs.size( ); i++)
+    {
+        statistics[ i ] = compute( counts[ i ], output + i * num_columns );
+        ok_samples[ i ] = num_ok_samples( *pairs[ i ].first, *pairs[ i ].second );
+    }
 }
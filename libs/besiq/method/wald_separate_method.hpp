@@ -34,9 +34,33 @@ public:
      * @see method_type::run.
      */
     virtual double run(const snp_row &row1, const snp_row &row2, float *output);
+
+    /**
+     * Counts all pairs of the batch before the codings are tested.
+     *
+     * @see method_type::run_batch.
+     */
+    virtual void run_batch(const std::vector<snp_row_pair> &pairs, float *output, size_t num_columns, double *statistics, size_t *ok_samples);
+
+    /**
+     * @see method_type::is_testable.
+     */
+    virtual bool is_testable(const snp_summary &snp1, const snp_summary &snp2);
+
 private:
-    void compute_lm(const snp_row &row1, const snp_row &row2, float *output);
-    void compute_binomial(const snp_row &row1, const snp_row &row2, float *output);
+    /**
+     * Computes the dd, rd, dr and rr tests from the joint table of a pair.
+     *
+     * @param count The table from joint_count or joint_count_cont.
+     * @param output The results, see method_type::run.
+     *
+     * @return The smallest p-value.
+     */
+    double compute(const arma::mat &count, float *output);
+
+    void compute_lm(const arma::mat &n, float *output);
+    void compute_binomial(const arma::mat &n, float *output);
+
     /**
      * Weight for each sample.
      */
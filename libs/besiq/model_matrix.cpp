@@ -250,35 +250,37 @@ noia_matrix::update_matrix(const snp_row &row1, const snp_row &row2, arma::uvec
 separate_matrix::separate_matrix(const arma::mat &cov, size_t n, separate_mode_t mode)
     : general_matrix( cov, n, 3, 4 )
 {
-    if( mode == DOM_DOM )
-    {
-        m_snp1_threshold = m_snp2_threshold = 1;
-    }
-    else if( mode == REC_DOM )
-    {
-        m_snp1_threshold = 2;
-        m_snp2_threshold = 1;
-    }
-    else if( mode == DOM_REC )
-    {
-        m_snp1_threshold = 1;
-        m_snp2_threshold = 2;
-    }
-    else if( mode == REC_REC )
-    {
-        m_snp1_threshold = m_snp2_threshold = 2;
-    }
+    separate_thresholds( mode, &m_snp1_threshold, &m_snp2_threshold );
 }
 
 void
 separate_matrix::update_matrix(const snp_row &row1, const snp_row &row2, arma::uvec &missing)
 {
+    std::vector<unsigned char> cells( row1.size( ) );
     for(int i = 0; i < row1.size( ); i++)
     {
-        if( row1[ i ] != 3 && row2[ i ] != 3 && missing[ i ] == 0 )
+        if( row1[ i ] != 3 && row2[ i ] != 3 )
+        {
+            cells[ i ] = 3 * row1[ i ] + row2[ i ];
+        }
+        else
         {
-            double snp1 = ( row1[ i ] >= m_snp1_threshold ) ? 1.0 : 0.0;
-            double snp2 = ( row2[ i ] >= m_snp2_threshold ) ? 1.0 : 0.0;
+            cells[ i ] = SEPARATE_MISSING_CELL;
+        }
+    }
+
+    update_matrix( cells, missing );
+}
+
+void
+separate_matrix::update_matrix(const std::vector<unsigned char> &cells, arma::uvec &missing)
+{
+    for(int i = 0; i < cells.size( ); i++)
+    {
+        if( cells[ i ] != SEPARATE_MISSING_CELL && missing[ i ] == 0 )
+        {
+            double snp1 = ( cells[ i ] / 3 >= m_snp1_threshold ) ? 1.0 : 0.0;
+            double snp2 = ( cells[ i ] % 3 >= m_snp2_threshold ) ? 1.0 : 0.0;
 
             m_alt( i, 0 ) = snp1;
             m_alt( i, 1 ) = snp2;
@@ -300,6 +302,13 @@ separate_matrix::update_matrix(const snp_row &row1, const snp_row &row2, arma::u
     }
 }
 
+void
+separate_thresholds(separate_mode_t mode, int *snp1_threshold, int *snp2_threshold)
+{
+    *snp1_threshold = ( mode == REC_DOM || mode == REC_REC ) ? 2 : 1;
+    *snp2_threshold = ( mode == DOM_REC || mode == REC_REC ) ? 2 : 1;
+}
+
 model_matrix *
 make_model_matrix(const std::string &type, const arma::mat &cov, size_t n)
 {
@@ -1,6 +1,8 @@
 #ifndef __MODEL_MATRIX_H__
 #define __MODEL_MATRIX_H__
 
+#include <vector>
+
 #include <armadillo>
 
 #include <plink/snp_row.hpp>
@@ -79,11 +81,36 @@ typedef enum
     REC_REC = 3
 } separate_mode_t;
 
+/**
+ * Returns the smallest genotype that is coded as 1 for each snp.
+ *
+ * @param mode The coding.
+ * @param snp1_threshold The threshold of the first snp will be stored here.
+ * @param snp2_threshold The threshold of the second snp will be stored here.
+ */
+void separate_thresholds(separate_mode_t mode, int *snp1_threshold, int *snp2_threshold);
+
+/**
+ * Joint genotype of each sample as 3 * snp1 + snp2, or
+ * SEPARATE_MISSING_CELL if either genotype is missing.
+ */
+const unsigned char SEPARATE_MISSING_CELL = 9;
+
 class separate_matrix : public general_matrix
 {
 public:
     separate_matrix(const arma::mat &cov, size_t n, separate_mode_t mode);
     void update_matrix(const snp_row &row1, const snp_row &row2, arma::uvec &missing);
+
+    /**
+     * Updates the model matrix from the joint genotype of each
+     * sample, so that a pair only needs to be decoded once for
+     * all codings.
+     *
+     * @param cells The joint genotype of each sample.
+     * @param missing Samples with a missing cell are marked by 1.
+     */
+    void update_matrix(const std::vector<unsigned char> &cells, arma::uvec &missing);
 private:
     int m_snp1_threshold;
     int m_snp2_threshold;
@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+#include <besiq/pair_summary.hpp>
+
+pair_summary::pair_summary(size_t num_top, bool hist)
+    : m_num_top( num_top ),
+      m_statistic_name( "P" ),
+      m_higher_is_better( false ),
+      m_use_hist( hist ),
+      m_hist( PAIR_SUMMARY_HIST_BINS, 0 )
+{
+}
+
+void
+pair_summary::set_statistic(const std::string &name, bool higher_is_better)
+{
+    m_statistic_name = name;
+    m_higher_is_better = higher_is_better;
+}
+
+bool
+pair_summary::is_pvalue() const
+{
+    return !m_higher_is_better;
+}
+
+bool
+pair_summary::has_grid() const
+{
+    return m_grid;
+}
+
+void
+pair_summary::enable_grid(const std::vector<pio_locus_t> &loci, const std::string &path)
+{
+    m_loci = loci;
+    m_grid_path = path;
+    m_grid = shared_ptr<logp_grid>( new logp_grid( loci ) );
+}
+
+void
+pair_summary::add_top(const std::pair<std::string, std::string> &pair, float p)
+{
+    if( !std::isfinite( p ) )
+    {
+        return;
+    }
+
+    float key = m_higher_is_better ? -p : p;
+    if( m_num_top > 0 && ( m_heap.size( ) < m_num_top || key < m_heap.front( ).key ) )
+    {
+        top_pair res;
+        res.variant_pair = pair;
+        res.value = p;
+        res.key = key;
+        m_heap.push_back( res );
+        std::push_heap( m_heap.begin( ), m_heap.end( ) );
+        if( m_heap.size( ) > m_num_top )
+        {
+            std::pop_heap( m_heap.begin( ), m_heap.end( ) );
+            m_heap.pop_back( );
+        }
+    }
+}
+
+void
+pair_summary::add(const std::pair<std::string, std::string> &pair, float p)
+{
+    if( !std::isfinite( p ) )
+    {
+        return;
+    }
+
+    add_top( pair, p );
+
+    if( m_use_hist )
+    {
+        double position = p * PAIR_SUMMARY_HIST_BINS;
+        if( !m_higher_is_better )
+        {
+            position = ( p > 0.0f ) ? -std::log10( p ) : PAIR_SUMMARY_HIST_BINS;
+        }
+        size_t bin = (size_t) std::max( 0.0, std::min( position, PAIR_SUMMARY_HIST_BINS - 1.0 ) );
+        m_hist[ bin ]++;
+    }
+
+    if( m_grid )
+    {
+        m_grid->add_pvalue( pair.first, pair.second, p );
+    }
+}
+
+void
+pair_summary::merge(const pair_summary &other)
+{
+    for(size_t i = 0; i < other.m_heap.size( ); i++)
+    {
+        add_top( other.m_heap[ i ].variant_pair, other.m_heap[ i ].value );
+    }
+
+    for(size_t i = 0; i < m_hist.size( ); i++)
+    {
+        m_hist[ i ] += other.m_hist[ i ];
+    }
+
+    if( m_grid && other.m_grid )
+    {
+        m_grid->merge( *other.m_grid );
+    }
+}
+
+pair_summary *
+pair_summary::create_empty() const
+{
+    pair_summary *summary = new pair_summary( m_num_top, m_use_hist );
+    summary->set_statistic( m_statistic_name, m_higher_is_better );
+    if( m_grid )
+    {
+        summary->enable_grid( m_loci, m_grid_path );
+    }
+
+    return summary;
+}
+
+void
+pair_summary::write(std::ostream &output)
+{
+    if( m_num_top > 0 )
+    {
+        std::vector<top_pair> sorted( m_heap );
+        std::sort_heap( sorted.begin( ), sorted.end( ) );
+
+        output << "snp1 snp2\t" << m_statistic_name << "\n";
+        for(size_t i = 0; i < sorted.size( ); i++)
+        {
+            output << sorted[ i ].variant_pair.first << " " << sorted[ i ].variant_pair.second;
+            output << "\t" << sorted[ i ].value << "\n";
+        }
+    }
+
+    if( m_use_hist && m_higher_is_better )
+    {
+        output << m_statistic_name << "_start\t" << m_statistic_name << "_end\tcount\n";
+        for(size_t i = 0; i < m_hist.size( ); i++)
+        {
+            output << ( (double) i ) / PAIR_SUMMARY_HIST_BINS << "\t" << ( i + 1.0 ) / PAIR_SUMMARY_HIST_BINS;
+            output << "\t" << m_hist[ i ] << "\n";
+        }
+    }
+    else if( m_use_hist )
+    {
+        output << "mlog10p_start\tmlog10p_end\tcount\n";
+        for(size_t i = 0; i < m_hist.size( ); i++)
+        {
+            output << i << "\t";
+            if( i + 1 < m_hist.size( ) )
+            {
+                output << i + 1;
+            }
+            else
+            {
+                output << "Inf";
+            }
+            output << "\t" << m_hist[ i ] << "\n";
+        }
+    }
+
+    if( m_grid )
+    {
+        std::ofstream grid_file( m_grid_path.c_str( ) );
+        m_grid->write_grid( grid_file );
+    }
+}
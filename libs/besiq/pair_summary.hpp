@@ -0,0 +1,179 @@
+#ifndef __PAIR_SUMMARY_H__
+#define __PAIR_SUMMARY_H__
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <besiq/logp_grid.hpp>
+#include <shared_ptr/shared_ptr.hpp>
+
+/**
+ * Number of bins in the histogram. For p-values each bin covers one
+ * unit of -log10(p) and the last bin is open ended, for statistics
+ * where higher is better, such as posteriors, the bins split [0, 1]
+ * evenly.
+ */
+#define PAIR_SUMMARY_HIST_BINS 20
+
+/**
+ * A pair and its statistic.
+ */
+struct top_pair
+{
+    std::pair<std::string, std::string> variant_pair;
+    float value;
+
+    /**
+     * The value negated if higher is better, so that the
+     * best pairs have the smallest key.
+     */
+    float key;
+
+    bool operator<(const top_pair &other) const
+    {
+        return key < other.key;
+    }
+};
+
+/**
+ * Summarizes the p-values of an analysis while it runs, so that the
+ * full result file does not have to be written. It keeps the K best
+ * pairs in a bounded heap, a histogram of p-values and optionally a
+ * logp_grid. Summaries that are filled independently, for example one
+ * for each thread, can be combined with merge.
+ */
+class pair_summary
+{
+public:
+    /**
+     * Constructor.
+     *
+     * @param num_top Number of pairs with the smallest p-values to keep, 0 to disable.
+     * @param hist If true a histogram of the p-values is kept.
+     */
+    pair_summary(size_t num_top, bool hist);
+
+    /**
+     * Sets the statistic that is summarized, by default p-values
+     * where lower is better. Must be called before any pairs are added.
+     *
+     * @param name Name of the statistic in the output, e.g. "P".
+     * @param higher_is_better True if larger values are stronger
+     *                         evidence, e.g. for posteriors.
+     */
+    void set_statistic(const std::string &name, bool higher_is_better);
+
+    /**
+     * Returns true if the statistic is a p-value, i.e. lower is better.
+     *
+     * @return True if the statistic is a p-value.
+     */
+    bool is_pvalue() const;
+
+    /**
+     * Returns true if a grid is kept, the grid can only
+     * summarize p-values.
+     *
+     * @return True if enable_grid has been called.
+     */
+    bool has_grid() const;
+
+    /**
+     * Also summarize the p-values in a grid.
+     *
+     * @param loci The loci of the genotype file.
+     * @param path The grid will be written to this file.
+     */
+    void enable_grid(const std::vector<pio_locus_t> &loci, const std::string &path);
+
+    /**
+     * Adds the statistic of a pair, statistics that are not finite
+     * are ignored.
+     *
+     * @param pair The variant pair.
+     * @param p The statistic, see set_statistic.
+     */
+    void add(const std::pair<std::string, std::string> &pair, float p);
+
+    /**
+     * Adds the contents of another summary, that has been created
+     * with the same settings, to this one.
+     *
+     * @param other The other summary.
+     */
+    void merge(const pair_summary &other);
+
+    /**
+     * Returns a new empty summary with the same settings, intended
+     * for use in a separate thread.
+     *
+     * @return A new empty summary.
+     */
+    pair_summary *create_empty() const;
+
+    /**
+     * Writes the top pairs and the histogram to the given stream,
+     * and the grid to its file.
+     *
+     * @param output The stream to write to.
+     */
+    void write(std::ostream &output);
+
+private:
+    /**
+     * Adds a pair to the heap of top pairs if it is among the best,
+     * statistics that are not finite are ignored.
+     *
+     * @param pair The variant pair.
+     * @param p The statistic.
+     */
+    void add_top(const std::pair<std::string, std::string> &pair, float p);
+
+    /**
+     * Number of pairs to keep.
+     */
+    size_t m_num_top;
+
+    /**
+     * Name of the statistic.
+     */
+    std::string m_statistic_name;
+
+    /**
+     * True if larger values of the statistic are better.
+     */
+    bool m_higher_is_better;
+
+    /**
+     * The kept pairs as a max-heap on the key, i.e. the worst kept pair first.
+     */
+    std::vector<top_pair> m_heap;
+
+    /**
+     * True if a histogram should be kept.
+     */
+    bool m_use_hist;
+
+    /**
+     * Number of pairs in each bin.
+     */
+    std::vector<uint64_t> m_hist;
+
+    /**
+     * The grid, or a null pointer.
+     */
+    shared_ptr<logp_grid> m_grid;
+
+    /**
+     * Loci used to create the grid.
+     */
+    std::vector<pio_locus_t> m_loci;
+
+    /**
+     * Path to the grid output file.
+     */
+    std::string m_grid_path;
+};
+
+#endif /* End of __PAIR_SUMMARY_H__ */
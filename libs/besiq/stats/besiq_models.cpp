@@ -9,20 +9,18 @@ saturated::saturated(log_double prior, const arma::vec &alpha)
 }
 
 log_double
-saturated::prob(const snp_row &row1, const snp_row &row2, const arma::vec &phenotype, const arma::vec &weight)
+saturated::prob(const arma::mat &count)
 {
-    mat counts = joint_count( row1, row2, phenotype, weight );
+    const ldirmult_table &table = get_table( );
 
-    vec alpha = get_alpha( );
-    
-    log_double likelihood = 1.0;
-    for(int i = 0; i < counts.n_rows; i++)
+    double log_likelihood = 0.0;
+    for(int i = 0; i < count.n_rows; i++)
     {
-        vec row_count = counts.row( i ).t( );
-        likelihood *= log_double::from_log( ldirmult( row_count, alpha ) );
+        double row_count[ 2 ] = { count( i, 0 ), count( i, 1 ) };
+        log_likelihood += table.compute( row_count );
     }
 
-    return likelihood;
+    return log_double::from_log( log_likelihood );
 }
 
 null::null(log_double prior, const arma::vec &alpha)
@@ -32,12 +30,16 @@ null::null(log_double prior, const arma::vec &alpha)
 }
 
 log_double
-null::prob(const snp_row &row1, const snp_row &row2, const arma::vec &phenotype, const arma::vec &weight)
+null::prob(const arma::mat &count)
 {
-    vec counts = pheno_count( row1, row2, phenotype, weight );
-    vec alpha = get_alpha( );
+    double counts[ 2 ] = { 0.0, 0.0 };
+    for(int i = 0; i < count.n_rows; i++)
+    {
+        counts[ 0 ] += count( i, 0 );
+        counts[ 1 ] += count( i, 1 );
+    }
 
-    return log_double::from_log( ldirmult( counts, alpha ) );
+    return log_double::from_log( get_table( ).compute( counts ) );
 }
 
 ld_assoc::ld_assoc(log_double prior, const arma::vec &alpha, bool is_first)
@@ -48,67 +50,92 @@ ld_assoc::ld_assoc(log_double prior, const arma::vec &alpha, bool is_first)
 }
 
 log_double
-ld_assoc::prob(const snp_row &row1, const snp_row &row2, const arma::vec &phenotype, const arma::vec &weight)
+ld_assoc::prob(const arma::mat &count)
 {
-    const snp_row &snp1 = m_is_first ? row1 : row2;
-    const snp_row &snp2 = m_is_first ? row2 : row1;
+    /* Marginalize over the snp that is not associated, the cell of genotypes i and j is 3 * i + j. */
+    double counts[ 3 ][ 2 ] = { { 0.0, 0.0 }, { 0.0, 0.0 }, { 0.0, 0.0 } };
+    for(int i = 0; i < 3; i++)
+    {
+        for(int j = 0; j < 3; j++)
+        {
+            int genotype = m_is_first ? i : j;
+            counts[ genotype ][ 0 ] += count( 3 * i + j, 0 );
+            counts[ genotype ][ 1 ] += count( 3 * i + j, 1 );
+        }
+    }
 
-    mat counts = single_count( snp1, snp2, phenotype, weight );
-    
-    vec alpha = get_alpha( );
+    const ldirmult_table &table = get_table( );
 
-    log_double likelihood = 1.0;
-    for(int i = 0; i < counts.n_rows; i++)
+    double log_likelihood = 0.0;
+    for(int i = 0; i < 3; i++)
     {
-        vec row_count = counts.row( i ).t( );
-        likelihood *= log_double::from_log( ldirmult( row_count, alpha ) );
+        log_likelihood += table.compute( counts[ i ] );
     }
 
-    return likelihood;
+    return log_double::from_log( log_likelihood );
 }
 
 sindependent::sindependent(log_double prior, const arma::vec &alpha, int num_mc_iterations)
 : model::model( prior, alpha ),
-  m_rdir( 0 ),
-  m_num_mc_iterations( num_mc_iterations )
-{
-}
-
-log_double
-sindependent::prob(const snp_row &row1, const snp_row &row2, const arma::vec &phenotype, const arma::vec &weight)
+  m_num_mc_iterations( num_mc_iterations ),
+  m_log_terms( num_mc_iterations, 15 )
 {
-    mat counts = joint_count( row1, row2, phenotype, weight );
+    /* A risk of 0 or 1 would give log( 0 ) * 0 for empty cells. */
+    const double min_log = -1e30;
 
-    vec alpha = model::get_alpha( );
-    log_double likelihood = 0.0;
+    dir_generator rdir( 0 );
     for(int k = 0; k < m_num_mc_iterations; k++)
     {
         double p[ 3 ];
         double q[ 3 ];
         for(int i = 0; i < 3; i++)
         {
-            p[ i ] = m_rdir.sample( alpha )[ 0 ];
-            q[ i ] = m_rdir.sample( alpha )[ 0 ];
+            p[ i ] = rdir.sample( alpha )[ 0 ];
+            q[ i ] = rdir.sample( alpha )[ 0 ];
         }
 
-        log_double factors = 1.0;
         for(int i = 0; i < 3; i++)
         {
             for(int j = 0; j < 3; j++)
             {
-                double n_ij0 = counts( 3 * i + j, 0 );
-                double n_ij1 = counts( 3 * i + j, 1 );
-
                 double risk = p[ i ] * q[ j ] + ( 1.0 - p[ i ] ) * q[ j ] + p[ i ] * ( 1.0 - q[ j ] );
-
-                log_double fac1 = log_double::from_log( n_ij1 * log( risk ) );
-                log_double fac2 = log_double::from_log( n_ij0 * log( 1.0 - risk ) );
-                factors *= fac1 * fac2;
+                m_log_terms( k, 3 * i + j ) = std::max( log( risk ), min_log );
             }
+
+            m_log_terms( k, 9 + i ) = std::max( log( 1.0 - p[ i ] ), min_log );
+            m_log_terms( k, 12 + i ) = std::max( log( 1.0 - q[ i ] ), min_log );
         }
+    }
+}
 
-        likelihood += factors / ( (double) m_num_mc_iterations );
+log_double
+sindependent::prob(const arma::mat &counts)
+{
+    if( m_num_mc_iterations <= 0 )
+    {
+        return 0.0;
+    }
+
+    /* Since 1 - risk_ij = ( 1 - p_i ) * ( 1 - q_j ), controls only need the margins. */
+    vec weights = zeros<vec>( 15 );
+    for(int i = 0; i < 3; i++)
+    {
+        for(int j = 0; j < 3; j++)
+        {
+            weights[ 3 * i + j ] = counts( 3 * i + j, 1 );
+            weights[ 9 + i ] += counts( 3 * i + j, 0 );
+            weights[ 12 + j ] += counts( 3 * i + j, 0 );
+        }
+    }
+
+    /* Average the likelihood of all draws with log-sum-exp. */
+    vec log_likelihood = m_log_terms * weights;
+    double max_log = log_likelihood.max( );
+    double sum_exp = 0.0;
+    for(int k = 0; k < m_num_mc_iterations; k++)
+    {
+        sum_exp += exp( log_likelihood[ k ] - max_log );
     }
 
-    return likelihood;
+    return log_double::from_log( max_log + log( sum_exp / m_num_mc_iterations ) );
 }
@@ -23,7 +23,8 @@ public:
      */
     model(log_double prior, const arma::vec &alpha)
     : m_prior( prior ),
-      m_alpha( alpha )
+      m_alpha( alpha ),
+      m_table( alpha )
     {
     }
 
@@ -52,18 +53,57 @@ public:
         return m_alpha;
     }
 
+    /**
+     * Tabulates the dirichlet multinomial terms for integer counts,
+     * should be called when all weights are 0 or 1.
+     *
+     * @param max_count The largest count, i.e. the number of samples.
+     */
+    void set_max_count(unsigned int max_count)
+    {
+        m_table = ldirmult_table( m_alpha, max_count );
+    }
+
+    /**
+     * Returns the dirichlet multinomial terms for the prior parameters.
+     *
+     * @return The dirichlet multinomial terms.
+     */
+    const ldirmult_table &get_table() const
+    {
+        return m_table;
+    }
+
     /**
      * Computes the likelihood of the phenotype under this
-     * model.
+     * model by counting the samples with joint_count and
+     * calling prob for the counts. It is not virtual, derived
+     * models implement prob for the counts and bring this
+     * overload into scope with "using model::prob".
      *
      * @param row1 The first snp.
-     * @param row2 The §second snp.
+     * @param row2 The second snp.
      * @param phenotype The phenotype, discrete 0.0 and 1.0.
      * @param weight A weight for each sample, this will be used instead of 1.0 as a count.
      *
      * @return The likelihood of the snps.
      */
-    virtual log_double prob(const snp_row &row1, const snp_row &row2, const arma::vec &phenotype, const arma::vec &weight) = 0;
+    log_double prob(const snp_row &row1, const snp_row &row2, const arma::vec &phenotype, const arma::vec &weight)
+    {
+        return prob( joint_count( row1, row2, phenotype, weight ) );
+    }
+
+    /**
+     * Computes the likelihood of the phenotype under this
+     * model from the joint counts, so that the samples only
+     * need to be counted once for all models.
+     *
+     * @param count The weighted counts from joint_count, 9 genotype
+     *              combinations for controls and cases.
+     *
+     * @return The likelihood of the snps.
+     */
+    virtual log_double prob(const arma::mat &count) = 0;
     
 private:
     /**
@@ -75,6 +115,11 @@ private:
      * The beta prior parameters.
      */
     arma::vec m_alpha;
+
+    /**
+     * Dirichlet multinomial terms for m_alpha.
+     */
+    ldirmult_table m_table;
 };
 
 /**
@@ -93,10 +138,12 @@ public:
      */
     saturated(log_double prior, const arma::vec &alpha);
     
+    using model::prob;
+
     /**
      * @see model::prob.
      */
-    virtual log_double prob(const snp_row &row1, const snp_row &row2, const arma::vec &phenotype, const arma::vec &weight);
+    virtual log_double prob(const arma::mat &count);
 };
 
 /**
@@ -152,10 +199,12 @@ public:
      */
     static log_double pheno_prob(const snp_row &row1, const snp_row &row2, const arma::vec &phenotype, const arma::vec &weight);
 
+    using model::prob;
+
     /**
      * @see model::prob.
      */
-    virtual log_double prob(const snp_row &row1, const snp_row &row2, const arma::vec &phenotype, const arma::vec &weight);
+    virtual log_double prob(const arma::mat &count);
 };
 
 /**
@@ -174,10 +223,12 @@ public:
      */
     ld_assoc(log_double prior, const arma::vec &alpha, bool is_first);
 
+    using model::prob;
+
     /**
      * @see model::prob.
      */
-    virtual log_double prob(const snp_row &row1, const snp_row &row2, const arma::vec &phenotype, const arma::vec &weight);
+    virtual log_double prob(const arma::mat &count);
 
 private:
     /**
@@ -191,9 +242,12 @@ private:
  * This class represents a model where two snps are independently
  * associated to the phenotype.
  *
- * The posterior of this model takes significantly longer than the
- * other models and should only be used on a small subset of
- * snp pairs.
+ * The likelihood is integrated by monte carlo over a fixed set of
+ * draws from the prior that is generated once, with a fixed seed,
+ * and shared by all pairs. A pair therefore always gets the same
+ * likelihood, regardless of the order in which pairs are run.
+ * The draws take 120 bytes of memory each, and are only read
+ * after they have been generated.
  */
 class sindependent
 : public model
@@ -207,18 +261,26 @@ public:
      */
     sindependent(log_double prior, const arma::vec &alpha, int num_mc_iterations);
 
+    using model::prob;
+
     /**
      * @see model::prob.
      */
-    virtual log_double prob(const snp_row &row1, const snp_row &row2, const arma::vec &phenotype, const arma::vec &weight);
+    virtual log_double prob(const arma::mat &count);
 
 private:
-    dir_generator m_rdir;
-
     /**
      * Number of monte carlo iterations.
      */
     int m_num_mc_iterations;
+
+    /**
+     * The log terms of each draw, one row per draw. Column 3 * i + j
+     * is log( risk_ij ), columns 9 + i are log( 1 - p_i ) and columns
+     * 12 + j are log( 1 - q_j ), so that the log likelihood of all
+     * draws is a product with the counts.
+     */
+    arma::mat m_log_terms;
 };
 
 #endif /* End of __BESIQ_MODELS_H__ */
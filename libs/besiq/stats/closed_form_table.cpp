@@ -0,0 +1,148 @@
+#include <cmath>
+
+#include <besiq/stats/closed_form_table.hpp>
+
+closed_form_table::closed_form_table(bool is_normal, unsigned int max_count)
+    : m_is_normal( is_normal )
+{
+    if( !is_normal )
+    {
+        m_xlogx.resize( max_count + 1, 0.0 );
+        for(unsigned int n = 1; n <= max_count; n++)
+        {
+            m_xlogx[ n ] = n * log( (double) n );
+        }
+    }
+}
+
+double
+closed_form_table::xlogx(double x) const
+{
+    if( x < m_xlogx.size( ) )
+    {
+        size_t n = (size_t) x;
+        if( n == x )
+        {
+            return m_xlogx[ n ];
+        }
+    }
+
+    return x > 0.0 ? x * log( x ) : 0.0;
+}
+
+double
+closed_form_table::binomial_group(double controls, double cases) const
+{
+    /* n1 * log( n1 / n ) + n0 * log( n0 / n ) */
+    return xlogx( cases ) + xlogx( controls ) - xlogx( cases + controls );
+}
+
+/**
+ * Log likelihood of a normal model with k parameters, where the
+ * variance is estimated from the residuals.
+ *
+ * @param n Number of samples.
+ * @param rss Residual sum of squares.
+ * @param k Number of parameters.
+ *
+ * @return The log likelihood.
+ */
+static double
+normal_loglik(double n, double rss, double k)
+{
+    double sigma_square = rss / ( n - k );
+
+    return -( n / 2 ) * log( 2 * arma::datum::pi ) - ( n / 2 ) * log( sigma_square ) - ( n - k ) / 2;
+}
+
+void
+closed_form_table::log_likelihoods(const arma::mat &count, double *loglik) const
+{
+    /* Marginal sums over the genotypes of the second (snp1) and first (snp2) snp. */
+    int num_cols = m_is_normal ? 3 : 2;
+    double snp1[ 3 ][ 3 ] = { { 0.0, 0.0, 0.0 }, { 0.0, 0.0, 0.0 }, { 0.0, 0.0, 0.0 } };
+    double snp2[ 3 ][ 3 ] = { { 0.0, 0.0, 0.0 }, { 0.0, 0.0, 0.0 }, { 0.0, 0.0, 0.0 } };
+    double total[ 3 ] = { 0.0, 0.0, 0.0 };
+    for(int i = 0; i < 3; i++)
+    {
+        for(int j = 0; j < 3; j++)
+        {
+            for(int c = 0; c < num_cols; c++)
+            {
+                double x = count( 3 * i + j, c );
+                snp1[ i ][ c ] += x;
+                snp2[ j ][ c ] += x;
+                total[ c ] += x;
+            }
+        }
+    }
+
+    if( !m_is_normal )
+    {
+        loglik[ CLOSED_FORM_FULL ] = 0.0;
+        for(int i = 0; i < 9; i++)
+        {
+            loglik[ CLOSED_FORM_FULL ] += binomial_group( count( i, 0 ), count( i, 1 ) );
+        }
+
+        loglik[ CLOSED_FORM_NULL ] = binomial_group( total[ 0 ], total[ 1 ] );
+        loglik[ CLOSED_FORM_SNP1 ] = 0.0;
+        loglik[ CLOSED_FORM_SNP2 ] = 0.0;
+        for(int i = 0; i < 3; i++)
+        {
+            loglik[ CLOSED_FORM_SNP1 ] += binomial_group( snp1[ i ][ 0 ], snp1[ i ][ 1 ] );
+            loglik[ CLOSED_FORM_SNP2 ] += binomial_group( snp2[ i ][ 0 ], snp2[ i ][ 1 ] );
+        }
+    }
+    else
+    {
+        /* The columns are the sum of the phenotype, the number of samples and the sum of squares. */
+        double rss_full = 0.0;
+        for(int i = 0; i < 9; i++)
+        {
+            rss_full += count( i, 2 ) - count( i, 0 ) * count( i, 0 ) / count( i, 1 );
+        }
+
+        double rss_snp1 = 0.0;
+        double rss_snp2 = 0.0;
+        for(int i = 0; i < 3; i++)
+        {
+            rss_snp1 += snp1[ i ][ 2 ] - snp1[ i ][ 0 ] * snp1[ i ][ 0 ] / snp1[ i ][ 1 ];
+            rss_snp2 += snp2[ i ][ 2 ] - snp2[ i ][ 0 ] * snp2[ i ][ 0 ] / snp2[ i ][ 1 ];
+        }
+
+        double rss_null = total[ 2 ] - total[ 0 ] * total[ 0 ] / total[ 1 ];
+
+        double n = total[ 1 ];
+        loglik[ CLOSED_FORM_FULL ] = normal_loglik( n, rss_full, df( CLOSED_FORM_FULL ) );
+        loglik[ CLOSED_FORM_NULL ] = normal_loglik( n, rss_null, df( CLOSED_FORM_NULL ) );
+        loglik[ CLOSED_FORM_SNP1 ] = normal_loglik( n, rss_snp1, df( CLOSED_FORM_SNP1 ) );
+        loglik[ CLOSED_FORM_SNP2 ] = normal_loglik( n, rss_snp2, df( CLOSED_FORM_SNP2 ) );
+    }
+}
+
+void
+closed_form_table::likelihood_ratios(const arma::mat &count, double *lr) const
+{
+    double loglik[ CLOSED_FORM_NUM_MODELS ];
+    log_likelihoods( count, loglik );
+
+    for(int i = 0; i < CLOSED_FORM_NUM_MODELS; i++)
+    {
+        lr[ i ] = -2.0 * ( loglik[ i ] - loglik[ CLOSED_FORM_FULL ] );
+    }
+}
+
+unsigned int
+closed_form_table::df(int model)
+{
+    switch( model )
+    {
+        case CLOSED_FORM_FULL:
+            return 9;
+        case CLOSED_FORM_NULL:
+            return 1;
+        default:
+            return 3;
+    }
+}
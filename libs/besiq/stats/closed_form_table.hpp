@@ -0,0 +1,109 @@
+#ifndef __CLOSED_FORM_TABLE_H__
+#define __CLOSED_FORM_TABLE_H__
+
+#include <vector>
+
+#include <armadillo>
+
+/**
+ * Index of each model in closed_form_table.
+ */
+enum closed_form_model_index
+{
+    /* Each of the 9 genotype combinations has its own parameter. */
+    CLOSED_FORM_FULL = 0,
+
+    /* No snp is associated with the phenotype. */
+    CLOSED_FORM_NULL = 1,
+
+    /* Only the first snp is associated with the phenotype. */
+    CLOSED_FORM_SNP1 = 2,
+
+    /* Only the second snp is associated with the phenotype. */
+    CLOSED_FORM_SNP2 = 3,
+
+    CLOSED_FORM_NUM_MODELS = 4
+};
+
+/**
+ * Computes the log likelihoods of the full, null and single snp
+ * closed form models in one pass over a joint count table, without
+ * allocating memory. This gives the same likelihoods as the
+ * binomial_* and normal_* models.
+ *
+ * For binomial models the terms x * log( x ) are looked up in a
+ * table for integer counts.
+ */
+class closed_form_table
+{
+public:
+    /**
+     * Constructor.
+     *
+     * @param is_normal If true the counts are from joint_count_cont,
+     *                  otherwise from joint_count.
+     * @param max_count The largest count that is looked up, i.e. the
+     *                  number of samples.
+     */
+    closed_form_table(bool is_normal, unsigned int max_count = 0);
+
+    /**
+     * Computes the log likelihood of each model.
+     *
+     * @param count The joint counts of a pair.
+     * @param loglik The log likelihood of each model will be stored here,
+     *               indexed by closed_form_model_index.
+     */
+    void log_likelihoods(const arma::mat &count, double *loglik) const;
+
+    /**
+     * Computes the likelihood ratio statistic of each model against
+     * the full model, i.e. -2 * ( loglik_i - loglik_full ).
+     *
+     * @param count The joint counts of a pair.
+     * @param lr The statistic of each model will be stored here, indexed
+     *           by closed_form_model_index, lr[ CLOSED_FORM_FULL ] is 0.
+     */
+    void likelihood_ratios(const arma::mat &count, double *lr) const;
+
+    /**
+     * Returns the degrees of freedom of a model.
+     *
+     * @param model The index of the model.
+     *
+     * @return The degrees of freedom.
+     */
+    static unsigned int df(int model);
+
+private:
+    /**
+     * Returns x * log( x ), and 0 for x = 0.
+     *
+     * @param x A non-negative count.
+     *
+     * @return x * log( x ).
+     */
+    double xlogx(double x) const;
+
+    /**
+     * Log likelihood of a group of samples with a binomial phenotype.
+     *
+     * @param controls Number of controls.
+     * @param cases Number of cases.
+     *
+     * @return The maximized log likelihood.
+     */
+    double binomial_group(double controls, double cases) const;
+
+    /**
+     * If true the phenotype is continuous.
+     */
+    bool m_is_normal;
+
+    /**
+     * x * log( x ) for x = 0, 1, ...
+     */
+    std::vector<double> m_xlogx;
+};
+
+#endif /* End of __CLOSED_FORM_TABLE_H__ */
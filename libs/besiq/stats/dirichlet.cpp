@@ -1,4 +1,7 @@
+#include <map>
+
 #include <assert.h>
+#include <pthread.h>
 
 #include <besiq/stats/dirichlet.hpp>
 #include <dcdflib/libdcdf.hpp>
@@ -42,6 +45,100 @@ lbinomial(double n, double k)
     return lgamma( n + 1.0 ) - lgamma( n - k + 1.0 ) - lgamma( k + 1.0 );
 }
 
+/**
+ * The largest table of lgamma( n + a ) that has been created for
+ * each a.
+ */
+static std::map< double, shared_ptr< std::vector<double> > > g_lgamma_tables;
+
+/**
+ * Protects g_lgamma_tables.
+ */
+static pthread_mutex_t g_lgamma_tables_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Returns a table of lgamma( n + a ) for n = 0, ..., max_count or
+ * more. The table is shared with all other users of the same a,
+ * and is only computed if no large enough table exists.
+ *
+ * @param a The parameter.
+ * @param max_count The largest n that is needed.
+ *
+ * @return The table.
+ */
+static shared_ptr< std::vector<double> >
+shared_lgamma_table(double a, unsigned int max_count)
+{
+    pthread_mutex_lock( &g_lgamma_tables_mutex );
+
+    shared_ptr< std::vector<double> > &table = g_lgamma_tables[ a ];
+    if( !table || table->size( ) <= max_count )
+    {
+        table = shared_ptr< std::vector<double> >( new std::vector<double>( max_count + 1 ) );
+        for(unsigned int n = 0; n <= max_count; n++)
+        {
+            (*table)[ n ] = lgamma( n + a );
+        }
+    }
+    shared_ptr< std::vector<double> > result = table;
+
+    pthread_mutex_unlock( &g_lgamma_tables_mutex );
+
+    return result;
+}
+
+ldirmult_table::ldirmult_table(const arma::vec &alpha, unsigned int max_count)
+    : m_alpha( alpha.begin( ), alpha.end( ) ),
+      m_alpha_sum( arma::sum( alpha ) ),
+      m_lgamma_alpha( alpha.n_elem )
+{
+    m_constant = lgamma( m_alpha_sum );
+    for(int i = 0; i < m_alpha.size( ); i++)
+    {
+        m_constant -= lgamma( m_alpha[ i ] );
+        m_lgamma_alpha[ i ] = shared_lgamma_table( m_alpha[ i ], max_count );
+    }
+
+    m_lgamma_alpha_sum = shared_lgamma_table( m_alpha_sum, max_count );
+}
+
+double
+ldirmult_table::lookup(const std::vector<double> &table, double x, double a) const
+{
+    if( x >= 0.0 && x < table.size( ) )
+    {
+        size_t n = (size_t) x;
+        if( n == x )
+        {
+            return table[ n ];
+        }
+    }
+
+    return lgamma( x + a );
+}
+
+double
+ldirmult_table::compute(const double *x) const
+{
+    double x_sum = 0.0;
+    double x_alpha = m_constant;
+    for(int i = 0; i < m_alpha.size( ); i++)
+    {
+        x_sum += x[ i ];
+        x_alpha += lookup( *m_lgamma_alpha[ i ], x[ i ], m_alpha[ i ] );
+    }
+
+    return x_alpha - lookup( *m_lgamma_alpha_sum, x_sum, m_alpha_sum );
+}
+
+double
+ldirmult_table::compute(const arma::vec &x) const
+{
+    assert( x.n_elem == m_alpha.size( ) );
+
+    return compute( x.memptr( ) );
+}
+
 dir_generator::dir_generator(unsigned long seed)
     :   m_generator( seed )
 {
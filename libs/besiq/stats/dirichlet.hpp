@@ -7,6 +7,8 @@
 #include <numeric>
 #include <vector>
 
+#include <shared_ptr/shared_ptr.hpp>
+
 #include <besiq/config.h>
 #ifndef HAVE_TR1_RANDOM
 #include <random>
@@ -48,6 +50,82 @@ double ldirmult(const arma::vec &x, const arma::vec &alpha);
  */
 double lbinomial(double n, double k);
 
+/**
+ * Computes ldirmult for a fixed alpha, using tables of lgamma
+ * for integer counts up to a maximum. Other counts, e.g. weighted
+ * counts, fall back to calling lgamma. The tables are shared by
+ * all objects with the same parameter values, so models with the
+ * same prior only keep one copy.
+ */
+class ldirmult_table
+{
+public:
+    /**
+     * Constructor.
+     *
+     * @param alpha The prior parameters of the dirichlet density.
+     * @param max_count The largest count that is looked up, the sum
+     *                  of the counts is also looked up if it is smaller.
+     */
+    ldirmult_table(const arma::vec &alpha, unsigned int max_count = 0);
+
+    /**
+     * Computes the dirichlet multinomial log probability.
+     *
+     * @param x The observations, one for each element of alpha.
+     *
+     * @return The log posterior probability of x.
+     */
+    double compute(const double *x) const;
+
+    /**
+     * Computes the dirichlet multinomial log probability.
+     *
+     * @param x The observations.
+     *
+     * @return The log posterior probability of x.
+     */
+    double compute(const arma::vec &x) const;
+
+private:
+    /**
+     * Returns lgamma( x + a ) from a table if x is an integer
+     * within the table.
+     *
+     * @param table Values of lgamma( n + a ) for n = 0, 1, ...
+     * @param x The count.
+     * @param a The parameter that the table was computed for.
+     *
+     * @return lgamma( x + a ).
+     */
+    double lookup(const std::vector<double> &table, double x, double a) const;
+
+    /**
+     * The prior parameters.
+     */
+    std::vector<double> m_alpha;
+
+    /**
+     * Sum of the prior parameters.
+     */
+    double m_alpha_sum;
+
+    /**
+     * lgamma( alpha_sum ) - sum_i lgamma( alpha_i ).
+     */
+    double m_constant;
+
+    /**
+     * lgamma( n + alpha_i ) for each parameter i.
+     */
+    std::vector< shared_ptr< std::vector<double> > > m_lgamma_alpha;
+
+    /**
+     * lgamma( n + alpha_sum ).
+     */
+    shared_ptr< std::vector<double> > m_lgamma_alpha_sum;
+};
+
 /**
  * This class is responsible for generating samples from a
  * dirichlet distribution. It does so by using the fact that
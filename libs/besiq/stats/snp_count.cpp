@@ -1,35 +1,714 @@
+#include <algorithm>
+
+#include <plink/snp_summary.hpp>
 #include <besiq/stats/snp_count.hpp>
 
 using namespace arma;
 
+/**
+ * Maps the genotypes ( snp1 << 2 ) | snp2 of a sample to its cell in
+ * the joint table. Samples with a missing genotype are mapped to cell
+ * JOINT_CELL_MISSING, so that they can be accumulated without a branch
+ * and then ignored.
+ */
+static const unsigned int JOINT_CELL_MISSING = 9;
+static const unsigned char JOINT_CELL[ 16 ] = { 0, 1, 2, 9, 3, 4, 5, 9, 6, 7, 8, 9, 9, 9, 9, 9 };
+
+/**
+ * Number of threads that may count the samples of a single pair.
+ */
+static int g_count_threads = 1;
+
+void
+set_count_threads(int num_threads)
+{
+    g_count_threads = std::max( num_threads, 1 );
+}
+
+int
+get_count_threads(size_t num_samples)
+{
+    return (int) std::max( std::min( (size_t) g_count_threads, num_samples / COUNT_SAMPLES_PER_THREAD ), (size_t) 1 );
+}
+
+int
+get_pair_threads(size_t num_samples, size_t num_pairs)
+{
+    if( get_count_threads( num_samples ) > 1 )
+    {
+        return 1;
+    }
+
+    return (int) std::max( std::min( (size_t) g_count_threads, num_pairs ), (size_t) 1 );
+}
+
+/**
+ * Visits the cell of each sample in a range of words of the joint
+ * table of two snps. The genotypes are read a word, i.e. 16 samples,
+ * at a time and the cell is looked up from the genotypes of both snps,
+ * instead of decoding each genotype separately.
+ *
+ * @param row1 The first snp.
+ * @param row2 The second snp.
+ * @param first The first word.
+ * @param last One past the last word.
+ * @param accumulate Called with the index of each sample and its cell,
+ *                   which is JOINT_CELL_MISSING if either genotype is missing.
+ */
+template<class accumulator>
+static inline void
+accumulate_range(const snp_row &row1, const snp_row &row2, size_t first, size_t last, accumulator &accumulate)
+{
+    const unsigned int *data1 = row1.data( );
+    const unsigned int *data2 = row2.data( );
+    size_t num_samples = row1.size( );
+    size_t samples_per_element = 4 * sizeof( unsigned int );
+
+    for(size_t e = first; e < last; e++)
+    {
+        unsigned int genotypes1 = data1[ e ];
+        unsigned int genotypes2 = data2[ e ];
+        size_t start = e * samples_per_element;
+        size_t end = std::min( start + samples_per_element, num_samples );
+        for(size_t i = start; i < end; i++)
+        {
+            accumulate( i, JOINT_CELL[ ( ( genotypes1 & 3 ) << 2 ) | ( genotypes2 & 3 ) ] );
+            genotypes1 >>= 2;
+            genotypes2 >>= 2;
+        }
+    }
+}
+
+/**
+ * Visits the cell of each sample in the joint table of two snps. For
+ * large sample sizes the words are split into contiguous ranges that
+ * are counted by separate threads, each into its own copy of the
+ * accumulator, and the copies are then merged.
+ *
+ * @param row1 The first snp.
+ * @param row2 The second snp.
+ * @param accumulate An accumulator with no samples, see accumulate_range.
+ */
+template<class accumulator>
+static void
+accumulate_cells(const snp_row &row1, const snp_row &row2, accumulator &accumulate)
+{
+    size_t num_elements = snp_row::num_elements( row1.size( ) );
+    int num_threads = get_count_threads( row1.size( ) );
+    if( num_threads <= 1 )
+    {
+        accumulate_range( row1, row2, 0, num_elements, accumulate );
+        return;
+    }
+
+    std::vector<accumulator> partial( num_threads, accumulate );
+    #pragma omp parallel for schedule( static ) num_threads( num_threads )
+    for(int t = 0; t < num_threads; t++)
+    {
+        size_t first = ( num_elements * t ) / num_threads;
+        size_t last = ( num_elements * ( t + 1 ) ) / num_threads;
+        accumulate_range( row1, row2, first, last, partial[ t ] );
+    }
+
+    for(int t = 0; t < num_threads; t++)
+    {
+        accumulate.merge( partial[ t ] );
+    }
+}
+
+/**
+ * Sums the weights of the controls and the cases in each cell,
+ * phenotypes other than 0 and 1 are ignored.
+ */
+struct weighted_count
+{
+    weighted_count(const arma::vec &phenotype, const arma::vec &weight)
+        : phenotype( phenotype.memptr( ) ),
+          weight( weight.memptr( ) )
+    {
+        std::fill( &sums[ 0 ][ 0 ], &sums[ 0 ][ 0 ] + 20, 0.0 );
+    }
+
+    void operator()(size_t i, unsigned int cell)
+    {
+        if( weight[ i ] == 0.0 )
+        {
+            return;
+        }
+
+        unsigned int pheno = (unsigned int) phenotype[ i ];
+        if( pheno < 2 )
+        {
+            sums[ cell ][ pheno ] += weight[ i ];
+        }
+    }
+
+    void merge(const weighted_count &other)
+    {
+        for(int i = 0; i < 20; i++)
+        {
+            ( &sums[ 0 ][ 0 ] )[ i ] += ( &other.sums[ 0 ][ 0 ] )[ i ];
+        }
+    }
+
+    const double *phenotype;
+    const double *weight;
+    double sums[ 10 ][ 2 ];
+};
+
+/**
+ * Sums the weighted phenotype, the weights and the weighted squared
+ * phenotype in each cell.
+ */
+struct weighted_moments
+{
+    weighted_moments(const arma::vec &phenotype, const arma::vec &weight)
+        : phenotype( phenotype.memptr( ) ),
+          weight( weight.memptr( ) )
+    {
+        std::fill( &sums[ 0 ][ 0 ], &sums[ 0 ][ 0 ] + 30, 0.0 );
+    }
+
+    void operator()(size_t i, unsigned int cell)
+    {
+        /* Missing samples may have an undefined phenotype. */
+        double w = weight[ i ];
+        if( w == 0.0 )
+        {
+            return;
+        }
+
+        double wy = w * phenotype[ i ];
+        sums[ cell ][ 0 ] += wy;
+        sums[ cell ][ 1 ] += w;
+        sums[ cell ][ 2 ] += wy * phenotype[ i ];
+    }
+
+    void merge(const weighted_moments &other)
+    {
+        for(int i = 0; i < 30; i++)
+        {
+            ( &sums[ 0 ][ 0 ] )[ i ] += ( &other.sums[ 0 ][ 0 ] )[ i ];
+        }
+    }
+
+    const double *phenotype;
+    const double *weight;
+    double sums[ 10 ][ 3 ];
+};
+
+/**
+ * Sums the weighted phenotypes, the weights and the weighted squared
+ * phenotypes in each cell for many phenotypes at once, each phenotype
+ * has its own weights. The phenotypes and weights of a sample are
+ * contiguous, so the inner loop is a plain vector add.
+ */
+struct weighted_phenotype_moments
+{
+    weighted_phenotype_moments(const arma::mat &phenotypes, const arma::mat &weights)
+        : phenotypes( phenotypes.memptr( ) ),
+          num_phenotypes( phenotypes.n_rows ),
+          weights( weights.memptr( ) ),
+          sums( 10 * 3 * phenotypes.n_rows, 0.0 )
+    {
+    }
+
+    void operator()(size_t i, unsigned int cell)
+    {
+        const double *y = phenotypes + i * num_phenotypes;
+        const double *w = weights + i * num_phenotypes;
+        double *sum = &sums[ 3 * num_phenotypes * cell ];
+        double *n = sum + num_phenotypes;
+        double *square = n + num_phenotypes;
+        for(size_t p = 0; p < num_phenotypes; p++)
+        {
+            double wy = w[ p ] * y[ p ];
+            sum[ p ] += wy;
+            n[ p ] += w[ p ];
+            square[ p ] += wy * y[ p ];
+        }
+    }
+
+    void merge(const weighted_phenotype_moments &other)
+    {
+        for(size_t i = 0; i < sums.size( ); i++)
+        {
+            sums[ i ] += other.sums[ i ];
+        }
+    }
+
+    const double *phenotypes;
+    size_t num_phenotypes;
+    const double *weights;
+    std::vector<double> sums;
+};
+
+/**
+ * Counts the samples in each cell.
+ */
+struct cell_count
+{
+    cell_count()
+    {
+        std::fill( sums, sums + 10, 0 );
+    }
+
+    void operator()(size_t i, unsigned int cell)
+    {
+        sums[ cell ]++;
+    }
+
+    void merge(const cell_count &other)
+    {
+        for(int i = 0; i < 10; i++)
+        {
+            sums[ i ] += other.sums[ i ];
+        }
+    }
+
+    unsigned int sums[ 10 ];
+};
+
 arma::mat
 joint_count(const snp_row &row1, const snp_row &row2, const arma::vec &phenotype, const arma::vec &weight)
 {
-    arma::mat counts = zeros<mat>( 9, 2 );
-    for(int i = 0; i < row1.size( ); i++)
+    weighted_count count( phenotype, weight );
+    accumulate_cells( row1, row2, count );
+
+    arma::mat counts( 9, 2 );
+    for(int i = 0; i < 9; i++)
     {
-        if( row1[ i ] != 3 && row2[ i ] != 3 )
+        counts( i, 0 ) = count.sums[ i ][ 0 ];
+        counts( i, 1 ) = count.sums[ i ][ 1 ];
+    }
+
+    return counts;
+}
+
+std::vector<arma::mat>
+joint_count(const std::vector<snp_row_pair> &pairs, const arma::vec &phenotype, const arma::vec &weight)
+{
+    /* Each pair is counted by a single thread, unless its samples are split between threads. */
+    std::vector<arma::mat> counts( pairs.size( ) );
+    int num_threads = get_pair_threads( phenotype.n_elem, pairs.size( ) );
+    #pragma omp parallel for schedule( dynamic, 8 ) num_threads( num_threads )
+    for(int i = 0; i < (int) pairs.size( ); i++)
+    {
+        counts[ i ] = joint_count( *pairs[ i ].first, *pairs[ i ].second, phenotype, weight );
+    }
+
+    return counts;
+}
+
+arma::mat
+joint_count_cont(const snp_row &row1, const snp_row &row2, const arma::vec &phenotype, const arma::vec &weight)
+{
+    weighted_moments moments( phenotype, weight );
+    accumulate_cells( row1, row2, moments );
+
+    arma::mat counts( 9, 3 );
+    for(int i = 0; i < 9; i++)
+    {
+        for(int j = 0; j < 3; j++)
         {
-            unsigned int pheno = (unsigned int) phenotype[ i ];
-            counts( 3 * row1[ i ] + row2[ i ], pheno ) += weight[ i ];
+            counts( i, j ) = moments.sums[ i ][ j ];
         }
     }
 
     return counts;
 }
 
+std::vector<arma::mat>
+joint_count_cont(const std::vector<snp_row_pair> &pairs, const arma::vec &phenotype, const arma::vec &weight)
+{
+    /* Each pair is counted by a single thread, unless its samples are split between threads. */
+    std::vector<arma::mat> counts( pairs.size( ) );
+    int num_threads = get_pair_threads( phenotype.n_elem, pairs.size( ) );
+    #pragma omp parallel for schedule( dynamic, 8 ) num_threads( num_threads )
+    for(int i = 0; i < (int) pairs.size( ); i++)
+    {
+        counts[ i ] = joint_count_cont( *pairs[ i ].first, *pairs[ i ].second, phenotype, weight );
+    }
+
+    return counts;
+}
+
+/**
+ * Even bits of a packed word, i.e. the low bit of each genotype.
+ */
+static const unsigned int LOW_BITS = 0x55555555u;
+
+/**
+ * Counts the number of set bits.
+ *
+ * @param x A word.
+ *
+ * @return The number of set bits in x.
+ */
+static inline unsigned int
+count_bits(unsigned int x)
+{
+#ifdef __GNUC__
+    return __builtin_popcount( x );
+#else
+    x = x - ( ( x >> 1 ) & 0x55555555u );
+    x = ( x & 0x33333333u ) + ( ( x >> 2 ) & 0x33333333u );
+    return ( ( ( x + ( x >> 4 ) ) & 0x0f0f0f0fu ) * 0x01010101u ) >> 24;
+#endif
+}
+
+phenotype_mask
+make_phenotype_mask(const arma::vec &phenotype, const arma::uvec &missing)
+{
+    size_t bits_per_element = 8 * sizeof( unsigned int );
+    phenotype_mask mask;
+    mask.controls.assign( snp_row::num_elements( phenotype.n_elem ), 0 );
+    mask.cases.assign( snp_row::num_elements( phenotype.n_elem ), 0 );
+    mask.num_controls = 0;
+    mask.num_cases = 0;
+    for(size_t i = 0; i < phenotype.n_elem; i++)
+    {
+        if( missing[ i ] != 0 )
+        {
+            continue;
+        }
+
+        unsigned int bit = 1u << ( ( 2 * i ) % bits_per_element );
+        if( phenotype[ i ] == 0.0 )
+        {
+            mask.controls[ ( 2 * i ) / bits_per_element ] |= bit;
+            mask.num_controls++;
+        }
+        else if( phenotype[ i ] == 1.0 )
+        {
+            mask.cases[ ( 2 * i ) / bits_per_element ] |= bit;
+            mask.num_cases++;
+        }
+    }
+
+    return mask;
+}
+
+/**
+ * Counts the controls and the cases of each cell in a range of words.
+ *
+ * @param row1 The first snp.
+ * @param row2 The second snp.
+ * @param mask The samples to count.
+ * @param first The first word.
+ * @param last One past the last word.
+ * @param counts The counts of the controls and cases of cell c will be
+ *               added to counts[ 2 * c ] and counts[ 2 * c + 1 ].
+ */
+static void
+count_masked_range(const snp_row &row1, const snp_row &row2, const phenotype_mask &mask, size_t first, size_t last, unsigned int *counts)
+{
+    const unsigned int *data1 = row1.data( );
+    const unsigned int *data2 = row2.data( );
+    for(size_t e = first; e < last; e++)
+    {
+        unsigned int controls = mask.controls[ e ];
+        unsigned int cases = mask.cases[ e ];
+        if( ( controls | cases ) == 0 )
+        {
+            continue;
+        }
+
+        /* One bit per sample for each genotype, missing genotypes (11) are in none. */
+        unsigned int low1 = data1[ e ] & LOW_BITS;
+        unsigned int high1 = ( data1[ e ] >> 1 ) & LOW_BITS;
+        unsigned int low2 = data2[ e ] & LOW_BITS;
+        unsigned int high2 = ( data2[ e ] >> 1 ) & LOW_BITS;
+        unsigned int geno1[ 3 ] = { ~( low1 | high1 ) & LOW_BITS, low1 & ~high1, high1 & ~low1 };
+        unsigned int geno2[ 3 ] = { ~( low2 | high2 ) & LOW_BITS, low2 & ~high2, high2 & ~low2 };
+
+        for(int i = 0; i < 3; i++)
+        {
+            for(int j = 0; j < 3; j++)
+            {
+                unsigned int both = geno1[ i ] & geno2[ j ];
+                counts[ 2 * ( 3 * i + j ) ] += count_bits( both & controls );
+                counts[ 2 * ( 3 * i + j ) + 1 ] += count_bits( both & cases );
+            }
+        }
+    }
+}
+
 arma::mat
-joint_count_cont(const snp_row &row1, const snp_row &row2, const arma::vec &phenotype, const arma::vec &weight)
+joint_count(const snp_row &row1, const snp_row &row2, const phenotype_mask &mask)
+{
+    size_t num_elements = std::min( snp_row::num_elements( row1.size( ) ), mask.cases.size( ) );
+    int num_threads = get_count_threads( row1.size( ) );
+
+    std::vector<unsigned int> partial( num_threads * 18, 0 );
+    #pragma omp parallel for schedule( static ) num_threads( num_threads )
+    for(int t = 0; t < num_threads; t++)
+    {
+        size_t first = ( num_elements * t ) / num_threads;
+        size_t last = ( num_elements * ( t + 1 ) ) / num_threads;
+        count_masked_range( row1, row2, mask, first, last, &partial[ 18 * t ] );
+    }
+
+    arma::mat result = zeros<mat>( 9, 2 );
+    for(int t = 0; t < num_threads; t++)
+    {
+        for(int i = 0; i < 9; i++)
+        {
+            result( i, 0 ) += partial[ 18 * t + 2 * i ];
+            result( i, 1 ) += partial[ 18 * t + 2 * i + 1 ];
+        }
+    }
+
+    return result;
+}
+
+/**
+ * Returns the phenotype of a sample in a phenotype mask.
+ *
+ * @param mask The samples to count.
+ * @param i Index of the sample.
+ *
+ * @return 0 for a control, 1 for a case and -1 if the sample is not counted.
+ */
+static inline int
+masked_phenotype(const phenotype_mask &mask, size_t i)
+{
+    size_t bits_per_element = 8 * sizeof( unsigned int );
+    unsigned int bit = 1u << ( ( 2 * i ) % bits_per_element );
+    if( mask.controls[ ( 2 * i ) / bits_per_element ] & bit )
+    {
+        return 0;
+    }
+    else if( mask.cases[ ( 2 * i ) / bits_per_element ] & bit )
+    {
+        return 1;
+    }
+    else
+    {
+        return -1;
+    }
+}
+
+/**
+ * Counts the controls and the cases with each non-missing genotype
+ * of a single snp, a word at a time.
+ *
+ * @param row The snp.
+ * @param mask The samples to count.
+ * @param counts The number of controls and cases with genotype g
+ *               will be stored in counts[ g ][ 0 ] and counts[ g ][ 1 ].
+ */
+static void
+count_masked_genotypes(const snp_row &row, const phenotype_mask &mask, unsigned int counts[ 3 ][ 2 ])
+{
+    std::fill( &counts[ 0 ][ 0 ], &counts[ 0 ][ 0 ] + 6, 0 );
+
+    const unsigned int *data = row.data( );
+    size_t num_elements = std::min( snp_row::num_elements( row.size( ) ), mask.cases.size( ) );
+    for(size_t e = 0; e < num_elements; e++)
+    {
+        unsigned int controls = mask.controls[ e ];
+        unsigned int cases = mask.cases[ e ];
+        if( ( controls | cases ) == 0 )
+        {
+            continue;
+        }
+
+        unsigned int low = data[ e ] & LOW_BITS;
+        unsigned int high = ( data[ e ] >> 1 ) & LOW_BITS;
+        unsigned int geno[ 3 ] = { ~( low | high ) & LOW_BITS, low & ~high, high & ~low };
+        for(int g = 0; g < 3; g++)
+        {
+            counts[ g ][ 0 ] += count_bits( geno[ g ] & controls );
+            counts[ g ][ 1 ] += count_bits( geno[ g ] & cases );
+        }
+    }
+}
+
+/**
+ * Converts the counts of all pairs of genotypes, including missing,
+ * to the joint table of the non-missing genotypes.
+ *
+ * @param counts The number of controls and cases for each pair of genotypes.
+ *
+ * @return Counts for each genotype as a 9x2 matrix, see joint_count.
+ */
+static arma::mat
+joint_table(const unsigned int counts[ 4 ][ 4 ][ 2 ])
 {
-    arma::mat counts = zeros<mat>( 9, 3 );
-    for(int i = 0; i < row1.size( ); i++)
+    arma::mat result( 9, 2 );
+    for(int i = 0; i < 3; i++)
     {
-        if( row1[ i ] != 3 && row2[ i ] != 3 )
+        for(int j = 0; j < 3; j++)
         {
-            double pheno = phenotype[ i ];
-            counts( 3 * row1[ i ] + row2[ i ], 0 ) += weight[ i ] * pheno;
-            counts( 3 * row1[ i ] + row2[ i ], 1 ) += weight[ i ] * 1.0;
-            counts( 3 * row1[ i ] + row2[ i ], 2 ) += weight[ i ] * pheno * pheno;
+            result( 3 * i + j, 0 ) = counts[ i ][ j ][ 0 ];
+            result( 3 * i + j, 1 ) = counts[ i ][ j ][ 1 ];
+        }
+    }
+
+    return result;
+}
+
+arma::mat
+marginal_count(const snp_row &row, const phenotype_mask &mask)
+{
+    unsigned int counts[ 3 ][ 2 ];
+    count_masked_genotypes( row, mask, counts );
+
+    arma::mat result( 3, 2 );
+    for(int g = 0; g < 3; g++)
+    {
+        result( g, 0 ) = counts[ g ][ 0 ];
+        result( g, 1 ) = counts[ g ][ 1 ];
+    }
+
+    return result;
+}
+
+/**
+ * Exchanges the first and second snp of a joint table.
+ *
+ * @param count Counts for each genotype as a 9x2 matrix.
+ *
+ * @return The table with the cell 3 * i + j moved to 3 * j + i.
+ */
+static arma::mat
+swap_snps(const arma::mat &count)
+{
+    arma::mat result( 9, 2 );
+    for(int i = 0; i < 3; i++)
+    {
+        for(int j = 0; j < 3; j++)
+        {
+            result( 3 * i + j, 0 ) = count( 3 * j + i, 0 );
+            result( 3 * i + j, 1 ) = count( 3 * j + i, 1 );
+        }
+    }
+
+    return result;
+}
+
+arma::mat
+joint_count(const sparse_row &row1, const snp_row &row2, const phenotype_mask &mask)
+{
+    return joint_count( row1, row2, mask, marginal_count( row2, mask ) );
+}
+
+arma::mat
+joint_count(const sparse_row &row1, const snp_row &row2, const phenotype_mask &mask, const arma::mat &marginal2)
+{
+    unsigned int counts[ 4 ][ 4 ][ 2 ];
+    std::fill( &counts[ 0 ][ 0 ][ 0 ], &counts[ 0 ][ 0 ][ 0 ] + 32, 0 );
+
+    const std::vector<unsigned int> &indices = row1.indices( );
+    const std::vector<unsigned char> &genotypes = row1.genotypes( );
+    for(size_t k = 0; k < indices.size( ); k++)
+    {
+        int pheno = masked_phenotype( mask, indices[ k ] );
+        if( pheno >= 0 )
+        {
+            counts[ genotypes[ k ] ][ row2[ indices[ k ] ] ][ pheno ]++;
+        }
+    }
+
+    /* The remaining samples with each genotype of the second snp are 0 in the first. */
+    for(int j = 0; j < 3; j++)
+    {
+        for(int c = 0; c < 2; c++)
+        {
+            counts[ 0 ][ j ][ c ] = (unsigned int) marginal2( j, c ) - counts[ 1 ][ j ][ c ] - counts[ 2 ][ j ][ c ] - counts[ 3 ][ j ][ c ];
+        }
+    }
+
+    return joint_table( counts );
+}
+
+arma::mat
+joint_count(const snp_row &row1, const sparse_row &row2, const phenotype_mask &mask)
+{
+    return swap_snps( joint_count( row2, row1, mask ) );
+}
+
+arma::mat
+joint_count(const snp_row &row1, const sparse_row &row2, const phenotype_mask &mask, const arma::mat &marginal1)
+{
+    return swap_snps( joint_count( row2, row1, mask, marginal1 ) );
+}
+
+arma::mat
+joint_count(const sparse_row &row1, const sparse_row &row2, const phenotype_mask &mask)
+{
+    unsigned int counts[ 4 ][ 4 ][ 2 ];
+    std::fill( &counts[ 0 ][ 0 ][ 0 ], &counts[ 0 ][ 0 ][ 0 ] + 32, 0 );
+
+    /* Merge the sorted indices, a sample missing from a row has genotype 0 in it. */
+    const std::vector<unsigned int> &indices1 = row1.indices( );
+    const std::vector<unsigned int> &indices2 = row2.indices( );
+    size_t k1 = 0;
+    size_t k2 = 0;
+    while( k1 < indices1.size( ) || k2 < indices2.size( ) )
+    {
+        size_t index;
+        unsigned int snp1 = 0;
+        unsigned int snp2 = 0;
+        if( k2 == indices2.size( ) || ( k1 < indices1.size( ) && indices1[ k1 ] < indices2[ k2 ] ) )
+        {
+            index = indices1[ k1 ];
+            snp1 = row1.genotypes( )[ k1++ ];
+        }
+        else if( k1 == indices1.size( ) || indices2[ k2 ] < indices1[ k1 ] )
+        {
+            index = indices2[ k2 ];
+            snp2 = row2.genotypes( )[ k2++ ];
+        }
+        else
+        {
+            index = indices1[ k1 ];
+            snp1 = row1.genotypes( )[ k1++ ];
+            snp2 = row2.genotypes( )[ k2++ ];
+        }
+
+        int pheno = masked_phenotype( mask, index );
+        if( pheno >= 0 )
+        {
+            counts[ snp1 ][ snp2 ][ pheno ]++;
+        }
+    }
+
+    /* All other samples are 0 in both snps. */
+    counts[ 0 ][ 0 ][ 0 ] = mask.num_controls;
+    counts[ 0 ][ 0 ][ 1 ] = mask.num_cases;
+    for(int i = 0; i < 4; i++)
+    {
+        for(int j = 0; j < 4; j++)
+        {
+            if( i != 0 || j != 0 )
+            {
+                counts[ 0 ][ 0 ][ 0 ] -= counts[ i ][ j ][ 0 ];
+                counts[ 0 ][ 0 ][ 1 ] -= counts[ i ][ j ][ 1 ];
+            }
+        }
+    }
+
+    return joint_table( counts );
+}
+
+arma::mat
+joint_count_phenotypes(const snp_row &row1, const snp_row &row2, const arma::mat &phenotypes, const arma::mat &weights)
+{
+    size_t num_phenotypes = phenotypes.n_rows;
+    weighted_phenotype_moments moments( phenotypes, weights );
+    accumulate_cells( row1, row2, moments );
+
+    arma::mat counts( 9, 3 * num_phenotypes );
+    for(size_t p = 0; p < num_phenotypes; p++)
+    {
+        for(int i = 0; i < 9; i++)
+        {
+            for(int j = 0; j < 3; j++)
+            {
+                counts( i, 3 * p + j ) = moments.sums[ 3 * num_phenotypes * i + j * num_phenotypes + p ];
+            }
         }
     }
 
@@ -39,14 +718,13 @@ joint_count_cont(const snp_row &row1, const snp_row &row2, const arma::vec &phen
 arma::vec
 joint_count(const snp_row &row1, const snp_row &row2)
 {
-    arma::vec counts = zeros<vec>( 9 );
-    for(int i = 0; i < row1.size( ); i++)
+    cell_count count;
+    accumulate_cells( row1, row2, count );
+
+    arma::vec counts( 9 );
+    for(int i = 0; i < 9; i++)
     {
-        if( row1[ i ] != 3 && row2[ i ] != 3 )
-        {
-            /* XXX: Should we have a weight here? */
-            counts[ 3 * row1[ i ] + row2[ i ] ] += 1.0;
-        }
+        counts[ i ] = count.sums[ i ];
     }
 
     return counts;
@@ -55,14 +733,14 @@ joint_count(const snp_row &row1, const snp_row &row2)
 arma::vec
 pheno_count(const snp_row &row1, const snp_row &row2, const arma::vec &phenotype, const arma::vec &weight)
 {
+    weighted_count count( phenotype, weight );
+    accumulate_cells( row1, row2, count );
+
     arma::vec counts = zeros<vec>( 2 );
-    for(int i = 0; i < row1.size( ); i++)
+    for(int i = 0; i < 9; i++)
     {
-        if( row1[ i ] != 3 && row2[ i ] != 3 )
-        {
-            unsigned int pheno = (unsigned int) phenotype[ i ];
-            counts[ pheno ] += weight[ i ];
-        }
+        counts[ 0 ] += count.sums[ i ][ 0 ];
+        counts[ 1 ] += count.sums[ i ][ 1 ];
     }
 
     return counts;
@@ -71,14 +749,14 @@ pheno_count(const snp_row &row1, const snp_row &row2, const arma::vec &phenotype
 arma::mat
 single_count(const snp_row &row1, const snp_row &row2, const arma::vec &phenotype, const arma::vec &weight)
 {
+    weighted_count count( phenotype, weight );
+    accumulate_cells( row1, row2, count );
+
     arma::mat counts = zeros<mat>( 3, 2 );
-    for(int i = 0; i < row1.size( ); i++)
+    for(int i = 0; i < 9; i++)
     {
-        if( row1[ i ] != 3 && row2[ i ] != 3 )
-        {
-            unsigned int pheno = (unsigned int) phenotype[ i ];
-            counts( row1[ i ], pheno ) += weight[ i ];
-        }
+        counts( i / 3, 0 ) += count.sums[ i ][ 0 ];
+        counts( i / 3, 1 ) += count.sums[ i ][ 1 ];
     }
 
     return counts;
@@ -100,27 +778,7 @@ compute_maf(const snp_row &row)
 float
 compute_real_maf(const snp_row &row)
 {
-    unsigned int n = 0;
-    float dose = 0.0;
-
-    for(int i = 0; i < row.size( ); i++)
-    {
-        if( row[ i ] != 3 )
-        {
-            dose += row[ i ];
-            n += 1;
-        }
-    }
-
-    if( n != 0 )
-    {
-        float maf = dose / ( 2 * n );
-        return std::min( maf, 1 - maf );
-    }
-    else
-    {
-        return 0.0;
-    }
+    return summarize_snp( row ).maf;
 }
 
 double
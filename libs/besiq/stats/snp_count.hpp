@@ -1,9 +1,55 @@
 #ifndef __SNP_COUNT_H__
 #define __SNP_COUNT_H__
 
+#include <vector>
+
 #include <armadillo>
 
 #include <plink/snp_row.hpp>
+#include <plink/sparse_row.hpp>
+
+/**
+ * The rows of the two snps of a pair.
+ */
+typedef std::pair<const snp_row *, const snp_row *> snp_row_pair;
+
+/**
+ * Smallest number of samples that each thread counts when the
+ * samples of a pair are split between threads, fewer samples are
+ * not worth the cost of starting the threads.
+ */
+const size_t COUNT_SAMPLES_PER_THREAD = 65536;
+
+/**
+ * Sets the number of threads that may count pairs. When there are at
+ * least COUNT_SAMPLES_PER_THREAD samples for each thread the samples
+ * of a single pair are split between them, otherwise the threads count
+ * different pairs when many pairs are counted at once.
+ *
+ * @param num_threads The maximum number of threads.
+ */
+void set_count_threads(int num_threads);
+
+/**
+ * Returns the number of threads that count the samples of a pair.
+ *
+ * @param num_samples The number of samples.
+ *
+ * @return The number of threads, at least 1.
+ */
+int get_count_threads(size_t num_samples);
+
+/**
+ * Returns the number of threads that count different pairs at the
+ * same time. Only one pair is counted at a time when the samples of
+ * a pair are split between threads, see get_count_threads.
+ *
+ * @param num_samples The number of samples.
+ * @param num_pairs The number of pairs that are counted.
+ *
+ * @return The number of threads, at least 1.
+ */
+int get_pair_threads(size_t num_samples, size_t num_pairs);
 
 /**
  * Counts the number of cases and controls with each genotype. The
@@ -21,6 +67,19 @@
  */
 arma::mat joint_count(const snp_row &row1, const snp_row &row2, const arma::vec &phenotype, const arma::vec &weight);
 
+/**
+ * Counts the number of cases and controls with each genotype for
+ * many pairs, see the version for a single pair. The pairs or the
+ * samples of each pair are split between threads, see get_pair_threads.
+ *
+ * @param pairs The pairs of snps.
+ * @param phenotype The phenotype 0.0 or 1.0.
+ * @param weight The weight of each individual.
+ *
+ * @return The 9x2 matrix of each pair.
+ */
+std::vector<arma::mat> joint_count(const std::vector<snp_row_pair> &pairs, const arma::vec &phenotype, const arma::vec &weight);
+
 /**
  * Aggregates the phenotype for each genotype. The
  * counts are based on the weight, so an individual with weight 0.5 will
@@ -29,7 +88,8 @@ arma::mat joint_count(const snp_row &row1, const snp_row &row2, const arma::vec
  * @param row1 The first snp.
  * @param row2 The second snp.
  * @param phenotype The phenotype 0.0 or 1.0.
- * @param weight The weight of each individual.
+ * @param weight The weight of each individual, individuals with weight 0
+ *               are skipped.
  * 
  * @return Counts for each genotype. They are represented as a 9x3 matrix,
  *         so that each row is a cell ordered from left to right and top to bottom,
@@ -37,6 +97,170 @@ arma::mat joint_count(const snp_row &row1, const snp_row &row2, const arma::vec
  */
 arma::mat joint_count_cont(const snp_row &row1, const snp_row &row2, const arma::vec &phenotype, const arma::vec &weight);
 
+/**
+ * Aggregates the phenotype for each genotype for many pairs, see
+ * the version for a single pair. The pairs or the samples of each
+ * pair are split between threads, see get_pair_threads.
+ *
+ * @param pairs The pairs of snps.
+ * @param phenotype The phenotype.
+ * @param weight The weight of each individual, individuals with weight 0
+ *               are skipped.
+ *
+ * @return The 9x3 matrix of each pair.
+ */
+std::vector<arma::mat> joint_count_cont(const std::vector<snp_row_pair> &pairs, const arma::vec &phenotype, const arma::vec &weight);
+
+/**
+ * Aggregates many phenotypes of the same samples for each genotype,
+ * the genotypes are only decoded once for all phenotypes.
+ *
+ * @param row1 The first snp.
+ * @param row2 The second snp.
+ * @param phenotypes The phenotypes as a P x N matrix, so that column i
+ *                   holds all phenotypes of sample i, i.e. the transpose
+ *                   of a sample by phenotype matrix.
+ * @param weights The weight of each phenotype and individual as a P x N
+ *                matrix, a missing value has weight 0 and must still
+ *                be a finite number in phenotypes, e.g. 0.
+ *
+ * @return A 9x3P matrix, where columns 3p to 3p + 2 are the 9x3 matrix
+ *         of joint_count_cont for phenotype p.
+ */
+arma::mat joint_count_phenotypes(const snp_row &row1, const snp_row &row2, const arma::mat &phenotypes, const arma::mat &weights);
+
+/**
+ * Selects the controls and the cases among the packed genotypes of
+ * a snp_row, so that the samples of each phenotype can be counted
+ * a word at a time. Each sample has one bit, at the position of the
+ * low bit of its genotype.
+ */
+struct phenotype_mask
+{
+    /**
+     * Non-missing samples with phenotype 0.
+     */
+    std::vector<unsigned int> controls;
+
+    /**
+     * Non-missing samples with phenotype 1.
+     */
+    std::vector<unsigned int> cases;
+
+    /**
+     * Number of non-missing samples with phenotype 0.
+     */
+    unsigned int num_controls;
+
+    /**
+     * Number of non-missing samples with phenotype 1.
+     */
+    unsigned int num_cases;
+};
+
+/**
+ * Creates the masks of the controls and the cases.
+ *
+ * @param phenotype The phenotype 0.0 or 1.0, other values are ignored.
+ * @param missing Missing samples are indicated by non-zero values.
+ *
+ * @return The masks.
+ */
+phenotype_mask make_phenotype_mask(const arma::vec &phenotype, const arma::uvec &missing);
+
+/**
+ * Counts the number of cases and controls with each genotype, in
+ * the same way as joint_count with unit weights. The genotypes are
+ * compared 16 samples at a time, and words without any selected
+ * sample are skipped.
+ *
+ * @param row1 The first snp.
+ * @param row2 The second snp.
+ * @param mask The samples to count, see make_phenotype_mask.
+ *
+ * @return Counts for each genotype as a 9x2 matrix, see joint_count.
+ */
+arma::mat joint_count(const snp_row &row1, const snp_row &row2, const phenotype_mask &mask);
+
+/**
+ * Counts the number of cases and controls with each genotype when
+ * the first snp is rare. Only the samples stored in the sparse row
+ * are visited, and the cells where the first snp is 0 are derived
+ * by subtracting them from the counts of the second snp.
+ *
+ * @param row1 The first snp.
+ * @param row2 The second snp.
+ * @param mask The samples to count, see make_phenotype_mask.
+ *
+ * @return Counts for each genotype as a 9x2 matrix, see joint_count.
+ */
+arma::mat joint_count(const sparse_row &row1, const snp_row &row2, const phenotype_mask &mask);
+
+/**
+ * Counts the number of cases and controls with each genotype of a
+ * single snp, a word at a time.
+ *
+ * @param row The snp.
+ * @param mask The samples to count, see make_phenotype_mask.
+ *
+ * @return Counts for each genotype as a 3x2 matrix of controls and
+ *         cases, missing genotypes are not counted.
+ */
+arma::mat marginal_count(const snp_row &row, const phenotype_mask &mask);
+
+/**
+ * Counts the number of cases and controls with each genotype when
+ * the first snp is rare, and the counts of the second snp are known.
+ * Only the samples stored in the sparse row are visited.
+ *
+ * @param row1 The first snp.
+ * @param row2 The second snp.
+ * @param mask The samples to count, see make_phenotype_mask.
+ * @param marginal2 The counts of the second snp, see marginal_count.
+ *
+ * @return Counts for each genotype as a 9x2 matrix, see joint_count.
+ */
+arma::mat joint_count(const sparse_row &row1, const snp_row &row2, const phenotype_mask &mask, const arma::mat &marginal2);
+
+/**
+ * Counts the number of cases and controls with each genotype when
+ * the second snp is rare, see the sparse_row and snp_row version.
+ *
+ * @param row1 The first snp.
+ * @param row2 The second snp.
+ * @param mask The samples to count, see make_phenotype_mask.
+ *
+ * @return Counts for each genotype as a 9x2 matrix, see joint_count.
+ */
+arma::mat joint_count(const snp_row &row1, const sparse_row &row2, const phenotype_mask &mask);
+
+/**
+ * Counts the number of cases and controls with each genotype when
+ * the second snp is rare, and the counts of the first snp are known.
+ *
+ * @param row1 The first snp.
+ * @param row2 The second snp.
+ * @param mask The samples to count, see make_phenotype_mask.
+ * @param marginal1 The counts of the first snp, see marginal_count.
+ *
+ * @return Counts for each genotype as a 9x2 matrix, see joint_count.
+ */
+arma::mat joint_count(const snp_row &row1, const sparse_row &row2, const phenotype_mask &mask, const arma::mat &marginal1);
+
+/**
+ * Counts the number of cases and controls with each genotype when
+ * both snps are rare. Only the samples stored in either row are
+ * visited, and the cell where both snps are 0 is derived by
+ * subtracting all other cells from the number of samples.
+ *
+ * @param row1 The first snp.
+ * @param row2 The second snp.
+ * @param mask The samples to count, see make_phenotype_mask.
+ *
+ * @return Counts for each genotype as a 9x2 matrix, see joint_count.
+ */
+arma::mat joint_count(const sparse_row &row1, const sparse_row &row2, const phenotype_mask &mask);
+
 /**
  * Counts the number of individuals with each genotype.
  *
@@ -0,0 +1,201 @@
+#include <algorithm>
+#include <sstream>
+
+#include <plink/bed_cache.hpp>
+
+bed_cache::bed_cache(size_t mem_budget)
+    : m_mem_budget( mem_budget ),
+      m_block_size( 1 ),
+      m_max_blocks( 3 ),
+      m_max_prefetch( 1 ),
+      m_stop( false ),
+      m_started( false )
+{
+    pthread_mutex_init( &m_mutex, NULL );
+    pthread_cond_init( &m_has_request, NULL );
+    pthread_cond_init( &m_has_ready, NULL );
+}
+
+bed_cache::~bed_cache()
+{
+    if( m_started )
+    {
+        pthread_mutex_lock( &m_mutex );
+        m_stop = true;
+        pthread_cond_signal( &m_has_request );
+        pthread_mutex_unlock( &m_mutex );
+
+        pthread_join( m_thread, NULL );
+    }
+
+    for(std::map<size_t, std::vector<snp_row> *>::iterator it = m_ready.begin( ); it != m_ready.end( ); ++it)
+    {
+        delete it->second;
+    }
+
+    pthread_cond_destroy( &m_has_ready );
+    pthread_cond_destroy( &m_has_request );
+    pthread_mutex_destroy( &m_mutex );
+}
+
+bool
+bed_cache::open(const std::string &path, size_t num_samples, size_t num_snps, bool mafflip)
+{
+    if( m_started || !m_reader.open( path, num_samples, num_snps, mafflip ) )
+    {
+        return false;
+    }
+
+    /* Use smaller blocks if the budget would hold only a few of them. */
+    size_t row_bytes = snp_row::num_elements( num_samples ) * sizeof( unsigned int ) + sizeof( snp_row );
+    size_t block_bytes = std::min( (size_t) BED_CACHE_BLOCK_BYTES, m_mem_budget / 8 );
+    m_block_size = std::max( block_bytes / row_bytes, (size_t) 1 );
+
+    /* A quarter of the budget is used for blocks decoded ahead of time. */
+    size_t num_blocks = std::max( m_mem_budget / ( m_block_size * row_bytes ), (size_t) 4 );
+    m_max_prefetch = num_blocks / 4;
+    m_max_blocks = num_blocks - m_max_prefetch;
+
+    if( pthread_create( &m_thread, NULL, &bed_cache::prefetch_main, this ) != 0 )
+    {
+        return false;
+    }
+    m_started = true;
+
+    return true;
+}
+
+bool
+bed_cache::has_rows() const
+{
+    return true;
+}
+
+snp_row *
+bed_cache::get_row(size_t index)
+{
+    size_t id = index / m_block_size;
+    std::map<size_t, std::list<block>::iterator>::iterator it = m_blocks.find( id );
+    if( it != m_blocks.end( ) )
+    {
+        m_lru.splice( m_lru.begin( ), m_lru, it->second );
+        return &it->second->rows[ index - id * m_block_size ];
+    }
+
+    m_lru.push_front( block( ) );
+    m_lru.front( ).id = id;
+
+    /* Wait for the prefetch thread if it has been asked for the block. */
+    std::vector<snp_row> *ready = NULL;
+    pthread_mutex_lock( &m_mutex );
+    if( m_pending.count( id ) > 0 )
+    {
+        while( m_ready.count( id ) == 0 )
+        {
+            pthread_cond_wait( &m_has_ready, &m_mutex );
+        }
+        ready = m_ready[ id ];
+        m_ready.erase( id );
+        m_pending.erase( id );
+    }
+    pthread_mutex_unlock( &m_mutex );
+
+    if( ready != NULL )
+    {
+        m_lru.front( ).rows.swap( *ready );
+        delete ready;
+    }
+    else if( !load_block( id, m_lru.front( ).rows ) )
+    {
+        m_lru.pop_front( );
+
+        std::ostringstream message;
+        message << "Could not read genotypes of snp " << index << " from the .bed file.";
+        throw plink_error( message.str( ) );
+    }
+    m_blocks[ id ] = m_lru.begin( );
+
+    while( m_lru.size( ) > m_max_blocks )
+    {
+        m_blocks.erase( m_lru.back( ).id );
+        m_lru.pop_back( );
+    }
+
+    return &m_lru.front( ).rows[ index - id * m_block_size ];
+}
+
+void
+bed_cache::prefetch(size_t index)
+{
+    size_t id = index / m_block_size;
+    if( !m_started || index >= m_reader.num_snps( ) || m_blocks.count( id ) > 0 )
+    {
+        return;
+    }
+
+    /* Hints beyond the prefetch budget are dropped, the block is then decoded when used. */
+    pthread_mutex_lock( &m_mutex );
+    if( m_pending.count( id ) == 0 && m_pending.size( ) < m_max_prefetch )
+    {
+        m_pending.insert( id );
+        m_requests.push_back( id );
+        pthread_cond_signal( &m_has_request );
+    }
+    pthread_mutex_unlock( &m_mutex );
+}
+
+bool
+bed_cache::load_block(size_t id, std::vector<snp_row> &rows) const
+{
+    size_t start = id * m_block_size;
+    size_t end = std::min( start + m_block_size, m_reader.num_snps( ) );
+
+    rows.resize( end - start );
+    for(size_t i = start; i < end; i++)
+    {
+        if( !m_reader.read_row( i, rows[ i - start ] ) )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void *
+bed_cache::prefetch_main(void *arg)
+{
+    bed_cache *cache = (bed_cache *) arg;
+
+    pthread_mutex_lock( &cache->m_mutex );
+    while( true )
+    {
+        while( cache->m_requests.empty( ) && !cache->m_stop )
+        {
+            pthread_cond_wait( &cache->m_has_request, &cache->m_mutex );
+        }
+
+        if( cache->m_stop )
+        {
+            break;
+        }
+
+        size_t id = cache->m_requests.front( );
+        cache->m_requests.pop_front( );
+        pthread_mutex_unlock( &cache->m_mutex );
+
+        std::vector<snp_row> *rows = new std::vector<snp_row>( );
+        if( !cache->load_block( id, *rows ) )
+        {
+            delete rows;
+            rows = NULL;
+        }
+
+        pthread_mutex_lock( &cache->m_mutex );
+        cache->m_ready[ id ] = rows;
+        pthread_cond_broadcast( &cache->m_has_ready );
+    }
+    pthread_mutex_unlock( &cache->m_mutex );
+
+    return NULL;
+}
@@ -0,0 +1,183 @@
+#ifndef __BED_CACHE_H__
+#define __BED_CACHE_H__
+
+#include <deque>
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+
+#include <plink/bed_reader.hpp>
+#include <plink/plink_file.hpp>
+
+/**
+ * Target number of bytes of decoded genotypes in each block.
+ */
+#define BED_CACHE_BLOCK_BYTES ( 1024 * 1024 )
+
+/**
+ * Keeps a bounded number of blocks of consecutive rows of a .bed
+ * file in memory, and decodes other blocks on demand. The least
+ * recently used block is dropped when the memory budget is reached.
+ *
+ * Blocks that are hinted with prefetch are decoded by a separate
+ * thread, so that the analysis does not wait for the disk when the
+ * rows are requested in roughly the same order as they are hinted.
+ *
+ * Only a single thread may call get_row and prefetch.
+ */
+class bed_cache
+: public genotype_storage
+{
+public:
+    /**
+     * Constructor.
+     *
+     * @param mem_budget Number of bytes of decoded genotypes to keep,
+     *                   at least four blocks are always kept.
+     */
+    bed_cache(size_t mem_budget);
+
+    /**
+     * Destructor, stops the prefetch thread.
+     */
+    ~bed_cache();
+
+    /**
+     * Opens a .bed file and starts the prefetch thread.
+     *
+     * @param path Path to the .bed file.
+     * @param num_samples Number of samples in the .fam file.
+     * @param num_snps Number of snps in the .bim file.
+     * @param mafflip If true, rows are flipped so that the minor allele is 2.
+     *
+     * @return True if the file could be opened, false otherwise.
+     */
+    bool open(const std::string &path, size_t num_samples, size_t num_snps, bool mafflip);
+
+    bool has_rows() const;
+
+    /**
+     * Returns a row, a row stays valid until rows from at least
+     * two other blocks have been requested.
+     *
+     * @throws plink_error if the row could not be read.
+     */
+    snp_row *get_row(size_t index);
+
+    void prefetch(size_t index);
+
+private:
+    /**
+     * Decoded rows of a block.
+     */
+    struct block
+    {
+        size_t id;
+        std::vector<snp_row> rows;
+    };
+
+    /**
+     * Decodes all rows of a block.
+     *
+     * @param id Index of the block.
+     * @param rows The rows will be stored here.
+     *
+     * @return True if the block could be read, false otherwise.
+     */
+    bool load_block(size_t id, std::vector<snp_row> &rows) const;
+
+    /**
+     * Main loop of the prefetch thread.
+     *
+     * @param arg Pointer to the bed_cache.
+     */
+    static void *prefetch_main(void *arg);
+
+    /**
+     * The .bed file.
+     */
+    bed_reader m_reader;
+
+    /**
+     * Number of bytes of decoded genotypes to keep.
+     */
+    size_t m_mem_budget;
+
+    /**
+     * Number of rows in each block.
+     */
+    size_t m_block_size;
+
+    /**
+     * Maximum number of blocks in m_lru.
+     */
+    size_t m_max_blocks;
+
+    /**
+     * Maximum number of blocks that are requested or decoded
+     * by the prefetch thread but not yet used.
+     */
+    size_t m_max_prefetch;
+
+    /**
+     * Blocks in use, the most recently used first.
+     */
+    std::list<block> m_lru;
+
+    /**
+     * Maps a block index to its position in m_lru.
+     */
+    std::map<size_t, std::list<block>::iterator> m_blocks;
+
+    /**
+     * Blocks that the prefetch thread should decode.
+     */
+    std::deque<size_t> m_requests;
+
+    /**
+     * Blocks that have been requested and not yet moved to m_lru.
+     */
+    std::set<size_t> m_pending;
+
+    /**
+     * Blocks that the prefetch thread has decoded, NULL if the
+     * block could not be read.
+     */
+    std::map<size_t, std::vector<snp_row> *> m_ready;
+
+    /**
+     * Set when the prefetch thread should exit.
+     */
+    bool m_stop;
+
+    /**
+     * True if the prefetch thread is running.
+     */
+    bool m_started;
+
+    /**
+     * Protects the requests, pending and ready blocks.
+     */
+    pthread_mutex_t m_mutex;
+
+    /**
+     * Signaled when a block has been requested.
+     */
+    pthread_cond_t m_has_request;
+
+    /**
+     * Signaled when a block has been decoded.
+     */
+    pthread_cond_t m_has_ready;
+
+    /**
+     * The prefetch thread.
+     */
+    pthread_t m_thread;
+};
+
+#endif /* End of __BED_CACHE_H__ */
@@ -0,0 +1,185 @@
+#include <vector>
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <plink/bed_reader.hpp>
+
+/**
+ * Size of the .bed header.
+ */
+#define BED_HEADER_SIZE 3
+
+/**
+ * Lookup tables that decode four genotypes, i.e. one byte of
+ * the .bed file, at a time.
+ */
+struct bed_tables
+{
+    bed_tables()
+    {
+        /* Plink codes: 00 homozygous, 01 missing, 10 heterozygous, 11 homozygous. */
+        const unsigned char decode_snp[ 4 ] = { 0, 3, 1, 2 };
+        const unsigned char flip_snp[ 4 ] = { 2, 1, 0, 3 };
+
+        for(int i = 0; i < 256; i++)
+        {
+            decode[ i ] = 0;
+            flip[ i ] = 0;
+            dosage[ i ] = 0;
+            called[ i ] = 0;
+            for(int j = 0; j < 4; j++)
+            {
+                unsigned char snp = decode_snp[ ( i >> ( 2 * j ) ) & 3 ];
+                decode[ i ] |= snp << ( 2 * j );
+                flip[ i ] |= flip_snp[ ( i >> ( 2 * j ) ) & 3 ] << ( 2 * j );
+                if( snp != 3 )
+                {
+                    dosage[ i ] += snp;
+                    called[ i ]++;
+                }
+            }
+        }
+    }
+
+    /* Maps a .bed byte to four genotypes in the snp_row layout. */
+    unsigned char decode[ 256 ];
+
+    /* Flips four decoded genotypes, missing genotypes are kept. */
+    unsigned char flip[ 256 ];
+
+    /* Sum of the non-missing genotypes of a .bed byte. */
+    unsigned char dosage[ 256 ];
+
+    /* Number of non-missing genotypes of a .bed byte. */
+    unsigned char called[ 256 ];
+};
+
+static const bed_tables g_bed_tables;
+
+bed_reader::bed_reader()
+    : m_fd( -1 ),
+      m_num_samples( 0 ),
+      m_num_snps( 0 ),
+      m_row_bytes( 0 ),
+      m_mafflip( false )
+{
+}
+
+bed_reader::~bed_reader()
+{
+    if( m_fd != -1 )
+    {
+        close( m_fd );
+    }
+}
+
+bool
+bed_reader::open(const std::string &path, size_t num_samples, size_t num_snps, bool mafflip)
+{
+    int fd = ::open( path.c_str( ), O_RDONLY );
+    if( fd == -1 )
+    {
+        return false;
+    }
+
+    /* Only the snp-major format has fixed size rows that are stored in order. */
+    unsigned char header[ BED_HEADER_SIZE ];
+    size_t row_bytes = ( num_samples + 3 ) / 4;
+    struct stat st;
+    if( pread( fd, header, BED_HEADER_SIZE, 0 ) != BED_HEADER_SIZE ||
+        header[ 0 ] != 0x6c || header[ 1 ] != 0x1b || header[ 2 ] != 0x01 ||
+        fstat( fd, &st ) != 0 ||
+        (uint64_t) st.st_size < BED_HEADER_SIZE + (uint64_t) row_bytes * num_snps )
+    {
+        close( fd );
+        return false;
+    }
+
+    if( m_fd != -1 )
+    {
+        close( m_fd );
+    }
+    m_fd = fd;
+    m_num_samples = num_samples;
+    m_num_snps = num_snps;
+    m_row_bytes = row_bytes;
+    m_mafflip = mafflip;
+
+    return true;
+}
+
+bool
+bed_reader::read_row(size_t index, snp_row &row) const
+{
+    if( m_fd == -1 || index >= m_num_snps )
+    {
+        return false;
+    }
+
+    size_t num_elements = snp_row::num_elements( m_num_samples );
+    std::vector<unsigned char> packed( num_elements * sizeof( unsigned int ), 0 );
+    off_t offset = BED_HEADER_SIZE + (off_t) index * m_row_bytes;
+    if( m_row_bytes > 0 && pread( m_fd, &packed[ 0 ], m_row_bytes, offset ) != (ssize_t) m_row_bytes )
+    {
+        return false;
+    }
+
+    /* Padding in the last byte can have any value, replace it with the missing code. */
+    size_t num_padding = m_row_bytes * 4 - m_num_samples;
+    if( num_padding > 0 )
+    {
+        unsigned char padding_mask = ( 0xff << ( 2 * ( 4 - num_padding ) ) ) & 0xff;
+        packed[ m_row_bytes - 1 ] = ( packed[ m_row_bytes - 1 ] & ~padding_mask ) | ( 0x55 & padding_mask );
+    }
+
+    unsigned int dosage = 0;
+    unsigned int called = 0;
+    for(size_t i = 0; i < m_row_bytes; i++)
+    {
+        dosage += g_bed_tables.dosage[ packed[ i ] ];
+        called += g_bed_tables.called[ packed[ i ] ];
+        packed[ i ] = g_bed_tables.decode[ packed[ i ] ];
+    }
+
+    bool flip = m_mafflip && ( (float) dosage ) / ( 2 * called ) > 0.5;
+    if( flip )
+    {
+        for(size_t i = 0; i < m_row_bytes; i++)
+        {
+            packed[ i ] = g_bed_tables.flip[ packed[ i ] ];
+        }
+    }
+
+    row.resize( m_num_samples );
+    unsigned int *genotypes = row.mutable_data( );
+    for(size_t i = 0; i < num_elements; i++)
+    {
+        const unsigned char *bytes = &packed[ i * sizeof( unsigned int ) ];
+        genotypes[ i ] = bytes[ 0 ] | ( bytes[ 1 ] << 8 ) | ( bytes[ 2 ] << 16 ) | ( (unsigned int) bytes[ 3 ] << 24 );
+    }
+
+    /* Bits after the last genotype are zero in all rows. */
+    size_t num_last = m_num_samples % 16;
+    if( num_last > 0 )
+    {
+        genotypes[ num_elements - 1 ] &= ( 1u << ( 2 * num_last ) ) - 1;
+    }
+
+    return true;
+}
+
+size_t
+bed_reader::num_snps() const
+{
+    return m_num_snps;
+}
+
+size_t
+bed_reader::num_samples() const
+{
+    return m_num_samples;
+}
@@ -0,0 +1,99 @@
+#ifndef __BED_READER_H__
+#define __BED_READER_H__
+
+#include <string>
+
+#include <plink/snp_row.hpp>
+
+/**
+ * Reads rows of a snp-major .bed file directly, so that any
+ * row can be read without decoding the rows before it. Rows
+ * are decoded in the same way as libplinkio, optionally coded
+ * according to the minor allele.
+ *
+ * Rows may be read from several threads at the same time.
+ */
+class bed_reader
+{
+public:
+    /**
+     * Constructor.
+     */
+    bed_reader();
+
+    /**
+     * Destructor, closes the file.
+     */
+    ~bed_reader();
+
+    /**
+     * Opens a .bed file.
+     *
+     * @param path Path to the .bed file.
+     * @param num_samples Number of samples in the .fam file.
+     * @param num_snps Number of snps in the .bim file.
+     * @param mafflip If true, rows are flipped so that the minor allele is 2.
+     *
+     * @return True if the file is a snp-major .bed file with the
+     *         given dimensions, false otherwise.
+     */
+    bool open(const std::string &path, size_t num_samples, size_t num_snps, bool mafflip);
+
+    /**
+     * Reads and decodes a row.
+     *
+     * @param index Index of the snp.
+     * @param row The genotypes will be stored here.
+     *
+     * @return True if the row could be read, false otherwise.
+     */
+    bool read_row(size_t index, snp_row &row) const;
+
+    /**
+     * Returns the number of snps.
+     *
+     * @return The number of snps.
+     */
+    size_t num_snps() const;
+
+    /**
+     * Returns the number of samples.
+     *
+     * @return The number of samples.
+     */
+    size_t num_samples() const;
+
+private:
+    /**
+     * Not copyable, since it owns the file.
+     */
+    bed_reader(const bed_reader &other);
+    bed_reader &operator=(const bed_reader &other);
+
+    /**
+     * File descriptor of the .bed file, -1 if not open.
+     */
+    int m_fd;
+
+    /**
+     * Number of samples.
+     */
+    size_t m_num_samples;
+
+    /**
+     * Number of snps.
+     */
+    size_t m_num_snps;
+
+    /**
+     * Number of bytes of each row in the file.
+     */
+    size_t m_row_bytes;
+
+    /**
+     * If true, rows are flipped so that the minor allele is 2.
+     */
+    bool m_mafflip;
+};
+
+#endif /* End of __BED_READER_H__ */
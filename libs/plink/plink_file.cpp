@@ -1,3 +1,5 @@
+#include <plink/bed_cache.hpp>
+#include <plink/bed_reader.hpp>
 #include <plink/plink_file.hpp>
 
 plink_file::plink_file(const pio_file_t &file, const std::vector<pio_sample_t> &samples, const std::vector<pio_locus_t> &loci, bool mafflip)
@@ -73,24 +75,6 @@ float compute_maf(snp_t *row, size_t length)
     return ((float) mac) / ( 2 * total );
 }
 
-float compute_real_maf(snp_row &row)
-{
-    int mac = 0;
-    int total = 0;
-    for(int i = 0; i < row.size( ); i++)
-    {
-        if( row[ i ] != 3 )
-        {
-            mac += row[ i ];
-            total++;
-        }
-    }
-
-    float maf = ((float) mac) / ( 2 * total );
-
-    return std::min( maf, 1 - maf );
-}
-
 bool
 plink_file::next_row(snp_row &row)
 {
@@ -158,13 +142,15 @@ genotype_matrix_ptr
 create_genotype_matrix(plink_file_ptr genotype_file)
 {
     shared_ptr< std::vector<snp_row> > genotypes( new std::vector<snp_row>( ) );
+    std::vector<snp_summary> summaries;
     snp_row row;
     while( genotype_file->next_row( row ) )
     {
         genotypes->push_back( row );
+        summaries.push_back( summarize_snp( row ) );
     }
 
-    return genotype_matrix_ptr( new genotype_matrix( genotypes, genotype_file->get_locus_names( ) ) );
+    return genotype_matrix_ptr( new genotype_matrix( genotypes, genotype_file->get_locus_names( ), &summaries ) );
 }
 
 genotype_matrix_ptr
@@ -172,59 +158,342 @@ create_filtered_genotype_matrix(plink_file_ptr genotype_file, float maf_threshol
 {
     shared_ptr< std::vector<snp_row> > genotypes( new std::vector<snp_row>( ) );
     std::vector<std::string> locus_names;
+    std::vector<snp_summary> summaries;
     snp_row row;
     int i = 0;
     while( genotype_file->next_row( row ) )
     {
-        float maf = compute_real_maf( row );
-        if( maf >= maf_threshold )
+        snp_summary summary = summarize_snp( row );
+        if( summary.maf >= maf_threshold )
         {
             genotypes->push_back( row );
             locus_names.push_back( genotype_file->get_loci( )[ i ].name );
+            summaries.push_back( summary );
         }
         i++;
     }
 
+    return genotype_matrix_ptr( new genotype_matrix( genotypes, locus_names, &summaries ) );
+}
+
+/**
+ * Returns true if two rows contain the same genotypes.
+ *
+ * @param a A row.
+ * @param b Another row.
+ *
+ * @return True if the rows contain the same genotypes.
+ */
+static bool
+same_genotypes(const snp_row &a, const snp_row &b)
+{
+    if( a.size( ) != b.size( ) )
+    {
+        return false;
+    }
+
+    for(size_t i = 0; i < a.size( ); i++)
+    {
+        if( a[ i ] != b[ i ] )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+genotype_matrix_ptr
+create_on_demand_genotype_matrix(const std::string &plink_prefix, plink_file_ptr genotype_file, bool mafflip, size_t mem_budget)
+{
+    size_t num_samples = genotype_file->get_samples( ).size( );
+    size_t num_snps = genotype_file->get_loci( ).size( );
+    shared_ptr<bed_cache> cache( new bed_cache( mem_budget ) );
+    if( !cache->open( plink_prefix + ".bed", num_samples, num_snps, mafflip ) )
+    {
+        return genotype_matrix_ptr( );
+    }
+
+    /* Make sure that the rows are decoded exactly as libplinkio does. */
+    snp_row row;
+    if( num_snps > 0 && genotype_file->next_row( row ) && !same_genotypes( row, *cache->get_row( 0 ) ) )
+    {
+        return genotype_matrix_ptr( );
+    }
+
+    shared_ptr< std::vector<snp_row> > no_rows( new std::vector<snp_row>( ) );
+    return genotype_matrix_ptr( new genotype_matrix( no_rows, genotype_file->get_locus_names( ), cache ) );
+}
+
+genotype_matrix_ptr
+create_subset_genotype_matrix(const std::string &plink_prefix, plink_file_ptr genotype_file, bool mafflip, const std::vector<bool> &used)
+{
+    shared_ptr< std::vector<snp_row> > genotypes( new std::vector<snp_row>( ) );
+    std::vector<std::string> locus_names;
+    const std::vector<pio_locus_t> &loci = genotype_file->get_loci( );
+
+    /* Seek to the used rows if the .bed file decodes the same as libplinkio. */
+    snp_row first;
+    snp_row row;
+    bed_reader reader;
+    bool has_first = loci.size( ) > 0 && genotype_file->next_row( first );
+    bool direct = has_first &&
+                  reader.open( plink_prefix + ".bed", genotype_file->get_samples( ).size( ), loci.size( ), mafflip ) &&
+                  reader.read_row( 0, row ) && same_genotypes( first, row );
+
+    for(size_t i = 0; i < loci.size( ); i++)
+    {
+        if( direct && !used[ i ] )
+        {
+            continue;
+        }
+
+        if( direct )
+        {
+            if( !reader.read_row( i, row ) )
+            {
+                throw plink_error( "Could not read genotypes from " + plink_prefix + ".bed" );
+            }
+        }
+        else if( i == 0 && has_first )
+        {
+            row = first;
+        }
+        else if( i == 0 || !genotype_file->next_row( row ) )
+        {
+            break;
+        }
+
+        if( used[ i ] )
+        {
+            genotypes->push_back( row );
+            locus_names.push_back( loci[ i ].name );
+        }
+    }
+
     return genotype_matrix_ptr( new genotype_matrix( genotypes, locus_names ) );
 }
 
-genotype_matrix::genotype_matrix(shared_ptr< std::vector<snp_row> > matrix, const std::vector<std::string> &snp_names) 
+genotype_matrix::genotype_matrix(shared_ptr< std::vector<snp_row> > matrix, const std::vector<std::string> &snp_names, const std::vector<snp_summary> *summaries) 
     : m_matrix( matrix ),
-    m_snp_names( snp_names )
+    m_snp_names( snp_names ),
+    m_storage_summaries( NULL ),
+    m_storage_sparse( NULL ),
+    m_use_storage_index( false ),
+    m_use_storage_rows( false )
 {
     for(int i = 0; i < snp_names.size( ); i++)
     {
         m_snp_to_index[ snp_names[ i ] ] = i;
     }
+
+    if( summaries != NULL )
+    {
+        m_summaries = *summaries;
+    }
+    else
+    {
+        summarize_rows( );
+    }
 }
 
-snp_row const *
-genotype_matrix::get_row(const std::string &name) const
+genotype_matrix::genotype_matrix(shared_ptr< std::vector<snp_row> > matrix, const std::vector<std::string> &snp_names, shared_ptr<genotype_storage> storage)
+    : m_matrix( matrix ),
+    m_snp_names( snp_names ),
+    m_storage_summaries( storage ? storage->get_summaries( ) : NULL ),
+    m_storage_sparse( storage ? storage->get_sparse_flags( ) : NULL ),
+    m_storage( storage ),
+    m_use_storage_index( storage && storage->has_snp_index( ) ),
+    m_use_storage_rows( storage && storage->has_rows( ) )
+{
+    if( m_use_storage_rows )
+    {
+        m_summaries.resize( snp_names.size( ) );
+        m_has_summary.resize( snp_names.size( ), false );
+    }
+    else if( m_storage_summaries == NULL )
+    {
+        summarize_rows( );
+    }
+
+    if( m_use_storage_index )
+    {
+        return;
+    }
+
+    for(int i = 0; i < snp_names.size( ); i++)
+    {
+        m_snp_to_index[ snp_names[ i ] ] = i;
+    }
+}
+
+void
+genotype_matrix::summarize_rows()
 {
+    m_summaries.resize( m_matrix->size( ) );
+    for(size_t i = 0; i < m_matrix->size( ); i++)
+    {
+        m_summaries[ i ] = summarize_snp( (*m_matrix)[ i ] );
+    }
+}
+
+bool
+genotype_matrix::find_index(const std::string &name, size_t *index) const
+{
+    if( m_use_storage_index )
+    {
+        return m_storage->find_snp( name, index );
+    }
+
     std::map<std::string, size_t>::const_iterator it = m_snp_to_index.find( name );
     if( it != m_snp_to_index.end( ) )
     {
-        return &(*m_matrix)[ it->second ];
+        *index = it->second;
+        return true;
+    }
+    else
+    {
+        return false;
+    }
+}
+
+snp_row const *
+genotype_matrix::get_row(const std::string &name) const
+{
+    size_t index;
+    if( find_index( name, &index ) )
+    {
+        return &get_row( index );
     }
     else
     {
         return NULL;
     }
 }
+
 snp_row &
 genotype_matrix::get_row(size_t index) const
 {
+    if( m_use_storage_rows )
+    {
+        return *m_storage->get_row( index );
+    }
+
     return (*m_matrix)[ index ];
 }
 
+sparse_row const *
+genotype_matrix::get_sparse_row(const std::string &name) const
+{
+    size_t index;
+    if( m_use_storage_rows || !find_index( name, &index ) )
+    {
+        return NULL;
+    }
+
+    /* Only the rows that are used get a sparse copy. */
+    if( m_has_sparse_row.empty( ) )
+    {
+        m_sparse_rows.resize( size( ) );
+        m_has_sparse_row.resize( size( ), false );
+    }
+    if( !m_has_sparse_row[ index ] )
+    {
+        const snp_row &row = (*m_matrix)[ index ];
+        bool sparse = m_storage_sparse != NULL ? m_storage_sparse[ index ] != 0 : sparse_row::is_sparse( get_summary( index ), row.size( ) );
+        if( sparse )
+        {
+            m_sparse_rows[ index ] = shared_ptr<sparse_row>( new sparse_row( row ) );
+        }
+        m_has_sparse_row[ index ] = true;
+    }
+
+    return m_sparse_rows[ index ].get( );
+}
+
+snp_summary const *
+genotype_matrix::get_summary(const std::string &name) const
+{
+    size_t index;
+    if( find_index( name, &index ) )
+    {
+        return &get_summary( index );
+    }
+    else
+    {
+        return NULL;
+    }
+}
+
+const snp_summary &
+genotype_matrix::get_summary(size_t index) const
+{
+    if( m_storage_summaries != NULL )
+    {
+        return m_storage_summaries[ index ];
+    }
+    if( m_use_storage_rows && !m_has_summary[ index ] )
+    {
+        m_summaries[ index ] = summarize_snp( *m_storage->get_row( index ) );
+        m_has_summary[ index ] = true;
+    }
+
+    return m_summaries[ index ];
+}
+
+void
+genotype_matrix::prefetch(const std::string &name) const
+{
+    size_t index;
+    if( m_use_storage_rows && find_index( name, &index ) )
+    {
+        m_storage->prefetch( index );
+    }
+}
+
+bool
+genotype_matrix::is_on_demand() const
+{
+    return m_use_storage_rows;
+}
+
 const std::vector<std::string> &
 genotype_matrix::get_snp_names() const
 {
+    if( m_snp_names.empty( ) && m_storage )
+    {
+        m_storage->get_snp_names( &m_snp_names );
+    }
+
     return m_snp_names;
 }
 
+bool
+genotype_matrix::select_samples(const std::vector<size_t> &samples)
+{
+    if( m_storage )
+    {
+        return false;
+    }
+
+    for(size_t i = 0; i < m_matrix->size( ); i++)
+    {
+        (*m_matrix)[ i ].select( samples );
+    }
+    summarize_rows( );
+    m_sparse_rows.clear( );
+    m_has_sparse_row.clear( );
+
+    return true;
+}
+
 size_t 
 genotype_matrix::size() const
 {
+    if( m_use_storage_rows )
+    {
+        return m_snp_names.size( );
+    }
+
     return m_matrix->size( );
 }
@@ -8,6 +8,8 @@
 #include <shared_ptr/shared_ptr.hpp>
 
 #include <plink/snp_row.hpp>
+#include <plink/snp_summary.hpp>
+#include <plink/sparse_row.hpp>
 #include <plinkio/plinkio.h>
 
 /**
@@ -126,6 +128,110 @@ private:
     bool m_mafflip;
 };
 
+/**
+ * Memory that holds the genotypes of rows that are views, e.g. a
+ * memory mapped file or shared memory segment. It is released
+ * when the last matrix that uses it is destroyed.
+ */
+class genotype_storage
+{
+public:
+    virtual ~genotype_storage() { }
+
+    /**
+     * Returns true if the storage can find rows by name, in which
+     * case the matrix does not build its own index.
+     *
+     * @return True if find_snp can be used.
+     */
+    virtual bool has_snp_index() const
+    {
+        return false;
+    }
+
+    /**
+     * Finds the row of a snp.
+     *
+     * @param name Name of the snp.
+     * @param index The row will be stored here.
+     *
+     * @return True if the snp was found, false otherwise.
+     */
+    virtual bool find_snp(const std::string &name, size_t *index)
+    {
+        return false;
+    }
+
+    /**
+     * Copies the names of the rows if the storage has them, the
+     * matrix only asks for them when they are needed.
+     *
+     * @param names The names will be stored here.
+     *
+     * @return True if the storage has the names.
+     */
+    virtual bool get_snp_names(std::vector<std::string> *names) const
+    {
+        return false;
+    }
+
+    /**
+     * Returns the summary of each row if the storage has them, in
+     * which case the matrix does not summarize the rows itself.
+     *
+     * @return The summaries, or NULL.
+     */
+    virtual const snp_summary *get_summaries() const
+    {
+        return NULL;
+    }
+
+    /**
+     * Returns for each row whether it is rare enough to also be
+     * stored sparsely, see sparse_row::is_sparse, if the storage
+     * has already made that choice.
+     *
+     * @return Non-zero for each sparse row, or NULL.
+     */
+    virtual const unsigned char *get_sparse_flags() const
+    {
+        return NULL;
+    }
+
+    /**
+     * Returns true if the storage decodes rows on demand, in
+     * which case the matrix gets all rows through get_row.
+     *
+     * @return True if get_row can be used.
+     */
+    virtual bool has_rows() const
+    {
+        return false;
+    }
+
+    /**
+     * Returns a row that is decoded on demand. The row stays
+     * valid at least until one other row has been requested.
+     *
+     * @param index Index of the row.
+     *
+     * @return The row.
+     */
+    virtual snp_row *get_row(size_t index)
+    {
+        return NULL;
+    }
+
+    /**
+     * Hints that a row will be requested soon.
+     *
+     * @param index Index of the row.
+     */
+    virtual void prefetch(size_t index)
+    {
+    }
+};
+
 class genotype_matrix
 {
 public:
@@ -134,8 +240,22 @@ public:
      *
      * @param matrix The genotypes. This class now takes responsibility
      *               of the matrix.
+     * @param snp_names Name of each row.
+     * @param summaries Summary of each row, computed from the rows if NULL.
+     */
+    genotype_matrix(shared_ptr< std::vector<snp_row> > matrix, const std::vector<std::string> &snp_names, const std::vector<snp_summary> *summaries = NULL);
+
+    /**
+     * Constructor for rows that are views of memory that is owned
+     * by a storage.
+     *
+     * @param matrix The genotypes. This class now takes responsibility
+     *               of the matrix.
+     * @param snp_names Name of each row, may be empty if the storage
+     *                  has the names and an index of them.
+     * @param storage The memory that the rows refer to.
      */
-    genotype_matrix(shared_ptr< std::vector<snp_row> > matrix, const std::vector<std::string> &snp_names);
+    genotype_matrix(shared_ptr< std::vector<snp_row> > matrix, const std::vector<std::string> &snp_names, shared_ptr<genotype_storage> storage);
 
     /**
      * Returns the genotypes for the given name.
@@ -156,6 +276,55 @@ public:
      */
     snp_row &get_row(size_t index) const;
 
+    /**
+     * Returns the sparse copy of the genotypes for the given name,
+     * only rare variants are also stored sparsely. The copy is
+     * created the first time it is asked for, so this must not be
+     * called concurrently.
+     *
+     * @param name Name of the variant.
+     *
+     * @return The sparse genotypes, or NULL if the variant was not
+     *         found or is only stored densely.
+     */
+    sparse_row const *get_sparse_row(const std::string &name) const;
+
+    /**
+     * Returns the genotype counts and allele frequency of a snp.
+     *
+     * @param name Name of the variant.
+     *
+     * @return The summary of the snp, or NULL if the snp
+     *         was not found.
+     */
+    snp_summary const *get_summary(const std::string &name) const;
+
+    /**
+     * Returns the genotype counts and allele frequency of a snp.
+     *
+     * @param index Index of the variant.
+     *
+     * @return The summary of the snp.
+     */
+    const snp_summary &get_summary(size_t index) const;
+
+    /**
+     * Hints that the genotypes for the given name will be
+     * needed soon, only has an effect when the rows are
+     * decoded on demand.
+     *
+     * @param name Name of the variant.
+     */
+    void prefetch(const std::string &name) const;
+
+    /**
+     * Returns true if rows are decoded on demand, so that
+     * calling prefetch is worthwhile.
+     *
+     * @return True if rows are decoded on demand.
+     */
+    bool is_on_demand() const;
+
     /**
      * Returns a list of snp names.
      *
@@ -168,21 +337,98 @@ public:
      */
     size_t size() const;
 
+    /**
+     * Removes samples from all rows. Rows that are owned by a
+     * storage are never modified, since they may be shared.
+     *
+     * @param samples Indices of the samples to keep, in increasing order.
+     *
+     * @return True if the samples were removed, false if the rows
+     *         are owned by a storage.
+     */
+    bool select_samples(const std::vector<size_t> &samples);
+
 private:
+    /**
+     * Finds the row of a snp.
+     *
+     * @param name Name of the variant.
+     * @param index The row will be stored here.
+     *
+     * @return True if the snp was found, false otherwise.
+     */
+    bool find_index(const std::string &name, size_t *index) const;
+
+    /**
+     * Computes the summary of each row in m_matrix.
+     */
+    void summarize_rows();
+
     /**
      * The underlying matrix.
      */
     shared_ptr< std::vector<snp_row> > m_matrix;
 
     /**
-     * List of snp names for each row.
+     * List of snp names for each row, copied from the storage the
+     * first time they are asked for if it has them.
      */
-    std::vector<std::string> m_snp_names;
+    mutable std::vector<std::string> m_snp_names;
 
     /**
      * An index mapping snp names to indices.
      */
     std::map<std::string, size_t> m_snp_to_index;
+
+    /**
+     * Summary of each row. Rows that are decoded on demand are
+     * summarized the first time they are used.
+     */
+    mutable std::vector<snp_summary> m_summaries;
+
+    /**
+     * True for each row that has been summarized, only used when
+     * rows are decoded on demand.
+     */
+    mutable std::vector<bool> m_has_summary;
+
+    /**
+     * Summary of each row when they are kept by the storage.
+     */
+    const snp_summary *m_storage_summaries;
+
+    /**
+     * Non-zero for each sparse row when the storage has chosen them.
+     */
+    const unsigned char *m_storage_sparse;
+
+    /**
+     * Sparse copy of each row, empty for rows that are only
+     * stored densely and for rows that are decoded on demand.
+     */
+    mutable std::vector< shared_ptr<sparse_row> > m_sparse_rows;
+
+    /**
+     * True for each row whose sparse copy has been considered.
+     */
+    mutable std::vector<bool> m_has_sparse_row;
+
+    /**
+     * Memory that the rows refer to, if they are views.
+     */
+    shared_ptr<genotype_storage> m_storage;
+
+    /**
+     * True if rows are found by name through the storage
+     * instead of m_snp_to_index.
+     */
+    bool m_use_storage_index;
+
+    /**
+     * True if rows are decoded on demand by the storage
+     * instead of being stored in m_matrix.
+     */
+    bool m_use_storage_rows;
 };
 
 typedef shared_ptr<genotype_matrix> genotype_matrix_ptr;
@@ -229,4 +475,33 @@ genotype_matrix_ptr create_genotype_matrix(plink_file_ptr genotype_file);
  */
 genotype_matrix_ptr create_filtered_genotype_matrix(plink_file_ptr genotype_file, float maf);
 
+/**
+ * Creates a matrix of genotypes that are decoded on demand from
+ * the .bed file, and keeps at most the given amount of decoded
+ * genotypes in memory.
+ *
+ * @param plink_prefix The path to the plink file.
+ * @param genotype_file The opened plink file, no rows must have been read.
+ * @param mafflip If true the alleles are coded according to the minor allele.
+ * @param mem_budget Number of bytes of decoded genotypes to keep in memory.
+ *
+ * @return A matrix of genotypes, or an empty pointer if the .bed
+ *         file can not be read directly.
+ */
+genotype_matrix_ptr create_on_demand_genotype_matrix(const std::string &plink_prefix, plink_file_ptr genotype_file, bool mafflip, size_t mem_budget);
+
+/**
+ * Creates a matrix that only contains the genotypes of the given
+ * snps. The rows are read directly from the .bed file if possible,
+ * so the other rows are never decoded.
+ *
+ * @param plink_prefix The path to the plink file.
+ * @param genotype_file The opened plink file, no rows must have been read.
+ * @param mafflip Whether the plink file was opened with mafflip.
+ * @param used used[ i ] is true if snp i should be in the matrix.
+ *
+ * @return A matrix of genotypes.
+ */
+genotype_matrix_ptr create_subset_genotype_matrix(const std::string &plink_prefix, plink_file_ptr genotype_file, bool mafflip, const std::vector<bool> &used);
+
 #endif /* End of __PLINK_FILE_H__ */
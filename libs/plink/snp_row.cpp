@@ -1,19 +1,92 @@
 #include <plink/snp_row.hpp>
 
 snp_row::snp_row()
+    : m_size( 0 ),
+      m_data( NULL )
 {
 
 }
 
+snp_row::snp_row(const unsigned int *data, size_t size)
+    : m_size( size ),
+      m_data( data )
+{
+}
+
+snp_row::snp_row(const snp_row &other)
+    : m_size( other.m_size ),
+      m_genotypes( other.m_genotypes ),
+      m_data( other.m_data )
+{
+    if( !m_genotypes.empty( ) )
+    {
+        m_data = &m_genotypes[ 0 ];
+    }
+}
+
+snp_row &
+snp_row::operator=(const snp_row &other)
+{
+    m_size = other.m_size;
+    m_genotypes = other.m_genotypes;
+    m_data = m_genotypes.empty( ) ? other.m_data : &m_genotypes[ 0 ];
+
+    return *this;
+}
+
 void
 snp_row::resize(size_t new_size)
 {
-    unsigned int total_number_of_bits = new_size * 2;
-    unsigned int bits_per_element = 8 * sizeof( int );
-    unsigned int elements_required = (total_number_of_bits + bits_per_element - 1) / bits_per_element;
-
     m_size = new_size;
-    m_genotypes.resize( elements_required );
+    m_genotypes.resize( num_elements( new_size ) );
+    m_data = m_genotypes.empty( ) ? NULL : &m_genotypes[ 0 ];
+}
+
+size_t
+snp_row::num_elements(size_t size)
+{
+    size_t bits_per_element = 8 * sizeof( unsigned int );
+    return ( size * 2 + bits_per_element - 1 ) / bits_per_element;
+}
+
+const unsigned int *
+snp_row::data() const
+{
+    return m_data;
+}
+
+unsigned int *
+snp_row::mutable_data()
+{
+    if( m_genotypes.empty( ) && m_data != NULL )
+    {
+        m_genotypes.assign( m_data, m_data + num_elements( m_size ) );
+        m_data = &m_genotypes[ 0 ];
+    }
+
+    return m_genotypes.empty( ) ? NULL : &m_genotypes[ 0 ];
+}
+
+void
+snp_row::select(const std::vector<size_t> &indices)
+{
+    /* The indices are increasing, so a genotype is read before its position is overwritten. */
+    mutable_data( );
+    for(size_t i = 0; i < indices.size( ); i++)
+    {
+        assign( i, (*this)[ indices[ i ] ] );
+    }
+
+    resize( indices.size( ) );
+    std::vector<unsigned int>( m_genotypes ).swap( m_genotypes );
+    m_data = m_genotypes.empty( ) ? NULL : &m_genotypes[ 0 ];
+
+    /* Bits after the last genotype are zero in all rows. */
+    size_t num_last = m_size % 16;
+    if( num_last > 0 )
+    {
+        m_genotypes.back( ) &= ( 1u << ( 2 * num_last ) ) - 1;
+    }
 }
 
 size_t
@@ -29,7 +102,7 @@ snp_row::operator[](size_t index) const
     unsigned int element_index = ( index * 2 ) - element * ( 8 * sizeof( unsigned int ) );
     unsigned int element_mask = 0x3 << element_index;
     
-    return ( m_genotypes[ element ] & element_mask ) >> element_index;
+    return ( m_data[ element ] & element_mask ) >> element_index;
 }
 
 void
@@ -40,5 +113,6 @@ snp_row::assign(size_t index, unsigned char value)
     unsigned int element_mask = ~( 0x3 << element_index );
     unsigned int positioned_value = ( value & 0x3 ) << element_index;
 
-    m_genotypes[ element ] = ( m_genotypes[ element ] & element_mask ) | positioned_value;
+    unsigned int *genotypes = mutable_data( );
+    genotypes[ element ] = ( genotypes[ element ] & element_mask ) | positioned_value;
 }
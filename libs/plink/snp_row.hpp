@@ -12,6 +12,31 @@ public:
      */
     snp_row();
 
+    /**
+     * Constructs a read-only view of packed genotypes that are
+     * owned by someone else, e.g. a memory mapped file.
+     *
+     * @param data The packed genotypes, see data( ).
+     * @param size Number of genotypes.
+     */
+    snp_row(const unsigned int *data, size_t size);
+
+    /**
+     * Copy constructor, a copy of a view is also a view.
+     *
+     * @param other The row to copy.
+     */
+    snp_row(const snp_row &other);
+
+    /**
+     * Assignment, a copy of a view is also a view.
+     *
+     * @param other The row to copy.
+     *
+     * @return This row.
+     */
+    snp_row &operator=(const snp_row &other);
+
     /**
      * Resizes the row to be able to hold the given size.
      *
@@ -36,13 +61,47 @@ public:
     unsigned char operator[](size_t index) const;
 
     /**
-     * Access operator for assignment.
+     * Access operator for assignment, a view is first copied
+     * so that the shared genotypes are never modified.
      *
      * @param index Index of the SNP to modify.
      * @param value The value to assign.
      */
     void assign(size_t index, unsigned char value);
 
+    /**
+     * Returns the packed genotypes, genotype i is stored in bits
+     * 2 * ( i % 16 ) and 2 * ( i % 16 ) + 1 of element i / 16.
+     *
+     * @return The packed genotypes.
+     */
+    const unsigned int *data() const;
+
+    /**
+     * Returns the packed genotypes for writing, a view is first
+     * copied. Bits after the last genotype must be zero.
+     *
+     * @return The packed genotypes.
+     */
+    unsigned int *mutable_data();
+
+    /**
+     * Returns the number of elements needed to store a row.
+     *
+     * @param size Number of genotypes.
+     *
+     * @return The number of elements of packed genotypes.
+     */
+    static size_t num_elements(size_t size);
+
+    /**
+     * Keeps only the given genotypes, in the given order, and
+     * releases the memory of the others.
+     *
+     * @param indices Indices of the genotypes to keep, in increasing order.
+     */
+    void select(const std::vector<size_t> &indices);
+
 private:
     /**
      * Size of the row.
@@ -53,6 +112,12 @@ private:
      * Internal data structure, as a vector.
      */
     std::vector<unsigned int> m_genotypes;
+
+    /**
+     * The packed genotypes, points into m_genotypes unless the
+     * row is a view.
+     */
+    const unsigned int *m_data;
 };
 
 #endif /* End of __SNP_ROW_H__ */
@@ -0,0 +1,90 @@
+#include <algorithm>
+
+#include <plink/snp_summary.hpp>
+
+/**
+ * Number of genotypes of each kind in a byte of a packed row,
+ * i.e. in four genotypes.
+ */
+struct genotype_count_table
+{
+    genotype_count_table()
+    {
+        for(int i = 0; i < 256; i++)
+        {
+            for(int j = 0; j < 4; j++)
+            {
+                counts[ i ][ j ] = 0;
+            }
+            for(int j = 0; j < 4; j++)
+            {
+                counts[ i ][ ( i >> ( 2 * j ) ) & 3 ]++;
+            }
+        }
+    }
+
+    unsigned char counts[ 256 ][ 4 ];
+};
+
+static const genotype_count_table g_count_table;
+
+snp_summary
+summarize_snp(const snp_row &row)
+{
+    snp_summary summary;
+    for(int i = 0; i < 4; i++)
+    {
+        summary.counts[ i ] = 0;
+    }
+
+    const unsigned int *data = row.data( );
+    size_t num_elements = snp_row::num_elements( row.size( ) );
+    for(size_t i = 0; i < num_elements; i++)
+    {
+        for(int j = 0; j < 4; j++)
+        {
+            const unsigned char *counts = g_count_table.counts[ ( data[ i ] >> ( 8 * j ) ) & 0xff ];
+            summary.counts[ 0 ] += counts[ 0 ];
+            summary.counts[ 1 ] += counts[ 1 ];
+            summary.counts[ 2 ] += counts[ 2 ];
+            summary.counts[ 3 ] += counts[ 3 ];
+        }
+    }
+
+    /* Bits after the last genotype are zero, and were counted as genotype 0. */
+    summary.counts[ 0 ] -= num_elements * 16 - row.size( );
+
+    unsigned int called = summary.counts[ 0 ] + summary.counts[ 1 ] + summary.counts[ 2 ];
+    unsigned int dose = summary.counts[ 1 ] + 2 * summary.counts[ 2 ];
+    summary.maf = 0.0;
+    summary.call_rate = row.size( ) > 0 ? ( (float) called ) / row.size( ) : 0.0;
+    summary.minor_count = std::min( dose, 2 * called - dose );
+    if( called > 0 )
+    {
+        float maf = ( (float) dose ) / ( 2 * called );
+        summary.maf = std::min( maf, 1 - maf );
+    }
+
+    return summary;
+}
+
+size_t
+count_called(const snp_row &row1, const snp_row &row2)
+{
+    /* A genotype is missing when both of its bits are set. */
+    const unsigned int *data1 = row1.data( );
+    const unsigned int *data2 = row2.data( );
+    size_t num_elements = snp_row::num_elements( row1.size( ) );
+    size_t num_missing = 0;
+    for(size_t i = 0; i < num_elements; i++)
+    {
+        unsigned int missing = ( data1[ i ] & ( data1[ i ] >> 1 ) ) | ( data2[ i ] & ( data2[ i ] >> 1 ) );
+        missing &= 0x55555555;
+        for(; missing != 0; missing &= missing - 1)
+        {
+            num_missing++;
+        }
+    }
+
+    return row1.size( ) - num_missing;
+}
@@ -0,0 +1,53 @@
+#ifndef __SNP_SUMMARY_H__
+#define __SNP_SUMMARY_H__
+
+#include <plink/snp_row.hpp>
+
+/**
+ * Genotype counts and allele frequencies of a snp, computed
+ * once when the genotypes are loaded.
+ */
+struct snp_summary
+{
+    /**
+     * Number of samples with genotype 0, 1, 2 and missing.
+     */
+    unsigned int counts[ 4 ];
+
+    /**
+     * Frequency of the minor allele among non-missing samples,
+     * 0 if all samples are missing.
+     */
+    float maf;
+
+    /**
+     * Fraction of samples that are not missing.
+     */
+    float call_rate;
+
+    /**
+     * Number of copies of the minor allele.
+     */
+    unsigned int minor_count;
+};
+
+/**
+ * Counts the genotypes of a snp.
+ *
+ * @param row A snp.
+ *
+ * @return The summary of the snp.
+ */
+snp_summary summarize_snp(const snp_row &row);
+
+/**
+ * Counts the samples that are non-missing in both snps.
+ *
+ * @param row1 The first snp.
+ * @param row2 The second snp, of the same size as the first.
+ *
+ * @return The number of samples that are non-missing in both snps.
+ */
+size_t count_called(const snp_row &row1, const snp_row &row2);
+
+#endif /* End of __SNP_SUMMARY_H__ */
@@ -0,0 +1,72 @@
+#include <algorithm>
+
+#include <plink/sparse_row.hpp>
+
+sparse_row::sparse_row()
+    : m_size( 0 )
+{
+    std::fill( m_counts, m_counts + 4, 0 );
+}
+
+sparse_row::sparse_row(const snp_row &row)
+    : m_size( row.size( ) )
+{
+    std::fill( m_counts, m_counts + 4, 0 );
+
+    /* Padding bits are zero, so words with only genotype 0 are skipped without decoding. */
+    const unsigned int *data = row.data( );
+    size_t num_elements = snp_row::num_elements( row.size( ) );
+    size_t samples_per_element = 4 * sizeof( unsigned int );
+    for(size_t e = 0; e < num_elements; e++)
+    {
+        unsigned int genotypes = data[ e ];
+        for(unsigned int i = e * samples_per_element; genotypes != 0; i++)
+        {
+            unsigned int genotype = genotypes & 3;
+            if( genotype != 0 )
+            {
+                m_indices.push_back( i );
+                m_genotypes.push_back( genotype );
+                m_counts[ genotype ]++;
+            }
+            genotypes >>= 2;
+        }
+    }
+}
+
+size_t
+sparse_row::size() const
+{
+    return m_size;
+}
+
+size_t
+sparse_row::num_entries() const
+{
+    return m_indices.size( );
+}
+
+const std::vector<unsigned int> &
+sparse_row::indices() const
+{
+    return m_indices;
+}
+
+const std::vector<unsigned char> &
+sparse_row::genotypes() const
+{
+    return m_genotypes;
+}
+
+const unsigned int *
+sparse_row::counts() const
+{
+    return m_counts;
+}
+
+bool
+sparse_row::is_sparse(const snp_summary &summary, size_t num_samples)
+{
+    size_t num_entries = summary.counts[ 1 ] + summary.counts[ 2 ] + summary.counts[ 3 ];
+    return summary.maf <= SPARSE_ROW_MAX_MAF && num_entries * SPARSE_ROW_MIN_SAMPLES_PER_ENTRY <= num_samples;
+}
@@ -0,0 +1,114 @@
+#ifndef __SPARSE_ROW_H__
+#define __SPARSE_ROW_H__
+
+#include <vector>
+
+#include <plink/snp_row.hpp>
+#include <plink/snp_summary.hpp>
+
+/**
+ * Largest minor allele frequency of a snp that is also stored
+ * as a sparse_row.
+ */
+const float SPARSE_ROW_MAX_MAF = 0.01;
+
+/**
+ * A snp is only stored as a sparse_row if at most one in this
+ * many samples has a genotype other than 0, below that the
+ * indices use more memory than the packed genotypes.
+ */
+const unsigned int SPARSE_ROW_MIN_SAMPLES_PER_ENTRY = 32;
+
+/**
+ * The genotypes of a snp as the sorted indices of the samples
+ * whose genotype is not 0, i.e. heterozygous, homozygous for the
+ * allele coded as 2 or missing. For rare variants coded according
+ * to the minor allele nearly all samples are 0, so a pair can be
+ * counted by visiting only the few remaining samples.
+ */
+class sparse_row
+{
+public:
+    /**
+     * Constructor, creates an empty row.
+     */
+    sparse_row();
+
+    /**
+     * Constructs a sparse copy of a row.
+     *
+     * @param row The genotypes.
+     */
+    explicit sparse_row(const snp_row &row);
+
+    /**
+     * Returns the number of samples.
+     *
+     * @return The number of samples.
+     */
+    size_t size() const;
+
+    /**
+     * Returns the number of samples whose genotype is not 0.
+     *
+     * @return The number of stored samples.
+     */
+    size_t num_entries() const;
+
+    /**
+     * Returns the indices of the samples whose genotype is not 0,
+     * in increasing order.
+     *
+     * @return The indices of the stored samples.
+     */
+    const std::vector<unsigned int> &indices() const;
+
+    /**
+     * Returns the genotype 1, 2 or 3 (missing) of each stored sample.
+     *
+     * @return The genotypes of the stored samples.
+     */
+    const std::vector<unsigned char> &genotypes() const;
+
+    /**
+     * Returns the number of stored samples with each genotype,
+     * element 0 is always 0.
+     *
+     * @return The number of samples with genotype 0, 1, 2 and 3.
+     */
+    const unsigned int *counts() const;
+
+    /**
+     * Determines from the genotype counts of a snp whether it
+     * should also be stored as a sparse_row.
+     *
+     * @param summary Summary of the snp.
+     * @param num_samples Number of samples.
+     *
+     * @return True if the snp is rare enough.
+     */
+    static bool is_sparse(const snp_summary &summary, size_t num_samples);
+
+private:
+    /**
+     * Number of samples.
+     */
+    size_t m_size;
+
+    /**
+     * Indices of the samples whose genotype is not 0.
+     */
+    std::vector<unsigned int> m_indices;
+
+    /**
+     * Genotype of each sample in m_indices.
+     */
+    std::vector<unsigned char> m_genotypes;
+
+    /**
+     * Number of stored samples with each genotype.
+     */
+    unsigned int m_counts[ 4 ];
+};
+
+#endif /* End of __SPARSE_ROW_H__ */
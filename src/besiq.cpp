@@ -19,6 +19,8 @@ struct command g_commands[] =
 {
     { "pairs", "Generate a set of pairs for a gene-gene analysis." },
     { "view", "Display a binary result file" },
+    { "merge", "Merge and optionally sort binary result files." },
+    { "load", "Decode genotypes once into shared memory for concurrent analyses." },
     { "correct", "Multiple testing correction." },
     { "glm", "Run a GLM model possibly with covariates." },
     { "wald", "Perform a 'fast' wald test with main effects." },
@@ -39,7 +39,8 @@ main(int argc, char *argv[])
         exit( 1 );
     }
 
-    shared_ptr<common_options> parsed_data = parse_common_options( options, parser.args( ) );
+    /* The prior is estimated from random snps, so all of them are needed. */
+    shared_ptr<common_options> parsed_data = parse_common_options( options, parser.args( ), options.is_set( "estimate_prior_params" ) );
 
     /* Read prior parameters */
     arma::vec alpha = arma::ones<arma::vec>( 2 );
@@ -22,6 +22,7 @@ main(int argc, char *argv[])
     char const* const method_choices[] = { "css", "r2", "contrast", "peer" };
     OptionParser parser = create_common_options( USAGE, DESCRIPTION, false );
     parser.add_option( "-m", "--method" ).choices( &method_choices[ 0 ], &method_choices[ 4 ] ).metavar( "method" ).help( "The type of test statistic to compute 'r2' or 'css'." ).set_default( "css" );
+    parser.add_option( "--cases-only" ).action( "store_true" ).help( "Compute 'r2' and 'css' from the cases only, the controls are removed before the analysis and the wald test is not run." );
     
     Values options = parser.parse_args( argc, argv );
     if( parser.args( ).size( ) != 2 )
@@ -29,12 +30,31 @@ main(int argc, char *argv[])
         parser.print_help( );
         exit( 1 );
     }
+    bool cases_only = options.is_set( "cases_only" );
+    if( cases_only && options[ "method" ] != "r2" && options[ "method" ] != "css" )
+    {
+        std::cerr << "besiq: error: --cases-only can only be used with 'r2' and 'css', '" << options[ "method" ] << "' needs the controls." << std::endl;
+        exit( 1 );
+    }
+
     shared_ptr<common_options> parsed_data = parse_common_options( options, parser.args( ) );
+    if( cases_only )
+    {
+        method_data_ptr data = parsed_data->data;
+        for(size_t i = 0; i < data->phenotype.n_elem; i++)
+        {
+            if( data->phenotype[ i ] != 1.0 )
+            {
+                data->missing[ i ] = 1;
+            }
+        }
+        remove_missing_samples( parsed_data->genotypes, data );
+    }
 
     method_type *m = NULL;
     if( options[ "method" ] != "peer" )
     {
-        m = new caseonly_method( parsed_data->data, options[ "method" ] );
+        m = new caseonly_method( parsed_data->data, options[ "method" ], cases_only );
     }
     else if( options[ "method" ] == "peer" )
     {
@@ -11,6 +11,7 @@
 #include <besiq/io/resultfile.hpp>
 #include <besiq/stats/snp_count.hpp>
 #include <plink/imputed.hpp>
+#include <plink/snp_summary.hpp>
 
 using namespace arma;
 using namespace optparse;
@@ -133,6 +134,18 @@ main(int argc, char *argv[])
     int v2_start = std::max( variant2 - window_size, 0 );
     int v2_end = std::min( variant2 + window_size, (int) imputed2.genotypes->size( ) );
 
+    /* Summarize each variant once instead of for every pair. */
+    std::vector<float> maf1_vec;
+    for(int i = v1_start; i < v1_end; i++)
+    {
+        maf1_vec.push_back( summarize_snp( (*imputed1.genotypes)[ i ] ).maf );
+    }
+    std::vector<float> maf2_vec;
+    for(int j = v2_start; j < v2_end; j++)
+    {
+        maf2_vec.push_back( summarize_snp( (*imputed2.genotypes)[ j ] ).maf );
+    }
+
     for(int i = v1_start; i < v1_end; i++)
     {
         for(int j = v2_start; j < v2_end; j++)
@@ -151,8 +164,8 @@ main(int argc, char *argv[])
             const snp_row &row1 = (*imputed1.genotypes)[ i ];
             const snp_row &row2 = (*imputed2.genotypes)[ j ];
             
-            float maf1 = compute_real_maf( row1 );
-            float maf2 = compute_real_maf( row2 );
+            float maf1 = maf1_vec[ i - v1_start ];
+            float maf2 = maf2_vec[ j - v2_start ];
 
             if( maf1 > maf_threshold && maf2 > maf_threshold && info1 > info_threshold && info2 > info_threshold )
             {
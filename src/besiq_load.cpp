@@ -0,0 +1,61 @@
+#include <iostream>
+
+#include <cpp-argparse/OptionParser.h>
+
+#include <plink/plink_file.hpp>
+#include <besiq/io/genotype_image.hpp>
+
+using namespace optparse;
+
+const std::string USAGE = "besiq-load --shm NAME plink_file";
+const std::string VERSION = "besiq 0.0.1";
+const std::string DESCRIPTION = "Decodes a plink file once into shared memory, so that analyses on the same node can attach it with --genotypes-shm instead of keeping their own copy.";
+const std::string EPILOG = "";
+
+int
+main(int argc, char *argv[])
+{
+    OptionParser parser = OptionParser( ).usage( USAGE )
+                                         .version( VERSION )
+                                         .description( DESCRIPTION )
+                                         .epilog( EPILOG );
+
+    parser.add_option( "--shm" ).metavar( "NAME" ).help( "Name of the shared memory segment, an existing segment with the same name is replaced." );
+    parser.add_option( "--remove" ).action( "store_true" ).help( "Remove the shared memory segment instead, it is freed when the last analysis detaches." );
+
+    Values options = parser.parse_args( argc, argv );
+    std::vector<std::string> args = parser.args( );
+    if( !options.is_set( "shm" ) )
+    {
+        std::cerr << "besiq-load: error: Need a segment name, use --shm." << std::endl;
+        parser.print_help( );
+        exit( 1 );
+    }
+
+    if( options.is_set( "remove" ) )
+    {
+        if( !remove_genotype_shm( options[ "shm" ] ) )
+        {
+            std::cerr << "besiq-load: error: Could not remove shared memory segment '" << options[ "shm" ] << "'." << std::endl;
+            exit( 1 );
+        }
+        return 0;
+    }
+
+    if( args.size( ) != 1 )
+    {
+        std::cerr << "besiq-load: error: Need a plink file." << std::endl;
+        parser.print_help( );
+        exit( 1 );
+    }
+
+    /* The analyses code alleles according to the minor allele. */
+    plink_file_ptr genotype_file = open_plink_file( args[ 0 ], true );
+    if( !create_genotype_shm( options[ "shm" ], args[ 0 ], genotype_file, true ) )
+    {
+        std::cerr << "besiq-load: error: Could not create shared memory segment '" << options[ "shm" ] << "'." << std::endl;
+        exit( 1 );
+    }
+
+    return 0;
+}
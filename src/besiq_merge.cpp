@@ -0,0 +1,181 @@
+#include <iostream>
+#include <map>
+
+#include <cpp-argparse/OptionParser.h>
+
+#include <besiq/io/resultfile.hpp>
+#include <besiq/io/result_sorter.hpp>
+
+using namespace optparse;
+
+const std::string USAGE = "besiq-merge [OPTIONS] result_file [result_file2 ...]";
+const std::string VERSION = "besiq 0.0.1";
+const std::string DESCRIPTION = "Merges binary result files with the same columns into a single file.";
+const std::string EPILOG = "";
+
+int
+main(int argc, char *argv[])
+{
+    OptionParser parser = OptionParser( ).usage( USAGE )
+                                         .version( VERSION )
+                                         .description( DESCRIPTION )
+                                         .epilog( EPILOG );
+
+    parser.add_option( "-o", "--out" ).help( "The merged binary result file." );
+    parser.add_option( "-f", "--field" ).set_default( 0 ).help( "The value field to sort and filter on, the field index of the first non snp name is 0." );
+    parser.add_option( "-s", "--sort" ).action( "store_true" ).help( "Sort the records in increasing order of the field, missing and NaN values are placed last." );
+    parser.add_option( "-t", "--threshold" ).help( "Only keep records where the field is non-missing and less than or equal to this threshold." );
+    parser.add_option( "-m", "--mem-budget" ).type( "int" ).metavar( "MB" ).set_default( 1024 ).help( "Number of megabytes to use for sorting, including the buffers of the temporary files that larger sorts use (default = 1024)." );
+    parser.add_option( "--columnar" ).action( "store_true" ).help( "Write the merged file in the block-compressed columnar format." );
+    parser.add_option( "--force" ).action( "store_true" ).help( "Merge possibly corrupted files." );
+
+    Values options = parser.parse_args( argc, argv );
+    std::vector<std::string> args = parser.args( );
+    if( args.size( ) < 1 )
+    {
+        std::cerr << "besiq-merge: error: Need at least one result file." << std::endl;
+        parser.print_help( );
+        exit( 1 );
+    }
+    if( !options.is_set( "out" ) )
+    {
+        std::cerr << "besiq-merge: error: Need an output file, use --out." << std::endl;
+        exit( 1 );
+    }
+
+    std::vector<mresultfile *> result_files;
+    std::vector<std::string> snp_names;
+    std::map<std::string, uint32_t> snp_index;
+    std::vector< std::vector<uint32_t> > snp_maps;
+    for(int i = 0; i < args.size( ); i++)
+    {
+        mresultfile *result = new mresultfile( args[ i ] );
+        if( !result->open( ) )
+        {
+            std::cerr << "besiq-merge: error: Could not open row-major result file: '" << args[ i ] << "'." << std::endl;
+            exit( 1 );
+        }
+        if( result->is_corrupted( ) && !options.is_set( "force" ) )
+        {
+            std::cerr << "besiq-merge: error: Result file '" << args[ i ] << "' may have been corrupted, use --force to merge anyway." << std::endl;
+            exit( 1 );
+        }
+        if( result_files.size( ) > 0 && result->get_header( ) != result_files[ 0 ]->get_header( ) )
+        {
+            std::cerr << "besiq-merge: error: Result file '" << args[ i ] << "' has different columns than '" << args[ 0 ] << "'." << std::endl;
+            exit( 1 );
+        }
+        if( result_files.size( ) > 0 && result->get_encodings( ) != result_files[ 0 ]->get_encodings( ) )
+        {
+            std::cerr << "besiq-merge: error: Result file '" << args[ i ] << "' has different column encodings than '" << args[ 0 ] << "', they were not written with the same --compact setting." << std::endl;
+            exit( 1 );
+        }
+
+        /* Map the snp indices of each file to the union of all snps. */
+        const std::vector<std::string> &names = result->get_snp_names( );
+        std::vector<uint32_t> snp_map( names.size( ) );
+        for(size_t j = 0; j < names.size( ); j++)
+        {
+            std::map<std::string, uint32_t>::const_iterator it = snp_index.find( names[ j ] );
+            if( it == snp_index.end( ) )
+            {
+                it = snp_index.insert( std::make_pair( names[ j ], (uint32_t) snp_names.size( ) ) ).first;
+                snp_names.push_back( names[ j ] );
+            }
+            snp_map[ j ] = it->second;
+        }
+
+        result_files.push_back( result );
+        snp_maps.push_back( snp_map );
+    }
+
+    std::vector<std::string> header = result_files[ 0 ]->get_header( );
+    size_t field = (size_t) options.get( "field" );
+    if( field >= header.size( ) )
+    {
+        std::cerr << "besiq-merge: error: Field is larger than the number of columns." << std::endl;
+        exit( 1 );
+    }
+
+    bool use_threshold = options.is_set( "threshold" );
+    float threshold = (float) options.get( "threshold" );
+
+    resultfile *output_file;
+    bool opened;
+    if( options.is_set( "columnar" ) )
+    {
+        output_file = new cresultfile( options[ "out" ], snp_names );
+        opened = output_file->open( );
+    }
+    else
+    {
+        bresultfile *row_file = new bresultfile( options[ "out" ], snp_names );
+        opened = row_file->open( );
+        row_file->set_encodings( result_files[ 0 ]->get_encodings( ) );
+        output_file = row_file;
+    }
+    if( !opened || !output_file->set_header( header ) )
+    {
+        std::cerr << "besiq-merge: error: Could not open output file: '" << options[ "out" ] << "'." << std::endl;
+        exit( 1 );
+    }
+
+    size_t record_size = sizeof( uint32_t ) * 2 + sizeof( float ) * header.size( );
+    result_sorter sorter( record_size, field, (size_t) (int) options.get( "mem_budget" ) * 1024 * 1024 );
+    bool sort = options.is_set( "sort" );
+
+    std::vector<char> record( record_size );
+    uint32_t *snps = (uint32_t *) &record[ 0 ];
+    float *values = (float *) &record[ sizeof( uint32_t ) * 2 ];
+    bool success = true;
+    for(size_t i = 0; i < result_files.size( ) && success; i++)
+    {
+        mresultfile *result = result_files[ i ];
+        for(uint64_t j = 0; j < result->num_records( ) && success; j++)
+        {
+            float value = result->get_value( j, field );
+            if( use_threshold && ( result_is_missing_key( value ) || value > threshold ) )
+            {
+                continue;
+            }
+
+            result->get_snps( j, snps );
+            if( snps[ 0 ] >= snp_maps[ i ].size( ) || snps[ 1 ] >= snp_maps[ i ].size( ) )
+            {
+                std::cerr << "besiq-merge: error: Bad snp index in '" << args[ i ] << "'." << std::endl;
+                exit( 1 );
+            }
+            snps[ 0 ] = snp_maps[ i ][ snps[ 0 ] ];
+            snps[ 1 ] = snp_maps[ i ][ snps[ 1 ] ];
+            for(size_t k = 0; k < header.size( ); k++)
+            {
+                values[ k ] = result->get_value( j, k );
+            }
+
+            if( sort )
+            {
+                success = sorter.add( &record[ 0 ] );
+            }
+            else
+            {
+                success = write_indexed_record( &record[ 0 ], snp_names, output_file );
+            }
+        }
+
+        delete result;
+    }
+
+    if( success && sort )
+    {
+        success = sorter.merge( snp_names, output_file );
+    }
+
+    delete output_file;
+    if( !success )
+    {
+        std::cerr << "besiq-merge: error: Could not write merged result file." << std::endl;
+        exit( 1 );
+    }
+
+    return 0;
+}
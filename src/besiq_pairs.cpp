@@ -1,7 +1,9 @@
+#include <algorithm>
 #include <set>
 #include <string>
 #include <vector>
 
+#include <besiq/io/genotype_image.hpp>
 #include <besiq/io/pairfile.hpp>
 
 #include <plink/plink_file.hpp>
@@ -31,18 +33,44 @@ compute_maf(plink_file_ptr &genotype_file)
     snp_row row;
     while( genotype_file->next_row( row ) )
     {
-        double maf = compute_real_maf( row );
-        if( maf > 0.5 )
-        {
-            maf = 1.0 - maf;
-        }
-
-        maf_vec.push_back( maf );
+        maf_vec.push_back( summarize_snp( row ).maf );
     }
 
     return maf_vec;
 }
 
+/**
+ * Reads the minor allele frequency for each snp from the
+ * genotype cache, the cache is created if it is not valid.
+ *
+ * @param plink_prefix Path to the plink file.
+ * @param genotype_file Plink file opened with mafflip.
+ * @param maf_vec The mafs will be stored here.
+ *
+ * @return True if the mafs could be read, false otherwise.
+ */
+bool
+read_cached_maf(const std::string &plink_prefix, plink_file_ptr &genotype_file, std::vector<double> &maf_vec)
+{
+    genotype_matrix_ptr genotypes = open_genotype_cache( plink_prefix, genotype_file, true );
+    if( !genotypes && create_genotype_cache( plink_prefix, genotype_file, true ) )
+    {
+        genotypes = open_genotype_cache( plink_prefix, genotype_file, true );
+    }
+    if( !genotypes )
+    {
+        return false;
+    }
+
+    maf_vec.clear( );
+    for(size_t i = 0; i < genotypes->size( ); i++)
+    {
+        maf_vec.push_back( genotypes->get_summary( i ).maf );
+    }
+
+    return true;
+}
+
 /**
  * A vector of pairs that represents pairs of genes.
  */
@@ -391,6 +419,315 @@ void output_all(pairfile &output, const output_options &oo)
     }
 }
 
+/**
+ * Orders snp indices by chromosome and then by position.
+ */
+struct locus_position_less
+{
+    locus_position_less(const output_options &oo)
+        : m_oo( oo )
+    {
+    }
+
+    bool operator()(size_t a, size_t b) const
+    {
+        const pio_locus_t &la = m_oo.loci_info[ a ];
+        const pio_locus_t &lb = m_oo.loci_info[ b ];
+        if( la.chromosome != lb.chromosome )
+        {
+            return la.chromosome < lb.chromosome;
+        }
+
+        return la.bp_position < lb.bp_position;
+    }
+
+    const output_options &m_oo;
+};
+
+/**
+ * A binary indexed tree that counts the number of inserted
+ * values with a rank less than a given rank.
+ */
+class rank_counter
+{
+public:
+    rank_counter(size_t size)
+        : m_tree( size + 1, 0 )
+    {
+    }
+
+    void add(size_t rank, long long delta)
+    {
+        for(size_t i = rank + 1; i < m_tree.size( ); i += i & (-i))
+        {
+            m_tree[ i ] += delta;
+        }
+    }
+
+    /**
+     * Returns the number of inserted values with a rank
+     * strictly less than the given rank.
+     */
+    long long count_below(size_t rank) const
+    {
+        long long total = 0;
+        for(size_t i = rank; i > 0; i -= i & (-i))
+        {
+            total += m_tree[ i ];
+        }
+
+        return total;
+    }
+
+private:
+    std::vector<long long> m_tree;
+};
+
+/**
+ * Returns the rank of the smallest value in sorted_maf that
+ * satisfies value * maf >= threshold, or sorted_maf.size( ) if
+ * no such value exists.
+ */
+size_t
+first_passing_rank(const std::vector<double> &sorted_maf, double maf, double threshold)
+{
+    size_t low = 0;
+    size_t high = sorted_maf.size( );
+    while( low < high )
+    {
+        size_t mid = low + ( high - low ) / 2;
+        if( sorted_maf[ mid ] * maf >= threshold )
+        {
+            high = mid;
+        }
+        else
+        {
+            low = mid + 1;
+        }
+    }
+
+    return low;
+}
+
+/**
+ * Counts the number of pairs among the given snps that would be
+ * outputted, i.e. the pairs i < j in the list that pass the maf,
+ * combined maf and distance filters, without enumerating them.
+ *
+ * The pairs passing the maf filters are counted on the sorted
+ * mafs, and pairs that are too close are then subtracted by
+ * sweeping each chromosome in position order.
+ *
+ * @param oo Output options.
+ * @param indices List of snps, may contain duplicates.
+ *
+ * @return The number of pairs.
+ */
+uint64_t
+count_pairs(const output_options &oo, const std::vector<size_t> &indices)
+{
+    std::vector<size_t> kept;
+    for(size_t i = 0; i < indices.size( ); i++)
+    {
+        if( oo.maf_vec[ indices[ i ] ] >= oo.maf_threshold )
+        {
+            kept.push_back( indices[ i ] );
+        }
+    }
+
+    size_t n = kept.size( );
+    std::vector<double> sorted_maf( n );
+    for(size_t i = 0; i < n; i++)
+    {
+        sorted_maf[ i ] = oo.maf_vec[ kept[ i ] ];
+    }
+    std::sort( sorted_maf.begin( ), sorted_maf.end( ) );
+
+    /* Pairs that pass the combined maf threshold, the product is
+     * non-decreasing in the second element so the first passing
+     * element only moves to the left as the first element grows. */
+    uint64_t num_pairs = 0;
+    size_t first = n;
+    for(size_t i = 0; i < n; i++)
+    {
+        while( first > 0 && sorted_maf[ i ] * sorted_maf[ first - 1 ] >= oo.combined_threshold )
+        {
+            first--;
+        }
+
+        num_pairs += n - std::max( first, i + 1 );
+    }
+
+    if( oo.pos_threshold <= 0 || n == 0 )
+    {
+        return num_pairs;
+    }
+
+    /* Remove pairs on the same chromosome that are too close. */
+    std::vector<double> unique_maf( sorted_maf );
+    unique_maf.erase( std::unique( unique_maf.begin( ), unique_maf.end( ) ), unique_maf.end( ) );
+
+    std::vector<size_t> by_position( kept );
+    std::sort( by_position.begin( ), by_position.end( ), locus_position_less( oo ) );
+
+    std::vector<size_t> rank( n );
+    for(size_t i = 0; i < n; i++)
+    {
+        rank[ i ] = std::lower_bound( unique_maf.begin( ), unique_maf.end( ), oo.maf_vec[ by_position[ i ] ] ) - unique_maf.begin( );
+    }
+
+    rank_counter window( unique_maf.size( ) );
+    size_t left = 0;
+    for(size_t i = 0; i < n; i++)
+    {
+        const pio_locus_t &locus = oo.loci_info[ by_position[ i ] ];
+        while( left < i && ( oo.loci_info[ by_position[ left ] ].chromosome != locus.chromosome ||
+                             locus.bp_position - oo.loci_info[ by_position[ left ] ].bp_position >= oo.pos_threshold ) )
+        {
+            window.add( rank[ left ], -1 );
+            left++;
+        }
+
+        size_t passing = first_passing_rank( unique_maf, oo.maf_vec[ by_position[ i ] ], oo.combined_threshold );
+        num_pairs -= ( i - left ) - window.count_below( passing );
+
+        window.add( rank[ i ], 1 );
+    }
+
+    return num_pairs;
+}
+
+/**
+ * Counts the pairs that output_within would output.
+ *
+ * @param oo Output options.
+ * @param gene_locus Map from gene to the loci belonging to that gene.
+ *
+ * @return The number of pairs.
+ */
+uint64_t
+count_within(const output_options &oo, const std::map< std::string, std::vector<size_t> > &gene_locus)
+{
+    uint64_t num_pairs = 0;
+    std::map< std::string, std::vector<size_t> >::const_iterator it;
+    for(it = gene_locus.begin( ); it != gene_locus.end( ); ++it)
+    {
+        num_pairs += count_pairs( oo, it->second );
+    }
+
+    return num_pairs;
+}
+
+/**
+ * Counts the pairs between two lists of snps.
+ *
+ * @param oo Output options.
+ * @param indices1 First list of snps.
+ * @param indices2 Second list of snps.
+ *
+ * @return The number of pairs.
+ */
+uint64_t
+count_cross(const output_options &oo, const std::vector<size_t> &indices1, const std::vector<size_t> &indices2)
+{
+    std::vector<size_t> combined( indices1 );
+    combined.insert( combined.end( ), indices2.begin( ), indices2.end( ) );
+
+    return count_pairs( oo, combined ) - count_pairs( oo, indices1 ) - count_pairs( oo, indices2 );
+}
+
+/**
+ * Counts the pairs that output_between would output.
+ *
+ * @param oo Output options.
+ * @param gene_locus Map from gene to the loci belonging to that gene.
+ *
+ * @return The number of pairs.
+ */
+uint64_t
+count_between(const output_options &oo, const std::map< std::string, std::vector<size_t> > &gene_locus)
+{
+    std::vector<size_t> all_indices;
+    std::map< std::string, std::vector<size_t> >::const_iterator it;
+    for(it = gene_locus.begin( ); it != gene_locus.end( ); ++it)
+    {
+        all_indices.insert( all_indices.end( ), it->second.begin( ), it->second.end( ) );
+    }
+
+    return count_pairs( oo, all_indices ) - count_within( oo, gene_locus );
+}
+
+/**
+ * Counts the pairs that output_between_restrict would output.
+ *
+ * @param oo Output options.
+ * @param gene_locus Map from gene to the loci belonging to that gene.
+ * @param gene_gene A list of pairs of genes to be considered.
+ *
+ * @return The number of pairs.
+ */
+uint64_t
+count_between_restrict(const output_options &oo, std::map< std::string, std::vector<size_t> > &gene_locus, const pair_vector &gene_gene)
+{
+    uint64_t num_pairs = 0;
+    for(int g = 0; g < gene_gene.size( ); g++)
+    {
+        num_pairs += count_cross( oo, gene_locus[ gene_gene[ g ].first ], gene_locus[ gene_gene[ g ].second ] );
+    }
+
+    return num_pairs;
+}
+
+/**
+ * Counts the pairs that output_set would output.
+ *
+ * @param oo Output options.
+ * @param snp_set Set of SNPs.
+ * @param ignore_in_set If true, ignore pairs between SNPs in the set.
+ *
+ * @return The number of pairs.
+ */
+uint64_t
+count_set(const output_options &oo, const std::set<size_t> &snp_set, bool ignore_in_set)
+{
+    std::vector<size_t> in_set( snp_set.begin( ), snp_set.end( ) );
+    std::vector<size_t> not_in_set;
+    for(size_t i = 0; i < oo.loci.size( ); i++)
+    {
+        if( snp_set.count( i ) == 0 )
+        {
+            not_in_set.push_back( i );
+        }
+    }
+
+    uint64_t num_pairs = count_cross( oo, in_set, not_in_set );
+    if( !ignore_in_set )
+    {
+        num_pairs += count_pairs( oo, in_set );
+    }
+
+    return num_pairs;
+}
+
+/**
+ * Counts the pairs that output_all would output.
+ *
+ * @param oo Output options.
+ *
+ * @return The number of pairs.
+ */
+uint64_t
+count_all(const output_options &oo)
+{
+    std::vector<size_t> indices( oo.loci.size( ) );
+    for(size_t i = 0; i < indices.size( ); i++)
+    {
+        indices[ i ] = i;
+    }
+
+    return count_pairs( oo, indices );
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -409,6 +746,8 @@ main(int argc, char *argv[])
     parser.add_option( "-n", "--set-no-ignore" ).help( "Output pairs in this set with all others including pairs in the set." );
     parser.add_option( "-p", "--split" ).help( "Split the output file in X files with extension .splitY." );
     parser.add_option( "-o", "--out" ).help( "Name of the output file." );
+    parser.add_option( "--cache" ).action( "store_true" ).help( "Read the mafs from the genotype cache genotype_plink_prefix" GENOTYPE_CACHE_EXTENSION ", it is created when it is missing or the plink file has changed size or modification time since it was created." );
+    parser.add_option( "--count" ).action( "store_true" ).help( "Only print the number of pairs that would be generated, no output file is written." );
 
     Values options = parser.parse_args( argc, argv );
     std::vector<std::string> args = parser.args( );
@@ -424,13 +763,66 @@ main(int argc, char *argv[])
     oo.combined_threshold = (double) options.get( "combined_maf" );
     oo.pos_threshold = (long) options.get( "distance" );
 
-    plink_file_ptr genotype_file = open_plink_file( args[ 0 ] );
-    oo.maf_vec = compute_maf( genotype_file );
+    plink_file_ptr genotype_file;
+    if( options.is_set( "cache" ) )
+    {
+        genotype_file = open_plink_file( args[ 0 ], true );
+        if( !read_cached_maf( args[ 0 ], genotype_file, oo.maf_vec ) )
+        {
+            printf( "besiq-pairs: error: Could not read or create the genotype cache.\n" );
+            exit( 1 );
+        }
+    }
+    else
+    {
+        genotype_file = open_plink_file( args[ 0 ] );
+        oo.maf_vec = compute_maf( genotype_file );
+    }
     oo.loci_info = std::vector<pio_locus_t>( genotype_file->get_loci( ) );
     oo.loci = genotype_file->get_locus_names( );
     
     std::ios_base::sync_with_stdio( false );
 
+    if( options.is_set( "count" ) )
+    {
+        uint64_t num_pairs = 0;
+        if( options.is_set( "within" ) )
+        {
+            std::map< std::string, std::vector<size_t> > gene_locus = parse_gene_locus( options[ "within" ].c_str( ), oo.loci );
+            num_pairs = count_within( oo, gene_locus );
+        }
+        else if( options.is_set( "set" ) )
+        {
+            std::set<size_t> snp_set = parse_set( options[ "set" ].c_str( ), oo.loci );
+            num_pairs = count_set( oo, snp_set, true );
+        }
+        else if( options.is_set( "set_no_ignore" ) )
+        {
+            std::set<size_t> snp_set = parse_set( options[ "set_no_ignore" ].c_str( ), oo.loci );
+            num_pairs = count_set( oo, snp_set, false );
+        }
+        else if( options.is_set( "between" ) )
+        {
+            std::map< std::string, std::vector<size_t> > gene_locus = parse_gene_locus( options[ "between" ].c_str( ), oo.loci );
+            if( !options.is_set( "restrict" ) )
+            {
+                num_pairs = count_between( oo, gene_locus );
+            }
+            else
+            {
+                pair_vector gene_pairs = parse_genes( options[ "restrict" ].c_str( ) );
+                num_pairs = count_between_restrict( oo, gene_locus, gene_pairs );
+            }
+        }
+        else
+        {
+            num_pairs = count_all( oo );
+        }
+
+        printf( "%llu\n", (unsigned long long) num_pairs );
+        return 0;
+    }
+
     if( !options.is_set( "out" ) )
     {
         printf( "besiq-pairs: error: No output file set.\n" );
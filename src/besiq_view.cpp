@@ -1,9 +1,13 @@
+#include <algorithm>
 #include <iostream>
 #include <iomanip>
+#include <map>
 
 #include <cpp-argparse/OptionParser.h>
 
+#include <besiq/io/metaresult.hpp>
 #include <besiq/io/resultfile.hpp>
+#include <besiq/io/result_index.hpp>
 
 using namespace optparse;
 
@@ -12,32 +16,140 @@ const std::string VERSION = "besiq 0.0.1";
 const std::string DESCRIPTION = "A tool for viewing binary result file.";
 const std::string EPILOG = "";
 
-struct comparator
+struct return_true : value_filter
 {
-    virtual bool operator()(const float& x, const float&y) const = 0;
+    bool operator()(float x) const { return true; };
 };
-
-struct return_true : comparator
+struct less : value_filter
 {
-    bool operator()(const float& x, const float&y) const { return true; };
+    less(float y) : m_y( y ) { };
+    bool operator()(float x) const { return x != result_get_missing( ) && x < m_y; };
+    bool may_match(float min, float max) const { return min < m_y; };
+    float m_y;
 };
-struct less : comparator
+struct less_equal : value_filter
 {
-    bool operator()(const float& x, const float&y) const { return x != result_get_missing( ) && x < y; };
+    less_equal(float y) : m_y( y ) { };
+    bool operator()(float x) const { return x != result_get_missing( ) && x <= m_y; };
+    bool may_match(float min, float max) const { return min <= m_y; };
+    float m_y;
 };
-struct less_equal : comparator
+struct greater : value_filter
 {
-    bool operator()(const float& x, const float&y) const { return x != result_get_missing( ) && x <= y; };
+    greater(float y) : m_y( y ) { };
+    bool operator()(float x) const { return x != result_get_missing( ) && x > m_y; };
+    bool may_match(float min, float max) const { return max > m_y; };
+    float m_y;
 };
-struct greater : comparator
+struct greater_equal : value_filter
 {
-    bool operator()(const float& x, const float&y) const { return x != result_get_missing( ) && x > y; };
+    greater_equal(float y) : m_y( y ) { };
+    bool operator()(float x) const { return x != result_get_missing( ) && x >= m_y; };
+    bool may_match(float min, float max) const { return max >= m_y; };
+    float m_y;
 };
-struct greater_equal : comparator
+
+/**
+ * A region on a chromosome.
+ */
+struct region
 {
-    bool operator()(const float& x, const float&y) const { return x != result_get_missing( ) && x >= y; };
+    std::string chromosome;
+    int64_t start;
+    int64_t end;
 };
 
+/**
+ * Parses a region on the form chr:start-end.
+ *
+ * @param str The string to parse.
+ * @param r The region will be stored here.
+ *
+ * @return True if the region could be parsed, false otherwise.
+ */
+bool
+parse_region(const std::string &str, region *r)
+{
+    size_t colon = str.find( ':' );
+    size_t dash = str.find( '-', colon );
+    if( colon == std::string::npos || dash == std::string::npos || colon == 0 )
+    {
+        return false;
+    }
+
+    r->chromosome = str.substr( 0, colon );
+    char *end;
+    std::string start_str = str.substr( colon + 1, dash - colon - 1 );
+    std::string end_str = str.substr( dash + 1 );
+    r->start = strtoll( start_str.c_str( ), &end, 10 );
+    if( start_str.empty( ) || *end != '\0' )
+    {
+        return false;
+    }
+    r->end = strtoll( end_str.c_str( ), &end, 10 );
+    if( end_str.empty( ) || *end != '\0' )
+    {
+        return false;
+    }
+
+    return r->start <= r->end;
+}
+
+/**
+ * Finds the records where one snp is in the first set and, if the
+ * second set is non-empty, the other snp is in the second set.
+ *
+ * @param result The result file.
+ * @param index The index of the result file.
+ * @param first Indices of the snps in the first set.
+ * @param second Indices of the snps in the second set, may be empty.
+ *
+ * @return The matching records in file order.
+ */
+std::vector<uint64_t>
+query_records(mresultfile &result, const result_index &index, const std::vector<uint32_t> &first, const std::vector<uint32_t> &second)
+{
+    size_t num_snps = result.num_snps( );
+    std::vector<bool> in_first( num_snps, false );
+    std::vector<bool> in_second( num_snps, false );
+    for(size_t i = 0; i < first.size( ); i++)
+    {
+        in_first[ first[ i ] ] = true;
+    }
+    for(size_t i = 0; i < second.size( ); i++)
+    {
+        in_second[ second[ i ] ] = true;
+    }
+
+    std::vector<uint64_t> records;
+    for(size_t i = 0; i < first.size( ); i++)
+    {
+        uint64_t length;
+        const uint64_t *snp_records = index.snp_records( first[ i ], &length );
+        records.insert( records.end( ), snp_records, snp_records + length );
+    }
+    std::sort( records.begin( ), records.end( ) );
+    records.erase( std::unique( records.begin( ), records.end( ) ), records.end( ) );
+
+    if( second.size( ) == 0 )
+    {
+        return records;
+    }
+
+    std::vector<uint64_t> between;
+    uint32_t snps[ 2 ];
+    for(size_t i = 0; i < records.size( ); i++)
+    {
+        result.get_snps( records[ i ], snps );
+        if( ( in_first[ snps[ 0 ] ] && in_second[ snps[ 1 ] ] ) || ( in_first[ snps[ 1 ] ] && in_second[ snps[ 0 ] ] ) )
+        {
+            between.push_back( records[ i ] );
+        }
+    }
+
+    return between;
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -52,7 +164,13 @@ main(int argc, char *argv[])
     parser.add_option( "-t", "--threshold" ).set_default( 0.05 ).help( "Filter using this threshold (default = 0.05)." );
     parser.add_option( "-f", "--field" ).set_default( 0 ).help( "The value field to filter on, the field index of the first non snp name is 0." );
     parser.add_option( "-o", "--out" ).help( "Write results to a binary result file." );
+    parser.add_option( "--columnar" ).action( "store_true" ).help( "Write the binary result file in the block-compressed columnar format." );
     parser.add_option( "--force" ).action( "store_true" ).help( "View possibly corrupted files." );
+    parser.add_option( "--threads" ).type( "int" ).set_default( 1 ).help( "Number of threads to use when filtering, 0 uses the OpenMP default (default = 1)." );
+    parser.add_option( "--build-index" ).action( "store_true" ).help( "Build an index of the pairs of each snp next to each result file and exit." );
+    parser.add_option( "--bim" ).help( "Plink .bim file with snp positions, used by --build-index to allow --region queries." );
+    parser.add_option( "--snp" ).action( "append" ).help( "Only show pairs that contain this snp, can be given multiple times. Requires an index." );
+    parser.add_option( "--region" ).action( "append" ).help( "Only show pairs with a snp in this region 'chr:start-end'. If given twice, only pairs between the two regions are shown, and if given with --snp only pairs between the snps and the region. Requires an index." );
     
     Values options = parser.parse_args( argc, argv );
     std::vector<std::string> args = parser.args( );
@@ -63,44 +181,110 @@ main(int argc, char *argv[])
         exit( 1 );
     }
 
-    std::vector<bresultfile *> result_files;
+    if( (int) options.get( "threads" ) < 0 )
+    {
+        std::cerr << "besiq-view: error: --threads must be 0 or more." << std::endl;
+        exit( 1 );
+    }
+
+    if( (bool) options.get( "count" ) )
+    {
+        for(int i = 0; i < args.size( ); i++)
+        {
+            result_header header;
+            bool corrupted;
+            if( !peek_result_header( args[ i ], &header, &corrupted ) )
+            {
+                std::cerr << "besiq-view: error: Could not open result file: '" << args[ i ] << "' skipping." << std::endl;
+                continue;
+            }
+
+            if( corrupted && !options.is_set( "force" ) )
+            {
+                std::cerr << "Result file '" << args[ i ] << "' may have been corrupted, ignoring, use --force to view anyway." << std::endl;
+                continue;
+            }
+
+            std::cout << header.num_pairs << std::endl;
+        }
+        return 0;
+    }
+
+    std::vector<resultfile *> result_files;
+    std::vector<std::string> result_paths;
     for(int i = 0; i < args.size( ); i++)
     {
-        bresultfile *result = new bresultfile( args[ i ] );
-        if( !result->open( ) )
+        resultfile *result = open_result_file( args[ i ] );
+        if( result == NULL || dynamic_cast<tresultfile *>( result ) != NULL || !result->open( ) )
         {
             std::cerr << "besiq-view: error: Could not open result file: '" << args[ i ] << "' skipping." << std::endl;
             continue;
         }
         
-        if( result->is_corrupted( ) && !options.is_set( "force" ) )
+        mresultfile *row_result = dynamic_cast<mresultfile *>( result );
+        if( row_result != NULL && row_result->is_corrupted( ) && !options.is_set( "force" ) )
         {
             std::cerr << "Result file '" << args[ i ] << "' may have been corrupted, ignoring, use --force to view anyway." << std::endl;
             continue;
         }
 
         result_files.push_back( result );
+        result_paths.push_back( args[ i ] );
     }
    
-    if( (bool) options.get( "count" ) )
+    if( result_files.size( ) == 0 )
     {
+        std::cerr << "besiq-view: error: No result files could be opened." << std::endl;
+        return 1;
+    }
+
+    if( options.is_set( "build_index" ) )
+    {
+        std::string bim_path = options.is_set( "bim" ) ? options[ "bim" ] : "";
         for(int i = 0; i < result_files.size( ); i++)
         {
-            std::cout << result_files[ i ]->num_pairs( ) << std::endl;
+            mresultfile *result = dynamic_cast<mresultfile *>( result_files[ i ] );
+            if( result == NULL || !build_result_index( *result, result_paths[ i ], bim_path ) )
+            {
+                std::cerr << "besiq-view: error: Could not build index for '" << result_paths[ i ] << "'." << std::endl;
+                return 1;
+            }
         }
         return 0;
     }
 
+    std::vector<region> regions;
+    if( options.is_set( "region" ) )
+    {
+        const std::list<std::string> &region_strs = options.all( "region" );
+        for(std::list<std::string>::const_iterator it = region_strs.begin( ); it != region_strs.end( ); ++it)
+        {
+            region r;
+            if( !parse_region( *it, &r ) )
+            {
+                std::cerr << "besiq-view: error: Could not parse region '" << *it << "', should be chr:start-end." << std::endl;
+                return 1;
+            }
+            regions.push_back( r );
+        }
+    }
+    bool use_index = options.is_set( "snp" ) || regions.size( ) > 0;
+    if( regions.size( ) > 2 || ( options.is_set( "snp" ) && regions.size( ) > 1 ) )
+    {
+        std::cerr << "besiq-view: error: At most two sets of snps can be given with --snp and --region." << std::endl;
+        return 1;
+    }
+
     float threshold = (float) options.get( "threshold" );
     size_t field = (size_t) options.get( "field" );
-    std::map< std::string, comparator * > op;
+    std::map< std::string, value_filter * > op;
     op[ "none" ] = new return_true( );
-    op[ "lt" ] = new less( );
-    op[ "le" ] = new less_equal( );
-    op[ "gt" ] = new greater( );
-    op[ "ge" ] = new greater_equal( );
+    op[ "lt" ] = new less( threshold );
+    op[ "le" ] = new less_equal( threshold );
+    op[ "gt" ] = new greater( threshold );
+    op[ "ge" ] = new greater_equal( threshold );
 
-    comparator &compare = *op[ (std::string) options.get( "operation" ) ];
+    value_filter &filter = *op[ (std::string) options.get( "operation" ) ];
 
     std::vector<std::string> header = result_files[ 0 ]->get_header( );
     size_t header_size = header.size( );
@@ -112,9 +296,18 @@ main(int argc, char *argv[])
             return 1;
         }
     }
+    if( field >= header_size )
+    {
+        std::cerr << "besiq-view: error: Field is larger than the number of columns." << std::endl;
+        return 1;
+    }
     
     resultfile *output_file;
-    if( options.is_set( "out" ) )
+    if( options.is_set( "out" ) && options.is_set( "columnar" ) )
+    {
+        output_file = new cresultfile( options[ "out" ], result_files[ 0 ]->get_snp_names( ) );
+    }
+    else if( options.is_set( "out" ) )
     {
         output_file = new bresultfile( options[ "out" ], result_files[ 0 ]->get_snp_names( ) );
     }
@@ -130,25 +323,60 @@ main(int argc, char *argv[])
 
     output_file->set_header( header );
 
-    std::setprecision( 4 );
-    float *output = new float[ header_size ];
-    for(int i = 0; i < result_files.size( ); i++)
+    if( !use_index )
     {
-        bresultfile &res = *result_files[ i ];
+        metaresultfile meta_result( result_files );
+        meta_result.filter( field, filter, output_file, (int) options.get( "threads" ) );
+        delete output_file;
 
-        std::pair<std::string, std::string> pair;
+        return 0;
+    }
 
-        while( res.read( &pair, output ) )
+    std::vector<float> values( header_size );
+    std::pair<std::string, std::string> pair;
+    for(int i = 0; i < result_files.size( ); i++)
+    {
+        mresultfile *result = dynamic_cast<mresultfile *>( result_files[ i ] );
+        result_index index( result_paths[ i ] );
+        if( result == NULL || !index.open( *result ) )
         {
-            if( !compare( output[ field ], threshold ) )
+            std::cerr << "besiq-view: error: No up to date index for '" << result_paths[ i ] << "', create it with --build-index." << std::endl;
+            return 1;
+        }
+
+        std::vector<uint32_t> sets[ 2 ];
+        size_t cur_set = 0;
+        if( options.is_set( "snp" ) )
+        {
+            const std::list<std::string> &snps = options.all( "snp" );
+            for(std::list<std::string>::const_iterator it = snps.begin( ); it != snps.end( ); ++it)
             {
-                continue;
+                uint32_t snp;
+                if( result->find_snp( *it, &snp ) )
+                {
+                    sets[ 0 ].push_back( snp );
+                }
             }
+            cur_set++;
+        }
+        for(size_t j = 0; j < regions.size( ); j++)
+        {
+            sets[ cur_set++ ] = index.region_snps( regions[ j ].chromosome, regions[ j ].start, regions[ j ].end );
+        }
+        if( cur_set == 2 && sets[ 1 ].size( ) == 0 )
+        {
+            continue;
+        }
 
-            output_file->write( pair, output );
+        std::vector<uint64_t> records = query_records( *result, index, sets[ 0 ], sets[ 1 ] );
+        for(size_t j = 0; j < records.size( ); j++)
+        {
+            if( result->read_record( records[ j ], &pair, &values[ 0 ] ) && filter( values[ field ] ) )
+            {
+                output_file->write( pair, &values[ 0 ] );
+            }
         }
     }
-    delete[] output;
     delete output_file;
     
     return 0;
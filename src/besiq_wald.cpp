@@ -27,6 +27,7 @@ main(int argc, char *argv[])
     parser.add_option( "-a", "--param" ).metavar( "param" ).help( "The model to use for the phenotype, 'binomial' or 'normal', default = 'binomial'." );
     parser.add_option( "-u", "--unequal-var" ).action( "store_true" ).help( "One variance is estimated for each genotype in the linear model." ).set_default( false );
     parser.add_option( "-s", "--separate" ).action( "store_true" ).help( "Separate p-values for each beta is computed." ).set_default( false );
+    parser.add_option( "--all-pheno" ).action( "store_true" ).help( "Test every phenotype in the --pheno file with the normal model, each pair is only counted once. A sample is only removed if all its phenotypes are missing." );
     
     Values options = parser.parse_args( argc, argv );
     if( parser.args( ).size( ) != 2 )
@@ -34,6 +35,11 @@ main(int argc, char *argv[])
         parser.print_help( );
         exit( 1 );
     }
+    if( options.is_set( "all_pheno" ) && ( !options.is_set( "pheno" ) || options[ "model" ] != "normal" || (bool) options.get( "separate" ) ) )
+    {
+        std::cerr << "besiq: error: --all-pheno needs --pheno and can only be used with the normal model." << std::endl;
+        exit( 1 );
+    }
     shared_ptr<common_options> parsed_data = parse_common_options( options, parser.args( ) );
 
     method_type *m = NULL;
@@ -1,5 +1,7 @@
 #include <armadillo>
 
+#include <besiq/stats/snp_count.hpp>
+
 #include "common_options.hpp"
 
 const std::string VERSION = "Bayesic 0.5.9";
@@ -19,17 +21,116 @@ create_common_options(const std::string &usage, const std::string &description,
     parser.add_option( "-p", "--pheno" ).help( "Read phenotypes from this file instead of a plink file." );
     parser.add_option( "-e", "--mpheno" ).help( "Name of the phenotype that you want to read (if there are more than one in the phenotype file)." );
     parser.add_option( "-o", "--out" ).help( "The output file that will contain the results (binary)." );
+    parser.add_option( "--columnar" ).action( "store_true" ).set_default( 0 ).help( "Write the output file in the block-compressed columnar format." );
+    parser.add_option( "--compact" ).action( "store_true" ).set_default( 0 ).help( "Store p-values as 16-bit log-scale values (relative error < 0.12%) and df as 8-bit integers in the binary output file." );
+    parser.add_option( "--cache" ).action( "store_true" ).set_default( 0 ).help( "Read the genotypes from plink_file" GENOTYPE_CACHE_EXTENSION ", the cache is created when it is missing or the plink file has changed size or modification time since it was created." );
+    parser.add_option( "--mem-budget" ).type( "int" ).metavar( "MB" ).help( "Keep at most this many megabytes of decoded genotypes in memory, other genotypes are read from the .bed file when needed. Works best when the pair file is sorted." );
+    parser.add_option( "--genotypes-shm" ).metavar( "NAME" ).help( "Use the genotypes in this shared memory segment created by 'besiq load' instead of decoding the plink file." );
     parser.add_option( "-c", "--cov" ).action( "store" ).type( "string" ).metavar( "filename" ).help( "Performs the analysis by including the covariates in this file." );
     parser.add_option( "-t", "--threshold" ).help( "Only output pairs with a p-value less than this." ).set_default( -9 );
     parser.add_option( "--split" ).help( "Runs the analysis on a part of the pair file, and this is part X of 1-<num_splits> parts (default = 1)." ).set_default( 1 );
     parser.add_option( "--num-splits" ).help( "Sets the number of parts to split the pair file in (default = 1)." ).set_default( 1 );
     parser.add_option( "--print-params" ).action( "store_true" ).set_default( 0 ).help( "Print parameter estimates in result file." );
+    parser.add_option( "--top" ).type( "int" ).set_default( 0 ).metavar( "K" ).help( "Print the K pairs with the smallest p-values, or the largest posteriors, when done." );
+    parser.add_option( "--grid" ).metavar( "filename" ).help( "Summarize the p-values in a grid over the genome and write it to this file." );
+    parser.add_option( "--hist" ).action( "store_true" ).set_default( 0 ).help( "Print a histogram of -log10 p-values, or of the posteriors, when done." );
+    parser.add_option( "--threads" ).type( "int" ).set_default( 1 ).help( "Count with up to this many threads. For large sample sizes the samples of each pair are split between the threads, otherwise several pairs are counted at once (default = 1)." );
     
     return parser;
 }
 
+/**
+ * Determines whether it is cheaper to scan the pair file for the
+ * snps that are used than to decode all genotypes. Scanning a binary
+ * pair file reads 8 bytes per pair, and decoding reads a quarter of
+ * a byte per sample and snp.
+ *
+ * @param path Path to the pair file.
+ * @param genotype_file The plink file.
+ * @param num_splits Number of parts of the pair file.
+ *
+ * @return True if the pair file should be scanned, false otherwise.
+ */
+static bool
+is_prescan_worthwhile(const std::string &path, plink_file_ptr genotype_file, size_t num_splits)
+{
+    if( path == "-" )
+    {
+        return false;
+    }
+
+    pairfile *pairs = open_pair_file( path, genotype_file->get_locus_names( ) );
+    if( pairs == NULL || !pairs->open( ) )
+    {
+        delete pairs;
+        return false;
+    }
+
+    /* Text files are small, since they are only used for a few pairs. */
+    bool worthwhile = true;
+    bpairfile *binary_pairs = dynamic_cast<bpairfile *>( pairs );
+    if( binary_pairs != NULL )
+    {
+        uint64_t pairs_per_split = ( binary_pairs->num_pairs( ) + num_splits - 1 ) / num_splits;
+        uint64_t bed_bytes = (uint64_t) genotype_file->get_loci( ).size( ) * ( ( genotype_file->get_samples( ).size( ) + 3 ) / 4 );
+        worthwhile = 2 * sizeof( uint32_t ) * pairs_per_split < bed_bytes;
+    }
+    delete pairs;
+
+    return worthwhile;
+}
+
+void
+remove_missing_samples(genotype_matrix_ptr genotypes, method_data_ptr data)
+{
+    if( data->samples.n_elem != data->missing.n_elem )
+    {
+        data->samples = uvec( data->missing.n_elem );
+        for(size_t i = 0; i < data->samples.n_elem; i++)
+        {
+            data->samples[ i ] = i;
+        }
+    }
+
+    uvec keep = find( data->missing == 0 );
+    if( keep.n_elem == data->missing.n_elem )
+    {
+        return;
+    }
+
+    std::vector<size_t> samples( keep.begin( ), keep.end( ) );
+    if( !genotypes->select_samples( samples ) )
+    {
+        return;
+    }
+
+    uvec kept_samples( keep.n_elem );
+    vec phenotype( keep.n_elem );
+    mat phenotypes( data->phenotypes.n_rows > 0 ? keep.n_elem : 0, data->phenotypes.n_cols );
+    mat covariate_matrix( data->covariate_matrix.n_rows > 0 ? keep.n_elem : 0, data->covariate_matrix.n_cols );
+    for(size_t i = 0; i < keep.n_elem; i++)
+    {
+        kept_samples[ i ] = data->samples[ keep[ i ] ];
+        phenotype[ i ] = data->phenotype[ keep[ i ] ];
+        if( phenotypes.n_rows > 0 )
+        {
+            phenotypes.row( i ) = data->phenotypes.row( keep[ i ] );
+        }
+        if( covariate_matrix.n_rows > 0 )
+        {
+            covariate_matrix.row( i ) = data->covariate_matrix.row( keep[ i ] );
+        }
+    }
+
+    data->samples = kept_samples;
+    data->phenotype = phenotype;
+    data->phenotypes = phenotypes;
+    data->covariate_matrix = covariate_matrix;
+    data->missing = zeros<uvec>( keep.n_elem );
+}
+
 shared_ptr<common_options>
-parse_common_options(optparse::Values &options, const std::vector<std::string> &args)
+parse_common_options(optparse::Values &options, const std::vector<std::string> &args, bool need_all_snps)
 {
     shared_ptr<common_options> result;
     if( args.size( ) != 2 )
@@ -37,11 +138,6 @@ parse_common_options(optparse::Values &options, const std::vector<std::string> &
         std::cerr << "besiq: error: Pairs or genetypes is missing." << std::endl;
         exit( 1 );
     }
-    /* Read all genotypes */
-    plink_file_ptr genotype_file = open_plink_file( args[ 1 ], true );
-    genotype_matrix_ptr genotypes = create_genotype_matrix( genotype_file );
-    
-    /* Create pair iterator */
     size_t split = (size_t) options.get( "split" );
     size_t num_splits = (size_t) options.get( "num_splits" );
     if( split > num_splits || split == 0 || num_splits == 0 )
@@ -49,7 +145,60 @@ parse_common_options(optparse::Values &options, const std::vector<std::string> &
         std::cerr << "besiq: error: Num splits and split must be > 0, and split <= num_splits." << std::endl;
         exit( 1 );
     }
+
+    /* Read all genotypes */
+    plink_file_ptr genotype_file = open_plink_file( args[ 1 ], true );
+    genotype_matrix_ptr genotypes;
+    if( options.is_set( "genotypes_shm" ) )
+    {
+        genotypes = attach_genotype_shm( options[ "genotypes_shm" ], genotype_file, true );
+        if( !genotypes )
+        {
+            std::cerr << "besiq: error: Could not attach shared memory segment '" << options[ "genotypes_shm" ] << "', or it was created from a different plink file." << std::endl;
+            exit( 1 );
+        }
+    }
+    else if( (bool) options.get( "cache" ) )
+    {
+        genotypes = open_genotype_cache( args[ 1 ], genotype_file, true );
+        if( !genotypes && create_genotype_cache( args[ 1 ], genotype_file, true ) )
+        {
+            genotypes = open_genotype_cache( args[ 1 ], genotype_file, true );
+        }
+        if( !genotypes )
+        {
+            std::cerr << "besiq: warning: Could not create genotype cache, reading the plink file instead." << std::endl;
+            genotype_file = open_plink_file( args[ 1 ], true );
+            genotypes = create_genotype_matrix( genotype_file );
+        }
+    }
+    else if( options.is_set( "mem_budget" ) )
+    {
+        size_t mem_budget = (size_t) (int) options.get( "mem_budget" ) * 1024 * 1024;
+        genotypes = create_on_demand_genotype_matrix( args[ 1 ], genotype_file, true, mem_budget );
+        if( !genotypes )
+        {
+            std::cerr << "besiq: warning: The .bed file can not be read on demand, reading all genotypes instead." << std::endl;
+            genotype_file = open_plink_file( args[ 1 ], true );
+            genotypes = create_genotype_matrix( genotype_file );
+        }
+    }
+    else
+    {
+        /* Only decode the snps that are part of a pair if that is cheaper. */
+        std::vector<bool> used;
+        if( !need_all_snps && is_prescan_worthwhile( args[ 0 ], genotype_file, num_splits ) &&
+            find_pair_snps( args[ 0 ], genotype_file->get_locus_names( ), split, num_splits, &used ) )
+        {
+            genotypes = create_subset_genotype_matrix( args[ 1 ], genotype_file, true, used );
+        }
+        else
+        {
+            genotypes = create_genotype_matrix( genotype_file );
+        }
+    }
     
+    /* Create pair iterator */
     pairfile *pairs = open_pair_file( args[ 0 ].c_str( ), genotype_file->get_locus_names( ) );
     if( pairs == NULL || !pairs->open( split, num_splits ) )
     {
@@ -64,7 +213,28 @@ parse_common_options(optparse::Values &options, const std::vector<std::string> &
     data->missing = zeros<uvec>( genotype_file->get_samples( ).size( ) );
     data->fast_inversion = false;
     std::vector<std::string> order = genotype_file->get_sample_iids( );
-    if( options.is_set( "pheno" ) )
+    if( options.is_set( "pheno" ) && options.is_set( "all_pheno" ) )
+    {
+        /* Each phenotype has its own missing values, a sample is only removed if all are missing. */
+        std::ifstream phenotype_file( options[ "pheno" ].c_str( ) );
+        std::vector<std::string> header;
+        uvec any_missing = zeros<uvec>( order.size( ) );
+        data->phenotypes = parse_covariate_matrix( phenotype_file, any_missing, order, &header );
+        data->phenotype_names.assign( header.begin( ) + 2, header.end( ) );
+        for(size_t i = 0; i < data->phenotypes.n_rows; i++)
+        {
+            data->missing[ i ] = 1;
+            for(size_t j = 0; j < data->phenotypes.n_cols; j++)
+            {
+                if( arma::is_finite( data->phenotypes( i, j ) ) )
+                {
+                    data->missing[ i ] = 0;
+                }
+            }
+        }
+        data->phenotype = data->phenotypes.col( 0 );
+    }
+    else if( options.is_set( "pheno" ) )
     {
         std::ifstream phenotype_file( options[ "pheno" ].c_str( ) );
         data->phenotype = parse_phenotypes( phenotype_file, data->missing, order, options[ "mpheno" ] );
@@ -78,6 +248,29 @@ parse_common_options(optparse::Values &options, const std::vector<std::string> &
         std::ifstream covariate_file( options[ "cov" ].c_str( ) );
         data->covariate_matrix = parse_covariate_matrix( covariate_file, data->missing, order );
     }
+    remove_missing_samples( genotypes, data );
+
+    /* Long rows split the samples of each pair between the threads, otherwise batches of pairs are
+     * counted in parallel. Rows that are decoded on demand are not batched. */
+    int num_threads = (int) options.get( "threads" );
+    set_count_threads( num_threads );
+    if( num_threads > 1 && get_count_threads( data->phenotype.n_elem ) <= 1 && genotypes->is_on_demand( ) )
+    {
+        std::cerr << "besiq: warning: Too few samples to count each pair with several threads, and pairs are counted one at a time with --mem-budget. Use --split to run parts of the pair file in parallel instead." << std::endl;
+    }
+
+    /* Summaries, the full results are only written if requested. */
+    size_t num_top = (int) options.get( "top" );
+    bool use_hist = (bool) options.get( "hist" );
+    bool use_summary = num_top > 0 || use_hist || options.is_set( "grid" );
+    if( use_summary )
+    {
+        data->summary = shared_ptr<pair_summary>( new pair_summary( num_top, use_hist ) );
+        if( options.is_set( "grid" ) )
+        {
+            data->summary->enable_grid( genotype_file->get_loci( ), options[ "grid" ] );
+        }
+    }
 
     /* XXX: Implement proper log file. */
     arma::set_stream_err1( std::cerr );
@@ -85,9 +278,22 @@ parse_common_options(optparse::Values &options, const std::vector<std::string> &
     
     /* Open results. */
     resultfile *result_file = NULL;
-    if( options.is_set( "out" ) )
+    if( options.is_set( "out" ) && (bool) options.get( "columnar" ) )
+    {
+        result_file = new cresultfile( options[ "out" ], genotype_file->get_locus_names( ) );
+    }
+    else if( options.is_set( "out" ) )
+    {
+        bresultfile *row_file = new bresultfile( options[ "out" ], genotype_file->get_locus_names( ) );
+        if( (bool) options.get( "compact" ) )
+        {
+            row_file->use_compact_encodings( );
+        }
+        result_file = row_file;
+    }
+    else if( use_summary )
     {
-        result_file = new bresultfile( options[ "out" ], genotype_file->get_locus_names( ) );
+        result_file = new nresultfile( );
     }
     else
     {
@@ -7,6 +7,7 @@
 
 #include <plink/plink_file.hpp>
 #include <besiq/io/covariates.hpp>
+#include <besiq/io/genotype_image.hpp>
 #include <besiq/io/pairfile.hpp>
 #include <besiq/io/resultfile.hpp>
 #include <besiq/method/method.hpp>
@@ -35,6 +36,29 @@ struct common_options
 
 optparse::OptionParser create_common_options(const std::string &usage, const std::string &description, bool support_cov);
 
-shared_ptr<common_options> parse_common_options(optparse::Values &options, const std::vector<std::string> &args);
+/**
+ * Reads the genotypes, pairs, phenotypes and covariates given on
+ * the command line, and opens the result file.
+ *
+ * @param options The parsed options.
+ * @param args The pair file and the plink file.
+ * @param need_all_snps If false, only the snps in the pair file may be decoded.
+ *
+ * @return The data for the analysis, exits on errors.
+ */
+shared_ptr<common_options> parse_common_options(optparse::Values &options, const std::vector<std::string> &args, bool need_all_snps = false);
+
+/**
+ * Removes samples that are marked as missing from the genotypes,
+ * phenotype and covariates, so that the methods never visit them.
+ * Nothing is removed when the genotypes are shared with other
+ * processes or decoded on demand, the samples are then only
+ * marked as missing. The .fam index of each kept sample is stored
+ * in data->samples in the original order, also over repeated calls.
+ *
+ * @param genotypes The genotypes.
+ * @param data The phenotype, covariates and missing samples.
+ */
+void remove_missing_samples(genotype_matrix_ptr genotypes, method_data_ptr data);
 
 #endif /* End of __COMMON_OPTION_H__ */
@@ -1,7 +1,11 @@
 #include <gtest/gtest.h>
 
+#include <cmath>
+#include <vector>
+
 #include <plink/snp_row.hpp>
 #include <besiq/stats/besiq_models.hpp>
+#include <besiq/stats/dirichlet.hpp>
 
 using namespace arma;
 
@@ -33,3 +37,135 @@ TEST(BayesicModelsTest, SIndependent)
     log_double likelihood = model.prob( snp1, snp2, phenotype, weight );
     ASSERT_NEAR( likelihood.value( ), 0.09, 0.001 );
 }
+
+/**
+ * Integrates the sindependent likelihood over the same draws as the
+ * model, but evaluates the risk and its complement in each cell
+ * directly instead of from the margins.
+ *
+ * @param counts The joint counts, see joint_count.
+ * @param alpha The prior of the draws.
+ * @param num_draws The number of draws.
+ */
+static log_double
+direct_sindependent(const arma::mat &counts, const arma::vec &alpha, int num_draws)
+{
+    dir_generator rdir( 0 );
+    log_double sum = 0.0;
+    for(int k = 0; k < num_draws; k++)
+    {
+        double p[ 3 ];
+        double q[ 3 ];
+        for(int i = 0; i < 3; i++)
+        {
+            p[ i ] = rdir.sample( alpha )[ 0 ];
+            q[ i ] = rdir.sample( alpha )[ 0 ];
+        }
+
+        log_double likelihood = 1.0;
+        for(int i = 0; i < 3; i++)
+        {
+            for(int j = 0; j < 3; j++)
+            {
+                double risk = p[ i ] * q[ j ] + ( 1.0 - p[ i ] ) * q[ j ] + p[ i ] * ( 1.0 - q[ j ] );
+                likelihood *= log_double::from_log( counts( 3 * i + j, 1 ) * log( risk ) + counts( 3 * i + j, 0 ) * log( 1.0 - risk ) );
+            }
+        }
+        sum += likelihood;
+    }
+
+    return log_double::from_log( sum.log_value( ) - log( (double) num_draws ) );
+}
+
+/**
+ * Creates joint counts for a few tables with different margins.
+ */
+static std::vector<arma::mat>
+sindependent_tables()
+{
+    std::vector<arma::mat> tables;
+    for(int t = 0; t < 4; t++)
+    {
+        arma::mat counts( 9, 2 );
+        for(int c = 0; c < 9; c++)
+        {
+            counts( c, 0 ) = ( 7 * c + 3 * t ) % 11;
+            counts( c, 1 ) = ( 5 * c + t ) % 6;
+        }
+        tables.push_back( counts );
+    }
+
+    return tables;
+}
+
+TEST(BayesicModelsTest, SIndependentSameAsDirect)
+{
+    arma::vec alpha = arma::ones<arma::vec>( 2 );
+    sindependent model( 1.0, alpha, 500 );
+
+    std::vector<arma::mat> tables = sindependent_tables( );
+    for(size_t t = 0; t < tables.size( ); t++)
+    {
+        log_double expected = direct_sindependent( tables[ t ], alpha, 500 );
+        ASSERT_NEAR( model.prob( tables[ t ] ).log_value( ), expected.log_value( ), 1e-7 ) << "table " << t;
+    }
+}
+
+TEST(BayesicModelsTest, SIndependentOrderIndependent)
+{
+    arma::vec alpha = arma::ones<arma::vec>( 2 );
+    sindependent forward( 1.0, alpha, 500 );
+    sindependent backward( 1.0, alpha, 500 );
+
+    std::vector<arma::mat> tables = sindependent_tables( );
+    std::vector<double> forward_prob( tables.size( ) );
+    for(size_t t = 0; t < tables.size( ); t++)
+    {
+        forward_prob[ t ] = forward.prob( tables[ t ] ).log_value( );
+    }
+
+    for(size_t t = tables.size( ); t > 0; t--)
+    {
+        ASSERT_EQ( forward_prob[ t - 1 ], backward.prob( tables[ t - 1 ] ).log_value( ) );
+    }
+
+    /* Evaluating the same model again gives the same likelihood. */
+    ASSERT_EQ( forward_prob[ 0 ], forward.prob( tables[ 0 ] ).log_value( ) );
+}
+
+TEST(BayesicModelsTest, LdAssocFromJointCounts)
+{
+    arma::vec alpha = arma::ones<arma::vec>( 2 );
+    ld_assoc first( 1.0, alpha, true );
+    ld_assoc second( 1.0, alpha, false );
+
+    snp_row snp1;
+    snp_row snp2;
+    snp1.resize( 12 );
+    snp2.resize( 12 );
+    arma::vec phenotype = arma::zeros<arma::vec>( 12 );
+    for(int i = 0; i < 12; i++)
+    {
+        snp1.assign( i, i % 3 );
+        snp2.assign( i, ( i / 2 ) % 3 );
+        phenotype[ i ] = ( i % 5 ) < 2;
+    }
+    snp2.assign( 7, 3 );
+
+    arma::vec weight = arma::ones<arma::vec>( 12 );
+    arma::mat counts1 = single_count( snp1, snp2, phenotype, weight );
+    arma::mat counts2 = single_count( snp2, snp1, phenotype, weight );
+
+    log_double expected1 = 1.0;
+    log_double expected2 = 1.0;
+    for(int i = 0; i < 3; i++)
+    {
+        arma::vec row_count1 = counts1.row( i ).t( );
+        arma::vec row_count2 = counts2.row( i ).t( );
+        expected1 *= log_double::from_log( ldirmult( row_count1, alpha ) );
+        expected2 *= log_double::from_log( ldirmult( row_count2, alpha ) );
+    }
+
+    ASSERT_NEAR( first.prob( snp1, snp2, phenotype, weight ).log_value( ), expected1.log_value( ), 1e-9 );
+    ASSERT_NEAR( second.prob( snp1, snp2, phenotype, weight ).log_value( ), expected2.log_value( ), 1e-9 );
+}
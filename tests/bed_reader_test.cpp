@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <plink/bed_cache.hpp>
+#include <plink/bed_reader.hpp>
+#include <plink/plink_file.hpp>
+
+#include "plink_fixture.hpp"
+
+/**
+ * Sample i of snp j has the plink code ( i + j ) % 4.
+ */
+static unsigned char
+cyclic_genotype(size_t snp, size_t sample)
+{
+    const unsigned char decoded[ 4 ] = { 0, 3, 1, 2 };
+    return decoded[ ( sample + snp ) % 4 ];
+}
+
+/**
+ * Writes a .bed file with the genotypes of cyclic_genotype.
+ *
+ * @param num_samples Number of samples.
+ * @param num_snps Number of snps.
+ *
+ * @return The path to the file.
+ */
+static std::string
+write_bed(size_t num_samples, size_t num_snps)
+{
+    std::string path = create_fixture_path( "bed_reader_test" );
+    write_bed_fixture( path, num_samples, num_snps, cyclic_genotype, false );
+
+    return path;
+}
+
+TEST(bed_reader_test, decode)
+{
+    const unsigned char decoded[ 4 ] = { 0, 3, 1, 2 };
+    std::string path = write_bed( 21, 5 );
+
+    bed_reader reader;
+    ASSERT_TRUE( reader.open( path, 21, 5, false ) );
+    ASSERT_FALSE( reader.open( path, 21, 6, false ) );
+
+    snp_row row;
+    for(size_t j = 0; j < 5; j++)
+    {
+        ASSERT_TRUE( reader.read_row( j, row ) );
+        ASSERT_EQ( 21, row.size( ) );
+        for(size_t i = 0; i < 21; i++)
+        {
+            ASSERT_EQ( decoded[ ( i + j ) % 4 ], row[ i ] );
+        }
+        ASSERT_EQ( 0, row.data( )[ 1 ] >> 10 );
+    }
+    ASSERT_FALSE( reader.read_row( 5, row ) );
+
+    /* Snp 3 starts with code 11, i.e. genotype 2, and is flipped. */
+    bed_reader flipped;
+    ASSERT_TRUE( flipped.open( path, 21, 5, true ) );
+    ASSERT_TRUE( flipped.read_row( 3, row ) );
+    ASSERT_EQ( 0, row[ 0 ] );
+    ASSERT_EQ( 1, row[ 3 ] );
+    ASSERT_EQ( 3, row[ 2 ] );
+
+    unlink( path.c_str( ) );
+}
+
+TEST(bed_reader_test, cache)
+{
+    std::string path = write_bed( 40, 200 );
+    bed_reader reader;
+    ASSERT_TRUE( reader.open( path, 40, 200, true ) );
+
+    bed_cache cache( 2048 );
+    ASSERT_TRUE( cache.open( path, 40, 200, true ) );
+
+    snp_row row;
+    for(size_t k = 0; k < 600; k++)
+    {
+        size_t j = ( k * 37 ) % 200;
+        cache.prefetch( ( j + 11 ) % 200 );
+        snp_row *cached = cache.get_row( j );
+
+        ASSERT_TRUE( reader.read_row( j, row ) );
+        for(size_t i = 0; i < 40; i++)
+        {
+            ASSERT_EQ( row[ i ], (*cached)[ i ] );
+        }
+    }
+
+    unlink( path.c_str( ) );
+}
+
+TEST(bed_reader_test, same_as_plink_file)
+{
+    /* Sample counts that leave 3, 2, 1 and no padded genotypes in the last byte. */
+    size_t sizes[] = { 21, 70, 71, 64 };
+    for(int k = 0; k < 4; k++)
+    {
+        size_t num_samples = sizes[ k ];
+        std::string prefix = write_plink_fixture( "bed_reader_test", num_samples, 12, cyclic_genotype, true );
+
+        genotype_matrix_ptr expected = create_genotype_matrix( open_plink_file( prefix, true ) );
+        genotype_matrix_ptr on_demand = create_on_demand_genotype_matrix( prefix, open_plink_file( prefix, true ), true, 1024 );
+        ASSERT_TRUE( on_demand );
+        ASSERT_EQ( expected->size( ), on_demand->size( ) );
+
+        for(size_t j = 0; j < expected->size( ); j++)
+        {
+            const snp_row &expected_row = expected->get_row( j );
+            const snp_row &row = on_demand->get_row( j );
+            ASSERT_EQ( num_samples, row.size( ) );
+            for(size_t i = 0; i < num_samples; i++)
+            {
+                ASSERT_EQ( expected_row[ i ], row[ i ] );
+            }
+
+            const snp_summary &summary = on_demand->get_summary( j );
+            for(int g = 0; g < 4; g++)
+            {
+                ASSERT_EQ( expected->get_summary( j ).counts[ g ], summary.counts[ g ] );
+            }
+        }
+
+        remove_plink_fixture( prefix );
+    }
+}
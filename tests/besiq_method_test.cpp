@@ -0,0 +1,68 @@
+#include <gtest/gtest.h>
+
+#include <armadillo>
+
+#include <besiq/method/besiq_method.hpp>
+#include <plink/snp_row.hpp>
+
+/**
+ * Number of samples.
+ */
+static const size_t NUM_SAMPLES = 120;
+
+/**
+ * Number of snps.
+ */
+static const size_t NUM_SNPS = 5;
+
+TEST(besiq_method_test, batch_same_as_run)
+{
+    std::vector<snp_row> rows( NUM_SNPS );
+    for(size_t j = 0; j < NUM_SNPS; j++)
+    {
+        rows[ j ].resize( NUM_SAMPLES );
+        for(size_t i = 0; i < NUM_SAMPLES; i++)
+        {
+            rows[ j ].assign( i, ( i * ( j + 3 ) + i / 7 ) % 23 == 0 ? 3 : ( i * ( j + 1 ) / 5 + j ) % 3 );
+        }
+    }
+
+    method_data_ptr data( new method_data( ) );
+    data->phenotype = arma::zeros<arma::vec>( NUM_SAMPLES );
+    data->missing = arma::zeros<arma::uvec>( NUM_SAMPLES );
+    for(size_t i = 0; i < NUM_SAMPLES; i++)
+    {
+        data->phenotype[ i ] = ( i % 3 ) == 0 || ( i % 7 ) == 1;
+        data->missing[ i ] = i % 31 == 0;
+    }
+    data->num_interactions = 10;
+    data->num_single = 5;
+    data->single_prior = 0.0;
+
+    std::vector<snp_row_pair> pairs;
+    for(size_t j = 0; j < NUM_SNPS; j++)
+    {
+        for(size_t k = j + 1; k < NUM_SNPS; k++)
+        {
+            pairs.push_back( snp_row_pair( &rows[ j ], &rows[ k ] ) );
+        }
+    }
+
+    besiq_method method( data );
+    std::vector<std::string> header = method.init( );
+    size_t num_columns = header.size( ) + 1;
+
+    std::vector<float> output( pairs.size( ) * num_columns, -9.0f );
+    std::vector<double> statistics( pairs.size( ), -9.0 );
+    std::vector<size_t> ok_samples( pairs.size( ), 0 );
+    method.run_batch( pairs, &output[ 0 ], num_columns, &statistics[ 0 ], &ok_samples[ 0 ] );
+
+    for(size_t i = 0; i < pairs.size( ); i++)
+    {
+        float expected = -9.0f;
+        double statistic = method.run( *pairs[ i ].first, *pairs[ i ].second, &expected );
+        ASSERT_DOUBLE_EQ( statistic, statistics[ i ] );
+        ASSERT_FLOAT_EQ( expected, output[ i * num_columns ] );
+        ASSERT_FLOAT_EQ( -9.0f, output[ i * num_columns + 1 ] );
+    }
+}
@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+
+#include <armadillo>
+#include <cmath>
+
+#include <besiq/stats/binomial_models.hpp>
+#include <besiq/stats/closed_form_table.hpp>
+#include <besiq/stats/normal_models.hpp>
+
+/**
+ * Compares the log likelihoods of a closed_form_table with the
+ * closed form models that it replaces.
+ *
+ * @param table The table.
+ * @param models The full, null, snp1 and snp2 models in the order
+ *               of closed_form_model_index.
+ * @param count The joint counts of a pair.
+ */
+static void
+expect_same_likelihoods(const closed_form_table &table, closed_form_model **models, const arma::mat &count)
+{
+    double loglik[ CLOSED_FORM_NUM_MODELS ];
+    table.log_likelihoods( count, loglik );
+
+    double lr[ CLOSED_FORM_NUM_MODELS ];
+    table.likelihood_ratios( count, lr );
+
+    double full = models[ CLOSED_FORM_FULL ]->prob( count ).log_value( );
+    for(int i = 0; i < CLOSED_FORM_NUM_MODELS; i++)
+    {
+        double expected = models[ i ]->prob( count ).log_value( );
+        EXPECT_NEAR( expected, loglik[ i ], 1e-8 * ( 1.0 + fabs( expected ) ) );
+        EXPECT_NEAR( -2.0 * ( expected - full ), lr[ i ], 1e-7 * ( 1.0 + fabs( expected ) ) );
+        EXPECT_EQ( models[ i ]->df( ), closed_form_table::df( i ) );
+    }
+}
+
+TEST(closed_form_table_test, binomial)
+{
+    /* Controls and cases of each genotype combination. */
+    double cells[ 9 ][ 2 ] = { { 10, 5 }, { 7, 3 }, { 4, 4 }, { 12, 2 }, { 6, 6 }, { 3, 9 }, { 8, 1 }, { 2, 5 }, { 5, 5 } };
+    arma::mat count( 9, 2 );
+    for(int i = 0; i < 9; i++)
+    {
+        count( i, 0 ) = cells[ i ][ 0 ];
+        count( i, 1 ) = cells[ i ][ 1 ];
+    }
+
+    binomial_full full;
+    binomial_null null;
+    binomial_single snp1( true );
+    binomial_single snp2( false );
+    closed_form_model *models[] = { &full, &null, &snp1, &snp2 };
+
+    /* Integer counts are looked up, the others are computed. */
+    expect_same_likelihoods( closed_form_table( false, 200 ), models, count );
+    expect_same_likelihoods( closed_form_table( false ), models, count );
+    arma::mat weighted = count * 0.75;
+    expect_same_likelihoods( closed_form_table( false, 200 ), models, weighted );
+}
+
+TEST(closed_form_table_test, normal)
+{
+    /* Sum of the phenotype, number of samples and sum of squares of each genotype combination. */
+    arma::mat count = arma::zeros<arma::mat>( 9, 3 );
+    for(int i = 0; i < 9; i++)
+    {
+        int n = 3 + i % 4;
+        for(int k = 0; k < n; k++)
+        {
+            double y = 0.5 * i + 0.3 * k - 0.1 * ( k % 2 ) * i;
+            count( i, 0 ) += y;
+            count( i, 1 ) += 1;
+            count( i, 2 ) += y * y;
+        }
+    }
+
+    normal_full full;
+    normal_null null;
+    normal_single snp1( true );
+    normal_single snp2( false );
+    closed_form_model *models[] = { &full, &null, &snp1, &snp2 };
+
+    expect_same_likelihoods( closed_form_table( true ), models, count );
+}
@@ -87,6 +87,56 @@ TEST_F(snp_count_test, joint_count2)
     ASSERT_NEAR( count( 8, 1 ), 0.0, 0.00001 );
 }
 
+TEST_F(snp_count_test, joint_count_mask)
+{
+    arma::uvec missing = arma::zeros<arma::uvec>( 5 );
+    phenotype_mask mask = make_phenotype_mask( phenotype, missing );
+    arma::mat count = joint_count( row1, row2, mask );
+    arma::mat expected = joint_count( row1, row2, phenotype, weight );
+
+    for(int i = 0; i < 9; i++)
+    {
+        ASSERT_NEAR( count( i, 0 ), expected( i, 0 ), 0.00001 );
+        ASSERT_NEAR( count( i, 1 ), expected( i, 1 ), 0.00001 );
+    }
+
+    /* Missing samples are not counted. */
+    missing[ 1 ] = 1;
+    mask = make_phenotype_mask( phenotype, missing );
+    count = joint_count( row1, row2, mask );
+    ASSERT_NEAR( count( 4, 1 ), 1.0, 0.00001 );
+}
+
+TEST_F(snp_count_test, joint_count_phenotypes)
+{
+    /* The second phenotype is missing for sample 2. */
+    arma::mat phenotypes( 2, 5 );
+    phenotypes.row( 0 ) = arma::trans( phenotype );
+    phenotypes.row( 1 ) = arma::trans( phenotype * 2.0 + 1.0 );
+    phenotypes( 1, 2 ) = 0.0;
+    arma::mat weights( 2, 5 );
+    weights.row( 0 ) = arma::trans( weight );
+    weights.row( 1 ) = arma::trans( weight );
+    weights( 1, 2 ) = 0.0;
+    arma::mat count = joint_count_phenotypes( row1, row2, phenotypes, weights );
+    ASSERT_NEAR( count( 4, 1 ), 2.0, 0.00001 );
+    ASSERT_NEAR( count( 4, 4 ), 1.0, 0.00001 );
+
+    for(int p = 0; p < 2; p++)
+    {
+        arma::vec y = arma::trans( phenotypes.row( p ) );
+        arma::vec w = arma::trans( weights.row( p ) );
+        arma::mat expected = joint_count_cont( row1, row2, y, w );
+        for(int i = 0; i < 9; i++)
+        {
+            for(int j = 0; j < 3; j++)
+            {
+                ASSERT_NEAR( count( i, 3 * p + j ), expected( i, j ), 0.00001 );
+            }
+        }
+    }
+}
+
 TEST_F(snp_count_test, pheno_count)
 {
     arma::vec count = pheno_count( row1, row2, phenotype, weight );
@@ -108,6 +158,76 @@ TEST_F(snp_count_test, single_count)
     ASSERT_NEAR( count( 2, 1 ), 0.0, 0.00001 );
 }
 
+TEST(snp_count_sparse_test, joint_count_sparse)
+{
+    /* Rare snps over a few words, with missing genotypes and samples. */
+    snp_row rare1;
+    snp_row rare2;
+    rare1.resize( 70 );
+    rare2.resize( 70 );
+    arma::vec pheno( 70 );
+    arma::uvec missing = arma::zeros<arma::uvec>( 70 );
+    for(int i = 0; i < 70; i++)
+    {
+        rare1.assign( i, i % 7 == 0 ? ( i / 7 ) % 4 : 0 );
+        rare2.assign( i, i % 5 == 0 ? ( i / 5 ) % 4 : 0 );
+        pheno[ i ] = i % 3 == 0;
+        missing[ i ] = i % 11 == 0;
+    }
+
+    sparse_row sparse1( rare1 );
+    sparse_row sparse2( rare2 );
+    ASSERT_EQ( sparse1.size( ), 70u );
+    ASSERT_EQ( sparse1.num_entries( ), 7u );
+    ASSERT_EQ( sparse1.indices( )[ 0 ], 7u );
+    ASSERT_EQ( sparse1.genotypes( )[ 0 ], 1 );
+
+    phenotype_mask mask = make_phenotype_mask( pheno, missing );
+    arma::mat expected = joint_count( rare1, rare2, mask );
+    arma::mat sparse_dense = joint_count( sparse1, rare2, mask );
+    arma::mat dense_sparse = joint_count( rare1, sparse2, mask );
+    arma::mat sparse_sparse = joint_count( sparse1, sparse2, mask );
+    arma::mat sparse_marginal = joint_count( sparse1, rare2, mask, marginal_count( rare2, mask ) );
+    arma::mat marginal_sparse = joint_count( rare1, sparse2, mask, marginal_count( rare1, mask ) );
+    for(int i = 0; i < 9; i++)
+    {
+        for(int j = 0; j < 2; j++)
+        {
+            ASSERT_NEAR( sparse_dense( i, j ), expected( i, j ), 0.00001 );
+            ASSERT_NEAR( dense_sparse( i, j ), expected( i, j ), 0.00001 );
+            ASSERT_NEAR( sparse_sparse( i, j ), expected( i, j ), 0.00001 );
+            ASSERT_NEAR( sparse_marginal( i, j ), expected( i, j ), 0.00001 );
+            ASSERT_NEAR( marginal_sparse( i, j ), expected( i, j ), 0.00001 );
+        }
+    }
+}
+
+TEST(snp_count_sparse_test, marginal_count)
+{
+    snp_row row;
+    row.resize( 70 );
+    arma::vec pheno( 70 );
+    arma::uvec missing = arma::zeros<arma::uvec>( 70 );
+    arma::mat expected = arma::zeros<arma::mat>( 3, 2 );
+    for(int i = 0; i < 70; i++)
+    {
+        row.assign( i, i % 4 );
+        pheno[ i ] = i % 3 == 0;
+        missing[ i ] = i % 11 == 0;
+        if( i % 4 != 3 && i % 11 != 0 )
+        {
+            expected( i % 4, pheno[ i ] )++;
+        }
+    }
+
+    arma::mat count = marginal_count( row, make_phenotype_mask( pheno, missing ) );
+    for(int g = 0; g < 3; g++)
+    {
+        ASSERT_NEAR( count( g, 0 ), expected( g, 0 ), 0.00001 );
+        ASSERT_NEAR( count( g, 1 ), expected( g, 1 ), 0.00001 );
+    }
+}
+
 TEST(snp_count_maf_test, compute_maf)
 {
     snp_row row;
@@ -128,3 +248,105 @@ TEST(snp_count_maf_test, compute_maf)
     ASSERT_NEAR( maf[ 1 ], 0.5, 0.00001 );
     ASSERT_NEAR( maf[ 2 ], 0.25, 0.00001 );
 }
+
+/**
+ * Creates rows and a phenotype that are long enough to split the
+ * samples of a pair between threads.
+ */
+static void
+make_long_pair(snp_row &row1, snp_row &row2, arma::vec &pheno, arma::vec &weight, arma::uvec &missing)
+{
+    size_t n = 2 * COUNT_SAMPLES_PER_THREAD + 123;
+    row1.resize( n );
+    row2.resize( n );
+    pheno = arma::zeros<arma::vec>( n );
+    weight = arma::zeros<arma::vec>( n );
+    missing = arma::zeros<arma::uvec>( n );
+    for(size_t i = 0; i < n; i++)
+    {
+        row1.assign( i, ( i * 7 + i / 13 ) % 4 );
+        row2.assign( i, ( i * 5 + i / 17 ) % 4 );
+        pheno[ i ] = ( i % 3 ) == 0;
+        /* Dyadic weights so that the sums are exact in any order. */
+        weight[ i ] = 0.25 * ( 1 + i % 5 );
+        missing[ i ] = ( i % 29 ) == 0;
+    }
+}
+
+TEST(snp_count_threads_test, same_for_all_threads)
+{
+    snp_row row1;
+    snp_row row2;
+    arma::vec pheno;
+    arma::vec weight;
+    arma::uvec missing;
+    make_long_pair( row1, row2, pheno, weight, missing );
+    phenotype_mask mask = make_phenotype_mask( pheno, missing );
+
+    set_count_threads( 1 );
+    ASSERT_EQ( get_count_threads( pheno.n_elem ), 1 );
+    arma::mat weighted = joint_count( row1, row2, pheno, weight );
+    arma::mat masked = joint_count( row1, row2, mask );
+    arma::mat cont = joint_count_cont( row1, row2, pheno, weight );
+
+    set_count_threads( 4 );
+    ASSERT_EQ( get_count_threads( pheno.n_elem ), 2 );
+    ASSERT_EQ( get_pair_threads( pheno.n_elem, 100 ), 1 );
+    arma::mat weighted_threads = joint_count( row1, row2, pheno, weight );
+    arma::mat masked_threads = joint_count( row1, row2, mask );
+    arma::mat cont_threads = joint_count_cont( row1, row2, pheno, weight );
+    set_count_threads( 1 );
+
+    for(int i = 0; i < 9; i++)
+    {
+        for(int j = 0; j < 2; j++)
+        {
+            ASSERT_EQ( weighted( i, j ), weighted_threads( i, j ) );
+            ASSERT_EQ( masked( i, j ), masked_threads( i, j ) );
+        }
+        for(int j = 0; j < 3; j++)
+        {
+            ASSERT_EQ( cont( i, j ), cont_threads( i, j ) );
+        }
+    }
+}
+
+TEST_F(snp_count_test, joint_count_batch)
+{
+    snp_row row3;
+    row3.resize( 5 );
+    for(int i = 0; i < 5; i++)
+    {
+        row3.assign( i, ( i + 2 ) % 4 );
+    }
+
+    std::vector<snp_row_pair> pairs;
+    for(int i = 0; i < 20; i++)
+    {
+        pairs.push_back( snp_row_pair( i % 2 ? &row1 : &row3, i % 3 ? &row2 : &row3 ) );
+    }
+
+    /* Few samples, so the pairs are split between the threads. */
+    set_count_threads( 4 );
+    ASSERT_EQ( get_pair_threads( 5, pairs.size( ) ), 4 );
+    ASSERT_EQ( get_pair_threads( 5, 2 ), 2 );
+    std::vector<arma::mat> counts = joint_count( pairs, phenotype, weight );
+    std::vector<arma::mat> conts = joint_count_cont( pairs, phenotype, weight );
+    set_count_threads( 1 );
+
+    ASSERT_EQ( counts.size( ), pairs.size( ) );
+    ASSERT_EQ( conts.size( ), pairs.size( ) );
+    for(size_t k = 0; k < pairs.size( ); k++)
+    {
+        arma::mat count = joint_count( *pairs[ k ].first, *pairs[ k ].second, phenotype, weight );
+        arma::mat cont = joint_count_cont( *pairs[ k ].first, *pairs[ k ].second, phenotype, weight );
+        for(int i = 0; i < 9; i++)
+        {
+            ASSERT_EQ( count( i, 0 ), counts[ k ]( i, 0 ) );
+            ASSERT_EQ( count( i, 1 ), counts[ k ]( i, 1 ) );
+            ASSERT_EQ( cont( i, 0 ), conts[ k ]( i, 0 ) );
+            ASSERT_EQ( cont( i, 1 ), conts[ k ]( i, 1 ) );
+            ASSERT_EQ( cont( i, 2 ), conts[ k ]( i, 2 ) );
+        }
+    }
+}
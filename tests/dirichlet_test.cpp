@@ -34,3 +34,28 @@ TEST(DirichletTest, Binomial)
     ASSERT_NEAR( exp( lbinomial( 4, 2 ) ), 6.0, 0.0001 );
     ASSERT_NEAR( exp( lbinomial( 14, 3 ) ), 364.0, 0.0001 );
 }
+
+TEST(DirichletTest, Table)
+{
+    double alpha_data[] = { 2.0, 3.5 };
+    vec alpha( alpha_data, 2 );
+    ldirmult_table table( alpha, 100 );
+
+    /* Integer counts within, at and beyond the table, and weighted counts. */
+    double x_data[][ 2 ] = { { 0.0, 0.0 }, { 3.0, 17.0 }, { 100.0, 0.0 }, { 80.0, 60.0 }, { 2.5, 7.25 } };
+    for(int i = 0; i < 5; i++)
+    {
+        vec x( x_data[ i ], 2 );
+        ASSERT_NEAR( table.compute( x ), ldirmult( x, alpha ), 1e-9 );
+    }
+
+    /* Tables with the same alpha share lgamma values, also when they have different sizes. */
+    ldirmult_table small( alpha, 10 );
+    ldirmult_table large( alpha, 200 );
+    for(int i = 0; i < 5; i++)
+    {
+        vec x( x_data[ i ], 2 );
+        ASSERT_NEAR( small.compute( x ), ldirmult( x, alpha ), 1e-9 );
+        ASSERT_NEAR( large.compute( x ), ldirmult( x, alpha ), 1e-9 );
+    }
+}
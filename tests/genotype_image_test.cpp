@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <besiq/io/genotype_image.hpp>
+#include <plink/plink_file.hpp>
+
+#include "plink_fixture.hpp"
+
+/**
+ * Number of samples, not a multiple of 4 so that the last byte
+ * of each row in the .bed file is padded.
+ */
+static const size_t NUM_SAMPLES = 70;
+
+/**
+ * Number of snps.
+ */
+static const size_t NUM_SNPS = 4;
+
+/**
+ * Returns the genotype of a sample before mafflip, snp 1 is rare,
+ * snp 2 has missing samples and snp 3 is rare after mafflip.
+ */
+static unsigned char
+genotype(size_t snp, size_t sample)
+{
+    switch( snp )
+    {
+        case 0: return sample % 3;
+        case 1: return sample == 5 ? 1 : 0;
+        case 2: return sample % 7 == 0 ? 3 : sample % 2;
+        default: return sample == 10 ? 1 : 2;
+    }
+}
+
+TEST(genotype_image_test, cache_round_trip)
+{
+    std::string prefix = write_plink_fixture( "genotype_image_test", NUM_SAMPLES, NUM_SNPS, genotype, false );
+
+    ASSERT_TRUE( create_genotype_cache( prefix, open_plink_file( prefix, true ), true ) );
+    genotype_matrix_ptr expected = create_genotype_matrix( open_plink_file( prefix, true ) );
+    genotype_matrix_ptr cached = open_genotype_cache( prefix, open_plink_file( prefix, true ), true );
+    ASSERT_TRUE( cached );
+    ASSERT_FALSE( open_genotype_cache( prefix, open_plink_file( prefix, false ), false ) );
+
+    ASSERT_EQ( NUM_SNPS, cached->size( ) );
+    ASSERT_EQ( expected->get_snp_names( ), cached->get_snp_names( ) );
+    for(size_t j = 0; j < NUM_SNPS; j++)
+    {
+        std::string name = expected->get_snp_names( )[ j ];
+        const snp_row *expected_row = expected->get_row( name );
+        const snp_row *cached_row = cached->get_row( name );
+        ASSERT_TRUE( cached_row != NULL );
+        ASSERT_EQ( NUM_SAMPLES, cached_row->size( ) );
+        for(size_t i = 0; i < NUM_SAMPLES; i++)
+        {
+            ASSERT_EQ( (*expected_row)[ i ], (*cached_row)[ i ] );
+        }
+
+        const snp_summary &expected_summary = expected->get_summary( j );
+        const snp_summary &cached_summary = cached->get_summary( j );
+        for(int k = 0; k < 4; k++)
+        {
+            ASSERT_EQ( expected_summary.counts[ k ], cached_summary.counts[ k ] );
+        }
+        ASSERT_FLOAT_EQ( expected_summary.maf, cached_summary.maf );
+        ASSERT_FLOAT_EQ( expected_summary.call_rate, cached_summary.call_rate );
+        ASSERT_EQ( expected_summary.minor_count, cached_summary.minor_count );
+
+        const sparse_row *expected_sparse = expected->get_sparse_row( name );
+        const sparse_row *cached_sparse = cached->get_sparse_row( name );
+        ASSERT_EQ( expected_sparse != NULL, cached_sparse != NULL );
+        if( cached_sparse != NULL )
+        {
+            ASSERT_EQ( expected_sparse->indices( ), cached_sparse->indices( ) );
+        }
+    }
+
+    ASSERT_TRUE( cached->get_sparse_row( "rs1" ) != NULL );
+    ASSERT_TRUE( cached->get_sparse_row( "rs3" ) != NULL );
+    ASSERT_TRUE( cached->get_sparse_row( "rs0" ) == NULL );
+    ASSERT_EQ( 10, cached->get_summary( 2 ).counts[ 3 ] );
+
+    remove_plink_fixture( prefix );
+    unlink( ( prefix + GENOTYPE_CACHE_EXTENSION ).c_str( ) );
+}
@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+
+#include <limits>
+#include <sstream>
+
+#include <besiq/pair_summary.hpp>
+
+TEST(pair_summary_test, top_and_merge)
+{
+    pair_summary first( 2, true );
+    pair_summary *second = first.create_empty( );
+
+    first.add( std::make_pair( "rs1", "rs2" ), 0.5f );
+    first.add( std::make_pair( "rs1", "rs3" ), 0.005f );
+    second->add( std::make_pair( "rs2", "rs3" ), 0.0005f );
+    second->add( std::make_pair( "rs2", "rs4" ), 0.9f );
+    first.merge( *second );
+    delete second;
+
+    std::stringstream output;
+    first.write( output );
+
+    std::string line;
+    std::getline( output, line );
+    ASSERT_EQ( "snp1 snp2\tP", line );
+    std::getline( output, line );
+    ASSERT_EQ( "rs2 rs3\t0.0005", line );
+    std::getline( output, line );
+    ASSERT_EQ( "rs1 rs3\t0.005", line );
+
+    std::getline( output, line );
+    ASSERT_EQ( "mlog10p_start\tmlog10p_end\tcount", line );
+    std::getline( output, line );
+    ASSERT_EQ( "0\t1\t2", line );
+    std::getline( output, line );
+    ASSERT_EQ( "1\t2\t0", line );
+    std::getline( output, line );
+    ASSERT_EQ( "2\t3\t1", line );
+    std::getline( output, line );
+    ASSERT_EQ( "3\t4\t1", line );
+}
+
+TEST(pair_summary_test, higher_is_better)
+{
+    pair_summary summary( 2, true );
+    summary.set_statistic( "Posterior", true );
+    ASSERT_FALSE( summary.is_pvalue( ) );
+
+    summary.add( std::make_pair( "rs1", "rs2" ), 0.5f );
+    summary.add( std::make_pair( "rs1", "rs3" ), 0.01f );
+    summary.add( std::make_pair( "rs2", "rs3" ), 0.99f );
+
+    std::stringstream output;
+    summary.write( output );
+
+    std::string line;
+    std::getline( output, line );
+    ASSERT_EQ( "snp1 snp2\tPosterior", line );
+    std::getline( output, line );
+    ASSERT_EQ( "rs2 rs3\t0.99", line );
+    std::getline( output, line );
+    ASSERT_EQ( "rs1 rs2\t0.5", line );
+
+    std::getline( output, line );
+    ASSERT_EQ( "Posterior_start\tPosterior_end\tcount", line );
+    std::getline( output, line );
+    ASSERT_EQ( "0\t0.05\t1", line );
+    for(int i = 1; i <= 10; i++)
+    {
+        std::getline( output, line );
+    }
+    ASSERT_EQ( "0.5\t0.55\t1", line );
+}
+
+TEST(pair_summary_test, ignores_nan)
+{
+    pair_summary summary( 2, true );
+    summary.add( std::make_pair( "rs1", "rs2" ), std::numeric_limits<float>::quiet_NaN( ) );
+    summary.add( std::make_pair( "rs1", "rs3" ), 0.5f );
+    summary.add( std::make_pair( "rs2", "rs3" ), std::numeric_limits<float>::quiet_NaN( ) );
+    summary.add( std::make_pair( "rs2", "rs4" ), std::numeric_limits<float>::infinity( ) );
+
+    pair_summary *other = summary.create_empty( );
+    other->add( std::make_pair( "rs3", "rs4" ), std::numeric_limits<float>::quiet_NaN( ) );
+    summary.merge( *other );
+    delete other;
+
+    std::stringstream output;
+    summary.write( output );
+
+    std::string line;
+    std::getline( output, line );
+    ASSERT_EQ( "snp1 snp2\tP", line );
+    std::getline( output, line );
+    ASSERT_EQ( "rs1 rs3\t0.5", line );
+
+    std::getline( output, line );
+    ASSERT_EQ( "mlog10p_start\tmlog10p_end\tcount", line );
+    std::getline( output, line );
+    ASSERT_EQ( "0\t1\t1", line );
+    while( std::getline( output, line ) )
+    {
+        ASSERT_EQ( "\t0", line.substr( line.size( ) - 2 ) );
+    }
+}
@@ -0,0 +1,128 @@
+#ifndef __PLINK_FIXTURE_H__
+#define __PLINK_FIXTURE_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+/**
+ * Writes small plink files for the tests. The genotypes are given
+ * by a function of the snp and the sample, coded as in snp_row with
+ * 3 for missing.
+ */
+typedef unsigned char (*fixture_genotype)(size_t snp, size_t sample);
+
+/**
+ * Creates an empty temporary file.
+ *
+ * @param name Prefix of the file name.
+ *
+ * @return The path to the file.
+ */
+inline std::string
+create_fixture_path(const std::string &name)
+{
+    std::string templ = "/tmp/" + name + "XXXXXX";
+    std::vector<char> path( templ.begin( ), templ.end( ) );
+    path.push_back( '\0' );
+    int fd = mkstemp( &path[ 0 ] );
+    close( fd );
+
+    return std::string( &path[ 0 ] );
+}
+
+/**
+ * Writes a snp-major .bed file.
+ *
+ * @param path The path to the file.
+ * @param num_samples Number of samples.
+ * @param num_snps Number of snps.
+ * @param genotype The genotype of each snp and sample.
+ * @param set_padding If true the padding bits of the last byte
+ *                    in each row are set instead of zero.
+ */
+inline void
+write_bed_fixture(const std::string &path, size_t num_samples, size_t num_snps, fixture_genotype genotype, bool set_padding)
+{
+    /* The plink code of genotype 0, 1, 2 and missing. */
+    const unsigned char codes[ 4 ] = { 0, 2, 3, 1 };
+
+    FILE *fp = fopen( path.c_str( ), "wb" );
+    unsigned char header[ 3 ] = { 0x6c, 0x1b, 0x01 };
+    fwrite( header, 1, 3, fp );
+    for(size_t j = 0; j < num_snps; j++)
+    {
+        for(size_t b = 0; b < ( num_samples + 3 ) / 4; b++)
+        {
+            unsigned char byte = 0;
+            for(size_t k = 0; k < 4; k++)
+            {
+                if( b * 4 + k < num_samples )
+                {
+                    byte |= codes[ genotype( j, b * 4 + k ) ] << ( 2 * k );
+                }
+                else if( set_padding )
+                {
+                    byte |= 3 << ( 2 * k );
+                }
+            }
+            fputc( byte, fp );
+        }
+    }
+    fclose( fp );
+}
+
+/**
+ * Writes a plink file, the snps are named rs0, rs1, ... and every
+ * other sample is a case.
+ *
+ * @param name Prefix of the file name.
+ * @param num_samples Number of samples.
+ * @param num_snps Number of snps.
+ * @param genotype The genotype of each snp and sample.
+ * @param set_padding If true the padding bits are set, see write_bed_fixture.
+ *
+ * @return The path to the plink file without extension.
+ */
+inline std::string
+write_plink_fixture(const std::string &name, size_t num_samples, size_t num_snps, fixture_genotype genotype, bool set_padding)
+{
+    std::string prefix = create_fixture_path( name );
+    write_bed_fixture( prefix + ".bed", num_samples, num_snps, genotype, set_padding );
+
+    FILE *bim = fopen( ( prefix + ".bim" ).c_str( ), "w" );
+    for(size_t j = 0; j < num_snps; j++)
+    {
+        fprintf( bim, "1\trs%d\t0\t%d\tA\tC\n", (int) j, (int) ( 1000 + j ) );
+    }
+    fclose( bim );
+
+    FILE *fam = fopen( ( prefix + ".fam" ).c_str( ), "w" );
+    for(size_t i = 0; i < num_samples; i++)
+    {
+        fprintf( fam, "f%d\ti%d\t0\t0\t1\t%d\n", (int) i, (int) i, (int) ( i % 2 + 1 ) );
+    }
+    fclose( fam );
+
+    return prefix;
+}
+
+/**
+ * Removes a plink file written by write_plink_fixture.
+ *
+ * @param prefix The path to the plink file without extension.
+ */
+inline void
+remove_plink_fixture(const std::string &prefix)
+{
+    const char *extensions[] = { "", ".bed", ".bim", ".fam" };
+    for(int i = 0; i < 4; i++)
+    {
+        unlink( ( prefix + extensions[ i ] ).c_str( ) );
+    }
+}
+
+#endif /* End of __PLINK_FIXTURE_H__ */
@@ -0,0 +1,539 @@
+#include <gtest/gtest.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <limits>
+
+#include <besiq/io/metaresult.hpp>
+#include <besiq/io/misc.hpp>
+#include <besiq/io/result_index.hpp>
+#include <besiq/io/result_sorter.hpp>
+#include <besiq/io/resultfile.hpp>
+
+/**
+ * Returns the value of record i in the test files, every 97th
+ * record is missing and every 89th is NaN.
+ */
+static float
+test_value(uint64_t i)
+{
+    if( i % 97 == 0 )
+    {
+        return result_get_missing( );
+    }
+    if( i % 89 == 0 )
+    {
+        return std::numeric_limits<float>::quiet_NaN( );
+    }
+
+    return ( ( i * 7919 ) % 1000 ) / 1000.0f;
+}
+
+/**
+ * Writes a result file where record i is the pair ( i % 5, ( i + 1 ) % 5 )
+ * with the value test_value( first + i ).
+ *
+ * @param output An output file, it will be opened.
+ * @param snp_names The snp names.
+ * @param first Value index of the first record.
+ * @param num_records The number of records.
+ */
+static void
+write_test_records(resultfile &output, const std::vector<std::string> &snp_names, uint64_t first, uint64_t num_records)
+{
+    std::vector<std::string> header;
+    header.push_back( "P" );
+
+    ASSERT_TRUE( output.open( ) );
+    ASSERT_TRUE( output.set_header( header ) );
+    for(uint64_t i = 0; i < num_records; i++)
+    {
+        float value = test_value( first + i );
+        ASSERT_TRUE( output.write( std::make_pair( snp_names[ i % 5 ], snp_names[ ( i + 1 ) % 5 ] ), &value ) );
+    }
+}
+
+/**
+ * Returns the test snp names rs0 to rs4.
+ */
+static std::vector<std::string>
+test_snp_names()
+{
+    std::vector<std::string> snp_names;
+    for(int i = 0; i < 5; i++)
+    {
+        snp_names.push_back( "rs" + std::string( 1, '0' + i ) );
+    }
+
+    return snp_names;
+}
+
+/**
+ * Keeps non-missing values that are at most a threshold, as
+ * besiq-view does.
+ */
+struct at_most : value_filter
+{
+    at_most(float y) : m_y( y ) { };
+    bool operator()(float x) const { return x != result_get_missing( ) && x <= m_y; };
+    bool may_match(float min, float max) const { return min <= m_y; };
+    float m_y;
+};
+
+TEST(resultfile_test, format_float)
+{
+    float values[] = { 0.0f, 1.0f, -2.5f, 0.1f, 1e-5f, 1.5e-30f, 123456.0f, 1234567.0f, 9.9999996f, 3.4e38f, 0.00012345678f };
+    char expected[ FORMAT_FLOAT_MAX_LENGTH ];
+    char actual[ FORMAT_FLOAT_MAX_LENGTH ];
+    for(int i = 0; i < sizeof( values ) / sizeof( float ); i++)
+    {
+        snprintf( expected, FORMAT_FLOAT_MAX_LENGTH, "%g", values[ i ] );
+        size_t length = format_float( values[ i ], actual );
+        ASSERT_STREQ( expected, actual );
+        ASSERT_EQ( strlen( expected ), length );
+    }
+}
+
+TEST(resultfile_test, block_writer)
+{
+    FILE *fp = tmpfile( );
+    {
+        block_writer writer( fp, 7, 2 );
+        for(int i = 0; i < 100; i++)
+        {
+            char c = 'a' + ( i % 26 );
+            ASSERT_TRUE( writer.write( &c, 1 ) );
+        }
+        ASSERT_TRUE( writer.write( "0123456789abcdef", 16 ) );
+        ASSERT_TRUE( writer.flush( ) );
+    }
+
+    ASSERT_EQ( 116, ftell( fp ) );
+    fseek( fp, 0L, SEEK_SET );
+    char buffer[ 116 ];
+    ASSERT_EQ( 116, fread( buffer, 1, 116, fp ) );
+    for(int i = 0; i < 100; i++)
+    {
+        ASSERT_EQ( 'a' + ( i % 26 ), buffer[ i ] );
+    }
+    ASSERT_EQ( 0, memcmp( buffer + 100, "0123456789abcdef", 16 ) );
+
+    fclose( fp );
+}
+
+TEST(resultfile_test, columnar)
+{
+    std::vector<std::string> snp_names;
+    snp_names.push_back( "rs1" );
+    snp_names.push_back( "rs2" );
+    snp_names.push_back( "rs3" );
+
+    std::vector<std::string> header;
+    header.push_back( "P" );
+
+    const char *path = "resultfile_test.cres";
+    int num_pairs = RESULT_BLOCK_NUM_PAIRS + 10;
+    {
+        cresultfile output( path, snp_names );
+        ASSERT_TRUE( output.open( ) );
+        ASSERT_TRUE( output.set_header( header ) );
+        for(int i = 0; i < num_pairs; i++)
+        {
+            float value = i < RESULT_BLOCK_NUM_PAIRS ? 0.5f : 1e-9f * i;
+            if( i % 3 == 0 )
+            {
+                value = result_get_missing( );
+            }
+            ASSERT_TRUE( output.write( std::make_pair( snp_names[ i % 3 ], snp_names[ ( i + 1 ) % 3 ] ), &value ) );
+        }
+    }
+
+    cresultfile input( path );
+    ASSERT_TRUE( input.open( ) );
+    ASSERT_EQ( num_pairs, input.num_pairs( ) );
+
+    ASSERT_TRUE( input.next_block( ) );
+    ASSERT_EQ( RESULT_BLOCK_NUM_PAIRS, input.block_num_pairs( ) );
+    ASSERT_FLOAT_EQ( 0.5f, input.block_min( 0 ) );
+    ASSERT_FLOAT_EQ( 0.5f, input.block_max( 0 ) );
+
+    ASSERT_TRUE( input.next_block( ) );
+    ASSERT_EQ( 10, input.block_num_pairs( ) );
+    const float *values = input.block_column( 0 );
+    ASSERT_TRUE( values != NULL );
+    ASSERT_FLOAT_EQ( 1e-9f * ( RESULT_BLOCK_NUM_PAIRS + 1 ), values[ 1 ] );
+
+    std::pair<std::string, std::string> pair;
+    float value;
+    ASSERT_TRUE( input.block_pair( 1, &pair, &value ) );
+    ASSERT_EQ( snp_names[ ( RESULT_BLOCK_NUM_PAIRS + 1 ) % 3 ], pair.first );
+    ASSERT_FALSE( input.next_block( ) );
+
+    remove( path );
+}
+
+TEST(resultfile_test, encoded_columns)
+{
+    std::vector<std::string> snp_names;
+    snp_names.push_back( "rs1" );
+    snp_names.push_back( "rs2" );
+
+    std::vector<std::string> header;
+    header.push_back( "LR" );
+    header.push_back( "P" );
+    header.push_back( "df" );
+
+    const char *path = "resultfile_test.bres";
+    float p_values[] = { 1.0f, 0.05f, 1.234e-8f, 3e-30f, 0.0f, result_get_missing( ) };
+    int num_pairs = sizeof( p_values ) / sizeof( float );
+    {
+        bresultfile output( path, snp_names );
+        ASSERT_TRUE( output.open( ) );
+        output.use_compact_encodings( );
+        ASSERT_TRUE( output.set_header( header ) );
+        for(int i = 0; i < num_pairs; i++)
+        {
+            float values[] = { 1.5f * i, p_values[ i ], (float) i };
+            ASSERT_TRUE( output.write( std::make_pair( snp_names[ 0 ], snp_names[ 1 ] ), values ) );
+        }
+    }
+
+    mresultfile input( path );
+    ASSERT_TRUE( input.open( ) );
+    ASSERT_FALSE( input.is_corrupted( ) );
+    ASSERT_EQ( num_pairs, input.num_records( ) );
+    ASSERT_EQ( RESULT_ENCODING_LOGP16, input.get_encodings( )[ 1 ] );
+
+    std::pair<std::string, std::string> pair;
+    float values[ 3 ];
+    for(int i = 0; i < num_pairs; i++)
+    {
+        ASSERT_TRUE( input.read( &pair, values ) );
+        ASSERT_EQ( snp_names[ 1 ], pair.second );
+        ASSERT_FLOAT_EQ( 1.5f * i, values[ 0 ] );
+        ASSERT_NEAR( p_values[ i ], values[ 1 ], fabs( p_values[ i ] ) * 0.0012f );
+        ASSERT_FLOAT_EQ( (float) i, values[ 2 ] );
+    }
+
+    bresultfile stream( path );
+    ASSERT_TRUE( stream.open( ) );
+    ASSERT_FALSE( stream.is_corrupted( ) );
+    ASSERT_TRUE( stream.read( &pair, values ) );
+    ASSERT_TRUE( stream.read( &pair, values ) );
+    ASSERT_NEAR( 0.05f, values[ 1 ], 0.05f * 0.0012f );
+
+    remove( path );
+}
+
+TEST(resultfile_test, default_encodings)
+{
+    const char *names[] = { "LR", "P", "df", "LR_bmi", "P_bmi", "df_bmi", "dfx", "N" };
+    const uint8_t expected[] = { RESULT_ENCODING_FLOAT, RESULT_ENCODING_LOGP16, RESULT_ENCODING_UINT8,
+                                 RESULT_ENCODING_FLOAT, RESULT_ENCODING_LOGP16, RESULT_ENCODING_UINT8,
+                                 RESULT_ENCODING_FLOAT, RESULT_ENCODING_FLOAT };
+    std::vector<std::string> col_names( names, names + 8 );
+
+    std::vector<uint8_t> encodings = result_default_encodings( col_names );
+    ASSERT_EQ( col_names.size( ), encodings.size( ) );
+    for(size_t i = 0; i < encodings.size( ); i++)
+    {
+        ASSERT_EQ( expected[ i ], encodings[ i ] ) << col_names[ i ];
+    }
+}
+
+TEST(resultfile_test, names_version)
+{
+    std::vector<std::string> snp_names;
+    snp_names.push_back( "rs1" );
+    snp_names.push_back( "rs2" );
+
+    std::vector<std::string> header;
+    header.push_back( "P" );
+
+    std::string packed_snp_names = pack_string( snp_names );
+    std::string packed_col_names = pack_string( header );
+
+    result_header old_header;
+    old_header.version = RESULT_NAMES_VERSION;
+    old_header.format = RESULT_FORMAT_FLOAT;
+    old_header.snp_names_length = packed_snp_names.size( ) + 1;
+    old_header.col_names_length = packed_col_names.size( ) + 1;
+    old_header.num_pairs = 1;
+    old_header.num_float_cols = 1;
+
+    const char *path = "resultfile_test_names.bres";
+    FILE *fp = fopen( path, "w" );
+    ASSERT_TRUE( fp != NULL );
+    uint32_t snps[] = { 1, 0 };
+    float p = 0.25f;
+    fwrite( &old_header, sizeof( result_header ), 1, fp );
+    fwrite( packed_snp_names.c_str( ), 1, old_header.snp_names_length, fp );
+    fwrite( packed_col_names.c_str( ), 1, old_header.col_names_length, fp );
+    fwrite( snps, sizeof( snps ), 1, fp );
+    fwrite( &p, sizeof( float ), 1, fp );
+    fclose( fp );
+
+    std::pair<std::string, std::string> pair;
+    float value;
+
+    bresultfile stream( path );
+    ASSERT_TRUE( stream.open( ) );
+    ASSERT_TRUE( stream.read( &pair, &value ) );
+    ASSERT_EQ( "rs2", pair.first );
+    ASSERT_EQ( "rs1", pair.second );
+    ASSERT_FLOAT_EQ( 0.25f, value );
+    ASSERT_EQ( snp_names, stream.get_snp_names( ) );
+
+    mresultfile mapped( path );
+    ASSERT_TRUE( mapped.open( ) );
+    ASSERT_TRUE( mapped.read( &pair, &value ) );
+    ASSERT_EQ( "rs2", pair.first );
+    ASSERT_EQ( 2, mapped.num_snps( ) );
+    mapped.close( );
+
+    /* A current version file must store a string table. */
+    old_header.version = RESULT_CUR_VERSION;
+    fp = fopen( path, "r+" );
+    fwrite( &old_header, sizeof( result_header ), 1, fp );
+    fclose( fp );
+
+    bresultfile invalid( path );
+    ASSERT_FALSE( invalid.open( ) );
+
+    remove( path );
+}
+
+TEST(resultfile_test, meta_filter)
+{
+    std::vector<std::string> snp_names = test_snp_names( );
+
+    /* The first file has two record ranges, the columnar file is filtered by blocks. */
+    uint64_t sizes[] = { META_RANGE_NUM_RECORDS + 1000, 5000, RESULT_BLOCK_NUM_PAIRS + 17 };
+    const char *paths[] = { "resultfile_test_meta1.bres", "resultfile_test_meta2.bres", "resultfile_test_meta3.cres" };
+    uint64_t first[ 3 ] = { 0, sizes[ 0 ], sizes[ 0 ] + sizes[ 1 ] };
+    {
+        bresultfile output1( paths[ 0 ], snp_names );
+        write_test_records( output1, snp_names, first[ 0 ], sizes[ 0 ] );
+        bresultfile output2( paths[ 1 ], snp_names );
+        write_test_records( output2, snp_names, first[ 1 ], sizes[ 1 ] );
+        cresultfile output3( paths[ 2 ], snp_names );
+        write_test_records( output3, snp_names, first[ 2 ], sizes[ 2 ] );
+    }
+
+    std::vector<uint64_t> expected;
+    for(int f = 0; f < 3; f++)
+    {
+        for(uint64_t i = 0; i < sizes[ f ]; i++)
+        {
+            if( at_most( 0.01f )( test_value( first[ f ] + i ) ) )
+            {
+                expected.push_back( first[ f ] + i );
+            }
+        }
+    }
+
+    int threads[] = { 1, 4 };
+    for(int t = 0; t < 2; t++)
+    {
+        std::vector<std::string> input_paths( paths, paths + 3 );
+        metaresultfile *meta = open_meta_result_file( input_paths );
+        const char *filtered_path = "resultfile_test_filtered.bres";
+        {
+            bresultfile filtered( filtered_path, snp_names );
+            ASSERT_TRUE( filtered.open( ) );
+            ASSERT_TRUE( filtered.set_header( meta->get_header( ) ) );
+            ASSERT_EQ( expected.size( ), meta->filter( 0, at_most( 0.01f ), &filtered, threads[ t ] ) );
+        }
+        delete meta;
+
+        /* The matches are written in file order. */
+        bresultfile filtered( filtered_path );
+        ASSERT_TRUE( filtered.open( ) );
+        std::pair<std::string, std::string> pair;
+        float value;
+        for(size_t k = 0; k < expected.size( ); k++)
+        {
+            ASSERT_TRUE( filtered.read( &pair, &value ) );
+            uint64_t f = expected[ k ] >= first[ 2 ] ? 2 : ( expected[ k ] >= first[ 1 ] ? 1 : 0 );
+            uint64_t i = expected[ k ] - first[ f ];
+            ASSERT_EQ( snp_names[ i % 5 ], pair.first );
+            ASSERT_EQ( snp_names[ ( i + 1 ) % 5 ], pair.second );
+            ASSERT_EQ( test_value( expected[ k ] ), value );
+        }
+        ASSERT_FALSE( filtered.read( &pair, &value ) );
+        remove( filtered_path );
+    }
+
+    for(int f = 0; f < 3; f++)
+    {
+        remove( paths[ f ] );
+    }
+}
+
+TEST(resultfile_test, result_index)
+{
+    std::vector<std::string> snp_names = test_snp_names( );
+    const char *path = "resultfile_test_index.bres";
+    {
+        bresultfile output( path, snp_names );
+        write_test_records( output, snp_names, 0, 200 );
+    }
+
+    const char *bim_path = "resultfile_test_index.bim";
+    FILE *bim = fopen( bim_path, "w" );
+    fprintf( bim, "1\trs0\t0\t100\tA\tC\n" );
+    fprintf( bim, "1\trs1\t0\t200\tA\tC\n" );
+    fprintf( bim, "2\trs2\t0\t150\tA\tC\n" );
+    fprintf( bim, "1\trs3\t0\t300\tA\tC\n" );
+    fprintf( bim, "2\trs4\t0\t50\tA\tC\n" );
+    fclose( bim );
+
+    {
+        mresultfile result( path );
+        ASSERT_TRUE( result.open( ) );
+        ASSERT_TRUE( build_result_index( result, path, bim_path ) );
+
+        result_index index( path );
+        ASSERT_TRUE( index.open( result ) );
+
+        /* Regions include both ends and are sorted by position. */
+        uint32_t rs1, rs3;
+        ASSERT_TRUE( result.find_snp( "rs1", &rs1 ) );
+        ASSERT_TRUE( result.find_snp( "rs3", &rs3 ) );
+        std::vector<uint32_t> snps = index.region_snps( "1", 150, 300 );
+        ASSERT_EQ( 2, snps.size( ) );
+        ASSERT_EQ( rs1, snps[ 0 ] );
+        ASSERT_EQ( rs3, snps[ 1 ] );
+        ASSERT_EQ( 0, index.region_snps( "1", 301, 400 ).size( ) );
+        ASSERT_EQ( 0, index.region_snps( "3", 0, 1000 ).size( ) );
+        ASSERT_EQ( 2, index.region_snps( "2", 0, 1000 ).size( ) );
+
+        /* Record i is the pair ( i % 5, ( i + 1 ) % 5 ). */
+        uint64_t length;
+        const uint64_t *records = index.snp_records( rs1, &length );
+        ASSERT_EQ( 80, length );
+        for(uint64_t k = 0; k < length; k++)
+        {
+            ASSERT_TRUE( records[ k ] % 5 == 0 || records[ k ] % 5 == 1 );
+            ASSERT_TRUE( k == 0 || records[ k - 1 ] < records[ k ] );
+        }
+    }
+
+    /* Touching the result file within the same second makes the index stale. */
+    struct stat st;
+    ASSERT_EQ( 0, stat( path, &st ) );
+    struct timespec times[ 2 ];
+    times[ 0 ] = st.st_atim;
+    times[ 1 ] = st.st_mtim;
+    times[ 1 ].tv_nsec = ( times[ 1 ].tv_nsec + 1 ) % 1000000000;
+    ASSERT_EQ( 0, utimensat( AT_FDCWD, path, times, 0 ) );
+    {
+        mresultfile result( path );
+        ASSERT_TRUE( result.open( ) );
+        result_index index( path );
+        ASSERT_FALSE( index.open( result ) );
+    }
+
+    /* A rewritten result file with more records is also rejected. */
+    {
+        mresultfile result( path );
+        ASSERT_TRUE( result.open( ) );
+        ASSERT_TRUE( build_result_index( result, path, bim_path ) );
+    }
+    {
+        bresultfile output( path, snp_names );
+        write_test_records( output, snp_names, 0, 201 );
+    }
+    {
+        mresultfile result( path );
+        ASSERT_TRUE( result.open( ) );
+        result_index index( path );
+        ASSERT_FALSE( index.open( result ) );
+    }
+
+    remove( path );
+    remove( bim_path );
+    remove( result_index_path( path ).c_str( ) );
+}
+
+TEST(resultfile_test, result_sorter)
+{
+    std::vector<std::string> snp_names = test_snp_names( );
+    std::vector<std::string> header;
+    header.push_back( "P" );
+    header.push_back( "index" );
+
+    /* Records are two snp indices, the value and the input index. */
+    const uint64_t num_records = 20000;
+    size_t record_size = sizeof( uint32_t ) * 2 + sizeof( float ) * 2;
+    size_t memories[] = { 64 * 1024, 64 * 1024 * 1024 };
+    for(int m = 0; m < 2; m++)
+    {
+        const char *path = "resultfile_test_sorted.bres";
+        {
+            bresultfile output( path, snp_names );
+            ASSERT_TRUE( output.open( ) );
+            ASSERT_TRUE( output.set_header( header ) );
+
+            result_sorter sorter( record_size, 0, memories[ m ] );
+            std::vector<char> record( record_size );
+            for(uint64_t i = 0; i < num_records; i++)
+            {
+                uint32_t snps[ 2 ] = { (uint32_t) ( i % 5 ), (uint32_t) ( ( i + 1 ) % 5 ) };
+                float values[ 2 ] = { test_value( i ), (float) i };
+                memcpy( &record[ 0 ], snps, sizeof( snps ) );
+                memcpy( &record[ sizeof( snps ) ], values, sizeof( values ) );
+                ASSERT_TRUE( sorter.add( &record[ 0 ] ) );
+            }
+            if( m == 0 )
+            {
+                ASSERT_GT( sorter.num_runs( ), 1 );
+            }
+            else
+            {
+                ASSERT_EQ( 0, sorter.num_runs( ) );
+            }
+            ASSERT_TRUE( sorter.merge( snp_names, &output ) );
+        }
+
+        /* Increasing values, then missing and NaN values, ties in input order. */
+        bresultfile input( path );
+        ASSERT_TRUE( input.open( ) );
+        std::pair<std::string, std::string> pair;
+        float values[ 2 ];
+        float prev_value = -1.0f;
+        bool prev_missing = false;
+        int64_t prev_index = -1;
+        for(uint64_t k = 0; k < num_records; k++)
+        {
+            ASSERT_TRUE( input.read( &pair, values ) );
+            uint64_t i = (uint64_t) values[ 1 ];
+            bool missing = result_is_missing_key( values[ 0 ] );
+            ASSERT_EQ( snp_names[ i % 5 ], pair.first );
+            ASSERT_TRUE( missing == result_is_missing_key( test_value( i ) ) );
+            ASSERT_TRUE( !prev_missing || missing );
+            if( !missing )
+            {
+                ASSERT_EQ( test_value( i ), values[ 0 ] );
+                ASSERT_LE( prev_value, values[ 0 ] );
+            }
+            if( missing == prev_missing && ( missing || values[ 0 ] == prev_value ) )
+            {
+                ASSERT_LT( prev_index, (int64_t) i );
+            }
+
+            prev_value = values[ 0 ];
+            prev_missing = missing;
+            prev_index = i;
+        }
+        ASSERT_TRUE( prev_missing );
+        ASSERT_FALSE( input.read( &pair, values ) );
+
+        remove( path );
+    }
+}
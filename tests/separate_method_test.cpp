@@ -0,0 +1,266 @@
+#include <gtest/gtest.h>
+
+#include <armadillo>
+#include <cmath>
+
+#include <dcdflib/libdcdf.hpp>
+#include <glm/glm.hpp>
+#include <glm/models/binomial.hpp>
+#include <glm/models/normal.hpp>
+
+#include <besiq/method/separate_method.hpp>
+#include <besiq/model_matrix.hpp>
+#include <plink/snp_row.hpp>
+
+/**
+ * Number of samples.
+ */
+static const size_t NUM_SAMPLES = 600;
+
+/**
+ * Returns a deterministic pseudo random number in [0, 1).
+ *
+ * @param i The sample.
+ * @param seed Selects the sequence.
+ */
+static double
+uniform(size_t i, unsigned int seed)
+{
+    unsigned int x = ( i + 1 ) * 2654435761u + seed * 40503u;
+    x ^= x >> 13;
+    x *= 1274126177u;
+    x ^= x >> 16;
+    return ( x % 100000 ) / 100000.0;
+}
+
+/**
+ * Returns a genotype with the given probabilities of 1 and 2,
+ * and a few missing samples.
+ */
+static unsigned char
+genotype(size_t i, unsigned int seed, double p1, double p2)
+{
+    double u = uniform( i, seed );
+    if( i % 37 == seed % 37 )
+    {
+        return 3;
+    }
+
+    return u < p2 ? 2 : ( u < p1 + p2 ? 1 : 0 );
+}
+
+/**
+ * Fits each coding on the samples with glm, the way separate_method
+ * did before the models were fitted on the joint table.
+ *
+ * @param row1 The first snp.
+ * @param row2 The second snp.
+ * @param data The phenotype and missing samples.
+ * @param model The glm model.
+ * @param output The 8 values of the pair, missing values are -9.
+ */
+static void
+glm_separate(const snp_row &row1, const snp_row &row2, method_data_ptr data, const glm_model &model, float *output)
+{
+    for(int mode = 0; mode < 4; mode++)
+    {
+        output[ 2*mode ] = -9;
+        output[ 2*mode + 1 ] = -9;
+
+        separate_matrix matrix( data->covariate_matrix, NUM_SAMPLES, (separate_mode_t) mode );
+        arma::uvec missing = data->missing;
+        matrix.update_matrix( row1, row2, missing );
+
+        glm_info alt_info;
+        arma::vec b = glm_fit( matrix.get_alt( ), data->phenotype, missing, model, alt_info );
+        glm_info null_info;
+        glm_fit( matrix.get_null( ), data->phenotype, missing, model, null_info );
+        if( !null_info.success || !alt_info.success )
+        {
+            continue;
+        }
+
+        try
+        {
+            double LR = -2 * ( null_info.logl - alt_info.logl );
+            output[ 2*mode + 1 ] = 1.0 - chi_square_cdf( LR, matrix.num_df( ) );
+            output[ 2*mode ] = b[ 2 ];
+        }
+        catch(bad_domain_value &e)
+        {
+        }
+    }
+}
+
+/**
+ * Runs separate_method on a pair and compares the beta and p-value of
+ * each coding with the glm fit on the samples. The p-values are
+ * compared closely so that they also check the log likelihoods.
+ *
+ * @param row1 The first snp.
+ * @param row2 The second snp.
+ * @param data The phenotype and missing samples.
+ * @param model The glm model.
+ */
+static void
+expect_same_as_glm(const snp_row &row1, const snp_row &row2, method_data_ptr data, glm_model *model)
+{
+    float expected[ 8 ];
+    glm_separate( row1, row2, data, *model, expected );
+
+    float actual[ 8 ] = { -9, -9, -9, -9, -9, -9, -9, -9 };
+    separate_method method( data, model );
+    method.init( );
+    method.run( row1, row2, actual );
+
+    for(int i = 0; i < 8; i++)
+    {
+        if( expected[ i ] == -9 )
+        {
+            EXPECT_EQ( -9, actual[ i ] ) << "value " << i;
+        }
+        else
+        {
+            EXPECT_NEAR( expected[ i ], actual[ i ], 1e-4 + 1e-3 * fabs( expected[ i ] ) ) << "value " << i;
+        }
+    }
+}
+
+/**
+ * Creates the method data with a binary phenotype that depends on the
+ * pair, samples in the cells of separated are all cases.
+ *
+ * @param row1 The first snp.
+ * @param row2 The second snp.
+ * @param separated Cells 3 * snp1 + snp2 that only have cases, or -1.
+ */
+static method_data_ptr
+binary_data(const snp_row &row1, const snp_row &row2, int separated)
+{
+    method_data_ptr data( new method_data( ) );
+    data->phenotype = arma::zeros<arma::vec>( NUM_SAMPLES );
+    data->missing = arma::zeros<arma::uvec>( NUM_SAMPLES );
+    for(size_t i = 0; i < NUM_SAMPLES; i++)
+    {
+        double g1 = row1[ i ] == 3 ? 0 : row1[ i ];
+        double g2 = row2[ i ] == 3 ? 0 : row2[ i ];
+        double eta = -0.5 + 0.3 * g1 + 0.2 * g2 + 0.4 * g1 * g2;
+        data->phenotype[ i ] = uniform( i, 99 ) < 1.0 / ( 1.0 + exp( -eta ) );
+        if( row1[ i ] != 3 && row2[ i ] != 3 && 3 * row1[ i ] + row2[ i ] == separated )
+        {
+            data->phenotype[ i ] = 1;
+        }
+        data->missing[ i ] = i % 53 == 0;
+    }
+
+    return data;
+}
+
+/**
+ * Creates a pair of snps.
+ *
+ * @param row1 The first snp will be stored here.
+ * @param row2 The second snp will be stored here.
+ * @param has_rare If false, the second snp has no homozygous minor samples.
+ */
+static void
+make_pair(snp_row &row1, snp_row &row2, bool has_rare)
+{
+    row1.resize( NUM_SAMPLES );
+    row2.resize( NUM_SAMPLES );
+    for(size_t i = 0; i < NUM_SAMPLES; i++)
+    {
+        row1.assign( i, genotype( i, 1, 0.45, 0.25 ) );
+        row2.assign( i, genotype( i, 2, 0.4, has_rare ? 0.3 : 0.0 ) );
+    }
+}
+
+TEST(separate_method_test, binomial)
+{
+    snp_row row1;
+    snp_row row2;
+    make_pair( row1, row2, true );
+
+    binomial model( "logit" );
+    expect_same_as_glm( row1, row2, binary_data( row1, row2, -1 ), &model );
+}
+
+TEST(separate_method_test, binomial_empty_cell)
+{
+    snp_row row1;
+    snp_row row2;
+    make_pair( row1, row2, false );
+
+    binomial model( "logit" );
+    expect_same_as_glm( row1, row2, binary_data( row1, row2, -1 ), &model );
+}
+
+TEST(separate_method_test, binomial_separated_cell)
+{
+    snp_row row1;
+    snp_row row2;
+    make_pair( row1, row2, true );
+
+    binomial model( "logit" );
+    expect_same_as_glm( row1, row2, binary_data( row1, row2, 3 * 2 + 2 ), &model );
+}
+
+TEST(separate_method_test, normal)
+{
+    snp_row row1;
+    snp_row row2;
+    make_pair( row1, row2, true );
+
+    method_data_ptr data( new method_data( ) );
+    data->phenotype = arma::zeros<arma::vec>( NUM_SAMPLES );
+    data->missing = arma::zeros<arma::uvec>( NUM_SAMPLES );
+    for(size_t i = 0; i < NUM_SAMPLES; i++)
+    {
+        double g1 = row1[ i ] == 3 ? 0 : row1[ i ];
+        double g2 = row2[ i ] == 3 ? 0 : row2[ i ];
+        data->phenotype[ i ] = 0.3 * g1 + 0.2 * g2 + 0.4 * g1 * g2 + uniform( i, 7 ) - 0.5;
+        data->missing[ i ] = i % 53 == 0;
+    }
+
+    normal model( "identity" );
+    expect_same_as_glm( row1, row2, data, &model );
+
+    make_pair( row1, row2, false );
+    expect_same_as_glm( row1, row2, data, &model );
+}
+
+TEST(separate_method_test, batch_same_as_run)
+{
+    snp_row row1;
+    snp_row row2;
+    make_pair( row1, row2, true );
+    snp_row rare1;
+    snp_row rare2;
+    make_pair( rare1, rare2, false );
+
+    std::vector<snp_row_pair> pairs;
+    pairs.push_back( snp_row_pair( &row1, &row2 ) );
+    pairs.push_back( snp_row_pair( &rare1, &rare2 ) );
+    pairs.push_back( snp_row_pair( &row2, &rare1 ) );
+
+    binomial model( "logit" );
+    separate_method method( binary_data( row1, row2, 3 * 2 + 2 ), &model );
+    size_t num_columns = method.init( ).size( ) + 1;
+
+    std::vector<float> output( pairs.size( ) * num_columns, -9.0f );
+    std::vector<double> statistics( pairs.size( ), -9.0 );
+    std::vector<size_t> ok_samples( pairs.size( ), 0 );
+    method.run_batch( pairs, &output[ 0 ], num_columns, &statistics[ 0 ], &ok_samples[ 0 ] );
+
+    for(size_t i = 0; i < pairs.size( ); i++)
+    {
+        float expected[ 8 ] = { -9, -9, -9, -9, -9, -9, -9, -9 };
+        double statistic = method.run( *pairs[ i ].first, *pairs[ i ].second, expected );
+        ASSERT_EQ( statistic, statistics[ i ] );
+        ASSERT_EQ( method.num_ok_samples( *pairs[ i ].first, *pairs[ i ].second ), ok_samples[ i ] );
+        for(int j = 0; j < 8; j++)
+        {
+            ASSERT_EQ( expected[ j ], output[ i * num_columns + j ] );
+        }
+    }
+}
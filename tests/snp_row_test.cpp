@@ -20,3 +20,28 @@ TEST(snp_row_test, test_assign)
         ASSERT_EQ( row[ i ], i % 4 );
     }
 }
+
+TEST(snp_row_test, test_select)
+{
+    snp_row row;
+    row.resize( 50 );
+
+    for(int i = 0; i < 50; i++)
+    {
+        row.assign( i, i % 4 );
+    }
+
+    std::vector<size_t> samples;
+    for(size_t i = 1; i < 50; i += 3)
+    {
+        samples.push_back( i );
+    }
+    row.select( samples );
+
+    ASSERT_EQ( row.size( ), samples.size( ) );
+    for(size_t i = 0; i < samples.size( ); i++)
+    {
+        ASSERT_EQ( row[ i ], samples[ i ] % 4 );
+    }
+    ASSERT_EQ( row.data( )[ 1 ] >> ( 2 * ( samples.size( ) % 16 ) ), 0u );
+}
@@ -0,0 +1,47 @@
+#include <gtest/gtest.h>
+
+#include <plink/snp_summary.hpp>
+
+TEST(snp_summary_test, test_summarize)
+{
+    snp_row row;
+    row.resize( 21 );
+
+    /* Genotypes 0 x 8, 1 x 6, 2 x 4 and 3 missing. */
+    unsigned char genotypes[ 21 ] = { 0, 1, 2, 3, 0, 1, 0, 0, 2, 1, 0, 3, 1, 0, 2, 1, 0, 3, 2, 1, 0 };
+    for(int i = 0; i < 21; i++)
+    {
+        row.assign( i, genotypes[ i ] );
+    }
+
+    snp_summary summary = summarize_snp( row );
+    ASSERT_EQ( summary.counts[ 0 ], 8 );
+    ASSERT_EQ( summary.counts[ 1 ], 6 );
+    ASSERT_EQ( summary.counts[ 2 ], 4 );
+    ASSERT_EQ( summary.counts[ 3 ], 3 );
+    ASSERT_EQ( summary.minor_count, 14 );
+    ASSERT_NEAR( summary.maf, 14.0 / 36.0, 1e-6 );
+    ASSERT_NEAR( summary.call_rate, 18.0 / 21.0, 1e-6 );
+
+    snp_row other;
+    other.resize( 21 );
+    other.assign( 0, 3 );
+    other.assign( 3, 3 );
+    other.assign( 20, 3 );
+    ASSERT_EQ( count_called( row, other ), 16 );
+}
+
+TEST(snp_summary_test, test_all_missing)
+{
+    snp_row row;
+    row.resize( 5 );
+    for(int i = 0; i < 5; i++)
+    {
+        row.assign( i, 3 );
+    }
+
+    snp_summary summary = summarize_snp( row );
+    ASSERT_EQ( summary.counts[ 3 ], 5 );
+    ASSERT_EQ( summary.maf, 0.0 );
+    ASSERT_EQ( summary.minor_count, 0 );
+}
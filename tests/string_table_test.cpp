@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+
+#include <besiq/io/pairfile.hpp>
+#include <besiq/io/string_table.hpp>
+
+TEST(string_table_test, pack_and_find)
+{
+    std::vector<std::string> names;
+    for(int i = 0; i < 1000; i++)
+    {
+        char name[ 16 ];
+        snprintf( name, sizeof( name ), "rs%d", i * 7 );
+        names.push_back( name );
+    }
+
+    std::string packed = string_table::pack( names );
+    string_table table;
+    ASSERT_TRUE( table.open( packed.data( ), packed.size( ) ) );
+    ASSERT_EQ( names.size( ), table.size( ) );
+    ASSERT_STREQ( "rs70", table.get( 10 ) );
+
+    uint32_t index;
+    ASSERT_TRUE( table.find( "rs6993", &index ) );
+    ASSERT_EQ( 999, index );
+    ASSERT_FALSE( table.find( "rs6994", &index ) );
+    ASSERT_EQ( names, table.to_vector( ) );
+
+    std::string packed_index = table.pack_index( );
+    string_table indexed;
+    ASSERT_TRUE( indexed.open( packed.data( ), packed.size( ) ) );
+    ASSERT_TRUE( indexed.open_index( packed_index.data( ), packed_index.size( ) ) );
+    ASSERT_TRUE( indexed.find( "rs70", &index ) );
+    ASSERT_EQ( 10, index );
+    ASSERT_FALSE( indexed.open_index( packed_index.data( ), packed_index.size( ) / 2 ) );
+
+    ASSERT_FALSE( table.open( packed.data( ), packed.size( ) - 1 ) );
+    ASSERT_EQ( 0, table.size( ) );
+}
+
+TEST(string_table_test, pair_file)
+{
+    std::vector<std::string> names;
+    names.push_back( "rs1" );
+    names.push_back( "rs2" );
+    names.push_back( "rs3" );
+
+    const char *path = "string_table_test.pair";
+    {
+        bpairfile output( path, names );
+        ASSERT_TRUE( output.open( ) );
+        ASSERT_TRUE( output.write( 0, 1 ) );
+        ASSERT_TRUE( output.write( 2, 1 ) );
+    }
+
+    bpairfile input( path );
+    ASSERT_TRUE( input.open( ) );
+    ASSERT_EQ( 2, input.num_pairs( ) );
+
+    std::pair<std::string, std::string> pair;
+    ASSERT_TRUE( input.read( pair ) );
+    ASSERT_EQ( "rs1", pair.first );
+    ASSERT_TRUE( input.read( pair ) );
+    ASSERT_EQ( "rs3", pair.first );
+    ASSERT_EQ( "rs2", pair.second );
+    ASSERT_FALSE( input.read( pair ) );
+    ASSERT_EQ( names, input.get_snp_names( ) );
+
+    remove( path );
+}
@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+
+#include <armadillo>
+#include <cmath>
+
+#include <besiq/method/wald_lm_method.hpp>
+#include <plink/snp_row.hpp>
+
+/**
+ * Number of samples, so that every cell has enough samples.
+ */
+static const size_t NUM_SAMPLES = 270;
+
+TEST(wald_lm_method_test, missing_secondary_phenotype)
+{
+    snp_row row1;
+    snp_row row2;
+    row1.resize( NUM_SAMPLES );
+    row2.resize( NUM_SAMPLES );
+
+    /* The second phenotype is missing for every seventh sample. */
+    arma::mat phenotypes( NUM_SAMPLES, 2 );
+    for(size_t i = 0; i < NUM_SAMPLES; i++)
+    {
+        row1.assign( i, i % 3 );
+        row2.assign( i, ( i / 3 ) % 3 );
+        phenotypes( i, 0 ) = 0.1 * ( i % 3 ) * ( ( i / 3 ) % 3 ) + 0.01 * ( i % 11 );
+        phenotypes( i, 1 ) = i % 7 == 0 ? arma::datum::nan : 0.5 * ( i % 3 ) + 0.02 * ( i % 13 );
+    }
+
+    method_data_ptr data( new method_data( ) );
+    data->missing = arma::zeros<arma::uvec>( NUM_SAMPLES );
+    data->phenotype = phenotypes.col( 0 );
+    data->phenotypes = phenotypes;
+    data->phenotype_names.push_back( "first" );
+    data->phenotype_names.push_back( "second" );
+
+    wald_lm_method method( data );
+    std::vector<std::string> header = method.init( );
+    ASSERT_EQ( 6u, header.size( ) );
+    ASSERT_EQ( "P_second", header[ 4 ] );
+
+    float output[ 6 ] = { -9, -9, -9, -9, -9, -9 };
+    double p = method.run( row1, row2, output );
+    ASSERT_EQ( NUM_SAMPLES, method.num_ok_samples( row1, row2 ) );
+
+    /* Each phenotype gives the same result as when it is tested alone. */
+    for(int k = 0; k < 2; k++)
+    {
+        method_data_ptr single( new method_data( ) );
+        single->missing = arma::zeros<arma::uvec>( NUM_SAMPLES );
+        single->phenotype = phenotypes.col( k );
+        for(size_t i = 0; i < NUM_SAMPLES; i++)
+        {
+            if( !arma::is_finite( single->phenotype[ i ] ) )
+            {
+                single->missing[ i ] = 1;
+                single->phenotype[ i ] = 0.0;
+            }
+        }
+
+        wald_lm_method single_method( single );
+        float expected[ 3 ] = { -9, -9, -9 };
+        single_method.run( row1, row2, expected );
+        for(int j = 0; j < 3; j++)
+        {
+            ASSERT_NEAR( expected[ j ], output[ 3 * k + j ], 1e-4 * ( 1.0 + fabs( expected[ j ] ) ) );
+        }
+        ASSERT_LE( p, expected[ 1 ] + 1e-6 );
+    }
+}